@@ -195,7 +195,12 @@ int      da2_standalone_enabled                 = 0;              /* (C) video o
 uint32_t mem_size                               = 0;              /* (C) memory size (Installed on
                                                                          system board)*/
 uint32_t isa_mem_size                           = 0;              /* (C) memory size (ISA Memory Cards) */
+int      mem_huge_pages                         = 0;              /* (C) back guest RAM with huge pages */
+int      mem_mergeable                          = 0;              /* (C) let the host merge identical
+                                                                         guest RAM pages */
 int      cpu_use_dynarec                        = 0;              /* (C) cpu uses/needs Dyna */
+int      cpu_dynarec_cache                      = 0;              /* (C) keep compiled block list across runs */
+int      cpu_dynarec_stats                      = 0;              /* (C) write dynarec statistics on exit */
 int      cpu                                    = 0;              /* (C) cpu type */
 int      fpu_type                               = 0;              /* (C) fpu type */
 int      fpu_softfloat                          = 0;              /* (C) fpu uses softfloat */
@@ -676,6 +681,7 @@ pc_show_usage(char *s)
             "-I or --image d:path\t\t- load 'path' as floppy image on drive d\n"
 #ifdef USE_INSTRUMENT
             "-J or --instrument name\t- set 'name' to be the profiling instrument\n"
+            "-K or --storagebench path\t- run the storage benchmark script in 'path'\n"
 #endif
             "-L or --logfile path\t\t- set 'path' to be the logfile\n"
             "-M or --missing\t\t- dump missing machines and video cards\n"
@@ -945,6 +951,10 @@ usage:
                 goto usage;
             instru_enabled = 1;
             sscanf(argv[++c], "%llu", &instru_run_ms);
+        } else if (!strcasecmp(argv[c], "--storagebench") || !strcasecmp(argv[c], "-K")) {
+            if ((c + 1) == argc)
+                goto usage;
+            hdd_bench_path = argv[++c];
 #endif
         }
 
@@ -1498,6 +1508,10 @@ pc_reset_hard_close(void)
 {
     ui_sb_set_ready(0);
 
+#if defined(USE_DYNAREC) && defined(USE_NEW_DYNAREC)
+    codegen_cache_save();
+#endif
+
     /* Close all the memory mappings. */
     mem_close();
 
@@ -1701,6 +1715,9 @@ pc_reset_hard_init(void)
 #endif
 #ifdef USE_DYNAREC
     cycles_main = 0;
+#    ifdef USE_NEW_DYNAREC
+    codegen_cache_load();
+#    endif
 #endif
 
     update_mouse_msg();
@@ -1772,6 +1789,12 @@ pc_close(UNUSED(thread_t *ptr))
 
     plat_mouse_capture(0);
 
+#if defined(USE_DYNAREC) && defined(USE_NEW_DYNAREC)
+    codegen_cache_save();
+    if (cpu_dynarec_stats)
+        codegen_stats_dump();
+#endif
+
     /* Close all the memory mappings. */
     mem_close();
 
@@ -1845,6 +1868,12 @@ pc_run(void)
         pc_reset_hard_init();
     }
 
+#ifdef USE_INSTRUMENT
+    /* The storage benchmark stops the CPU while it runs a job. */
+    if ((hdd_bench_path != NULL) && hdd_bench_frame())
+        return;
+#endif
+
     /* Update the guest-CPU independent timer for devices with independent clock speed */
     rivatimer_update_all();
 
@@ -1863,6 +1892,9 @@ pc_run(void)
     joystick_process(0); // Gameport 0
     endblit();
 
+    /* Flush hard disk writes held back for longer than their timeout. */
+    hdd_image_process();
+
     /* Done with this frame, update statistics. */
     framecount++;
     if (++framecountx >= (force_10ms ? 100 : 1000)) {
@@ -1896,6 +1928,11 @@ pc_onesec(void)
     fps        = framecount;
     framecount = 0;
 
+    mem_recalc_onesec();
+#if defined(USE_DYNAREC) && defined(USE_NEW_DYNAREC)
+    codegen_stats_onesec();
+#endif
+
     title_update = 1;
 }
 
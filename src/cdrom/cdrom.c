@@ -362,6 +362,39 @@ cdrom_is_sector_good(cdrom_t *dev, const uint8_t *b, const uint8_t mode2, const
     return ret;
 }
 
+/* Calls into the back end, serialized with its read-ahead thread. */
+static int
+cdrom_get_track_info(const cdrom_t *dev, const uint32_t track, const int end, track_info_t *ti)
+{
+    int ret;
+
+    cdrom_cache_io_lock(dev);
+    ret = dev->ops->get_track_info(dev->local, track, end, ti);
+    cdrom_cache_io_unlock(dev);
+
+    return ret;
+}
+
+static void
+cdrom_get_raw_track_info(const cdrom_t *dev, int *num, uint8_t *rti)
+{
+    cdrom_cache_io_lock(dev);
+    dev->ops->get_raw_track_info(dev->local, num, rti);
+    cdrom_cache_io_unlock(dev);
+}
+
+static uint8_t
+cdrom_get_track_type(const cdrom_t *dev, const uint32_t lba)
+{
+    uint8_t ret;
+
+    cdrom_cache_io_lock(dev);
+    ret = dev->ops->get_track_type(dev->local, lba);
+    cdrom_cache_io_unlock(dev);
+
+    return ret;
+}
+
 static int
 read_data(cdrom_t *dev, const uint32_t lba, int check)
 {
@@ -371,8 +404,7 @@ read_data(cdrom_t *dev, const uint32_t lba, int check)
     if (dev->cached_sector != lba) {
         dev->cached_sector = lba;
 
-        ret = dev->ops->read_sector(dev->local,
-                                    dev->raw_buffer[dev->cur_buf ^ 1], lba);
+        ret = cdrom_cache_read(dev, dev->raw_buffer[dev->cur_buf ^ 1], lba, CDROM_CACHE_DATA);
 
         if ((ret > 0) && check) {
             if (dev->mode2) {
@@ -529,7 +561,7 @@ read_toc_normal(const cdrom_t *dev, unsigned char *b,
     cdrom_log(dev->log, "read_toc_normal(%016" PRIXPTR ", %016" PRIXPTR ", %02X, %i, %i)\n",
               (uintptr_t) dev, (uintptr_t) b, start_track, msf, sony);
 
-    dev->ops->get_raw_track_info(dev->local, &num, rti);
+    cdrom_get_raw_track_info(dev, &num, rti);
 
     if (num > 0) {
         int j = 0;
@@ -622,7 +654,7 @@ read_toc_session(const cdrom_t *dev, unsigned char *b, const int msf)
     int                     num        = 0;
     int                     len        = 4;
 
-    dev->ops->get_raw_track_info(dev->local, &num, rti);
+    cdrom_get_raw_track_info(dev, &num, rti);
 
     /* Bytes 2 and 3 = Number of first and last sessions */
     read_toc_identify_sessions((raw_track_info_t *) rti, num, b);
@@ -698,7 +730,7 @@ read_toc_raw(const cdrom_t *dev, unsigned char *b, const unsigned char start_tra
     cdrom_log(dev->log, "read_toc_raw(%016" PRIXPTR ", %016" PRIXPTR ", %02X)\n",
               (uintptr_t) dev, (uintptr_t) b, start_track);
 
-    dev->ops->get_raw_track_info(dev->local, &num, rti);
+    cdrom_get_raw_track_info(dev, &num, rti);
 
     if (num != 0)  for (int i = 0; i < num; i++)
         if (t[i].session >= start_track) {
@@ -1054,6 +1086,9 @@ cdrom_unload(cdrom_t *dev)
     dev->cd_status     = CD_STATUS_EMPTY;
     dev->cached_sector = -1;
 
+    cdrom_audio_stream_close(dev);
+    cdrom_cache_close(dev);
+
     if (dev->local != NULL) {
         dev->ops->close(dev->local);
         dev->local = NULL;
@@ -1476,20 +1511,15 @@ cdrom_seek(cdrom_t *dev, const uint32_t pos, const uint8_t vendor_type)
 int
 cdrom_is_pre(const cdrom_t *dev, const uint32_t lba)
 {
-    if (dev->ops && dev->ops->is_track_pre)
-        return dev->ops->is_track_pre(dev->local, lba);
+    int ret = 0;
 
-    return 0;
-}
-
-#include <86box/filters.h>
+    if (dev->ops && dev->ops->is_track_pre) {
+        cdrom_cache_io_lock(dev);
+        ret = dev->ops->is_track_pre(dev->local, lba);
+        cdrom_cache_io_unlock(dev);
+    }
 
-static void
-cdrom_audio_deemphasize(int16_t *buffer)
-{
-    for (int i = 0; i < 588; i++)
-        for (int j = 0; j < 2; j++)
-            buffer[(i * 2) + j] = deemph_iir(j, buffer[(i * 2) + j]);
+    return ret;
 }
 
 int
@@ -1499,27 +1529,19 @@ cdrom_audio_callback(cdrom_t *dev, int16_t *output, const int len)
 
     while (dev->cd_buflen < len) {
         if (dev->seek_pos < dev->cd_end) {
-            ret = dev->ops->read_sector(dev->local,
-                                        dev->raw_buffer[dev->cur_buf ^ 1],
-                                        dev->seek_pos);
-            if (!dev->sound_on)
+            /* Decoded ahead of time, silenced if it is a data sector
+               and de-emphasized if needed. */
+            ret = cdrom_audio_stream_read(dev, dev->seek_pos, dev->cd_end,
+                                          dev->raw_buffer[dev->cur_buf ^ 1],
+                                          &(dev->cd_buffer[dev->cd_buflen]));
+            if (!dev->sound_on) {
                 memset(dev->raw_buffer[dev->cur_buf ^ 1], 0x00, 2352);
+                memset(&(dev->cd_buffer[dev->cd_buflen]), 0x00, RAW_SECTOR_SIZE);
+            }
             dev->cur_buf ^= 1;
             if (ret) {
                 cdrom_log(dev->log, "Read LBA %08X successful\n", dev->seek_pos);
                 dev->cached_sector = dev->seek_pos;
-                /* Q subchannel data in bit 6: 4-5-6-7-0-1-2-3. */
-                if ((dev->raw_buffer[dev->cur_buf][2353] >> 6) & 0x01)
-                    /* Data sector, copy silence into buffer. */
-                    memset((uint8_t *) &(dev->cd_buffer[dev->cd_buflen]),
-                           0x00, RAW_SECTOR_SIZE);
-                else {
-                    memcpy((uint8_t *) &(dev->cd_buffer[dev->cd_buflen]),
-                           dev->raw_buffer[dev->cur_buf], RAW_SECTOR_SIZE);
-                    if ((dev->raw_buffer[dev->cur_buf][2355] >> 6) & 0x01)
-                        /* De-emphasize pre-emphasized audio. */
-                        cdrom_audio_deemphasize(&(dev->cd_buffer[dev->cd_buflen]));
-                }
                 dev->seek_pos++;
                 dev->cd_buflen += (RAW_SECTOR_SIZE / 2);
                 ret = 1;
@@ -1567,7 +1589,7 @@ cdrom_audio_play(cdrom_t *dev, const uint32_t pos, const uint32_t len, const int
             pos2 = ismsf & 0xff;
             if ((dev->is_bcd || dev->is_chinon) && (pos2 < 0xa0))
                 pos2 = bcd2bin(pos2);
-            ret = dev->ops->get_track_info(dev->local, ismsf & 0xff, 0, &ti);
+            ret = cdrom_get_track_info(dev, ismsf & 0xff, 0, &ti);
             if (ret)
                pos2 += MSFtoLBA(ti.m, ti.s, ti.f) - 150;
             else {
@@ -1578,7 +1600,7 @@ cdrom_audio_play(cdrom_t *dev, const uint32_t pos, const uint32_t len, const int
         } else if ((ismsf == 2) || (ismsf == 3)) {
             if ((dev->is_bcd || dev->is_chinon) && (pos2 < 0xa0))
                 pos2 = bcd2bin(pos2);
-            ret = dev->ops->get_track_info(dev->local, pos2, 0, &ti);
+            ret = cdrom_get_track_info(dev, pos2, 0, &ti);
             if (ret) {
                 pos2 = MSFtoLBA(ti.m, ti.s, ti.f) - 150;
                 if (ismsf == 2) {
@@ -1586,7 +1608,7 @@ cdrom_audio_play(cdrom_t *dev, const uint32_t pos, const uint32_t len, const int
                        not at the beginning. */
                     if ((dev->is_bcd || dev->is_chinon) && (len2 < 0xa0))
                         len2 = bcd2bin(len2);
-                    ret = dev->ops->get_track_info(dev->local, len2, 1, &ti);
+                    ret = cdrom_get_track_info(dev, len2, 1, &ti);
                     if (ret)
                         len2 = MSFtoLBA(ti.m, ti.s, ti.f) - 150;
                     else {
@@ -1644,7 +1666,7 @@ cdrom_audio_play(cdrom_t *dev, const uint32_t pos, const uint32_t len, const int
            Do this at this point, since it's at this point that we know the
            actual LBA position to start playing from.
          */
-        ret = (dev->ops->get_track_type(dev->local, pos2) == CD_TRACK_AUDIO);
+        ret = (cdrom_get_track_type(dev, pos2) == CD_TRACK_AUDIO);
 
         if (ret) {
             dev->seek_diff     = ABS(dev->seek_pos - pos2);
@@ -1700,7 +1722,7 @@ cdrom_audio_track_search(cdrom_t *dev, const uint32_t pos,
                 pos2 = (pos2 >> 24) & 0xff;
                 if (pos2 < 0xa0)
                     pos2 = bcd2bin(pos2);
-                ret = dev->ops->get_track_info(dev->local, pos2, 1, &ti);
+                ret = cdrom_get_track_info(dev, pos2, 1, &ti);
                 if (ret)
                     dev->seek_pos = MSFtoLBA(ti.m, ti.s, ti.f) - 150;
                 else {
@@ -1753,7 +1775,7 @@ cdrom_audio_track_search_pioneer(cdrom_t *dev, const uint32_t pos, const uint8_t
            Do this at this point, since it's at this point that we know the
            actual LBA position to start playing from.
          */
-        if (dev->ops->get_track_type(dev->local, pos2) & CD_TRACK_AUDIO) {
+        if (cdrom_get_track_type(dev, pos2) & CD_TRACK_AUDIO) {
             dev->cd_end    = dev->cdrom_capacity;
             dev->cd_buflen = 0;
 
@@ -1818,7 +1840,7 @@ cdrom_audio_play_toshiba(cdrom_t *dev, const uint32_t pos, const int type)
                 pos2 = (pos2 >> 24) & 0xff;
                 if (pos2 < 0xa0)
                     pos2 = bcd2bin(pos2);
-                ret = dev->ops->get_track_info(dev->local, pos2, 1, &ti);
+                ret = cdrom_get_track_info(dev, pos2, 1, &ti);
                 if (ret)
                     dev->cd_end = MSFtoLBA(ti.m, ti.s, ti.f) - 150;
                 else {
@@ -1866,7 +1888,7 @@ cdrom_audio_scan(cdrom_t *dev, const uint32_t pos)
 
         /* Do this at this point, since it's at this point that we know the
            actual LBA position to start playing from. */
-        if (dev->ops->get_track_type(dev->local, pos) & CD_TRACK_AUDIO) {
+        if (cdrom_get_track_type(dev, pos) & CD_TRACK_AUDIO) {
             dev->cd_buflen = 0;
             ret            = 1;
         } else {
@@ -2202,7 +2224,7 @@ cdrom_get_track_buffer(cdrom_t *dev, uint8_t *buf)
     int               last        = -1;
 
     if (dev != NULL)
-        dev->ops->get_raw_track_info(dev->local, &num, rti);
+        cdrom_get_raw_track_info(dev, &num, rti);
 
     if (num > 0) {
         first = find_track(trti, num, 1);
@@ -2252,11 +2274,11 @@ cdrom_mitsumi_audio_play(cdrom_t *dev, uint32_t pos, uint32_t len)
     if (dev->cd_status & CD_STATUS_HAS_AUDIO) {
         cdrom_log(dev->log, "Play Mitsumi audio - %08X %08X\n", pos, len);
 
-        ret = dev->ops->get_track_info(dev->local, pos, 0, &ti);
+        ret = cdrom_get_track_info(dev, pos, 0, &ti);
 
         if (ret) {
             pos = MSFtoLBA(ti.m, ti.s, ti.f) - 150;
-            ret = dev->ops->get_track_info(dev->local, len, 1, &ti);
+            ret = cdrom_get_track_info(dev, len, 1, &ti);
 
             if (ret) {
                 len = MSFtoLBA(ti.m, ti.s, ti.f) - 150;
@@ -2265,7 +2287,7 @@ cdrom_mitsumi_audio_play(cdrom_t *dev, uint32_t pos, uint32_t len)
                    Do this at this point, since it's at this point that we know the
                    actual LBA position to start playing from.
                  */
-                ret = (dev->ops->get_track_type(dev->local, pos) == CD_TRACK_AUDIO);
+                ret = (cdrom_get_track_type(dev, pos) == CD_TRACK_AUDIO);
 
                 if (ret) {
                     dev->seek_pos  = pos;
@@ -2306,7 +2328,7 @@ cdrom_read_disc_info_toc(cdrom_t *dev, uint8_t *b,
     cdrom_log(dev->log, "Read DISC Info TOC Type = %d, track = %d\n", type, track);
 
     dev->inv_field = track;
-    dev->ops->get_raw_track_info(dev->local, &num, rti);
+    cdrom_get_raw_track_info(dev, &num, rti);
 
     switch (type) {
         case 0:
@@ -2449,7 +2471,7 @@ cdrom_is_track_audio(cdrom_t *dev, const int sector,
                                       cdrom_sector_type, vendor_type);
 
     if (dev->ops->get_track_type)
-        audio = dev->ops->get_track_type(dev->local, lba);
+        audio = cdrom_get_track_type(dev, lba);
 
     audio        &= CD_TRACK_AUDIO;
 
@@ -2488,7 +2510,7 @@ cdrom_readsector_raw(cdrom_t *dev, uint8_t *buffer, const int sector, const int
         *len = 0;
 
         if (dev->ops->get_track_type)
-            audio = dev->ops->get_track_type(dev->local, lba);
+            audio = cdrom_get_track_type(dev, lba);
 
         const int dm  = audio & CD_TRACK_MODE_MASK;
         audio        &= CD_TRACK_AUDIO;
@@ -2611,8 +2633,11 @@ cdrom_read_dvd_structure(const cdrom_t *dev, const uint8_t layer, const uint8_t
         if (dev->cd_status != CD_STATUS_DVD) {
             *info = format;
             ret   = -(SENSE_ILLEGAL_REQUEST << 16) | (ASC_INCOMPATIBLE_FORMAT << 8);
-        } else if ((dev->ops != NULL) && (dev->ops->read_dvd_structure != NULL))
+        } else if ((dev->ops != NULL) && (dev->ops->read_dvd_structure != NULL)) {
+            cdrom_cache_io_lock(dev);
             ret   = dev->ops->read_dvd_structure(dev->local, layer, format, buffer, info);
+            cdrom_cache_io_unlock(dev);
+        }
     }
 
     if (ret == 0)  switch (format) {
@@ -2740,7 +2765,7 @@ cdrom_read_disc_information(const cdrom_t *dev, uint8_t *buffer)
     int               ls_last    = 0;
     int               t_b0       = -1;
 
-    dev->ops->get_raw_track_info(dev->local, &num, rti);
+    cdrom_get_raw_track_info(dev, &num, rti);
 
     for (int i = 0; i < num; i++)
         if (t[i].session > sessions)
@@ -2818,7 +2843,7 @@ cdrom_read_track_information(cdrom_t *dev, const uint8_t *cdb, uint8_t *buffer)
     int                     num        = 0;
     int                     ret;
 
-    dev->ops->get_raw_track_info(dev->local, &num, rti);
+    cdrom_get_raw_track_info(dev, &num, rti);
 
     switch (cdb[1] & 0x03) {
         default:
@@ -2960,6 +2985,9 @@ cdrom_set_empty(cdrom_t *dev)
 {
     dev->cd_status      = CD_STATUS_EMPTY;
     dev->cached_sector  = -1;
+
+    cdrom_cache_flush(dev);
+    cdrom_audio_stream_flush(dev);
 }
 
 void
@@ -2967,6 +2995,11 @@ cdrom_update_status(cdrom_t *dev)
 {
     const int  was_empty = (dev->cd_status == CD_STATUS_EMPTY);
 
+    cdrom_cache_flush(dev);
+    cdrom_audio_stream_flush(dev);
+
+    cdrom_cache_io_lock(dev);
+
     if (dev->ops->load != NULL)
         dev->ops->load(dev->local);
 
@@ -2986,6 +3019,8 @@ cdrom_update_status(cdrom_t *dev)
     dev->cached_sector  = -1;
     dev->cdrom_capacity = dev->ops->get_last_block(dev->local);
 
+    cdrom_cache_io_unlock(dev);
+
     if ((dev->cd_status != CD_STATUS_EMPTY) && (dev->cd_status != CD_STATUS_DVD_REJECTED)) {
         /* Signal media change to the emulated machine. */
         cdrom_insert(dev->id);
@@ -3043,6 +3078,9 @@ cdrom_load(cdrom_t *dev, const char *fn, const int skip_insert)
 
         cdrom_log(dev->log, "CD-ROM capacity: %i sectors (%" PRIi64 " bytes)\n",
                   dev->cdrom_capacity, ((uint64_t) dev->cdrom_capacity) << 11ULL);
+
+        cdrom_cache_open(dev);
+        cdrom_audio_stream_open(dev);
     }
 
 #ifdef ENABLE_CDROM_LOG
@@ -0,0 +1,319 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          CD-ROM audio decoding ahead of playback.
+ *
+ *          While a drive plays audio, a thread reads the following
+ *          sectors, including those of compressed audio files from
+ *          CUE sheets, silences data sectors, de-emphasizes the audio
+ *          and queues the results in a single producer, single consumer
+ *          ring. The sound thread then only has to copy them out, and
+ *          neither waits on host I/O nor takes any lock while the
+ *          decoder keeps up.
+ *
+ * Authors: 86Box developers
+ *
+ *          Copyright 2026 86Box developers.
+ */
+#ifdef ENABLE_CDROM_AUDIO_STREAM_LOG
+#include <stdarg.h>
+#endif
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <wchar.h>
+#include <86box/86box.h>
+#include <86box/cdrom.h>
+#include <86box/log.h>
+#include <86box/thread.h>
+
+#define CDROM_AUDIO_STREAM_SLOTS  64 /* Must be a power of 2. */
+#define CDROM_AUDIO_STREAM_SECTOR 2448
+#define CDROM_DEEMPH_TAPS         3
+
+/* History of the de-emphasis filter, per channel. */
+typedef struct cdrom_deemph_t {
+    double x[2][CDROM_DEEMPH_TAPS]; /* Input samples. */
+    double y[2][CDROM_DEEMPH_TAPS]; /* Output samples. */
+} cdrom_deemph_t;
+
+typedef struct cdrom_audio_stream_slot_t {
+    uint32_t lba;
+    uint32_t session;
+    int      ret;
+    uint8_t  raw[CDROM_AUDIO_STREAM_SECTOR];
+    int16_t  samples[RAW_SECTOR_SIZE / 2];
+} cdrom_audio_stream_slot_t;
+
+typedef struct cdrom_audio_stream_t {
+    cdrom_t                  *dev;
+
+    thread_t                 *thread;
+    event_t                  *wake;
+    mutex_t                  *lock; /* Restarts of the decoding. */
+    volatile int              stop;
+
+    atomic_uint               session;
+    atomic_uint               end;
+    uint32_t                  next;
+
+    /* Used by the decoder only, restarted along with the decoding. */
+    cdrom_deemph_t            deemph;
+    uint32_t                  deemph_session;
+    uint32_t                  deemph_next;
+
+    /* Written by the decoder only. */
+    atomic_uint               head;
+    /* Written by the sound thread only. */
+    atomic_uint               tail;
+
+    cdrom_audio_stream_slot_t slots[CDROM_AUDIO_STREAM_SLOTS];
+} cdrom_audio_stream_t;
+
+#ifdef ENABLE_CDROM_AUDIO_STREAM_LOG
+int cdrom_audio_stream_do_log = ENABLE_CDROM_AUDIO_STREAM_LOG;
+
+static void
+cdrom_audio_stream_log(void *priv, const char *fmt, ...)
+{
+    if (cdrom_audio_stream_do_log) {
+        va_list ap;
+        va_start(ap, fmt);
+        log_out(priv, fmt, ap);
+        va_end(ap);
+    }
+}
+#else
+#    define cdrom_audio_stream_log(priv, fmt, ...)
+#endif
+
+/* fc=5.283kHz, gain=-9.477dB, width=0.4845 */
+static const double deemph_a[CDROM_DEEMPH_TAPS] = {
+    0.46035077886318842566,
+    -0.28440821191249848754,
+    0.03388877229118691936
+};
+
+static const double deemph_b[CDROM_DEEMPH_TAPS] = {
+    1.00000000000000000000,
+    -1.05429146278569141337,
+    0.26412280202756849290
+};
+
+static void
+cdrom_audio_deemphasize(cdrom_deemph_t *f, int16_t *buffer)
+{
+    double *x;
+    double *y;
+
+    for (int i = 0; i < 588; i++)
+        for (int j = 0; j < 2; j++) {
+            x = f->x[j];
+            y = f->y[j];
+
+            /* Shift the old samples. */
+            for (int n = CDROM_DEEMPH_TAPS - 1; n > 0; n--) {
+                x[n] = x[n - 1];
+                y[n] = y[n - 1];
+            }
+
+            x[0] = buffer[(i * 2) + j];
+            y[0] = deemph_a[0] * x[0];
+            for (int n = 1; n < CDROM_DEEMPH_TAPS; n++)
+                y[0] += deemph_a[n] * x[n] - deemph_b[n] * y[n];
+
+            buffer[(i * 2) + j] = (int16_t) y[0];
+        }
+}
+
+/* Read a sector and turn it into the samples to play, de-emphasizing with
+   the filter history in f. */
+static int
+cdrom_audio_stream_decode(cdrom_t *dev, const uint32_t lba, uint8_t *raw, int16_t *samples,
+                          cdrom_deemph_t *f)
+{
+    const int ret = cdrom_cache_read(dev, raw, lba, CDROM_CACHE_AUDIO);
+
+    if (ret <= 0)
+        return ret;
+
+    /* Q subchannel data in bit 6: 4-5-6-7-0-1-2-3. */
+    if ((raw[2353] >> 6) & 0x01)
+        /* Data sector, copy silence into buffer. */
+        memset(samples, 0x00, RAW_SECTOR_SIZE);
+    else {
+        memcpy(samples, raw, RAW_SECTOR_SIZE);
+        if ((raw[2355] >> 6) & 0x01)
+            /* De-emphasize pre-emphasized audio. */
+            cdrom_audio_deemphasize(f, samples);
+    }
+
+    return ret;
+}
+
+static void
+cdrom_audio_stream_thread(void *priv)
+{
+    cdrom_audio_stream_t      *stream = (cdrom_audio_stream_t *) priv;
+    cdrom_t                   *dev    = stream->dev;
+    cdrom_audio_stream_slot_t *slot;
+    uint32_t                   session;
+    uint32_t                   head;
+    uint32_t                   lba;
+
+    while (!stream->stop) {
+        thread_wait_event(stream->wake, -1);
+        thread_reset_event(stream->wake);
+
+        while (!stream->stop) {
+            head = atomic_load_explicit(&stream->head, memory_order_relaxed);
+            if ((head - atomic_load_explicit(&stream->tail, memory_order_acquire)) >= CDROM_AUDIO_STREAM_SLOTS)
+                break;
+
+            thread_wait_mutex(stream->lock);
+            if (stream->next >= atomic_load(&stream->end)) {
+                thread_release_mutex(stream->lock);
+                break;
+            }
+            lba     = stream->next++;
+            session = atomic_load(&stream->session);
+            thread_release_mutex(stream->lock);
+
+            /* Do not carry the filter history over a restart or seek. */
+            if ((session != stream->deemph_session) || (lba != stream->deemph_next)) {
+                memset(&stream->deemph, 0, sizeof(cdrom_deemph_t));
+                stream->deemph_session = session;
+            }
+            stream->deemph_next = lba + 1;
+
+            slot          = &stream->slots[head & (CDROM_AUDIO_STREAM_SLOTS - 1)];
+            slot->lba     = lba;
+            slot->session = session;
+            slot->ret     = cdrom_audio_stream_decode(dev, lba, slot->raw, slot->samples, &stream->deemph);
+
+            atomic_store_explicit(&stream->head, head + 1, memory_order_release);
+        }
+    }
+}
+
+/* Called from the sound thread to get the samples of the sector at lba,
+   playback ending at end. The raw sector, with its subchannel data, is
+   also returned, the result is that of the read_sector operation of the
+   drive's back end. */
+int
+cdrom_audio_stream_read(cdrom_t *dev, const uint32_t lba, const uint32_t end,
+                        uint8_t *raw, int16_t *samples)
+{
+    cdrom_audio_stream_t      *stream = (cdrom_audio_stream_t *) dev->audio_stream;
+    cdrom_audio_stream_slot_t *slot   = NULL;
+    cdrom_deemph_t             deemph = { 0 };
+    uint32_t                   session;
+    uint32_t                   head;
+    uint32_t                   tail;
+    int                        ret;
+
+    if (stream == NULL)
+        return cdrom_audio_stream_decode(dev, lba, raw, samples, &deemph);
+
+    session = atomic_load(&stream->session);
+    atomic_store(&stream->end, end);
+
+    /* Drop whatever was decoded for an earlier position or medium. */
+    head = atomic_load_explicit(&stream->head, memory_order_acquire);
+    tail = atomic_load_explicit(&stream->tail, memory_order_relaxed);
+    while (tail != head) {
+        slot = &stream->slots[tail & (CDROM_AUDIO_STREAM_SLOTS - 1)];
+        if ((slot->session == session) && (slot->lba == lba))
+            break;
+        slot = NULL;
+        tail++;
+    }
+
+    if (slot != NULL) {
+        memcpy(raw, slot->raw, CDROM_AUDIO_STREAM_SECTOR);
+        memcpy(samples, slot->samples, RAW_SECTOR_SIZE);
+        ret = slot->ret;
+        atomic_store_explicit(&stream->tail, tail + 1, memory_order_release);
+    } else {
+        atomic_store_explicit(&stream->tail, tail, memory_order_release);
+
+        cdrom_audio_stream_log(dev->log, "Audio stream: LBA %08X not decoded, restarting\n", lba);
+
+        /* Playback started or jumped, decode this sector here and have
+           the thread continue from the next one. */
+        thread_wait_mutex(stream->lock);
+        atomic_fetch_add(&stream->session, 1);
+        stream->next = lba + 1;
+        thread_release_mutex(stream->lock);
+
+        ret = cdrom_audio_stream_decode(dev, lba, raw, samples, &deemph);
+    }
+
+    thread_set_event(stream->wake);
+
+    return ret;
+}
+
+/* Drop all decoded sectors, for when the medium has changed. */
+void
+cdrom_audio_stream_flush(cdrom_t *dev)
+{
+    cdrom_audio_stream_t *stream = (cdrom_audio_stream_t *) dev->audio_stream;
+
+    if (stream == NULL)
+        return;
+
+    thread_wait_mutex(stream->lock);
+    atomic_fetch_add(&stream->session, 1);
+    atomic_store(&stream->end, 0);
+    stream->next = 0;
+    thread_release_mutex(stream->lock);
+}
+
+/* Called once the back end of the drive has been opened. */
+void
+cdrom_audio_stream_open(cdrom_t *dev)
+{
+    cdrom_audio_stream_t *stream;
+
+    cdrom_audio_stream_close(dev);
+
+    stream = (cdrom_audio_stream_t *) calloc(1, sizeof(cdrom_audio_stream_t));
+    stream->dev    = dev;
+    stream->lock   = thread_create_mutex();
+    stream->wake   = thread_create_event();
+    atomic_init(&stream->session, 0);
+    atomic_init(&stream->end, 0);
+    atomic_init(&stream->head, 0);
+    atomic_init(&stream->tail, 0);
+    stream->thread = thread_create(cdrom_audio_stream_thread, stream);
+
+    dev->audio_stream = stream;
+}
+
+/* Called before the back end of the drive is closed. */
+void
+cdrom_audio_stream_close(cdrom_t *dev)
+{
+    cdrom_audio_stream_t *stream = (cdrom_audio_stream_t *) dev->audio_stream;
+
+    if (stream == NULL)
+        return;
+
+    stream->stop = 1;
+    thread_set_event(stream->wake);
+    thread_wait(stream->thread);
+
+    dev->audio_stream = NULL;
+
+    thread_destroy_event(stream->wake);
+    thread_close_mutex(stream->lock);
+    free(stream);
+}
@@ -0,0 +1,314 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          CD-ROM sector cache and read-ahead.
+ *
+ *          Keeps recently read sectors of a drive, and once the
+ *          emulated machine reads sequentially, has a thread fetch
+ *          the following sectors from the image or host drive before
+ *          they are asked for. This only hides host I/O latency, the
+ *          emulated seek and transfer timing is left to the drive.
+ *
+ * Authors: 86Box developers
+ *
+ *          Copyright 2026 86Box developers.
+ */
+#include <inttypes.h>
+#ifdef ENABLE_CDROM_CACHE_LOG
+#include <stdarg.h>
+#endif
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <wchar.h>
+#include <86box/86box.h>
+#include <86box/cdrom.h>
+#include <86box/log.h>
+#include <86box/thread.h>
+
+#define CDROM_CACHE_SLOTS  64 /* Must be a power of 2. */
+#define CDROM_READ_AHEAD   32
+#define CDROM_CACHE_SECTOR 2448
+
+typedef struct cdrom_cache_slot_t {
+    uint32_t lba;
+    int      valid;
+    int      ret;
+    uint8_t  data[CDROM_CACHE_SECTOR];
+} cdrom_cache_slot_t;
+
+/* Sequential read detection and read-ahead window of one reader. */
+typedef struct cdrom_cache_stream_t {
+    uint32_t last;
+    uint32_t ra_next;
+    uint32_t ra_end;
+} cdrom_cache_stream_t;
+
+typedef struct cdrom_cache_t {
+    cdrom_t           *dev;
+
+    thread_t          *thread;
+    event_t           *wake;
+    mutex_t           *lock;    /* Slots and read-ahead state. */
+    mutex_t           *io_lock; /* Calls into the image or host drive back end. */
+    volatile int       stop;
+
+    uint32_t             generation;
+    cdrom_cache_stream_t streams[CDROM_CACHE_STREAMS];
+
+    uint64_t           hits;
+    uint64_t           misses;
+    uint64_t           prefetched;
+
+    cdrom_cache_slot_t slots[CDROM_CACHE_SLOTS];
+} cdrom_cache_t;
+
+#ifdef ENABLE_CDROM_CACHE_LOG
+int cdrom_cache_do_log = ENABLE_CDROM_CACHE_LOG;
+
+static void
+cdrom_cache_log(void *priv, const char *fmt, ...)
+{
+    if (cdrom_cache_do_log) {
+        va_list ap;
+        va_start(ap, fmt);
+        log_out(priv, fmt, ap);
+        va_end(ap);
+    }
+}
+#else
+#    define cdrom_cache_log(priv, fmt, ...)
+#endif
+
+/* Called with the cache lock held, returns the next sector to read ahead
+   for any of the streams, or 0xffffffff if there is none. */
+static uint32_t
+cdrom_cache_next(cdrom_cache_t *cache)
+{
+    cdrom_cache_stream_t *st;
+    cdrom_cache_slot_t   *slot;
+
+    for (int i = 0; i < CDROM_CACHE_STREAMS; i++) {
+        st = &cache->streams[i];
+        while (st->ra_next < st->ra_end) {
+            slot = &cache->slots[st->ra_next & (CDROM_CACHE_SLOTS - 1)];
+            if (!slot->valid || (slot->lba != st->ra_next))
+                return st->ra_next++;
+            st->ra_next++;
+        }
+    }
+
+    return 0xffffffff;
+}
+
+/* Called with the cache lock held. */
+static void
+cdrom_cache_store(cdrom_cache_t *cache, const uint32_t sector, const uint8_t *buffer, const int ret)
+{
+    cdrom_cache_slot_t *slot = &cache->slots[sector & (CDROM_CACHE_SLOTS - 1)];
+
+    slot->lba   = sector;
+    slot->valid = 1;
+    slot->ret   = ret;
+    memcpy(slot->data, buffer, CDROM_CACHE_SECTOR);
+}
+
+static void
+cdrom_cache_thread(void *priv)
+{
+    cdrom_cache_t      *cache = (cdrom_cache_t *) priv;
+    cdrom_t            *dev   = cache->dev;
+    uint8_t             buffer[4096];
+    uint32_t            generation;
+    uint32_t            sector;
+    int                 ret;
+
+    while (!cache->stop) {
+        thread_wait_event(cache->wake, -1);
+        thread_reset_event(cache->wake);
+
+        while (!cache->stop) {
+            thread_wait_mutex(cache->lock);
+            sector = cdrom_cache_next(cache);
+            if (sector == 0xffffffff) {
+                thread_release_mutex(cache->lock);
+                break;
+            }
+            generation = cache->generation;
+            thread_release_mutex(cache->lock);
+
+            thread_wait_mutex(cache->io_lock);
+            ret = dev->ops->read_sector(dev->local, buffer, sector);
+            thread_release_mutex(cache->io_lock);
+
+            thread_wait_mutex(cache->lock);
+            if ((ret > 0) && (generation == cache->generation)) {
+                cdrom_cache_store(cache, sector, buffer, ret);
+                cache->prefetched++;
+            }
+            thread_release_mutex(cache->lock);
+        }
+    }
+}
+
+/* Read a sector through the cache, with the same result as the
+   read_sector operation of the drive's back end. Each stream (data reads
+   and the audio decoder) is detected as sequential on its own. */
+int
+cdrom_cache_read(cdrom_t *dev, uint8_t *buffer, const uint32_t sector, const int stream)
+{
+    cdrom_cache_t        *cache = (cdrom_cache_t *) dev->cache;
+    cdrom_cache_stream_t *st;
+    cdrom_cache_slot_t   *slot;
+    uint32_t            generation;
+    int                 hit  = 0;
+    int                 wake = 0;
+    int                 ret  = 0;
+
+    if (cache == NULL)
+        return dev->ops->read_sector(dev->local, buffer, sector);
+
+    slot = &cache->slots[sector & (CDROM_CACHE_SLOTS - 1)];
+    st   = &cache->streams[stream];
+
+    thread_wait_mutex(cache->lock);
+    if (slot->valid && (slot->lba == sector)) {
+        memcpy(buffer, slot->data, CDROM_CACHE_SECTOR);
+        ret = slot->ret;
+        hit = 1;
+        cache->hits++;
+    } else
+        cache->misses++;
+
+    /* Extend the read-ahead window on sequential reads. */
+    if (sector == (st->last + 1)) {
+        if ((st->ra_next <= sector) || (st->ra_next > (sector + 1 + CDROM_READ_AHEAD)))
+            st->ra_next = sector + 1;
+        st->ra_end = sector + 1 + CDROM_READ_AHEAD;
+        if (st->ra_end > (dev->cdrom_capacity + 1))
+            st->ra_end = dev->cdrom_capacity + 1;
+        wake = (st->ra_next < st->ra_end);
+    }
+    st->last = sector;
+    generation  = cache->generation;
+    thread_release_mutex(cache->lock);
+
+    if (!hit) {
+        thread_wait_mutex(cache->io_lock);
+        ret = dev->ops->read_sector(dev->local, buffer, sector);
+        thread_release_mutex(cache->io_lock);
+
+        if (ret > 0) {
+            thread_wait_mutex(cache->lock);
+            if (generation == cache->generation)
+                cdrom_cache_store(cache, sector, buffer, ret);
+            thread_release_mutex(cache->lock);
+        }
+    }
+
+    if (wake)
+        thread_set_event(cache->wake);
+
+    return ret;
+}
+
+/* Drop all cached sectors, for when the medium has changed. */
+void
+cdrom_cache_flush(cdrom_t *dev)
+{
+    cdrom_cache_t *cache = (cdrom_cache_t *) dev->cache;
+
+    if (cache == NULL)
+        return;
+
+    thread_wait_mutex(cache->lock);
+    for (int i = 0; i < CDROM_CACHE_SLOTS; i++)
+        cache->slots[i].valid = 0;
+    cache->generation++;
+    for (int i = 0; i < CDROM_CACHE_STREAMS; i++) {
+        cache->streams[i].last    = 0xffffffff;
+        cache->streams[i].ra_next = 0;
+        cache->streams[i].ra_end  = 0;
+    }
+    thread_release_mutex(cache->lock);
+}
+
+/* Serialize a call into the back end of the drive with the read-ahead
+   thread, the back ends are not safe to call from several threads. */
+void
+cdrom_cache_io_lock(const cdrom_t *dev)
+{
+    const cdrom_cache_t *cache = (const cdrom_cache_t *) dev->cache;
+
+    if (cache != NULL)
+        thread_wait_mutex(cache->io_lock);
+}
+
+void
+cdrom_cache_io_unlock(const cdrom_t *dev)
+{
+    const cdrom_cache_t *cache = (const cdrom_cache_t *) dev->cache;
+
+    if (cache != NULL)
+        thread_release_mutex(cache->io_lock);
+}
+
+void
+cdrom_cache_get_stats(const cdrom_t *dev, uint64_t *hits, uint64_t *misses, uint64_t *prefetched)
+{
+    const cdrom_cache_t *cache = (const cdrom_cache_t *) dev->cache;
+
+    *hits       = cache ? cache->hits : 0;
+    *misses     = cache ? cache->misses : 0;
+    *prefetched = cache ? cache->prefetched : 0;
+}
+
+/* Called once the back end of the drive has been opened. */
+void
+cdrom_cache_open(cdrom_t *dev)
+{
+    cdrom_cache_t *cache;
+
+    cdrom_cache_close(dev);
+
+    cache = (cdrom_cache_t *) calloc(1, sizeof(cdrom_cache_t));
+    cache->dev     = dev;
+    for (int i = 0; i < CDROM_CACHE_STREAMS; i++)
+        cache->streams[i].last = 0xffffffff;
+    cache->lock    = thread_create_mutex();
+    cache->io_lock = thread_create_mutex();
+    cache->wake    = thread_create_event();
+    cache->thread  = thread_create(cdrom_cache_thread, cache);
+
+    dev->cache = cache;
+}
+
+/* Called before the back end of the drive is closed. */
+void
+cdrom_cache_close(cdrom_t *dev)
+{
+    cdrom_cache_t *cache = (cdrom_cache_t *) dev->cache;
+
+    if (cache == NULL)
+        return;
+
+    cache->stop = 1;
+    thread_set_event(cache->wake);
+    thread_wait(cache->thread);
+
+    cdrom_cache_log(dev->log, "Cache: %" PRIu64 " hits, %" PRIu64 " misses, %" PRIu64 " sectors read ahead\n",
+                    cache->hits, cache->misses, cache->prefetched);
+
+    dev->cache = NULL;
+
+    thread_destroy_event(cache->wake);
+    thread_close_mutex(cache->io_lock);
+    thread_close_mutex(cache->lock);
+    free(cache);
+}
@@ -38,6 +38,9 @@
 #include <86box/cdrom.h>
 #include <86box/cdrom_image.h>
 #include <86box/cdrom_image_viso.h>
+#ifdef USE_LIBCHDR
+#    include <86box/cdrom_image_chd.h>
+#endif
 
 #include <sndfile.h>
 
@@ -249,8 +252,9 @@ static char   *cit[4]   = { "SPECIAL", "NONE", "ZERO", "NORMAL" };
 #endif
 
 typedef struct audio_file_t {
-    SNDFILE *file;
-    SF_INFO  info;
+    SNDFILE   *file;
+    SF_INFO    info;
+    sf_count_t pos;  /* Frame the decoder is at, -1 if unknown. */
 } audio_file_t;
 
 /* Audio file functions */
@@ -258,20 +262,31 @@ static int
 audio_read(void *priv, uint8_t *buffer, const uint64_t seek, const size_t count)
 {
     const track_file_t *tf            = (track_file_t *) priv;
-    const audio_file_t *audio         = (audio_file_t *) tf->priv;
+    audio_file_t       *audio         = (audio_file_t *) tf->priv;
     const uint64_t      samples_seek  = seek / 4;
     const uint64_t      samples_count = count / 4;
+    sf_count_t          res;
 
     if ((seek & 3) || (count & 3)) {
         image_log(tf->log, "CD Audio file: Reading on non-4-aligned boundaries.\n");
     }
 
-    const sf_count_t res = sf_seek(audio->file, samples_seek, SEEK_SET);
+    /* Seeking in compressed files makes the decoder start over from the
+       previous key frame, so skip it when playback is sequential. */
+    if (audio->pos != (sf_count_t) samples_seek) {
+        res = sf_seek(audio->file, samples_seek, SEEK_SET);
 
-    if (res == -1)
-        return 0;
+        if (res == -1) {
+            audio->pos = -1;
+            return 0;
+        }
+    }
 
-    return !!sf_readf_short(audio->file, (short *) buffer, samples_count);
+    res = sf_readf_short(audio->file, (short *) buffer, samples_count);
+
+    audio->pos = (res > 0) ? (sf_count_t) (samples_seek + res) : -1;
+
+    return !!res;
 }
 
 static uint64_t
@@ -1354,6 +1369,23 @@ image_set_track_subch_type(track_t *ct)
         ct->subch_type = 0x00;
 }
 
+static void
+image_set_track_form(track_t *ct)
+{
+    if (ct->mode == 2)  switch(ct->sector_size) {
+        default:
+            break;
+        case 2324: case 2328:
+            ct->form = 2;
+            break;
+        case 2048: case 2332: case 2336: case 2352: case 2368: case 2448:
+            ct->form = 1;
+            break;
+    }
+    if (((ct->sector_size == 2336) || (ct->sector_size == 2332)) && (ct->mode == 2) && (ct->form == 1))
+        ct->skip        = 8;
+}
+
 static int
 image_load_iso(cd_image_t *img, const char *filename)
 {
@@ -1632,18 +1664,7 @@ image_load_cue(cd_image_t *img, const char *cuefile)
                 sscanf(type, "MODE%" PRIu32 "/%" PRIu32,
                        &mode, &(ct->sector_size));
                 ct->mode = mode;
-                if (ct->mode == 2)  switch(ct->sector_size) {
-                    default:
-                        break;
-                    case 2324: case 2328:
-                        ct->form = 2;
-                        break;
-                    case 2048: case 2332: case 2336: case 2352: case 2368: case 2448:
-                        ct->form = 1;
-                        break;
-                }
-                if (((ct->sector_size == 2336) || (ct->sector_size == 2332)) && (ct->mode == 2) && (ct->form == 1))
-                    ct->skip        = 8;
+                image_set_track_form(ct);
             } else if (!memcmp(type, "CD", 2)) {
                 ct->attr        = DATA_TRACK;
                 ct->mode        = 2;
@@ -1847,6 +1868,93 @@ image_load_cue(cd_image_t *img, const char *cuefile)
     return success;
 }
 
+#ifdef USE_LIBCHDR
+/*
+   CHD images are loaded as if they were a Cue sheet with one file per
+   track, with the track files provided by the CHD back end.
+ */
+static int
+image_load_chd(cd_image_t *img, const char *chdfile)
+{
+    chd_track_info_t tracks[CHD_MAX_TRACKS];
+    track_t         *ct = NULL;
+    int              tracks_num;
+
+    img->tracks     = NULL;
+    img->tracks_num = 0;
+
+    /*
+       Pass 1 - loading the CHD track metadata.
+     */
+    image_log(img->log, "Pass 1 (loading the CHD track metadata)...\n");
+    tracks_num = chd_image_open(img->dev->id, chdfile, tracks, CHD_MAX_TRACKS);
+    if (tracks_num == 0) {
+#ifdef ENABLE_IMAGE_LOG
+        log_warning(img->log, "    [CHD     ] Unable to open CHD image \"%s\"\n", chdfile);
+#else
+        warning("Unable to open CHD image \"%s\"\n", chdfile);
+#endif
+        return 0;
+    }
+
+    for (int i = 0; i < 3; i++)
+        (void) image_insert_track(img, 1, 0xa0 + i);
+
+    for (int i = 0; i < tracks_num; i++) {
+        const chd_track_info_t *ti = &tracks[i];
+
+        ct = image_insert_track(img, 1, i + 1);
+
+        for (int j = 2; j >= 0; j--) {
+            ct->idx[j].type = INDEX_NONE;
+            ct->idx[j].file = ti->file;
+        }
+
+        ct->attr        = ti->attr;
+        ct->mode        = ti->mode;
+        ct->form        = 0;
+        ct->sector_size = ti->sector_size;
+        image_set_track_form(ct);
+        image_set_track_subch_type(ct);
+
+        if (ti->pregap_data) {
+            ct->idx[0].type       = INDEX_NORMAL;
+            ct->idx[0].file_start = 0ULL;
+            ct->idx[1].file_start = ti->pregap;
+        } else {
+            if (ti->pregap > 0) {
+                ct->idx[0].type   = INDEX_ZERO;
+                ct->idx[0].length = ti->pregap;
+            }
+            ct->idx[1].file_start = 0ULL;
+        }
+        ct->idx[1].type = INDEX_NORMAL;
+
+        if (ti->postgap > 0) {
+            ct->idx[2].type   = INDEX_ZERO;
+            ct->idx[2].length = ti->postgap;
+        }
+
+        image_log(img->log, "    [TRACK   ] %02X/%02X, ATTR %02X, MODE %02X/%02X,\n",
+                  ct->session,
+                  ct->point,
+                  ct->attr,
+                  ct->mode, ct->form);
+        image_log(img->log, "               %i\n",
+                  ct->sector_size);
+    }
+
+    image_process(img);
+
+    for (int i = 0; i < tracks_num; i++) {
+        if (tracks[i].attr == AUDIO_TRACK)
+            return 1;
+    }
+
+    return 2;
+}
+#endif
+
 // Converts UTF-16 string into UTF-8 string.
 // If destination string is NULL returns total number of symbols that would've
 // been written (without null terminator). However, when actually writing into
@@ -2672,6 +2780,9 @@ image_open(cdrom_t *dev, const char *path)
         int       ret;
         const int is_cue  = ((ext == 4) && !stricmp(path + strlen(path) - ext + 1, "CUE"));
         const int is_mds  = ((ext == 4) && !stricmp(path + strlen(path) - ext + 1, "MDS"));
+#ifdef USE_LIBCHDR
+        const int is_chd  = ((ext == 4) && !stricmp(path + strlen(path) - ext + 1, "CHD"));
+#endif
         char      n[1024] = { 0 };
 
         sprintf(n, "CD-ROM %i Image", dev->id + 1);
@@ -2686,6 +2797,18 @@ image_open(cdrom_t *dev, const char *path)
                 img->has_audio = 0;
             else if (ret)
                 img->has_audio = 1;
+#ifdef USE_LIBCHDR
+        } else if (is_chd) {
+            ret = image_load_chd(img, path);
+
+            if (ret >= 2)
+                img->has_audio = 0;
+            else if (ret)
+                img->has_audio = 1;
+
+            if (ret >= 1)
+                img->is_dvd = 2;
+#endif
         } else if (is_cue) {
             ret = image_load_cue(img, path);
 
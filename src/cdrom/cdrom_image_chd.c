@@ -0,0 +1,551 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          CHD (MAME compressed hunks of data) CD-ROM image back-end.
+ *
+ *          Every track of the image gets its own track file, so the
+ *          image is handled like a Cue sheet with one file per track.
+ *          Decompressed hunks are kept in a small LRU cache, and the
+ *          hunks following the last one read are decompressed ahead
+ *          of time by worker threads, each with its own handle to the
+ *          image as libchdr handles are not thread safe.
+ *
+ * Authors: 86Box developers
+ *
+ *          Copyright 2026 86Box developers.
+ */
+#include <inttypes.h>
+#ifdef ENABLE_IMAGE_CHD_LOG
+#include <stdarg.h>
+#endif
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <86box/86box.h>
+#include <86box/cdrom.h>
+#include <86box/cdrom_image.h>
+#include <86box/cdrom_image_chd.h>
+#include <86box/log.h>
+#include <86box/thread.h>
+
+#include <libchdr/chd.h>
+
+#define CHD_FRAME_SIZE    2448 /* 2352 bytes of sector data followed by 96 of subchannel */
+#define CHD_TRACK_PADDING 4    /* tracks start on a multiple of this many frames */
+#define CHD_CACHE_HUNKS   64
+#define CHD_READ_AHEAD    16
+#define CHD_THREADS       3
+
+enum {
+    CHD_HUNK_EMPTY = 0,
+    CHD_HUNK_PENDING,
+    CHD_HUNK_READY
+};
+
+typedef struct chd_hunk_t {
+    uint32_t hunk;
+    int      state;
+    uint64_t used;
+    uint8_t *data;
+} chd_hunk_t;
+
+typedef struct chd_worker_t {
+    struct chd_image_t *img;
+
+    chd_file *chd;
+    thread_t *thread;
+    event_t  *wake_event;
+} chd_worker_t;
+
+typedef struct chd_image_t {
+    chd_file *chd;
+    uint32_t  hunk_bytes;
+    uint32_t  total_hunks;
+    uint32_t  frames_per_hunk;
+    int       refs;
+    int       running;
+    int       workers_num;
+    uint64_t  stamp;
+    void     *log;
+
+    chd_hunk_t  hunks[CHD_CACHE_HUNKS];
+    chd_hunk_t *last;
+    int         queue[CHD_CACHE_HUNKS];
+    int         queue_pos;
+    int         queue_len;
+
+    chd_worker_t workers[CHD_THREADS];
+    mutex_t     *mutex;
+    event_t     *done_event;
+} chd_image_t;
+
+typedef struct chd_track_t {
+    chd_image_t *img;
+    uint32_t     start; /* First frame of the track in the image */
+    uint32_t     frames;
+    uint32_t     sector_size;
+    int          audio;
+} chd_track_t;
+
+#ifdef ENABLE_IMAGE_CHD_LOG
+int image_chd_do_log = ENABLE_IMAGE_CHD_LOG;
+
+static void
+image_chd_log(void *priv, const char *fmt, ...)
+{
+    va_list ap;
+
+    if (image_chd_do_log) {
+        va_start(ap, fmt);
+        log_out(priv, fmt, ap);
+        va_end(ap);
+    }
+}
+#else
+#    define image_chd_log(priv, fmt, ...)
+#endif
+
+/* Must be called with the mutex held. */
+static chd_hunk_t *
+chd_image_find(chd_image_t *img, uint32_t hunk)
+{
+    for (int i = 0; i < CHD_CACHE_HUNKS; i++) {
+        if ((img->hunks[i].state != CHD_HUNK_EMPTY) && (img->hunks[i].hunk == hunk))
+            return &img->hunks[i];
+    }
+
+    return NULL;
+}
+
+/* Must be called with the mutex held. Hunks being decompressed are never evicted. */
+static chd_hunk_t *
+chd_image_alloc(chd_image_t *img, uint32_t hunk)
+{
+    chd_hunk_t *victim = NULL;
+
+    for (int i = 0; i < CHD_CACHE_HUNKS; i++) {
+        chd_hunk_t *h = &img->hunks[i];
+
+        if (h->state == CHD_HUNK_EMPTY) {
+            victim = h;
+            break;
+        } else if ((h->state == CHD_HUNK_READY) && ((victim == NULL) || (h->used < victim->used)))
+            victim = h;
+    }
+
+    if (victim != NULL) {
+        if (victim == img->last)
+            img->last = NULL;
+        victim->hunk = hunk;
+        victim->used = ++img->stamp;
+    }
+
+    return victim;
+}
+
+static chd_hunk_t *
+chd_image_pop(chd_image_t *img)
+{
+    chd_hunk_t *h = NULL;
+
+    thread_wait_mutex(img->mutex);
+    if (img->queue_len > 0) {
+        h              = &img->hunks[img->queue[img->queue_pos]];
+        img->queue_pos = (img->queue_pos + 1) % CHD_CACHE_HUNKS;
+        img->queue_len--;
+    }
+    thread_release_mutex(img->mutex);
+
+    return h;
+}
+
+static void
+chd_image_thread(void *priv)
+{
+    chd_worker_t *worker = (chd_worker_t *) priv;
+    chd_image_t  *img    = worker->img;
+    chd_hunk_t   *h;
+    int           ok;
+
+    while (1) {
+        thread_wait_event(worker->wake_event, -1);
+        thread_reset_event(worker->wake_event);
+
+        while ((h = chd_image_pop(img)) != NULL) {
+            ok = (chd_read(worker->chd, h->hunk, h->data) == CHDERR_NONE);
+
+            /* A failed hunk is dropped, the reader will then retry it itself and report the error. */
+            thread_wait_mutex(img->mutex);
+            h->state = ok ? CHD_HUNK_READY : CHD_HUNK_EMPTY;
+            thread_release_mutex(img->mutex);
+            thread_set_event(img->done_event);
+        }
+
+        if (!img->running)
+            break;
+    }
+}
+
+/* Must be called with the mutex held. */
+static void
+chd_image_read_ahead(chd_image_t *img, uint32_t hunk)
+{
+    chd_hunk_t *h;
+    int         queued = 0;
+
+    if (img->workers_num == 0)
+        return;
+
+    /* Bounding the queue keeps enough hunks around for the reader to never run out. */
+    for (uint32_t n = hunk + 1; (n <= (hunk + CHD_READ_AHEAD)) && (n < img->total_hunks) &&
+         (img->queue_len < CHD_READ_AHEAD); n++) {
+        if (chd_image_find(img, n) != NULL)
+            continue;
+
+        if ((h = chd_image_alloc(img, n)) == NULL)
+            break;
+
+        h->state = CHD_HUNK_PENDING;
+        img->queue[(img->queue_pos + img->queue_len) % CHD_CACHE_HUNKS] = h - img->hunks;
+        img->queue_len++;
+        queued = 1;
+    }
+
+    if (queued) {
+        for (int i = 0; i < img->workers_num; i++)
+            thread_set_event(img->workers[i].wake_event);
+    }
+}
+
+static const uint8_t *
+chd_image_get_hunk(chd_image_t *img, uint32_t hunk)
+{
+    chd_hunk_t *h;
+    int         ok;
+
+    /* Only this thread evicts hunks, so the last one read is still valid. */
+    if ((img->last != NULL) && (img->last->hunk == hunk))
+        return img->last->data;
+
+    thread_wait_mutex(img->mutex);
+
+    /* Wait for a worker which is already decompressing this hunk. */
+    while (((h = chd_image_find(img, hunk)) != NULL) && (h->state == CHD_HUNK_PENDING)) {
+        thread_reset_event(img->done_event);
+        thread_release_mutex(img->mutex);
+        thread_wait_event(img->done_event, -1);
+        thread_wait_mutex(img->mutex);
+    }
+
+    if (h == NULL) {
+        if ((h = chd_image_alloc(img, hunk)) == NULL) {
+            thread_release_mutex(img->mutex);
+            return NULL;
+        }
+        h->state = CHD_HUNK_PENDING;
+        thread_release_mutex(img->mutex);
+
+        image_chd_log(img->log, "Hunk %" PRIu32 " not cached\n", hunk);
+        ok = (chd_read(img->chd, hunk, h->data) == CHDERR_NONE);
+
+        thread_wait_mutex(img->mutex);
+        h->state = ok ? CHD_HUNK_READY : CHD_HUNK_EMPTY;
+        if (!ok) {
+            thread_release_mutex(img->mutex);
+            image_chd_log(img->log, "Failed to read hunk %" PRIu32 "\n", hunk);
+            return NULL;
+        }
+    }
+
+    h->used = ++img->stamp;
+    chd_image_read_ahead(img, hunk);
+    thread_release_mutex(img->mutex);
+
+    img->last = h;
+    return h->data;
+}
+
+static void
+chd_image_close(chd_image_t *img)
+{
+    img->running = 0;
+    for (int i = 0; i < img->workers_num; i++) {
+        thread_set_event(img->workers[i].wake_event);
+        thread_wait(img->workers[i].thread);
+        thread_destroy_event(img->workers[i].wake_event);
+        chd_close(img->workers[i].chd);
+    }
+
+    if (img->done_event != NULL)
+        thread_destroy_event(img->done_event);
+    if (img->mutex != NULL)
+        thread_close_mutex(img->mutex);
+
+    for (int i = 0; i < CHD_CACHE_HUNKS; i++)
+        free(img->hunks[i].data);
+
+    if (img->chd != NULL)
+        chd_close(img->chd);
+
+    if (img->log != NULL)
+        log_close(img->log);
+
+    free(img);
+}
+
+/* Track file functions. */
+static int
+chd_track_read(void *priv, uint8_t *buffer, uint64_t seek, size_t count)
+{
+    const track_file_t *tf    = (track_file_t *) priv;
+    const chd_track_t  *track = (chd_track_t *) tf->priv;
+    chd_image_t        *img   = track->img;
+    const uint8_t      *p;
+
+    while (count > 0) {
+        uint64_t frame  = seek / track->sector_size;
+        uint32_t offset = seek % track->sector_size;
+        size_t   len    = MIN(count, track->sector_size - offset);
+
+        if (frame >= track->frames)
+            return -1;
+        frame += track->start;
+
+        p = chd_image_get_hunk(img, frame / img->frames_per_hunk);
+        if (p == NULL)
+            return -1;
+        p += (frame % img->frames_per_hunk) * CHD_FRAME_SIZE;
+
+        /*
+         * Audio is stored big endian. The samples are aligned to the start of the
+         * frame, so every byte is paired by its offset in the frame rather than in
+         * the request, which may start or end in the middle of a sample.
+         */
+        if (track->audio) {
+            for (size_t i = 0; i < len; i++)
+                buffer[i] = p[(offset + i) ^ 1];
+        } else
+            memcpy(buffer, p + offset, len);
+
+        buffer += len;
+        seek += len;
+        count -= len;
+    }
+
+    return 1;
+}
+
+static uint64_t
+chd_track_get_length(void *priv)
+{
+    const track_file_t *tf    = (track_file_t *) priv;
+    const chd_track_t  *track = (chd_track_t *) tf->priv;
+
+    return ((uint64_t) track->frames) * track->sector_size;
+}
+
+static void
+chd_track_close(void *priv)
+{
+    track_file_t *tf    = (track_file_t *) priv;
+    chd_track_t  *track = (chd_track_t *) tf->priv;
+
+    if (--track->img->refs == 0)
+        chd_image_close(track->img);
+
+    free(track);
+    free(tf);
+}
+
+static int
+chd_track_type(const char *type, chd_track_info_t *info)
+{
+    static const struct {
+        const char *name;
+        uint8_t     attr;
+        uint8_t     mode;
+        uint32_t    sector_size;
+    } types[] = {
+  // clang-format off
+        { "MODE1",          DATA_TRACK,  1, COOKED_SECTOR_SIZE },
+        { "MODE1_RAW",      DATA_TRACK,  1, RAW_SECTOR_SIZE    },
+        { "MODE2",          DATA_TRACK,  2, 2336               },
+        { "MODE2_FORM1",    DATA_TRACK,  2, COOKED_SECTOR_SIZE },
+        { "MODE2_FORM2",    DATA_TRACK,  2, 2324               },
+        { "MODE2_FORM_MIX", DATA_TRACK,  2, 2336               },
+        { "MODE2_RAW",      DATA_TRACK,  2, RAW_SECTOR_SIZE    },
+        { "AUDIO",          AUDIO_TRACK, 0, RAW_SECTOR_SIZE    }
+  // clang-format on
+    };
+
+    for (size_t i = 0; i < (sizeof(types) / sizeof(types[0])); i++) {
+        if (!strcmp(type, types[i].name)) {
+            info->attr        = types[i].attr;
+            info->mode        = types[i].mode;
+            info->sector_size = types[i].sector_size;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Open a CHD image and describe its tracks, each with its own track file.
+ * Returns the number of tracks, or 0 if the file is not a CD-ROM CHD.
+ */
+int
+chd_image_open(const uint8_t id, const char *filename, chd_track_info_t *tracks, int max)
+{
+    chd_image_t      *img = (chd_image_t *) calloc(1, sizeof(chd_image_t));
+    const chd_header *hdr;
+    chd_track_t      *track;
+    track_file_t     *tf;
+    char              meta[256];
+    char              type[32];
+    char              subtype[32];
+    char              pgtype[32];
+    char              pgsub[32];
+    uint32_t          meta_len;
+    uint32_t          frame = 0;
+    int               num   = 0;
+    int               number;
+    int               frames;
+    int               pregap;
+    int               postgap;
+
+    if (img == NULL)
+        return 0;
+
+    char n[1024] = { 0 };
+
+    sprintf(n, "CD-ROM %i CHD  ", id + 1);
+    img->log = log_open(n);
+
+    if (chd_open(filename, CHD_OPEN_READ, NULL, &img->chd) != CHDERR_NONE) {
+        image_chd_log(img->log, "Unable to open \"%s\"\n", filename);
+        goto fail;
+    }
+
+    hdr                  = chd_get_header(img->chd);
+    img->hunk_bytes      = hdr->hunkbytes;
+    img->total_hunks     = hdr->totalhunks;
+    img->frames_per_hunk = hdr->hunkbytes / CHD_FRAME_SIZE;
+    if ((img->frames_per_hunk == 0) || (hdr->hunkbytes % CHD_FRAME_SIZE)) {
+        image_chd_log(img->log, "Hunk size %" PRIu32 " is not a multiple of a frame\n", hdr->hunkbytes);
+        goto fail;
+    }
+
+    for (int i = 0; i < CHD_CACHE_HUNKS; i++) {
+        if ((img->hunks[i].data = (uint8_t *) malloc(img->hunk_bytes)) == NULL)
+            goto fail;
+    }
+
+    /* Go through the track metadata, newest format first. */
+    for (uint32_t i = 0; num < max; i++) {
+        pregap    = 0;
+        postgap   = 0;
+        pgtype[0] = '\0';
+
+        if (chd_get_metadata(img->chd, CDROM_TRACK_METADATA2_TAG, i, meta, sizeof(meta) - 1,
+                             &meta_len, NULL, NULL) == CHDERR_NONE) {
+            meta[MIN(meta_len, sizeof(meta) - 1)] = '\0';
+            if (sscanf(meta, "TRACK:%d TYPE:%31s SUBTYPE:%31s FRAMES:%d PREGAP:%d PGTYPE:%31s PGSUB:%31s POSTGAP:%d",
+                       &number, type, subtype, &frames, &pregap, pgtype, pgsub, &postgap) != 8)
+                break;
+        } else if (chd_get_metadata(img->chd, CDROM_TRACK_METADATA_TAG, i, meta, sizeof(meta) - 1,
+                                    &meta_len, NULL, NULL) == CHDERR_NONE) {
+            meta[MIN(meta_len, sizeof(meta) - 1)] = '\0';
+            if (sscanf(meta, "TRACK:%d TYPE:%31s SUBTYPE:%31s FRAMES:%d",
+                       &number, type, subtype, &frames) != 4)
+                break;
+        } else
+            break;
+
+        memset(&tracks[num], 0x00, sizeof(chd_track_info_t));
+        if ((frames <= 0) || !chd_track_type(type, &tracks[num])) {
+            image_chd_log(img->log, "Unsupported track: %s\n", meta);
+            goto fail;
+        }
+
+        /* A V pre-gap type means the pre-gap is stored in the image, and counted in the frames. */
+        tracks[num].pregap      = pregap;
+        tracks[num].postgap     = postgap;
+        tracks[num].pregap_data = (pgtype[0] == 'V');
+
+        track = (chd_track_t *) calloc(1, sizeof(chd_track_t));
+        tf    = (track_file_t *) calloc(1, sizeof(track_file_t));
+        if ((track == NULL) || (tf == NULL)) {
+            free(track);
+            free(tf);
+            goto fail;
+        }
+
+        track->img         = img;
+        track->start       = frame;
+        track->frames      = frames;
+        track->sector_size = tracks[num].sector_size;
+        track->audio       = (tracks[num].attr == AUDIO_TRACK);
+        img->refs++;
+
+        strncpy(tf->fn, filename, sizeof(tf->fn) - 1);
+        tf->priv       = track;
+        tf->read       = chd_track_read;
+        tf->get_length = chd_track_get_length;
+        tf->close      = chd_track_close;
+
+        tracks[num++].file = tf;
+
+        image_chd_log(img->log, "Track %02i: %s, %i frames at %" PRIu32 ", pre-gap %i (%s), post-gap %i\n",
+                      number, type, frames, frame, pregap, pgtype, postgap);
+
+        frame += frames;
+        frame += (CHD_TRACK_PADDING - (frames % CHD_TRACK_PADDING)) % CHD_TRACK_PADDING;
+    }
+
+    if (num == 0)
+        goto fail;
+
+    /* Start the read-ahead workers, the image is still usable without them. */
+    img->running    = 1;
+    img->mutex      = thread_create_mutex();
+    img->done_event = thread_create_event();
+    for (int i = 0; i < CHD_THREADS; i++) {
+        chd_worker_t *worker = &img->workers[img->workers_num];
+
+        if (chd_open(filename, CHD_OPEN_READ, NULL, &worker->chd) != CHDERR_NONE)
+            break;
+
+        worker->img        = img;
+        worker->wake_event = thread_create_event();
+        worker->thread     = thread_create(chd_image_thread, worker);
+        if (worker->thread == NULL) {
+            thread_destroy_event(worker->wake_event);
+            chd_close(worker->chd);
+            break;
+        }
+        img->workers_num++;
+    }
+
+    image_chd_log(img->log, "Opened \"%s\": %i tracks, %" PRIu32 " hunks of %" PRIu32 " frames, %i workers\n",
+                  filename, num, img->total_hunks, img->frames_per_hunk, img->workers_num);
+
+    return num;
+
+fail:
+    /* The image goes away along with the last track file. */
+    if (num > 0) {
+        while (num-- > 0)
+            tracks[num].file->close(tracks[num].file);
+    } else
+        chd_image_close(img);
+
+    return 0;
+}
@@ -40,6 +40,7 @@
 #include <86box/plat.h>
 #include <86box/bswap.h>
 #include <86box/plat_dir.h>
+#include <86box/thread.h>
 #include <86box/version.h>
 #include <86box/nvr.h>
 
@@ -78,8 +79,10 @@ typedef struct stat stat_t;
         (p) += 4;                               \
     }
 
-#define VISO_SECTOR_SIZE COOKED_SECTOR_SIZE
-#define VISO_OPEN_FILES  32
+#define VISO_SECTOR_SIZE  COOKED_SECTOR_SIZE
+#define VISO_OPEN_FILES   256
+#define VISO_STAT_THREADS 4
+#define VISO_STAT_MIN     64 /* don't bother with threads for smaller directories */
 
 enum {
     VISO_CHARSET_D = 0,
@@ -121,20 +124,31 @@ typedef struct _viso_entry_ {
     char *basename, path[];
 } viso_entry_t;
 
+/* Sectors occupied by a file, sorted by sector for binary search. */
+typedef struct {
+    size_t        sector, sectors;
+    viso_entry_t *entry;
+} viso_extent_t;
+
 typedef struct {
     uint64_t vol_size_offsets[2];
     uint64_t pt_meta_offsets[2];
     int      format;
     uint8_t  use_version_suffix : 1;
-    size_t   metadata_sectors, all_sectors, entry_map_size, sector_size, file_fifo_pos;
+    size_t   metadata_sectors, all_sectors, extent_count, sector_size, file_fifo_pos;
     uint8_t *metadata;
 
     track_file_t   tf;
     viso_entry_t  *root_dir;
-    viso_entry_t **entry_map;
+    viso_extent_t *extents;
     viso_entry_t  *file_fifo[VISO_OPEN_FILES];
 } viso_t;
 
+typedef struct {
+    viso_entry_t **entries;
+    size_t         count, first, stride;
+} viso_stat_job_t;
+
 static const char rr_eid[]   = "RRIP_1991A"; /* identifiers used in ER field for Rock Ridge */
 static const char rr_edesc[] = "THE ROCK RIDGE INTERCHANGE PROTOCOL PROVIDES SUPPORT FOR POSIX FILE SYSTEM SEMANTICS.";
 static int8_t     tz_offset  = 0;
@@ -680,73 +694,112 @@ viso_compare_entries(const void *a, const void *b)
     return strcmp((*((viso_entry_t **) a))->name_short, (*((viso_entry_t **) b))->name_short);
 }
 
+static const viso_extent_t *
+viso_find_extent(const viso_t *viso, size_t sector)
+{
+    size_t lo = 0;
+    size_t hi = viso->extent_count;
+
+    /* Find the last extent starting at or before this sector. */
+    while (lo < hi) {
+        size_t mid = lo + ((hi - lo) / 2);
+        if (viso->extents[mid].sector <= sector)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo ? &viso->extents[lo - 1] : NULL;
+}
+
+static FILE *
+viso_open_file(viso_t *viso, viso_entry_t *entry)
+{
+    if (entry->file)
+        return entry->file;
+
+    /* Close any existing FIFO entry's file. */
+    viso_entry_t *other_entry = viso->file_fifo[viso->file_fifo_pos];
+    if (other_entry && other_entry->file) {
+        image_viso_log(viso->tf.log, "Closing [%s]...\n", other_entry->path);
+        fclose(other_entry->file);
+        other_entry->file = NULL;
+        image_viso_log(viso->tf.log, "Done\n");
+    }
+
+    /* Open file. */
+    image_viso_log(viso->tf.log, "Opening [%s]...\n", entry->path);
+    if ((entry->file = fopen(entry->path, "rb"))) {
+        image_viso_log(viso->tf.log, "Done\n");
+
+        /* Add this entry to the FIFO. */
+        viso->file_fifo[viso->file_fifo_pos++] = entry;
+        viso->file_fifo_pos &= (sizeof(viso->file_fifo) / sizeof(viso->file_fifo[0])) - 1;
+    } else {
+        image_viso_log(viso->tf.log, "Failed\n");
+
+        /* Clear any existing FIFO entry. */
+        viso->file_fifo[viso->file_fifo_pos] = NULL;
+    }
+
+    return entry->file;
+}
+
 int
 viso_read(void *priv, uint8_t *buffer, uint64_t seek, size_t count)
 {
     track_file_t *tf   = (track_file_t *) priv;
     viso_t       *viso = (viso_t *) tf->priv;
 
-    /* Handle reads in a sector by sector basis. */
+    /* Handle reads in as few pieces as possible: all the metadata
+       at once, then as much of each file as was asked for. */
     while (count > 0) {
-        /* Determine the current sector, offset and remainder. */
-        size_t sector        = seek / viso->sector_size;
-        size_t sector_offset = seek % viso->sector_size;
-        size_t sector_remain = MIN(count, viso->sector_size - sector_offset);
+        size_t sector = seek / viso->sector_size;
+        size_t remain;
 
-        /* Handle sector. */
         if (sector < viso->metadata_sectors) {
             /* Copy metadata. */
-            memcpy(buffer, viso->metadata + seek, sector_remain);
+            remain = MIN(count, (viso->metadata_sectors * viso->sector_size) - seek);
+            memcpy(buffer, viso->metadata + seek, remain);
         } else {
-            size_t read = 0;
-
-            /* Get the file entry corresponding to this sector. */
-            viso_entry_t *entry = viso->entry_map[sector - viso->metadata_sectors];
-            if (entry) {
-                /* Open file if it's not already open. */
-                if (!entry->file) {
-                    /* Close any existing FIFO entry's file. */
-                    viso_entry_t *other_entry = viso->file_fifo[viso->file_fifo_pos];
-                    if (other_entry && other_entry->file) {
-                        image_viso_log(viso->tf.log, "Closing [%s]...\n", other_entry->path);
-                        fclose(other_entry->file);
-                        other_entry->file = NULL;
-                        image_viso_log(viso->tf.log, "Done\n");
-                    }
-
-                    /* Open file. */
-                    image_viso_log(viso->tf.log, "Opening [%s]...\n", entry->path);
-                    if ((entry->file = fopen(entry->path, "rb"))) {
-                        image_viso_log(viso->tf.log, "Done\n");
-
-                        /* Add this entry to the FIFO. */
-                        viso->file_fifo[viso->file_fifo_pos++] = entry;
-                        viso->file_fifo_pos &= (sizeof(viso->file_fifo) / sizeof(viso->file_fifo[0])) - 1;
-                    } else {
-                        image_viso_log(viso->tf.log, "Failed\n");
-
-                        /* Clear any existing FIFO entry. */
-                        viso->file_fifo[viso->file_fifo_pos] = NULL;
-                    }
+            const viso_extent_t *extent = viso_find_extent(viso, sector);
+            size_t               read   = 0;
+
+            if (extent && (sector < (extent->sector + extent->sectors))) {
+                viso_entry_t *entry  = extent->entry;
+                uint64_t      offset = seek - entry->data_offset;
+                FILE         *fp;
+
+                /* Stop at the end of this file's last sector. */
+                remain = MIN(count, ((extent->sector + extent->sectors) * viso->sector_size) - seek);
+
+                /* Read data, not seeking if a previous read left off here. */
+                if (offset < (uint64_t) entry->stats.st_size) {
+                    if (!(fp = viso_open_file(viso, entry)) ||
+                        ((ftello64(fp) != offset) && (fseeko64(fp, offset, SEEK_SET) == -1)))
+                        return -1;
+                    read = fread(buffer, 1, MIN(remain, (size_t) (entry->stats.st_size - offset)), fp);
+                    if (!read)
+                        return -1;
                 }
-
-                /* Read data. */
-                if (!entry->file || (fseeko64(entry->file, seek - entry->data_offset, SEEK_SET) == -1))
-                    return -1;
-                read = fread(buffer, 1, sector_remain, entry->file);
-                if (sector_remain && !read)
-                    return -1;
+            } else {
+                /* Not part of any file, up to the next one or the end. */
+                extent = extent ? (extent + 1) : viso->extents;
+                if (extent < (viso->extents + viso->extent_count))
+                    remain = MIN(count, (extent->sector * viso->sector_size) - seek);
+                else
+                    remain = count;
             }
 
             /* Fill remainder with 00 bytes if needed. */
-            if (read < sector_remain)
-                memset(buffer + read, 0x00, sector_remain - read);
+            if (read < remain)
+                memset(buffer + read, 0x00, remain - read);
         }
 
-        /* Move on to the next sector. */
-        buffer += sector_remain;
-        seek += sector_remain;
-        count -= sector_remain;
+        /* Move on to the next piece. */
+        buffer += remain;
+        seek += remain;
+        count -= remain;
     }
 
     return 1;
@@ -791,8 +844,8 @@ viso_close(void *priv)
 
     if (viso->metadata)
         free(viso->metadata);
-    if (viso->entry_map)
-        free(viso->entry_map);
+    if (viso->extents)
+        free(viso->extents);
 
     if (tf->log != NULL)
         log_close(tf->log);
@@ -800,6 +853,47 @@ viso_close(void *priv)
     free(viso);
 }
 
+static void
+viso_stat_thread(void *priv)
+{
+    viso_stat_job_t *job = (viso_stat_job_t *) priv;
+
+    for (size_t i = job->first; i < job->count; i += job->stride) {
+        if (stat(job->entries[i]->path, &job->entries[i]->stats) != 0) {
+            /* Use a blank structure if stat failed. */
+            memset(&job->entries[i]->stats, 0x00, sizeof(stat_t));
+        }
+    }
+}
+
+/* Stat a directory's children, spreading large directories over a few
+   threads, as the time is mostly spent waiting on the host file system. */
+static void
+viso_stat_entries(viso_entry_t **entries, size_t count)
+{
+    viso_stat_job_t jobs[VISO_STAT_THREADS];
+    thread_t       *threads[VISO_STAT_THREADS] = { NULL };
+    int             stride                     = (count >= VISO_STAT_MIN) ? VISO_STAT_THREADS : 1;
+
+    for (int i = 0; i < stride; i++) {
+        jobs[i].entries = entries;
+        jobs[i].count   = count;
+        jobs[i].first   = i;
+        jobs[i].stride  = stride;
+        if (i > 0)
+            threads[i] = thread_create(viso_stat_thread, &jobs[i]);
+    }
+
+    /* Take the first share here, along with that of any thread which failed to start. */
+    viso_stat_thread(&jobs[0]);
+    for (int i = 1; i < stride; i++) {
+        if (threads[i])
+            thread_wait(threads[i]);
+        else
+            viso_stat_thread(&jobs[i]);
+    }
+}
+
 track_file_t *
 viso_init(const uint8_t id, const char *dirname, int *error)
 {
@@ -907,11 +1001,8 @@ viso_init(const uint8_t id, const char *dirname, int *error)
             if (!children_count)
                 dir->first_child = entry;
 
-            /* Stat the current directory or parent directory. */
-            if (stat(children_count ? dir->parent->path : dir->path, &entry->stats) != 0) {
-                /* Use a blank structure if stat failed. */
-                memset(&entry->stats, 0x00, sizeof(stat_t));
-            }
+            /* Copy the current directory or parent directory's stats. */
+            entry->stats = children_count ? dir->parent->stats : dir->stats;
 
             /* Set basename. */
             strcpy(entry->name_short, children_count ? ".." : ".");
@@ -923,7 +1014,7 @@ viso_init(const uint8_t id, const char *dirname, int *error)
         /* Iterate through this directory's children again, making the entries. */
         if (dirp) {
             rewinddir(dirp);
-            while ((readdir_entry = readdir(dirp))) {
+            while ((readdir_entry = readdir(dirp)) && (children_count < (dir_entries_len - 1))) {
                 /* Ignore . and .. pseudo-directories. */
                 if ((readdir_entry->d_name[0] == '.') &&
                     ((readdir_entry->d_name[1] == '\0') ||
@@ -931,22 +1022,26 @@ viso_init(const uint8_t id, const char *dirname, int *error)
                     continue;
 
                 /* Add and fill entry. */
-                entry = dir_entries[children_count++] =
+                entry = dir_entries[children_count] =
                     (viso_entry_t *) calloc(1, sizeof(viso_entry_t) +
                         dir_path_len + strlen(readdir_entry->d_name) + 2);
                 if (entry == NULL)
                     break;
+                children_count++;
                 entry->parent = dir;
                 strcpy(entry->path, dir->path);
                 path_slash(&entry->path[dir_path_len]);
                 entry->basename = &entry->path[dir_path_len + 1];
                 strcpy(entry->basename, readdir_entry->d_name);
+            }
 
-                /* Stat this child. */
-                if (stat(entry->path, &entry->stats) != 0) {
-                    /* Use a blank structure if stat failed. */
-                    memset(&entry->stats, 0x00, sizeof(stat_t));
-                }
+            /* Stat all children, which is where most of the time goes on large trees. */
+            viso_stat_entries(&dir_entries[2], children_count - 2);
+
+            /* Go through the children, dropping the ones without a short name. */
+            size_t count = children_count;
+            for (size_t i = children_count = 2; i < count; i++) {
+                entry = dir_entries[children_count++] = dir_entries[i];
 
                 /* Handle file size and El Torito boot code. */
                 if (!S_ISDIR(entry->stats.st_mode)) {
@@ -954,29 +1049,27 @@ viso_init(const uint8_t id, const char *dirname, int *error)
                     if (entry->stats.st_size > ((uint32_t) -1))
                         entry->stats.st_size = (uint32_t) -1;
 
-                    /* Increase entry map size. */
-                    viso->entry_map_size += entry->stats.st_size / viso->sector_size;
-                    if (entry->stats.st_size % viso->sector_size)
-                        viso->entry_map_size++; /* round up to the next sector */
+                    /* Count this file towards the extent map. */
+                    viso->extent_count++;
 
                     /* Detect El Torito boot code file and set it accordingly. */
                     if (dir == eltorito_dir) {
-                        if (!stricmp(readdir_entry->d_name, "Boot-NoEmul.img")) {
+                        if (!stricmp(entry->basename, "Boot-NoEmul.img")) {
                             eltorito_type = 0x00;
 have_eltorito_entry:
                             if (eltorito_entry)
                                 eltorito_others_present = 1; /* flag that the boot code directory contains other files */
                             eltorito_entry = entry;
-                        } else if (!stricmp(readdir_entry->d_name, "Boot-1.2M.img")) {
+                        } else if (!stricmp(entry->basename, "Boot-1.2M.img")) {
                             eltorito_type = 0x01;
                             goto have_eltorito_entry;
-                        } else if (!stricmp(readdir_entry->d_name, "Boot-1.44M.img")) {
+                        } else if (!stricmp(entry->basename, "Boot-1.44M.img")) {
                             eltorito_type = 0x02;
                             goto have_eltorito_entry;
-                        } else if (!stricmp(readdir_entry->d_name, "Boot-2.88M.img")) {
+                        } else if (!stricmp(entry->basename, "Boot-2.88M.img")) {
                             eltorito_type = 0x03;
                             goto have_eltorito_entry;
-                        } else if (!stricmp(readdir_entry->d_name, "Boot-HardDisk.img")) {
+                        } else if (!stricmp(entry->basename, "Boot-HardDisk.img")) {
                             eltorito_type = 0x04;
                             goto have_eltorito_entry;
                         } else {
@@ -985,13 +1078,13 @@ have_eltorito_entry:
                     } else {
                         /* Disable version suffixes if this structure appears to contain the Windows NT
                            El Torito boot code, which is known not to tolerate suffixed file names. */
-                        if (eltorito_dir &&                                  /* El Torito directory present? */
-                            (eltorito_type == 0x00) &&                       /* El Torito directory not checked yet, or confirmed to contain non-emulation boot code? */
-                            (dir->parent == viso->root_dir) &&               /* one subdirectory deep? (I386 for instance) */
-                            !stricmp(readdir_entry->d_name, "SETUPLDR.BIN")) /* SETUPLDR.BIN present? */
+                        if (eltorito_dir &&                                   /* El Torito directory present? */
+                            (eltorito_type == 0x00) &&                        /* El Torito directory not checked yet, or confirmed to contain non-emulation boot code? */
+                            (dir->parent == viso->root_dir) &&                /* one subdirectory deep? (I386 for instance) */
+                            !stricmp(entry->basename, "SETUPLDR.BIN")) /* SETUPLDR.BIN present? */
                             viso->use_version_suffix = 0;
                     }
-                } else if ((dir == viso->root_dir) && !stricmp(readdir_entry->d_name, "[BOOT]")) {
+                } else if ((dir == viso->root_dir) && !stricmp(entry->basename, "[BOOT]")) {
                     /* Set this as the directory containing El Torito boot code. */
                     eltorito_dir            = entry;
                     eltorito_others_present = 0;
@@ -1482,45 +1575,11 @@ next_entry:
         }
     }
 
-    /* Allocate entry map for sector->file lookups. */
-    size_t orig_sector_size = viso->sector_size;
-    while (1) {
-        image_viso_log(viso->tf.log, "Allocating entry map for %zu %zu-byte sectors\n",
-                       viso->entry_map_size, viso->sector_size);
-        viso->entry_map = (viso_entry_t **) calloc(viso->entry_map_size, sizeof(viso_entry_t *));
-        if (viso->entry_map) {
-            /* Successfully allocated. */
-            break;
-        } else {
-            /* Blank data buffer for padding if this is the first run. */
-            if (orig_sector_size == viso->sector_size)
-                memset(data, 0x00, orig_sector_size);
-
-            /* If we don't have enough memory, double the sector size. */
-            viso->sector_size *= 2;
-            if ((viso->sector_size < VISO_SECTOR_SIZE) || (viso->sector_size > (1 << 30))) /* give up if sectors become too large */
-                goto end;
-
-            /* Go through files, recalculating the entry map size. */
-            size_t orig_entry_map_size = viso->entry_map_size;
-            viso->entry_map_size       = 0;
-            entry                      = viso->root_dir;
-            while (entry) {
-                if (!S_ISDIR(entry->stats.st_mode)) {
-                    viso->entry_map_size += entry->stats.st_size / viso->sector_size;
-                    if (entry->stats.st_size % viso->sector_size)
-                        viso->entry_map_size++; /* round up to the next sector */
-                }
-                entry = entry->next;
-            }
-            if (viso->entry_map_size == orig_entry_map_size) /* give up if there was no change in map size */
-                goto end;
-
-            /* Pad metadata to the new size's next sector. */
-            while (ftello64(viso->tf.fp) % viso->sector_size)
-                fwrite(data, orig_sector_size, 1, viso->tf.fp);
-        }
-    }
+    /* Allocate extent map for sector->file lookups. */
+    image_viso_log(viso->tf.log, "Allocating extent map for %zu files\n", viso->extent_count);
+    viso->extents = (viso_extent_t *) calloc(MAX(viso->extent_count, 1), sizeof(viso_extent_t));
+    if (viso->extents == NULL)
+        goto end;
 
     /* Start sector counts. */
     viso->metadata_sectors = ftello64(viso->tf.fp) / viso->sector_size;
@@ -1528,10 +1587,9 @@ next_entry:
 
     /* Go through files, assigning sectors to them. */
     image_viso_log(viso->tf.log, "Assigning sectors to files:\n");
-    size_t        base_factor  = viso->sector_size / orig_sector_size;
-    viso_entry_t *prev_entry   = viso->root_dir;
-    viso_entry_t **entry_map_p = viso->entry_map;
-    entry                      = prev_entry->next;
+    viso_entry_t  *prev_entry = viso->root_dir;
+    viso_extent_t *extent     = viso->extents;
+    entry                     = prev_entry->next;
     while (entry) {
         /* Skip this entry if it corresponds to a directory. */
         if (S_ISDIR(entry->stats.st_mode)) {
@@ -1556,11 +1614,11 @@ next_entry:
             } else { /* emulation */
                 AS_U16(data[0]) = cpu_to_le16(1);
             }
-            AS_U32(data[2]) = cpu_to_le32(viso->all_sectors * base_factor);
+            AS_U32(data[2]) = cpu_to_le32(viso->all_sectors);
             viso_pwrite(data, eltorito_offset, 6, 1, viso->tf.fp);
         } else {
             p = data;
-            VISO_LBE_32(p, viso->all_sectors * base_factor);
+            VISO_LBE_32(p, viso->all_sectors);
             for (int i = 0; i <= max_vd; i++)
                 viso_pwrite(data, entry->dr_offsets[i] + 2, 8, 1, viso->tf.fp);
         }
@@ -1575,16 +1633,22 @@ next_entry:
         image_viso_log(viso->tf.log, "[%08X] %s => %zu + %zu sectors\n", entry,
                        entry->path, viso->all_sectors, size);
 
-        /* Allocate sectors to this file. */
+        /* Allocate sectors to this file. Empty files take none and get no extent. */
+        if (size) {
+            extent->sector  = viso->all_sectors;
+            extent->sectors = size;
+            extent->entry   = entry;
+            extent++;
+        }
         viso->all_sectors += size;
-        while (size-- > 0)
-            *entry_map_p++ = entry;
 
         /* Move on to the next entry. */
         prev_entry = entry;
         entry      = entry->next;
     }
 
+    viso->extent_count = extent - viso->extents;
+
     /* Write final volume size to all volume descriptors. */
     p = data;
     VISO_LBE_32(p, viso->all_sectors);
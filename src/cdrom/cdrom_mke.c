@@ -357,7 +357,9 @@ mke_read_toc(mke_t *mke, unsigned char *b, uint8_t track) {
     int           num            = 0;
     int           ret            = 0;
 
+    cdrom_cache_io_lock(dev);
     dev->ops->get_raw_track_info(dev->local, &num, mke->temp_buf);
+    cdrom_cache_io_unlock(dev);
 
     if (num > 0) {
         if (track == 0xaa)
@@ -443,7 +445,9 @@ mke_read_multisess(mke_t *mke)
     int           first_sess     = 0;
     int           last_sess      = 0;
 
+    cdrom_cache_io_lock(dev);
     dev->ops->get_raw_track_info(dev->local, &num, mke->temp_buf);
+    cdrom_cache_io_unlock(dev);
 
     if (num > 0) {
         int trk = - 1;
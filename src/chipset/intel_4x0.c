@@ -97,7 +97,6 @@ i4x0_map(i4x0_t *dev, uint32_t addr, uint32_t size, int state)
     if (dev->mem_state[base] != state) {
         mem_set_mem_state_both(addr, size, states[state]);
         dev->mem_state[base] = state;
-        flushmmucache_nopc();
     }
 }
 
@@ -106,6 +105,9 @@ i4x0_smram_handler_phase0(i4x0_t *dev)
 {
     uint32_t tom = (mem_size << 10);
 
+    /* Recalculated once at the end of phase 1. */
+    mem_recalc_begin();
+
     if (((dev->type == INTEL_430TX) || (dev->type >= INTEL_440BX)) && smram_enabled(dev->smram_high)) {
         tom -= (1 << 20);
         mem_set_mem_state_smm(tom, (1 << 20), MEM_READ_INTERNAL | MEM_WRITE_INTERNAL);
@@ -201,6 +203,7 @@ i4x0_smram_handler_phase1(i4x0_t *dev)
         }
     }
 
+    mem_recalc_commit();
     flushmmucache();
 }
 
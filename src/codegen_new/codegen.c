@@ -58,6 +58,9 @@ int has_ea;
 codeblock_t *codeblock;
 uint16_t    *codeblock_hash;
 
+uint16_t               codeblock_victim[CODEBLOCK_VICTIM_SIZE];
+codeblock_hash_stats_t codeblock_hash_stats;
+
 void (*codegen_timing_start)(void);
 void (*codegen_timing_prefix)(uint8_t prefix, uint32_t fetchdat);
 void (*codegen_timing_opcode)(uint8_t opcode, uint32_t fetchdat, int op_32, uint32_t op_pc);
@@ -30,6 +30,41 @@
   same page).
 */
 
+/*Direct block chaining :
+
+  Exits with a constant destination (taken Jcc, LOOP, JCXZ etc) are compiled as
+  a patchable jump. Initially the jump leads to a stub that records the exit in
+  codegen_chain_exit and returns to the dispatcher. If the dispatcher then finds
+  a valid block for the new PC, codegen_chain_link() patches the exit to jump
+  straight to that block's chain entry, skipping the hash lookup and validation.
+
+  A linked exit still returns to the dispatcher when the cycle budget or the
+  next timer is reached, when an interrupt, NMI or SMI is pending, or when the
+  TLB has been flushed since the exit was linked (codegen_chain_epoch). The
+  chain entry of the target block repeats the remaining checks done by the
+  dispatcher - PC, CS, CPU status, FPU top-of-stack and the dirty masks of the
+  pages the block is in.
+
+  Links are removed when either end is deleted, invalidated or recompiled.*/
+#define CODEBLOCK_CHAIN_EXITS 4
+
+/*Reference to exit of a code block, as stored in codegen_chain_exit*/
+#define CHAIN_EXIT(block_nr, exit) (((block_nr) << 2) | (exit))
+#define CHAIN_EXIT_BLOCK(ref)      ((ref) >> 2)
+#define CHAIN_EXIT_NR(ref)         ((ref) & 3)
+
+typedef struct codeblock_chain_t {
+    /*Patch points in the host code for the TLB epoch the exit was linked in,
+      and for the jump itself. The unlinked stub immediately follows the jump.*/
+    uint32_t *epoch_patch;
+    uint32_t *jump_patch;
+
+    /*Block this exit is linked to, BLOCK_INVALID if not linked*/
+    uint16_t target;
+    /*Next exit (CHAIN_EXIT() reference) linked to the same target*/
+    uint16_t next;
+} codeblock_chain_t;
+
 typedef struct codeblock_t {
     uint32_t pc;
     uint32_t _cs;
@@ -57,11 +92,39 @@ typedef struct codeblock_t {
     /*First mem_block_t used by this block. Any subsequent mem_block_ts
       will be in the list starting at head_mem_block->next.*/
     struct mem_block_t *head_mem_block;
+
+    /*Host address chained exits of other blocks jump to, NULL if this block
+      can not be chained to. chain_in is the first exit linked to this block.*/
+    uint8_t          *chain_entry;
+    uint16_t          chain_in;
+    uint8_t           chain_exit_nr;
+    codeblock_chain_t chain_exits[CODEBLOCK_CHAIN_EXITS];
 } codeblock_t;
 
 extern codeblock_t *codeblock;
 
-extern uint16_t *codeblock_hash;
+/*Blocks are looked up by physical address in a set-associative cache,
+  holding block numbers with the most recently used way first. Blocks pushed
+  out of a set are kept in a small victim cache, and only if that misses as
+  well is the page tree walked.*/
+#define CODEBLOCK_HASH_WAYS    4
+#define CODEBLOCK_HASH_SETS    0x8000
+#define CODEBLOCK_HASH_SET(l)  ((((l) >> 15) ^ (l)) & (CODEBLOCK_HASH_SETS - 1))
+#define CODEBLOCK_VICTIM_SIZE  16
+
+typedef struct codeblock_hash_stats_t {
+    uint64_t way_hits[CODEBLOCK_HASH_WAYS];
+    uint64_t victim_hits;
+    uint64_t misses;
+} codeblock_hash_stats_t;
+
+extern uint16_t              *codeblock_hash;
+extern uint16_t               codeblock_victim[CODEBLOCK_VICTIM_SIZE];
+extern codeblock_hash_stats_t codeblock_hash_stats;
+
+extern void codeblock_hash_add(codeblock_t *block);
+extern void codeblock_hash_remove(codeblock_t *block);
+extern void codeblock_hash_clear(void);
 
 extern uint8_t *block_write_data;
 
@@ -81,6 +144,8 @@ extern uint8_t *block_write_data;
 #define CODEBLOCK_IN_DIRTY_LIST 0x40
 /*Code block is not inlining immediate parameters, parameters must be fetched from memory*/
 #define CODEBLOCK_NO_IMMEDIATES 0x80
+/*Code block was set up from the persistent cache and is not in its pages' block lists yet*/
+#define CODEBLOCK_NOT_LISTED 0x100
 
 #define BLOCK_PC_INVALID        0xffffffff
 
@@ -92,6 +157,54 @@ get_block_nr(codeblock_t *block)
     return ((uintptr_t) block - (uintptr_t) codeblock) / sizeof(codeblock_t);
 }
 
+static inline int
+codeblock_matches(const codeblock_t *block, uint32_t phys, uint32_t _cs, uint32_t pc)
+{
+    return (block->pc == pc) && (block->_cs == _cs) && (block->phys == phys) && !((block->status ^ cpu_cur_status) & CPU_STATUS_FLAGS) && ((block->status & cpu_cur_status & CPU_STATUS_MASK) == (cpu_cur_status & CPU_STATUS_MASK));
+}
+
+/*Find a block in the lookup cache, moving it to the front of its set. Empty
+  ways point at block 0, which never matches, so no separate checks are
+  needed for them.*/
+static inline codeblock_t *
+codeblock_hash_find(uint32_t phys, uint32_t _cs, uint32_t pc)
+{
+    uint16_t    *set = &codeblock_hash[CODEBLOCK_HASH_SET(phys) * CODEBLOCK_HASH_WAYS];
+    codeblock_t *block;
+
+    if (codeblock_matches(&codeblock[set[0]], phys, _cs, pc)) {
+        codeblock_hash_stats.way_hits[0]++;
+        return &codeblock[set[0]];
+    }
+
+    for (int way = 1; way < CODEBLOCK_HASH_WAYS; way++) {
+        block = &codeblock[set[way]];
+
+        if (codeblock_matches(block, phys, _cs, pc)) {
+            uint16_t block_nr = set[way];
+
+            codeblock_hash_stats.way_hits[way]++;
+            for (; way > 0; way--)
+                set[way] = set[way - 1];
+            set[0] = block_nr;
+            return block;
+        }
+    }
+
+    for (int c = 0; c < CODEBLOCK_VICTIM_SIZE; c++) {
+        block = &codeblock[codeblock_victim[c]];
+
+        if (codeblock_matches(block, phys, _cs, pc)) {
+            codeblock_hash_stats.victim_hits++;
+            codeblock_hash_add(block);
+            return block;
+        }
+    }
+
+    codeblock_hash_stats.misses++;
+    return NULL;
+}
+
 static inline codeblock_t *
 codeblock_tree_find(uint32_t phys, uint32_t _cs)
 {
@@ -297,6 +410,50 @@ extern void codegen_block_start_recompile(codeblock_t *block);
 extern void codegen_block_end_recompile(codeblock_t *block);
 extern void codegen_block_end(void);
 extern void codegen_delete_block(codeblock_t *block);
+
+typedef struct codegen_cache_stats_t {
+    uint64_t hits;   /* Blocks compiled on first use thanks to the cache */
+    uint64_t misses; /* Blocks not in the cache */
+    uint64_t stale;  /* Cached blocks whose guest bytes have changed */
+    uint64_t added;  /* Compiled blocks recorded in the cache */
+} codegen_cache_stats_t;
+
+extern int                   codegen_cache_active;
+extern codegen_cache_stats_t codegen_cache_stats;
+
+extern void         codegen_cache_add(codeblock_t *block);
+extern codeblock_t *codegen_cache_block_init(uint32_t phys_addr);
+
+#define CODEGEN_STATS_BUCKETS 12 /* log2 buckets, the last one is open ended */
+#define CODEGEN_STATS_PAGES   16 /* Must be a power of 2 */
+
+typedef struct codegen_stats_page_t {
+    uint32_t page;
+    uint32_t count;
+} codegen_stats_page_t;
+
+typedef struct codegen_stats_t {
+    uint64_t marked;          /* Blocks run once and marked for compilation */
+    uint64_t compiled;        /* Blocks compiled to host code */
+    uint64_t recompiled;      /* Invalidated blocks compiled again from the dirty list */
+    uint64_t flushes;         /* Calls to codegen_check_flush() */
+    uint64_t invalidated;     /* Blocks invalidated by writes to their code */
+    uint64_t dirty_evicted;   /* Blocks pushed out of the full dirty list */
+    uint64_t free_list_empty; /* Block allocations that found the free list empty */
+
+    uint64_t uops[CODEGEN_STATS_BUCKETS];
+    uint64_t host_bytes[CODEGEN_STATS_BUCKETS];
+    uint64_t flush_invalidated[CODEGEN_STATS_BUCKETS];
+
+    codegen_stats_page_t flush_pages[CODEGEN_STATS_PAGES];
+} codegen_stats_t;
+
+extern codegen_stats_t codegen_stats;
+
+extern void codegen_stats_block(int uops, int host_bytes);
+extern void codegen_stats_flush(uint32_t page, int invalidated);
+extern void codegen_block_list_sizes(int *free_blocks, int *dirty_blocks);
+
 extern void codegen_generate_call(uint8_t opcode, OpFn op, uint32_t fetchdat, uint32_t new_pc, uint32_t old_pc);
 extern void codegen_generate_seg_restore(void);
 extern void codegen_set_op32(void);
@@ -308,6 +465,16 @@ extern void codegen_check_seg_read(codeblock_t *block, struct ir_data_t *ir, x86
 extern void codegen_check_seg_write(codeblock_t *block, struct ir_data_t *ir, x86seg *seg);
 extern void codegen_check_regs(void);
 
+/*Link the exit recorded in codegen_chain_exit (if any) to block, which is
+  about to be run by the dispatcher*/
+extern void codegen_chain_link(codeblock_t *block);
+/*Remove all links to and from block*/
+extern void codegen_chain_unlink(codeblock_t *block);
+
+extern uint32_t codegen_chain_exit;
+extern uint32_t codegen_chain_epoch;
+extern int32_t  codegen_chain_cycles;
+
 extern int codegen_purge_purgable_list(void);
 /*Delete a random code block to free memory. This is obviously quite expensive, and
   will only be called when the allocator is out of memory*/
@@ -122,3 +122,16 @@ codegen_allocator_clean_blocks(UNUSED(struct mem_block_t *block))
     }
 #endif
 }
+
+int
+codegen_allocator_count(struct mem_block_t *block)
+{
+    int count = 0;
+
+    while (block) {
+        count++;
+        block = block->next ? &mem_blocks[block->next - 1] : NULL;
+    }
+
+    return count;
+}
@@ -31,6 +31,8 @@ void codegen_allocator_free(struct mem_block_t *block);
 uint8_t *codeblock_allocator_get_ptr(struct mem_block_t *block);
 /*Cache clean memory block list*/
 void codegen_allocator_clean_blocks(struct mem_block_t *block);
+/*Number of mem_block_ts in the list starting at block*/
+int codegen_allocator_count(struct mem_block_t *block);
 
 extern int codegen_allocator_usage;
 
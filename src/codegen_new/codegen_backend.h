@@ -12,6 +12,10 @@
 void codegen_backend_init(void);
 void codegen_backend_prologue(codeblock_t *block);
 void codegen_backend_epilogue(codeblock_t *block);
+/*Point the chained exit with the jump at jump_patch to dest*/
+void codegen_backend_chain_patch(uint32_t *jump_patch, void *dest);
+/*Store the TLB epoch a chained exit was linked in*/
+void codegen_backend_chain_epoch(uint32_t *epoch_patch, uint32_t epoch);
 
 struct ir_data_t;
 struct uop_t;
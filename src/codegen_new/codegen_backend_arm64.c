@@ -25,6 +25,9 @@
 #    if defined WIN32 || defined _WIN32 || defined _WIN32
 #        include <windows.h>
 #    endif
+#    if defined(__APPLE__) && defined(__aarch64__)
+#        include <pthread.h>
+#    endif
 #    include <string.h>
 
 void *codegen_mem_load_byte;
@@ -286,10 +289,10 @@ codegen_backend_init(void)
     codeblock_t *block;
 
     codeblock      = malloc(BLOCK_SIZE * sizeof(codeblock_t));
-    codeblock_hash = malloc(HASH_SIZE * sizeof(codeblock_t *));
+    codeblock_hash = malloc(CODEBLOCK_HASH_SETS * CODEBLOCK_HASH_WAYS * sizeof(uint16_t));
 
     memset(codeblock, 0, BLOCK_SIZE * sizeof(codeblock_t));
-    memset(codeblock_hash, 0, HASH_SIZE * sizeof(codeblock_t *));
+    codeblock_hash_clear();
 
     for (int c = 0; c < BLOCK_SIZE; c++) {
         codeblock[c].pc = BLOCK_PC_INVALID;
@@ -339,6 +342,22 @@ codegen_set_rounding_mode(int mode)
     cpu_state.new_fp_control = mode << 3;
 }
 
+/*Start of the translated code proper, following the prologue*/
+static uint8_t *codegen_chain_body;
+
+/*Register setup shared by the prologue and the chain entry*/
+static void
+codegen_backend_setup(codeblock_t *block)
+{
+    host_arm64_MOVX_IMM(block, REG_CPUSTATE, (uint64_t) &cpu_state);
+
+    if (block->flags & CODEBLOCK_HAS_FPU) {
+        host_arm64_LDR_IMM_W(block, REG_TEMP, REG_CPUSTATE, (uintptr_t) &cpu_state.TOP - (uintptr_t) &cpu_state);
+        host_arm64_SUB_IMM(block, REG_TEMP, REG_TEMP, block->TOP);
+        host_arm64_STR_IMM_W(block, REG_TEMP, REG_XSP, IREG_TOP_diff_stack_offset);
+    }
+}
+
 /*R10 - cpu_state*/
 void
 codegen_backend_prologue(codeblock_t *block)
@@ -354,13 +373,81 @@ codegen_backend_prologue(codeblock_t *block)
     host_arm64_STP_PREIDX_X(block, REG_X21, REG_X22, REG_XSP, -16);
     host_arm64_STP_PREIDX_X(block, REG_X19, REG_X20, REG_XSP, -64);
 
-    host_arm64_MOVX_IMM(block, REG_CPUSTATE, (uint64_t) &cpu_state);
+    codegen_backend_setup(block);
+    codegen_chain_body = &block_write_data[block_pos];
+}
 
-    if (block->flags & CODEBLOCK_HAS_FPU) {
+/*Entry point for exits of other blocks chained to this one. The stack frame
+  is already set up, so repeat the register setup and the checks that the
+  dispatcher would do before running this block, then continue into the
+  translated code. Any mismatch returns to the dispatcher.*/
+static void
+codegen_backend_chain_entry(codeblock_t *block)
+{
+    uint32_t *branch_offset;
+
+    block->chain_entry = &block_write_data[block_pos];
+
+    codegen_backend_setup(block);
+
+    host_arm64_LDR_IMM_W(block, REG_TEMP, REG_CPUSTATE, (uintptr_t) &cpu_state.pc - (uintptr_t) &cpu_state);
+    host_arm64_mov_imm(block, REG_TEMP2, block->pc - block->_cs);
+    host_arm64_CMP_REG(block, REG_TEMP, REG_TEMP2);
+    branch_offset = host_arm64_BNE_(block);
+    host_arm64_branch_set_offset(branch_offset, codegen_exit_rout);
+    host_arm64_LDR_IMM_W(block, REG_TEMP, REG_CPUSTATE, (uintptr_t) &cpu_state.seg_cs.base - (uintptr_t) &cpu_state);
+    host_arm64_mov_imm(block, REG_TEMP2, block->_cs);
+    host_arm64_CMP_REG(block, REG_TEMP, REG_TEMP2);
+    branch_offset = host_arm64_BNE_(block);
+    host_arm64_branch_set_offset(branch_offset, codegen_exit_rout);
+    /*Require an exact status match, which is stricter than the dispatcher*/
+    host_arm64_MOVX_IMM(block, REG_X16, (uint64_t) &cpu_cur_status);
+    host_arm64_LDRH_IMM(block, REG_TEMP, REG_X16, 0);
+    host_arm64_mov_imm(block, REG_TEMP2, block->status);
+    host_arm64_CMP_REG(block, REG_TEMP, REG_TEMP2);
+    branch_offset = host_arm64_BNE_(block);
+    host_arm64_branch_set_offset(branch_offset, codegen_exit_rout);
+    /*Translated code is only run while CACHE_ON() and not overridden*/
+    host_arm64_MOVX_IMM(block, REG_X16, (uint64_t) &cpu_override_dynarec);
+    host_arm64_LDR_IMM_W(block, REG_TEMP, REG_X16, 0);
+    host_arm64_CBNZ(block, REG_TEMP, (uintptr_t) codegen_exit_rout);
+    host_arm64_LDRH_IMM(block, REG_TEMP, REG_CPUSTATE, (uintptr_t) &cpu_state.flags - (uintptr_t) &cpu_state);
+    host_arm64_TST_IMM(block, REG_TEMP, T_FLAG);
+    branch_offset = host_arm64_BNE_(block);
+    host_arm64_branch_set_offset(branch_offset, codegen_exit_rout);
+    host_arm64_LDR_IMM_W(block, REG_TEMP, REG_CPUSTATE, (uintptr_t) &cr0 - (uintptr_t) &cpu_state);
+    host_arm64_TST_IMM(block, REG_TEMP, 1 << 30);
+    branch_offset = host_arm64_BNE_(block);
+    host_arm64_branch_set_offset(branch_offset, codegen_exit_rout);
+#    ifdef USE_DEBUG_REGS_486
+    host_arm64_MOVX_IMM(block, REG_X16, (uint64_t) &dr[7]);
+    host_arm64_LDR_IMM_W(block, REG_TEMP, REG_X16, 0);
+    host_arm64_TST_IMM(block, REG_TEMP, 0xff);
+    branch_offset = host_arm64_BNE_(block);
+    host_arm64_branch_set_offset(branch_offset, codegen_exit_rout);
+#    endif
+    if (block->flags & CODEBLOCK_STATIC_TOP) {
         host_arm64_LDR_IMM_W(block, REG_TEMP, REG_CPUSTATE, (uintptr_t) &cpu_state.TOP - (uintptr_t) &cpu_state);
-        host_arm64_SUB_IMM(block, REG_TEMP, REG_TEMP, block->TOP);
-        host_arm64_STR_IMM_W(block, REG_TEMP, REG_XSP, IREG_TOP_diff_stack_offset);
+        host_arm64_AND_IMM(block, REG_TEMP, REG_TEMP, 7);
+        host_arm64_CMP_IMM(block, REG_TEMP, block->TOP);
+        branch_offset = host_arm64_BNE_(block);
+        host_arm64_branch_set_offset(branch_offset, codegen_exit_rout);
+    }
+    host_arm64_MOVX_IMM(block, REG_X16, (uint64_t) block->dirty_mask);
+    if (block->page_mask & 0xffffffff) {
+        host_arm64_LDR_IMM_W(block, REG_TEMP, REG_X16, 0);
+        host_arm64_mov_imm(block, REG_TEMP2, block->page_mask & 0xffffffff);
+        host_arm64_AND_REG(block, REG_TEMP, REG_TEMP, REG_TEMP2, 0);
+        host_arm64_CBNZ(block, REG_TEMP, (uintptr_t) codegen_exit_rout);
     }
+    if (block->page_mask >> 32) {
+        host_arm64_LDR_IMM_W(block, REG_TEMP, REG_X16, 4);
+        host_arm64_mov_imm(block, REG_TEMP2, block->page_mask >> 32);
+        host_arm64_AND_REG(block, REG_TEMP, REG_TEMP, REG_TEMP2, 0);
+        host_arm64_CBNZ(block, REG_TEMP, (uintptr_t) codegen_exit_rout);
+    }
+
+    host_arm64_B(block, codegen_chain_body);
 }
 
 void
@@ -374,7 +461,50 @@ codegen_backend_epilogue(codeblock_t *block)
     host_arm64_LDP_POSTIDX_X(block, REG_X29, REG_X30, REG_XSP, 16);
     host_arm64_RET(block, REG_X30);
 
+    /*Blocks spanning two pages would also need the mapping of the second page
+      checked, leave those to the dispatcher*/
+    if (!block->page_mask2)
+        codegen_backend_chain_entry(block);
+
     codegen_allocator_clean_blocks(block->head_mem_block);
 }
 
+/*Code memory is only writable while recompiling on macOS, so lift the write
+  protection around patches made from outside the recompiler*/
+static void
+codegen_backend_chain_write(int enable)
+{
+#    if defined(__APPLE__) && defined(__aarch64__)
+    if (!codegen_in_recompile) {
+        if (__builtin_available(macOS 11.0, *)) {
+            pthread_jit_write_protect_np(!enable);
+        }
+    }
+#    else
+    (void) enable;
+#    endif
+}
+
+void
+codegen_backend_chain_patch(uint32_t *jump_patch, void *dest)
+{
+    codegen_backend_chain_write(1);
+    host_arm64_B_set_dest(jump_patch, dest);
+    codegen_backend_chain_write(0);
+
+#    ifndef _MSC_VER
+    __clear_cache((char *) jump_patch, (char *) (jump_patch + 1));
+#    else
+    FlushInstructionCache(GetCurrentProcess(), jump_patch, 4);
+#    endif
+}
+
+void
+codegen_backend_chain_epoch(uint32_t *epoch_patch, uint32_t epoch)
+{
+    codegen_backend_chain_write(1);
+    *epoch_patch = epoch;
+    codegen_backend_chain_write(0);
+}
+
 #endif
@@ -4,11 +4,6 @@
 #define BLOCK_MASK  0x3fff
 #define BLOCK_START 0
 
-#define HASH_SIZE   0x20000
-#define HASH_MASK   0x1ffff
-
-#define HASH(l)     ((l) &0x1ffff)
-
 #define BLOCK_MAX   0x3c0
 
 void host_arm64_BLR(codeblock_t *block, int addr_reg);
@@ -47,6 +47,7 @@
 #    define OPCODE_ADR                (0x10 << OPCODE_SHIFT)
 #    define OPCODE_B                  (0x14 << OPCODE_SHIFT)
 #    define OPCODE_BCOND              (0x54 << OPCODE_SHIFT)
+#    define OPCODE_LDR_LITERAL_W      (0x18 << OPCODE_SHIFT)
 #    define OPCODE_CBNZ               (0xb5 << OPCODE_SHIFT)
 #    define OPCODE_CBZ                (0xb4 << OPCODE_SHIFT)
 #    define OPCODE_CMN_IMM            (0x31 << OPCODE_SHIFT)
@@ -447,6 +448,25 @@ host_arm64_B(codeblock_t *block, void *dest)
     codegen_addlong(block, OPCODE_B | OFFSET26(offset));
 }
 
+uint32_t *
+host_arm64_B_(codeblock_t *block)
+{
+    codegen_alloc(block, 4);
+    codegen_addlong(block, OPCODE_B);
+    return (uint32_t *) &block_write_data[block_pos - 4];
+}
+
+/*Point an existing B instruction at a new destination*/
+void
+host_arm64_B_set_dest(uint32_t *opcode, void *dest)
+{
+    int offset = (uintptr_t) dest - (uintptr_t) opcode;
+
+    if (!offset_is_26bit(offset))
+        fatal("host_arm64_B_set_dest - offset out of range %x\n", offset);
+    *opcode = OPCODE_B | OFFSET26(offset);
+}
+
 void
 host_arm64_BFI(codeblock_t *block, int dst_reg, int src_reg, int lsb, int width)
 {
@@ -955,6 +975,23 @@ host_arm64_LDR_IMM_X(codeblock_t *block, int dest_reg, int base_reg, int offset)
     codegen_addlong(block, OPCODE_LDR_IMM_X | OFFSET12_Q(offset) | Rn(base_reg) | Rt(dest_reg));
 }
 
+uint32_t *
+host_arm64_LDR_LITERAL_W_(codeblock_t *block, int dest_reg)
+{
+    codegen_alloc(block, 4);
+    codegen_addlong(block, OPCODE_LDR_LITERAL_W | Rt(dest_reg));
+    return (uint32_t *) &block_write_data[block_pos - 4];
+}
+void
+host_arm64_LDR_LITERAL_set_dest(uint32_t *opcode, void *dest)
+{
+    int offset = (uintptr_t) dest - (uintptr_t) opcode;
+
+    if (!offset_is_19bit(offset))
+        fatal("host_arm64_LDR_LITERAL_set_dest - offset out of range %x\n", offset);
+    *opcode |= OFFSET19(offset);
+}
+
 void
 host_arm64_LDR_REG(codeblock_t *block, int dest_reg, int base_reg, int offset_reg)
 {
@@ -1504,6 +1541,15 @@ host_arm64_jump(codeblock_t *block, uintptr_t dst_addr)
     host_arm64_BR(block, REG_X16);
 }
 
+/*Emit a 32-bit data word into the instruction stream*/
+uint32_t *
+host_arm64_DATA_W(codeblock_t *block, uint32_t data)
+{
+    codegen_alloc(block, 4);
+    codegen_addlong(block, data);
+    return (uint32_t *) &block_write_data[block_pos - 4];
+}
+
 void
 host_arm64_mov_imm(codeblock_t *block, int reg, uint32_t imm_data)
 {
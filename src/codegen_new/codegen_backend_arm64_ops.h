@@ -20,7 +20,9 @@ void host_arm64_ANDS_IMM(codeblock_t *block, int dst_reg, int src_n_reg, uint32_
 
 void host_arm64_ASR(codeblock_t *block, int dst_reg, int src_n_reg, int shift_reg);
 
-void host_arm64_B(codeblock_t *block, void *dest);
+void      host_arm64_B(codeblock_t *block, void *dest);
+uint32_t *host_arm64_B_(codeblock_t *block);
+void      host_arm64_B_set_dest(uint32_t *opcode, void *dest);
 
 void host_arm64_BFI(codeblock_t *block, int dst_reg, int src_reg, int lsb, int width);
 
@@ -125,6 +127,8 @@ void host_arm64_LDP_POSTIDX_X(codeblock_t *block, int src_reg1, int src_reg2, in
 
 void host_arm64_LDR_IMM_W(codeblock_t *block, int dest_reg, int base_reg, int offset);
 void host_arm64_LDR_IMM_X(codeblock_t *block, int dest_reg, int base_reg, int offset);
+uint32_t *host_arm64_LDR_LITERAL_W_(codeblock_t *block, int dest_reg);
+void      host_arm64_LDR_LITERAL_set_dest(uint32_t *opcode, void *dest);
 void host_arm64_LDR_REG(codeblock_t *block, int dest_reg, int base_reg, int offset_reg);
 void host_arm64_LDR_REG_X(codeblock_t *block, int dest_reg, int base_reg, int offset_reg);
 
@@ -247,6 +251,8 @@ void host_arm64_ZIP2_V8B(codeblock_t *block, int dst_reg, int src_n_reg, int src
 void host_arm64_ZIP2_V4H(codeblock_t *block, int dst_reg, int src_n_reg, int src_m_reg);
 void host_arm64_ZIP2_V2S(codeblock_t *block, int dst_reg, int src_n_reg, int src_m_reg);
 
+uint32_t *host_arm64_DATA_W(codeblock_t *block, uint32_t data);
+
 void host_arm64_call(codeblock_t *block, void *dst_addr);
 void host_arm64_jump(codeblock_t *block, uintptr_t dst_addr);
 void host_arm64_mov_imm(codeblock_t *block, int reg, uint32_t imm_data);
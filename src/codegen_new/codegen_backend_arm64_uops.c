@@ -4,6 +4,9 @@
 #    include <86box/86box.h>
 #    include "cpu.h"
 #    include <86box/mem.h>
+#    include <86box/nmi.h>
+#    include <86box/pic.h>
+#    include <86box/timer.h>
 #    include <86box/plat_unused.h>
 
 #    include "x86.h"
@@ -814,6 +817,89 @@ codegen_JMP(codeblock_t *block, uop_t *uop)
     return 0;
 }
 
+static int
+codegen_JMP_CHAIN(codeblock_t *block, UNUSED(uop_t *uop))
+{
+    codeblock_chain_t *exit;
+    uint32_t          *branch_offset[5];
+    uint32_t          *epoch_load;
+
+    if (block->chain_exit_nr >= CODEBLOCK_CHAIN_EXITS) {
+        host_arm64_B(block, codegen_exit_rout);
+        return 0;
+    }
+    exit = &block->chain_exits[block->chain_exit_nr];
+
+    /*The literal load of the epoch must reach its data word, so keep the whole
+      sequence in one memory block*/
+    codegen_alloc(block, 352);
+
+    /*Return to the dispatcher if the next timer is due. codegen_chain_cycles is
+      the value of cycles when the dispatcher entered this chain, and tsc has
+      not been advanced since*/
+    host_arm64_MOVX_IMM(block, REG_X16, (uint64_t) &timer_target);
+    host_arm64_LDR_IMM_W(block, REG_TEMP, REG_X16, 0);
+    host_arm64_MOVX_IMM(block, REG_X16, (uint64_t) &tsc);
+    host_arm64_LDR_IMM_W(block, REG_TEMP2, REG_X16, 0);
+    host_arm64_SUB_REG(block, REG_TEMP, REG_TEMP, REG_TEMP2, 0);
+    host_arm64_MOVX_IMM(block, REG_X16, (uint64_t) &codegen_chain_cycles);
+    host_arm64_LDR_IMM_W(block, REG_TEMP2, REG_X16, 0);
+    host_arm64_SUB_REG(block, REG_TEMP2, REG_TEMP2, REG_TEMP, 0);
+    host_arm64_LDR_IMM_W(block, REG_TEMP, REG_CPUSTATE, (uintptr_t) &cycles - (uintptr_t) &cpu_state);
+    host_arm64_CMP_REG(block, REG_TEMP, REG_TEMP2);
+    branch_offset[0] = host_arm64_BLE_(block);
+    host_arm64_CMP_IMM(block, REG_TEMP, 0);
+    branch_offset[1] = host_arm64_BLE_(block);
+
+    /*...or if anything is pending that the dispatcher would act on*/
+    host_arm64_MOVX_IMM(block, REG_X16, (uint64_t) &pic.int_pending);
+    host_arm64_LDRB_IMM_W(block, REG_TEMP, REG_X16, 0);
+    host_arm64_LDRB_IMM_W(block, REG_TEMP2, REG_CPUSTATE, (uintptr_t) &smi_line - (uintptr_t) &cpu_state);
+    host_arm64_ORR_REG(block, REG_TEMP, REG_TEMP, REG_TEMP2, 0);
+    host_arm64_LDRB_IMM_W(block, REG_TEMP2, REG_CPUSTATE, (uintptr_t) &cpu_state.abrt - (uintptr_t) &cpu_state);
+    host_arm64_ORR_REG(block, REG_TEMP, REG_TEMP, REG_TEMP2, 0);
+    host_arm64_MOVX_IMM(block, REG_X16, (uint64_t) &nmi);
+    host_arm64_LDR_IMM_W(block, REG_TEMP2, REG_X16, 0);
+    host_arm64_ORR_REG(block, REG_TEMP, REG_TEMP, REG_TEMP2, 0);
+    host_arm64_MOVX_IMM(block, REG_X16, (uint64_t) &new_ne);
+    host_arm64_LDR_IMM_W(block, REG_TEMP2, REG_X16, 0);
+    host_arm64_ORR_REG(block, REG_TEMP, REG_TEMP, REG_TEMP2, 0);
+    host_arm64_MOVX_IMM(block, REG_X16, (uint64_t) &cpu_init);
+    host_arm64_LDR_IMM_W(block, REG_TEMP2, REG_X16, 0);
+    host_arm64_ORR_REG(block, REG_TEMP, REG_TEMP, REG_TEMP2, 0);
+    host_arm64_CMP_IMM(block, REG_TEMP, 0);
+    branch_offset[2] = host_arm64_BNE_(block);
+
+    /*...or if the TLB has been flushed since this exit was linked*/
+    host_arm64_MOVX_IMM(block, REG_X16, (uint64_t) &codegen_chain_epoch);
+    host_arm64_LDR_IMM_W(block, REG_TEMP, REG_X16, 0);
+    epoch_load = host_arm64_LDR_LITERAL_W_(block, REG_TEMP2);
+    host_arm64_CMP_REG(block, REG_TEMP, REG_TEMP2);
+    branch_offset[3] = host_arm64_BNE_(block);
+
+    /*Patched by codegen_chain_link() to branch to the target block*/
+    exit->jump_patch = host_arm64_B_(block);
+    branch_offset[4] = exit->jump_patch;
+
+    /*Unlinked stub*/
+    for (int c = 0; c < 5; c++)
+        host_arm64_branch_set_offset(branch_offset[c], &block_write_data[block_pos]);
+    host_arm64_MOVX_IMM(block, REG_X16, (uint64_t) &codegen_chain_exit);
+    host_arm64_mov_imm(block, REG_TEMP, CHAIN_EXIT(get_block_nr(block), block->chain_exit_nr));
+    host_arm64_STR_IMM_W(block, REG_TEMP, REG_X16, 0);
+    host_arm64_B(block, codegen_exit_rout);
+
+    /*Epoch this exit was linked in*/
+    exit->epoch_patch = host_arm64_DATA_W(block, 0);
+    host_arm64_LDR_LITERAL_set_dest(epoch_load, exit->epoch_patch);
+
+    exit->target = BLOCK_INVALID;
+    exit->next   = 0;
+    block->chain_exit_nr++;
+
+    return 0;
+}
+
 static int
 codegen_LOAD_FUNC_ARG0(codeblock_t *block, uop_t *uop)
 {
@@ -2923,6 +3009,9 @@ const uOpFn uop_handlers[UOP_MAX] = {
     [UOP_JMP &
         UOP_MASK]
     = codegen_JMP,
+    [UOP_JMP_CHAIN &
+        UOP_MASK]
+    = codegen_JMP_CHAIN,
 
     [UOP_LOAD_SEG &
         UOP_MASK]
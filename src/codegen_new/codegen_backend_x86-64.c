@@ -289,10 +289,10 @@ codegen_backend_init(void)
     int          c;
 
     codeblock      = malloc(BLOCK_SIZE * sizeof(codeblock_t));
-    codeblock_hash = malloc(HASH_SIZE * sizeof(codeblock_t *));
+    codeblock_hash = malloc(CODEBLOCK_HASH_SETS * CODEBLOCK_HASH_WAYS * sizeof(uint16_t));
 
     memset(codeblock, 0, BLOCK_SIZE * sizeof(codeblock_t));
-    memset(codeblock_hash, 0, HASH_SIZE * sizeof(codeblock_t *));
+    codeblock_hash_clear();
 
     for (c = 0; c < BLOCK_SIZE; c++)
         codeblock[c].pc = BLOCK_PC_INVALID;
@@ -346,6 +346,23 @@ codegen_set_rounding_mode(int mode)
     cpu_state.new_fp_control = (cpu_state.old_fp_control & ~0x6000) | (mode << 13);
 }
 
+/*Start of the translated code proper, following the prologue*/
+static uint8_t *codegen_chain_body;
+
+/*Register setup shared by the prologue and the chain entry*/
+static void
+codegen_backend_setup(codeblock_t *block)
+{
+    host_x86_MOV64_REG_IMM(block, REG_RBP, ((uintptr_t) &cpu_state) + 128);
+    if (block->flags & CODEBLOCK_HAS_FPU) {
+        host_x86_MOV32_REG_ABS(block, REG_EAX, &cpu_state.TOP);
+        host_x86_SUB32_REG_IMM(block, REG_EAX, block->TOP);
+        host_x86_MOV32_BASE_OFFSET_REG(block, REG_RSP, IREG_TOP_diff_stack_offset, REG_EAX);
+    }
+    if (block->flags & CODEBLOCK_NO_IMMEDIATES)
+        host_x86_MOV64_REG_IMM(block, REG_R12, ((uintptr_t) ram) + 2147483648ULL);
+}
+
 void
 codegen_backend_prologue(codeblock_t *block)
 {
@@ -365,14 +382,64 @@ codegen_backend_prologue(codeblock_t *block)
 #else
     host_x86_SUB64_REG_IMM(block, REG_RSP, 0x48);
 #endif
-    host_x86_MOV64_REG_IMM(block, REG_RBP, ((uintptr_t) &cpu_state) + 128);
-    if (block->flags & CODEBLOCK_HAS_FPU) {
-        host_x86_MOV32_REG_ABS(block, REG_EAX, &cpu_state.TOP);
-        host_x86_SUB32_REG_IMM(block, REG_EAX, block->TOP);
-        host_x86_MOV32_BASE_OFFSET_REG(block, REG_RSP, IREG_TOP_diff_stack_offset, REG_EAX);
+    codegen_backend_setup(block);
+    codegen_chain_body = &block_write_data[block_pos];
+}
+
+/*Entry point for exits of other blocks chained to this one. The stack frame
+  is already set up, so repeat the register setup and the checks that the
+  dispatcher would do before running this block, then continue into the
+  translated code. Any mismatch returns to the dispatcher.*/
+static void
+codegen_backend_chain_entry(codeblock_t *block)
+{
+    block->chain_entry = &block_write_data[block_pos];
+
+    codegen_backend_setup(block);
+
+    host_x86_MOV32_REG_ABS(block, REG_ECX, &cpu_state.pc);
+    host_x86_CMP32_REG_IMM(block, REG_ECX, block->pc - block->_cs);
+    host_x86_JNZ(block, codegen_exit_rout);
+    host_x86_MOV32_REG_ABS(block, REG_ECX, &cpu_state.seg_cs.base);
+    host_x86_CMP32_REG_IMM(block, REG_ECX, block->_cs);
+    host_x86_JNZ(block, codegen_exit_rout);
+    /*Require an exact status match, which is stricter than the dispatcher*/
+    host_x86_MOVZX_REG_ABS_32_16(block, REG_ECX, &cpu_cur_status);
+    host_x86_CMP32_REG_IMM(block, REG_ECX, block->status);
+    host_x86_JNZ(block, codegen_exit_rout);
+    /*Translated code is only run while CACHE_ON() and not overridden*/
+    host_x86_MOV32_REG_ABS(block, REG_ECX, &cpu_override_dynarec);
+    host_x86_TEST32_REG(block, REG_ECX, REG_ECX);
+    host_x86_JNZ(block, codegen_exit_rout);
+    host_x86_MOVZX_REG_ABS_32_16(block, REG_ECX, &cpu_state.flags);
+    host_x86_TEST32_REG_IMM(block, REG_ECX, T_FLAG);
+    host_x86_JNZ(block, codegen_exit_rout);
+    host_x86_MOV32_REG_ABS(block, REG_ECX, &cr0);
+    host_x86_TEST32_REG_IMM(block, REG_ECX, 1 << 30);
+    host_x86_JNZ(block, codegen_exit_rout);
+#    ifdef USE_DEBUG_REGS_486
+    host_x86_MOV32_REG_ABS(block, REG_ECX, &dr[7]);
+    host_x86_TEST32_REG_IMM(block, REG_ECX, 0xff);
+    host_x86_JNZ(block, codegen_exit_rout);
+#    endif
+    if (block->flags & CODEBLOCK_STATIC_TOP) {
+        host_x86_MOV32_REG_ABS(block, REG_ECX, &cpu_state.TOP);
+        host_x86_AND32_REG_IMM(block, REG_ECX, 7);
+        host_x86_CMP32_REG_IMM(block, REG_ECX, block->TOP);
+        host_x86_JNZ(block, codegen_exit_rout);
     }
-    if (block->flags & CODEBLOCK_NO_IMMEDIATES)
-        host_x86_MOV64_REG_IMM(block, REG_R12, ((uintptr_t) ram) + 2147483648ULL);
+    if (block->page_mask & 0xffffffff) {
+        host_x86_MOV32_REG_ABS(block, REG_ECX, (uint32_t *) block->dirty_mask);
+        host_x86_TEST32_REG_IMM(block, REG_ECX, block->page_mask & 0xffffffff);
+        host_x86_JNZ(block, codegen_exit_rout);
+    }
+    if (block->page_mask >> 32) {
+        host_x86_MOV32_REG_ABS(block, REG_ECX, (uint32_t *) block->dirty_mask + 1);
+        host_x86_TEST32_REG_IMM(block, REG_ECX, block->page_mask >> 32);
+        host_x86_JNZ(block, codegen_exit_rout);
+    }
+
+    host_x86_JMP(block, codegen_chain_body);
 }
 
 void
@@ -394,5 +461,22 @@ codegen_backend_epilogue(codeblock_t *block)
     host_x86_POP(block, REG_RBP);
     host_x86_POP(block, REG_RBX);
     host_x86_RET(block);
+
+    /*Blocks spanning two pages would also need the mapping of the second page
+      checked, leave those to the dispatcher*/
+    if (!block->page_mask2)
+        codegen_backend_chain_entry(block);
+}
+
+void
+codegen_backend_chain_patch(uint32_t *jump_patch, void *dest)
+{
+    *jump_patch = (uintptr_t) dest - (uintptr_t) jump_patch - 4;
+}
+
+void
+codegen_backend_chain_epoch(uint32_t *epoch_patch, uint32_t epoch)
+{
+    *epoch_patch = epoch;
 }
 #endif
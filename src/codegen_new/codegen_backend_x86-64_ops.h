@@ -25,7 +25,8 @@ void host_x86_CMP8_REG_REG(codeblock_t *block, int src_reg_a, int src_reg_b);
 void host_x86_CMP16_REG_REG(codeblock_t *block, int src_reg_a, int src_reg_b);
 void host_x86_CMP32_REG_REG(codeblock_t *block, int src_reg_a, int src_reg_b);
 
-void host_x86_JMP(codeblock_t *block, void *p);
+void      host_x86_JMP(codeblock_t *block, void *p);
+uint32_t *host_x86_JMP_long(codeblock_t *block);
 
 void host_x86_JNZ(codeblock_t *block, void *p);
 void host_x86_JZ(codeblock_t *block, void *p);
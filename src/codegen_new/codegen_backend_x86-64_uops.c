@@ -4,6 +4,9 @@
 #    include <86box/86box.h>
 #    include "cpu.h"
 #    include <86box/mem.h>
+#    include <86box/nmi.h>
+#    include <86box/pic.h>
+#    include <86box/timer.h>
 #    include <86box/plat_unused.h>
 
 #    include "x86.h"
@@ -858,6 +861,73 @@ codegen_JMP(codeblock_t *block, uop_t *uop)
     return 0;
 }
 
+static int
+codegen_JMP_CHAIN(codeblock_t *block, UNUSED(uop_t *uop))
+{
+    codeblock_chain_t *exit;
+    uint32_t          *branch_offset[5];
+    uint8_t           *stub;
+
+    if (block->chain_exit_nr >= CODEBLOCK_CHAIN_EXITS) {
+        host_x86_JMP(block, codegen_exit_rout);
+        return 0;
+    }
+    exit = &block->chain_exits[block->chain_exit_nr];
+
+    /*Return to the dispatcher if the next timer is due. codegen_chain_cycles is
+      the value of cycles when the dispatcher entered this chain, and tsc has
+      not been advanced since*/
+    host_x86_MOV32_REG_ABS(block, REG_ECX, &timer_target);
+    host_x86_MOV32_REG_ABS(block, REG_ESI, &tsc);
+    host_x86_SUB32_REG_REG(block, REG_ECX, REG_ESI);
+    host_x86_MOV32_REG_ABS(block, REG_ESI, &codegen_chain_cycles);
+    host_x86_SUB32_REG_REG(block, REG_ESI, REG_ECX);
+    host_x86_MOV32_REG_ABS(block, REG_ECX, &cycles);
+    host_x86_CMP32_REG_REG(block, REG_ECX, REG_ESI);
+    branch_offset[0] = host_x86_JLE_long(block);
+    host_x86_TEST32_REG(block, REG_ECX, REG_ECX);
+    branch_offset[1] = host_x86_JLE_long(block);
+
+    /*...or if anything is pending that the dispatcher would act on*/
+    host_x86_MOVZX_REG_ABS_32_8(block, REG_ECX, &pic.int_pending);
+    host_x86_MOVZX_REG_ABS_32_8(block, REG_ESI, &smi_line);
+    host_x86_OR32_REG_REG(block, REG_ECX, REG_ESI);
+    host_x86_MOVZX_REG_ABS_32_8(block, REG_ESI, &cpu_state.abrt);
+    host_x86_OR32_REG_REG(block, REG_ECX, REG_ESI);
+    host_x86_MOV32_REG_ABS(block, REG_ESI, &nmi);
+    host_x86_OR32_REG_REG(block, REG_ECX, REG_ESI);
+    host_x86_MOV32_REG_ABS(block, REG_ESI, &new_ne);
+    host_x86_OR32_REG_REG(block, REG_ECX, REG_ESI);
+    host_x86_MOV32_REG_ABS(block, REG_ESI, &cpu_init);
+    host_x86_OR32_REG_REG(block, REG_ECX, REG_ESI);
+    branch_offset[2] = host_x86_JNZ_long(block);
+
+    /*...or if the TLB has been flushed since this exit was linked*/
+    host_x86_MOV32_REG_ABS(block, REG_ECX, &codegen_chain_epoch);
+    host_x86_MOV32_REG_IMM(block, REG_ESI, 0);
+    exit->epoch_patch = (uint32_t *) &block_write_data[block_pos - 4];
+    host_x86_CMP32_REG_REG(block, REG_ECX, REG_ESI);
+    branch_offset[3] = host_x86_JNZ_long(block);
+
+    /*Patched by codegen_chain_link() to jump to the target block*/
+    exit->jump_patch = host_x86_JMP_long(block);
+    branch_offset[4] = exit->jump_patch;
+
+    /*Unlinked stub*/
+    stub = &block_write_data[block_pos];
+    for (int c = 0; c < 5; c++)
+        *branch_offset[c] = (uintptr_t) stub - (uintptr_t) branch_offset[c] - 4;
+    host_x86_MOV64_REG_IMM(block, REG_RSI, (uintptr_t) &codegen_chain_exit);
+    host_x86_MOV32_BASE_OFFSET_IMM(block, REG_RSI, 0, CHAIN_EXIT(get_block_nr(block), block->chain_exit_nr));
+    host_x86_JMP(block, codegen_exit_rout);
+
+    exit->target = BLOCK_INVALID;
+    exit->next   = 0;
+    block->chain_exit_nr++;
+
+    return 0;
+}
+
 static int
 codegen_LOAD_FUNC_ARG0(codeblock_t *block, uop_t *uop)
 {
@@ -2880,6 +2950,9 @@ const uOpFn uop_handlers[UOP_MAX] = {
     [UOP_JMP &
         UOP_MASK]
     = codegen_JMP,
+    [UOP_JMP_CHAIN &
+        UOP_MASK]
+    = codegen_JMP_CHAIN,
 
     [UOP_LOAD_SEG &
         UOP_MASK]
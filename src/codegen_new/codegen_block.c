@@ -40,11 +40,18 @@ uint32_t op_old_pc;
 uint32_t recomp_page = -1;
 
 int        block_current = 0;
-static int block_num;
 int        block_pos;
 
 uint32_t codegen_endpc;
 
+/*Exit taken by the last block to return through an unlinked chain stub*/
+uint32_t codegen_chain_exit;
+/*Incremented on every TLB flush, linked exits only jump to their target
+  while this matches the value they were linked with*/
+uint32_t codegen_chain_epoch;
+/*Value of cycles when the dispatcher entered the running chain of blocks*/
+int32_t codegen_chain_cycles;
+
 int        codegen_block_cycles;
 static int codegen_block_ins;
 static int codegen_block_full_ins;
@@ -58,6 +65,7 @@ uint32_t instr_counts[256 * 256];
 #endif
 
 static uint16_t block_free_list;
+static int      free_list_size = 0;
 static void     delete_block(codeblock_t *block);
 static void     delete_dirty_block(codeblock_t *block);
 
@@ -72,6 +80,67 @@ static uint16_t block_dirty_list_tail;
 static int      dirty_list_size = 0;
 #define DIRTY_LIST_MAX_SIZE 64
 
+static int codeblock_victim_pos;
+
+static void
+codeblock_victim_remove(uint16_t block_nr)
+{
+    for (int c = 0; c < CODEBLOCK_VICTIM_SIZE; c++) {
+        if (codeblock_victim[c] == block_nr)
+            codeblock_victim[c] = BLOCK_INVALID;
+    }
+}
+
+/*Make block the most recently used way of its set. The least recently used
+  way is pushed out to the victim cache.*/
+void
+codeblock_hash_add(codeblock_t *block)
+{
+    uint16_t *set      = &codeblock_hash[CODEBLOCK_HASH_SET(block->phys) * CODEBLOCK_HASH_WAYS];
+    uint16_t  block_nr = get_block_nr(block);
+    int       way;
+
+    for (way = 0; way < CODEBLOCK_HASH_WAYS - 1; way++) {
+        if (set[way] == block_nr)
+            break;
+    }
+    if (set[way] != block_nr && set[way] != BLOCK_INVALID) {
+        codeblock_victim[codeblock_victim_pos] = set[way];
+        codeblock_victim_pos                   = (codeblock_victim_pos + 1) & (CODEBLOCK_VICTIM_SIZE - 1);
+    }
+    for (; way > 0; way--)
+        set[way] = set[way - 1];
+    set[0] = block_nr;
+
+    codeblock_victim_remove(block_nr);
+}
+
+void
+codeblock_hash_remove(codeblock_t *block)
+{
+    uint16_t *set      = &codeblock_hash[CODEBLOCK_HASH_SET(block->phys) * CODEBLOCK_HASH_WAYS];
+    uint16_t  block_nr = get_block_nr(block);
+
+    for (int way = 0; way < CODEBLOCK_HASH_WAYS; way++) {
+        if (set[way] == block_nr) {
+            for (; way < CODEBLOCK_HASH_WAYS - 1; way++)
+                set[way] = set[way + 1];
+            set[CODEBLOCK_HASH_WAYS - 1] = BLOCK_INVALID;
+            break;
+        }
+    }
+
+    codeblock_victim_remove(block_nr);
+}
+
+void
+codeblock_hash_clear(void)
+{
+    memset(codeblock_hash, 0, CODEBLOCK_HASH_SETS * CODEBLOCK_HASH_WAYS * sizeof(uint16_t));
+    memset(codeblock_victim, 0, sizeof(codeblock_victim));
+    codeblock_victim_pos = 0;
+}
+
 static void
 block_free_list_add(codeblock_t *block)
 {
@@ -85,6 +154,7 @@ block_free_list_add(codeblock_t *block)
         block->next = 0;
     block_free_list = get_block_nr(block);
     block->flags    = CODEBLOCK_IN_FREE_LIST;
+    free_list_size++;
 }
 
 static void
@@ -126,6 +196,7 @@ block_dirty_list_add(codeblock_t *block)
         dirty_list_size--;
         evict_block->flags &= ~CODEBLOCK_IN_DIRTY_LIST;
         delete_dirty_block(evict_block);
+        codegen_stats.dirty_evicted++;
     }
 }
 
@@ -163,7 +234,7 @@ block_dirty_list_remove(codeblock_t *block)
 int
 codegen_purge_purgable_list(void)
 {
-    if (purgable_page_list_head) {
+    if (purgable_page_list_head != EVICT_NOT_IN_LIST) {
         page_t *page = &pages[purgable_page_list_head];
 
         if (page->code_present_mask & page->dirty_mask) {
@@ -181,6 +252,9 @@ block_free_list_get(void)
 {
     codeblock_t *block = NULL;
 
+    if (!block_free_list)
+        codegen_stats.free_list_empty++;
+
     while (!block_free_list) {
         /*Free list is empty, check the dirty list*/
         if (block_dirty_list_tail) {
@@ -211,6 +285,7 @@ block_free_list_get(void)
     block_free_list = block->next;
     block->flags &= ~CODEBLOCK_IN_FREE_LIST;
     block->next = 0;
+    free_list_size--;
     return block;
 }
 
@@ -222,6 +297,7 @@ codegen_init(void)
 
     codegen_backend_init();
     block_free_list = 0;
+    free_list_size  = 0;
     for (uint32_t c = 0; c < BLOCK_SIZE; c++)
         block_free_list_add(&codeblock[c]);
     block_dirty_list_head = block_dirty_list_tail = 0;
@@ -247,10 +323,12 @@ codegen_reset(void)
     }
 
     memset(codeblock, 0, BLOCK_SIZE * sizeof(codeblock_t));
-    memset(codeblock_hash, 0, HASH_SIZE * sizeof(uint16_t));
+    codeblock_hash_clear();
     mem_reset_page_blocks();
+    codegen_chain_exit = 0;
 
     block_free_list = 0;
+    free_list_size  = 0;
     for (c = 0; c < BLOCK_SIZE; c++) {
         codeblock[c].pc = BLOCK_PC_INVALID;
         block_free_list_add(&codeblock[c]);
@@ -331,6 +409,10 @@ remove_from_block_list(codeblock_t *block, UNUSED(uint32_t pc))
 #ifndef RELEASE_BUILD
     if (block->flags & CODEBLOCK_IN_DIRTY_LIST)
         fatal("remove_from_block_list: in dirty list\n");
+    if (block->flags & CODEBLOCK_NOT_LISTED)
+        fatal("remove_from_block_list: not listed\n");
+    if (!block->prev && (pages[block->phys >> 12].block != get_block_nr(block)))
+        fatal("remove_from_block_list: not head of page %08x list\n", block->phys);
 #endif
     if (block->prev) {
         codeblock[block->prev].next = block->next;
@@ -352,6 +434,10 @@ remove_from_block_list(codeblock_t *block, UNUSED(uint32_t pc))
         return;
     }
     block->flags &= ~CODEBLOCK_HAS_PAGE2;
+#ifndef RELEASE_BUILD
+    if (!block->prev_2 && (pages[block->phys_2 >> 12].block_2 != get_block_nr(block)))
+        fatal("remove_from_block_list: not head of page %08x list_2\n", block->phys_2);
+#endif
 
     if (block->prev_2) {
         codeblock[block->prev_2].next_2 = block->next_2;
@@ -377,6 +463,7 @@ invalidate_block(codeblock_t *block)
     if (block->pc == BLOCK_PC_INVALID)
         fatal("Invalidating deleted block\n");
 #endif
+    codegen_chain_unlink(block);
     remove_from_block_list(block, old_pc);
     block_dirty_list_add(block);
     if (block->head_mem_block)
@@ -389,8 +476,7 @@ delete_block(codeblock_t *block)
 {
     uint32_t old_pc = block->pc;
 
-    if (block == &codeblock[codeblock_hash[HASH(block->phys)]])
-        codeblock_hash[HASH(block->phys)] = BLOCK_INVALID;
+    codeblock_hash_remove(block);
 
 #ifndef RELEASE_BUILD
     if (block->pc == BLOCK_PC_INVALID)
@@ -398,10 +484,11 @@ delete_block(codeblock_t *block)
 #endif
     block->pc = BLOCK_PC_INVALID;
 
+    codegen_chain_unlink(block);
     codeblock_tree_delete(block);
     if (block->flags & CODEBLOCK_IN_DIRTY_LIST)
         block_dirty_list_remove(block);
-    else
+    else if (!(block->flags & CODEBLOCK_NOT_LISTED))
         remove_from_block_list(block, old_pc);
     if (block->head_mem_block)
         codegen_allocator_free(block->head_mem_block);
@@ -412,8 +499,7 @@ delete_block(codeblock_t *block)
 static void
 delete_dirty_block(codeblock_t *block)
 {
-    if (block == &codeblock[codeblock_hash[HASH(block->phys)]])
-        codeblock_hash[HASH(block->phys)] = BLOCK_INVALID;
+    codeblock_hash_remove(block);
 
 #ifndef RELEASE_BUILD
     if (block->pc == BLOCK_PC_INVALID)
@@ -450,11 +536,19 @@ codegen_delete_random_block(int required_mem_block)
     }
 }
 
+void
+codegen_block_list_sizes(int *free_blocks, int *dirty_blocks)
+{
+    *free_blocks  = free_list_size;
+    *dirty_blocks = dirty_list_size;
+}
+
 void
 codegen_check_flush(page_t *page, UNUSED(uint64_t mask), UNUSED(uint32_t phys_addr))
 {
     uint16_t block_nr               = page->block;
     int      remove_from_evict_list = 0;
+    int      invalidated            = 0;
 
     while (block_nr) {
         codeblock_t *block      = &codeblock[block_nr];
@@ -462,6 +556,7 @@ codegen_check_flush(page_t *page, UNUSED(uint64_t mask), UNUSED(uint32_t phys_ad
 
         if (*block->dirty_mask & block->page_mask) {
             invalidate_block(block);
+            invalidated++;
         }
 #ifndef RELEASE_BUILD
         if (block_nr == next_block)
@@ -478,6 +573,7 @@ codegen_check_flush(page_t *page, UNUSED(uint64_t mask), UNUSED(uint32_t phys_ad
 
         if (*block->dirty_mask2 & block->page_mask2) {
             invalidate_block(block);
+            invalidated++;
         }
 #ifndef RELEASE_BUILD
         if (block_nr == next_block)
@@ -491,14 +587,18 @@ codegen_check_flush(page_t *page, UNUSED(uint64_t mask), UNUSED(uint32_t phys_ad
     page->code_present_mask &= ~page->dirty_mask;
     page->dirty_mask = 0;
 
-    for (uint8_t c = 0; c < 64; c++) {
-        if (page->byte_code_present_mask[c] & page->byte_dirty_mask[c])
-            remove_from_evict_list = 0;
-        page->byte_code_present_mask[c] &= ~page->byte_dirty_mask[c];
-        page->byte_dirty_mask[c] = 0;
+    if (page->byte_code_present_mask) {
+        for (uint8_t c = 0; c < 64; c++) {
+            if (page->byte_code_present_mask[c] & page->byte_dirty_mask[c])
+                remove_from_evict_list = 0;
+            page->byte_code_present_mask[c] &= ~page->byte_dirty_mask[c];
+            page->byte_dirty_mask[c] = 0;
+        }
     }
     if (remove_from_evict_list)
         page_remove_from_evict_list(page);
+
+    codegen_stats_flush(page - pages, invalidated);
 }
 
 void
@@ -516,9 +616,6 @@ codegen_block_init(uint32_t phys_addr)
 #endif
     block_current = get_block_nr(block);
 
-    block_num                 = HASH(phys_addr);
-    codeblock_hash[block_num] = block_current;
-
     block->ins         = 0;
     block->pc          = cs + cpu_state.pc;
     block->_cs         = cs;
@@ -530,9 +627,13 @@ codegen_block_init(uint32_t phys_addr)
     block->page_mask = block->page_mask2 = 0;
     block->flags                         = CODEBLOCK_STATIC_TOP;
     block->status                        = cpu_cur_status;
+    block->chain_entry                   = NULL;
+    block->chain_in                      = 0;
+    block->chain_exit_nr                 = 0;
 
     recomp_page = block->phys & ~0xfff;
     codeblock_tree_add(block);
+    codeblock_hash_add(block);
 }
 
 static ir_data_t *ir_data;
@@ -551,7 +652,6 @@ codegen_block_start_recompile(codeblock_t *block)
     if (!page->block)
         mem_flush_write_page(block->phys, cs + cpu_state.pc);
 
-    block_num     = HASH(block->phys);
     block_current = get_block_nr(block); // block->pnt;
 
 #ifndef RELEASE_BUILD
@@ -559,6 +659,7 @@ codegen_block_start_recompile(codeblock_t *block)
         fatal("Recompile to used block!\n");
 #endif
 
+    codegen_chain_unlink(block);
     block->head_mem_block = codegen_allocator_allocate(NULL, block_current);
     block->data           = codeblock_allocator_get_ptr(block->head_mem_block);
 
@@ -641,7 +742,7 @@ codegen_block_generate_end_mask_recompile(void)
         if (block->phys_2 != -1) {
             page_t *page_2 = &pages[block->phys_2 >> 12];
 
-            if (block->flags & CODEBLOCK_BYTE_MASK) {
+            if ((block->flags & CODEBLOCK_BYTE_MASK) && page_2->byte_code_present_mask) {
                 int offset = (block->phys_2 >> PAGE_BYTE_MASK_SHIFT) & PAGE_BYTE_MASK_OFFSET_MASK;
 
                 page_2->byte_code_present_mask[offset] |= block->page_mask2;
@@ -755,6 +856,7 @@ codegen_block_end(void)
 
     codegen_block_generate_end_mask_mark();
     add_to_block_list(block);
+    codegen_stats.marked++;
 }
 
 void
@@ -763,10 +865,15 @@ codegen_block_end_recompile(codeblock_t *block)
     codegen_timing_block_end();
     codegen_accumulate(ir_data, ACCREG_cycles, -codegen_block_cycles);
 
-    if (block->flags & CODEBLOCK_IN_DIRTY_LIST)
+    if (block->flags & CODEBLOCK_IN_DIRTY_LIST) {
         block_dirty_list_remove(block);
-    else
-        remove_from_block_list(block, block->pc);
+        codegen_stats.recompiled++;
+    } else {
+        if (!(block->flags & CODEBLOCK_NOT_LISTED))
+            remove_from_block_list(block, block->pc);
+        block->flags &= ~CODEBLOCK_NOT_LISTED;
+        codegen_stats.compiled++;
+    }
     block->next = block->prev = BLOCK_INVALID;
     block->next_2 = block->prev_2 = BLOCK_INVALID;
     codegen_block_generate_end_mask_recompile();
@@ -777,12 +884,96 @@ codegen_block_end_recompile(codeblock_t *block)
 
     codegen_accumulate_flush(ir_data);
     codegen_ir_compile(ir_data, block);
+
+    if (codegen_cache_active)
+        codegen_cache_add(block);
 }
 
 void
 codegen_flush(void)
 {
-    return;
+    /*Linear to physical mappings may have changed, stop all linked exits from
+      being taken until they have been relinked by the dispatcher*/
+    codegen_chain_epoch++;
+}
+
+/*Remove exit nr of block from the list of its target, and point it back at
+  its stub*/
+static void
+chain_exit_remove(codeblock_t *block, int nr)
+{
+    codeblock_chain_t *exit = &block->chain_exits[nr];
+    uint16_t           ref  = CHAIN_EXIT(get_block_nr(block), nr);
+    uint16_t          *prev = &codeblock[exit->target].chain_in;
+
+    while (*prev != ref) {
+#ifndef RELEASE_BUILD
+        if (!*prev)
+            fatal("chain_exit_remove: exit %04x not linked to %04x\n", ref, exit->target);
+#endif
+        prev = &codeblock[CHAIN_EXIT_BLOCK(*prev)].chain_exits[CHAIN_EXIT_NR(*prev)].next;
+    }
+    *prev = exit->next;
+
+    codegen_backend_chain_patch(exit->jump_patch, (uint8_t *) exit->jump_patch + 4);
+    exit->target = BLOCK_INVALID;
+}
+
+void
+codegen_chain_link(codeblock_t *block)
+{
+    uint32_t           ref = codegen_chain_exit;
+    uint16_t           block_nr;
+    codeblock_t       *from;
+    codeblock_chain_t *exit;
+
+    codegen_chain_exit = 0;
+    if (!ref || !block->chain_entry)
+        return;
+
+    from = &codeblock[CHAIN_EXIT_BLOCK(ref)];
+    if ((from->pc == BLOCK_PC_INVALID) || !(from->flags & CODEBLOCK_WAS_RECOMPILED) || (from->flags & CODEBLOCK_IN_DIRTY_LIST) || (from->_cs != block->_cs) || (CHAIN_EXIT_NR(ref) >= from->chain_exit_nr))
+        return;
+
+    block_nr = get_block_nr(block);
+    exit     = &from->chain_exits[CHAIN_EXIT_NR(ref)];
+    codegen_backend_chain_epoch(exit->epoch_patch, codegen_chain_epoch);
+    if (exit->target == block_nr)
+        return; /*Already linked, exit was refused because of a TLB flush or pending event*/
+    if (exit->target != BLOCK_INVALID)
+        chain_exit_remove(from, CHAIN_EXIT_NR(ref));
+
+    codegen_backend_chain_patch(exit->jump_patch, block->chain_entry);
+    exit->target    = block_nr;
+    exit->next      = block->chain_in;
+    block->chain_in = ref;
+}
+
+void
+codegen_chain_unlink(codeblock_t *block)
+{
+    uint16_t ref = block->chain_in;
+
+    /*Point all exits linked to this block back at their stubs*/
+    while (ref) {
+        codeblock_chain_t *exit = &codeblock[CHAIN_EXIT_BLOCK(ref)].chain_exits[CHAIN_EXIT_NR(ref)];
+
+        codegen_backend_chain_patch(exit->jump_patch, (uint8_t *) exit->jump_patch + 4);
+        exit->target = BLOCK_INVALID;
+        ref          = exit->next;
+    }
+    block->chain_in = 0;
+
+    /*Remove the exits of this block from the lists of their targets*/
+    for (int c = 0; c < block->chain_exit_nr; c++) {
+        if (block->chain_exits[c].target != BLOCK_INVALID)
+            chain_exit_remove(block, c);
+    }
+    block->chain_exit_nr = 0;
+    block->chain_entry   = NULL;
+
+    if (codegen_chain_exit && (CHAIN_EXIT_BLOCK(codegen_chain_exit) == get_block_nr(block)))
+        codegen_chain_exit = 0;
 }
 
 void
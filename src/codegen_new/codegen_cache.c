@@ -0,0 +1,378 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Persistent table of compile hints.
+ *
+ *          A block is normally only marked the first time it runs and
+ *          compiled the second time. The blocks that got compiled are
+ *          remembered across runs of the same machine, keyed by their
+ *          physical address, linear PC, CS and CPU status along with a
+ *          hash of their guest bytes, so that the next boot can compile
+ *          them the first time they are reached, with the code present
+ *          mask granularity they ended up needing.
+ *
+ *          This is not a translation cache: no host code is kept, as it
+ *          embeds the addresses of cpu_state, of the helpers and of the
+ *          other blocks, which all differ between runs. Hinted blocks
+ *          still go through the whole IR pipeline and the dirty mask
+ *          tracking, so the saving is the marking pass, and a stale
+ *          entry can only cost an unnecessary compile.
+ *
+ *          The table lives in a file next to the machine configuration,
+ *          which is mapped in shared so entries are written to it as
+ *          they are added. Without a mapping the table is only kept for
+ *          the current run.
+ *
+ * Authors: 86Box developers
+ *
+ *          Copyright 2026 86Box developers.
+ */
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#    include <windows.h>
+#    include <io.h>
+#else
+#    include <sys/mman.h>
+#    include <unistd.h>
+#endif
+#define HAVE_STDARG_H
+#include <86box/86box.h>
+#include "cpu.h"
+#include <86box/machine.h>
+#include <86box/mem.h>
+#include <86box/path.h>
+#include <86box/plat.h>
+
+#include "codegen.h"
+
+#define CODEGEN_CACHE_SIZE    0x10000 /* Entries, must be a power of 2 */
+#define CODEGEN_CACHE_PROBE   8
+#define CODEGEN_CACHE_VERSION 2
+#define CODEGEN_CACHE_FLAGS   (CODEBLOCK_BYTE_MASK | CODEBLOCK_NO_IMMEDIATES)
+
+typedef struct codegen_cache_entry_t {
+    uint32_t phys;
+    uint32_t pc;
+    uint32_t _cs;
+    uint32_t hash;
+    uint16_t status;
+    uint16_t flags;
+    uint16_t len; /* Guest bytes covered by hash, 0 if the entry is free */
+    uint16_t pad;
+} codegen_cache_entry_t;
+
+typedef struct codegen_cache_header_t {
+    char     magic[8];
+    uint32_t version;
+    uint32_t entry_size;
+    uint32_t entries;
+    int32_t  cpu;
+    char     machine[64];
+    char     cpu_family[64];
+} codegen_cache_header_t;
+
+#define CODEGEN_CACHE_FILE_SIZE (sizeof(codegen_cache_header_t) + (CODEGEN_CACHE_SIZE * sizeof(codegen_cache_entry_t)))
+
+static const char codegen_cache_magic[8] = { '8', '6', 'B', 'X', 'D', 'R', 'C', 0 };
+
+static codegen_cache_entry_t *codegen_cache;
+static FILE                  *codegen_cache_fp;
+static uint8_t               *codegen_cache_map; /* The whole file, NULL if the table is not mapped. */
+#ifdef _WIN32
+static HANDLE codegen_cache_map_handle;
+#endif
+int                           codegen_cache_active;
+codegen_cache_stats_t         codegen_cache_stats;
+
+#ifdef ENABLE_CODEGEN_CACHE_LOG
+int codegen_cache_do_log = ENABLE_CODEGEN_CACHE_LOG;
+
+static void
+codegen_cache_log(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (codegen_cache_do_log) {
+        va_start(ap, fmt);
+        pclog_ex(fmt, ap);
+        va_end(ap);
+    }
+}
+#else
+#    define codegen_cache_log(fmt, ...)
+#endif
+
+static void
+codegen_cache_path(char *path)
+{
+    path_append_filename(path, usr_path, "dynarec.cache");
+}
+
+static void
+codegen_cache_fill_header(codegen_cache_header_t *hdr)
+{
+    memset(hdr, 0x00, sizeof(codegen_cache_header_t));
+    memcpy(hdr->magic, codegen_cache_magic, sizeof(hdr->magic));
+    hdr->version    = CODEGEN_CACHE_VERSION;
+    hdr->entry_size = sizeof(codegen_cache_entry_t);
+    hdr->entries    = CODEGEN_CACHE_SIZE;
+    hdr->cpu        = cpu;
+    strncpy(hdr->machine, machine_get_internal_name(), sizeof(hdr->machine) - 1);
+    strncpy(hdr->cpu_family, cpu_f->internal_name, sizeof(hdr->cpu_family) - 1);
+}
+
+static __inline uint32_t
+codegen_cache_slot(uint32_t phys, uint32_t pc)
+{
+    uint32_t h = phys ^ (pc << 7) ^ (phys >> 15);
+
+    return (h ^ (h >> 16)) & (CODEGEN_CACHE_SIZE - 1);
+}
+
+/* FNV-1a over the guest bytes as seen by instruction fetches. */
+static int
+codegen_cache_hash(uint32_t phys, int len, uint32_t *hash)
+{
+    const uint8_t *p = _mem_exec[phys >> MEM_GRANULARITY_BITS];
+    uint32_t       h = 0x811c9dc5;
+
+    if (p == NULL)
+        return 0;
+
+    p += phys & MEM_GRANULARITY_MASK;
+    for (int c = 0; c < len; c++)
+        h = (h ^ p[c]) * 0x01000193;
+
+    *hash = h;
+    return 1;
+}
+
+/* Remember a block that has just been compiled. */
+void
+codegen_cache_add(codeblock_t *block)
+{
+    codegen_cache_entry_t *entry;
+    uint32_t               slot;
+    uint32_t               hash;
+    int                    len;
+
+    if (codegen_cache == NULL)
+        return;
+
+    /* Only the bytes on the first page are hashed. */
+    len = codegen_endpc - block->pc;
+    if (len > (0x1000 - (int) (block->phys & 0xfff)))
+        len = 0x1000 - (block->phys & 0xfff);
+    if ((len <= 0) || !codegen_cache_hash(block->phys, len, &hash))
+        return;
+
+    slot  = codegen_cache_slot(block->phys, block->pc);
+    entry = &codegen_cache[slot];
+    for (int c = 0; c < CODEGEN_CACHE_PROBE; c++) {
+        codegen_cache_entry_t *e = &codegen_cache[(slot + c) & (CODEGEN_CACHE_SIZE - 1)];
+
+        if (!e->len || ((e->phys == block->phys) && (e->pc == block->pc) && (e->_cs == block->_cs) &&
+                        (e->status == block->status))) {
+            entry = e;
+            break;
+        }
+    }
+
+    entry->phys   = block->phys;
+    entry->pc     = block->pc;
+    entry->_cs    = block->_cs;
+    entry->hash   = hash;
+    entry->status = block->status;
+    entry->flags  = block->flags & CODEGEN_CACHE_FLAGS;
+    entry->len    = len;
+    codegen_cache_stats.added++;
+}
+
+/*
+ * Called by the dispatcher when no block exists for the current position.
+ * If the block is known from an earlier run and its guest bytes have not
+ * changed, set it up to be compiled right away and return it.
+ */
+codeblock_t *
+codegen_cache_block_init(uint32_t phys_addr)
+{
+    const codegen_cache_entry_t *e;
+    codeblock_t                 *block;
+    const page_t                *page;
+    uint32_t                     slot;
+    uint32_t                     hash;
+
+    slot = codegen_cache_slot(phys_addr, cs + cpu_state.pc);
+    for (int c = 0; c < CODEGEN_CACHE_PROBE; c++) {
+        e = &codegen_cache[(slot + c) & (CODEGEN_CACHE_SIZE - 1)];
+
+        if (!e->len)
+            break;
+        if ((e->phys != phys_addr) || (e->pc != (cs + cpu_state.pc)) || (e->_cs != cs) ||
+            ((e->status ^ cpu_cur_status) & CPU_STATUS_FLAGS) ||
+            ((e->status & cpu_cur_status & CPU_STATUS_MASK) != (cpu_cur_status & CPU_STATUS_MASK)))
+            continue;
+
+        if (!codegen_cache_hash(phys_addr, e->len, &hash) || (hash != e->hash)) {
+            codegen_cache_stats.stale++;
+            return NULL;
+        }
+
+        codegen_block_init(phys_addr);
+        block = &codeblock[block_current];
+
+        /* Pages without RAM behind them have no byte masks. */
+        page = &pages[phys_addr >> 12];
+        if ((e->flags & CODEBLOCK_BYTE_MASK) && !page->byte_code_present_mask)
+            block->flags |= CODEBLOCK_NO_IMMEDIATES;
+        else
+            block->flags |= e->flags;
+        /* The marking pass that would have listed it is skipped. */
+        block->flags |= CODEBLOCK_NOT_LISTED;
+
+        codegen_cache_stats.hits++;
+        return block;
+    }
+
+    codegen_cache_stats.misses++;
+    return NULL;
+}
+
+/* Write a header and an empty table, for new files and ones made for another machine. */
+static int
+codegen_cache_create(FILE *fp, const codegen_cache_header_t *hdr)
+{
+    static const codegen_cache_entry_t empty[256];
+
+    if (fwrite(hdr, 1, sizeof(codegen_cache_header_t), fp) != sizeof(codegen_cache_header_t))
+        return -1;
+
+    for (int c = 0; c < CODEGEN_CACHE_SIZE; c += 256) {
+        if (fwrite(empty, sizeof(codegen_cache_entry_t), 256, fp) != 256)
+            return -1;
+    }
+
+    return (fflush(fp) == 0) ? 0 : -1;
+}
+
+static int
+codegen_cache_map_file(FILE *fp)
+{
+#ifdef _WIN32
+    codegen_cache_map_handle = CreateFileMapping((HANDLE) _get_osfhandle(_fileno(fp)), NULL, PAGE_READWRITE, 0, 0, NULL);
+    if (codegen_cache_map_handle == NULL)
+        return -1;
+    codegen_cache_map = (uint8_t *) MapViewOfFile(codegen_cache_map_handle, FILE_MAP_WRITE, 0, 0, CODEGEN_CACHE_FILE_SIZE);
+    if (codegen_cache_map == NULL) {
+        CloseHandle(codegen_cache_map_handle);
+        codegen_cache_map_handle = NULL;
+        return -1;
+    }
+#else
+    void *p = mmap(NULL, CODEGEN_CACHE_FILE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fileno(fp), 0);
+    if (p == MAP_FAILED)
+        return -1;
+    codegen_cache_map = (uint8_t *) p;
+#endif
+
+    return 0;
+}
+
+static void
+codegen_cache_close(void)
+{
+    if (codegen_cache_map != NULL) {
+#ifdef _WIN32
+        UnmapViewOfFile(codegen_cache_map);
+        CloseHandle(codegen_cache_map_handle);
+        codegen_cache_map_handle = NULL;
+#else
+        munmap(codegen_cache_map, CODEGEN_CACHE_FILE_SIZE);
+#endif
+        codegen_cache_map = NULL;
+    } else
+        free(codegen_cache);
+    codegen_cache = NULL;
+
+    if (codegen_cache_fp != NULL) {
+        fclose(codegen_cache_fp);
+        codegen_cache_fp = NULL;
+    }
+
+    codegen_cache_active = 0;
+}
+
+/* Map the table for the current machine, if enabled. */
+void
+codegen_cache_load(void)
+{
+    codegen_cache_header_t hdr;
+    codegen_cache_header_t file_hdr;
+    char                   path[1024];
+    FILE                  *fp;
+
+    codegen_cache_close();
+    memset(&codegen_cache_stats, 0x00, sizeof(codegen_cache_stats_t));
+
+    if (!cpu_dynarec_cache)
+        return;
+
+    codegen_cache_path(path);
+    codegen_cache_fill_header(&hdr);
+
+    fp = plat_fopen(path, "rb+");
+    if ((fp != NULL) &&
+        ((fread(&file_hdr, 1, sizeof(file_hdr), fp) != sizeof(file_hdr)) || memcmp(&hdr, &file_hdr, sizeof(hdr)) ||
+         (fseek(fp, 0, SEEK_END) != 0) || (ftell(fp) < (long) CODEGEN_CACHE_FILE_SIZE))) {
+        /* Different machine or format, start over. */
+        codegen_cache_log("CODEGEN: discarding compile hints %s\n", path);
+        fclose(fp);
+        fp = NULL;
+    }
+
+    if (fp == NULL) {
+        fp = plat_fopen(path, "wb+");
+        if ((fp != NULL) && (codegen_cache_create(fp, &hdr) < 0)) {
+            fclose(fp);
+            fp = NULL;
+            remove(path);
+        }
+    }
+
+    if ((fp != NULL) && (codegen_cache_map_file(fp) == 0)) {
+        codegen_cache_fp = fp;
+        codegen_cache    = (codegen_cache_entry_t *) (codegen_cache_map + sizeof(codegen_cache_header_t));
+        codegen_cache_log("CODEGEN: mapped compile hints %s\n", path);
+    } else {
+        if (fp != NULL)
+            fclose(fp);
+        codegen_cache = (codegen_cache_entry_t *) calloc(CODEGEN_CACHE_SIZE, sizeof(codegen_cache_entry_t));
+        codegen_cache_log("CODEGEN: unable to map compile hints %s, keeping them for this run only\n", path);
+    }
+
+    codegen_cache_active = (codegen_cache != NULL);
+}
+
+/* Called when the machine is closed or hard reset. Entries are already in
+   the file, unmapping it leaves the writing back to the host. */
+void
+codegen_cache_save(void)
+{
+    if (!codegen_cache_active)
+        return;
+
+    codegen_cache_log("CODEGEN: compile hints %" PRIu64 " hits, %" PRIu64 " misses, %" PRIu64 " stale, %" PRIu64 " added\n",
+                      codegen_cache_stats.hits, codegen_cache_stats.misses, codegen_cache_stats.stale, codegen_cache_stats.added);
+
+    codegen_cache_close();
+}
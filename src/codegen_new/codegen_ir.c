@@ -1,4 +1,7 @@
+#include <stdarg.h>
 #include <stdint.h>
+#include <string.h>
+#define HAVE_STDARG_H
 #include <86box/86box.h>
 #include "cpu.h"
 #include <86box/mem.h>
@@ -17,6 +20,26 @@ static int codegen_unroll_start;
 static int codegen_unroll_count;
 static int codegen_unroll_first_instruction;
 
+static uint8_t uop_barrier_or_dest[UOP_NR_MAX + 1];
+
+#ifdef ENABLE_CODEGEN_IR_LOG
+int codegen_ir_do_log = ENABLE_CODEGEN_IR_LOG;
+
+static void
+codegen_ir_log(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (codegen_ir_do_log) {
+        va_start(ap, fmt);
+        pclog_ex(fmt, ap);
+        va_end(ap);
+    }
+}
+#else
+#    define codegen_ir_log(fmt, ...)
+#endif
+
 ir_data_t *
 codegen_ir_init(void)
 {
@@ -59,10 +82,125 @@ duplicate_uop(ir_data_t *ir, uop_t *uop, int offset)
     }
 }
 
+#ifdef ENABLE_CODEGEN_IR_LOG
+static int
+count_live_uops(ir_data_t *ir)
+{
+    int count = 0;
+
+    for (int c = 0; c < ir->wr_pos; c++) {
+        if ((ir->uops[c].type & UOP_MASK) != UOP_INVALID)
+            count++;
+    }
+
+    return count;
+}
+#endif
+
+/*Remove constant stores that write the value a register already holds.
+
+  The dead list only catches a version that is overwritten before anything
+  reads it. Each translated instruction stores its flags_op (and op32, ssegs,
+  ...) as an immediate though, and the memory accesses in between mark those
+  versions as required, so a run of ADDs still writes back FLAGS_ADD32 once
+  per instruction. When a MOV_IMM/MOV_PTR stores the same value as the
+  previous version of its register, and nothing could have changed the
+  register in between (no barrier, which may call C code touching cpu_state,
+  and no jump landing in between), fold it into the previous version. Readers
+  are pointed at the older version, which inherits the required flag, and
+  the register allocator then sees nothing dirty to write back.*/
+static void
+codegen_ir_fold_constants(ir_data_t *ir)
+{
+    int last_barrier = -1;
+
+    memset(uop_barrier_or_dest, 0, ir->wr_pos + 1);
+    for (int c = 0; c < ir->wr_pos; c++) {
+        const uop_t *uop = &ir->uops[c];
+
+        if (uop->type & UOP_TYPE_BARRIER)
+            uop_barrier_or_dest[c] = 1;
+        if ((uop->type & UOP_TYPE_JUMP) && uop->jump_dest_uop != -1)
+            uop_barrier_or_dest[uop->jump_dest_uop] = 1;
+    }
+
+    for (int c = 0; c < ir->wr_pos; c++) {
+        uop_t         *uop = &ir->uops[c];
+        uop_t         *prev_uop;
+        ir_reg_t       dest;
+        reg_version_t *version;
+        reg_version_t *prev;
+        int            reg;
+        int            prev_nr;
+        int            next_write;
+
+        if (uop_barrier_or_dest[c])
+            last_barrier = c;
+
+        if ((uop->type & UOP_MASK) != (UOP_MOV_IMM & UOP_MASK) && (uop->type & UOP_MASK) != (UOP_MOV_PTR & UOP_MASK))
+            continue;
+
+        dest = uop->dest_reg_a;
+        reg  = IREG_GET_REG(dest.reg);
+        if (reg <= IREG_EBX || reg >= IREG_temp0 || !reg_is_native_size(dest))
+            continue;
+        version = &reg_version[reg][dest.version];
+        if (version->flags & REG_FLAGS_DEAD)
+            continue;
+
+        /*Skip over versions folded away earlier*/
+        prev_nr = dest.version - 1;
+        while (prev_nr > 0 && (reg_version[reg][prev_nr].flags & REG_FLAGS_DEAD))
+            prev_nr--;
+        if (prev_nr < 1)
+            continue;
+        prev = &reg_version[reg][prev_nr];
+        if (!prev->refcount && !(prev->flags & REG_FLAGS_REQUIRED))
+            continue; /*Already on the dead list*/
+        if ((prev->refcount + version->refcount) > REG_REFCOUNT_MAX)
+            continue;
+        if (last_barrier > prev->parent_uop)
+            continue;
+
+        prev_uop = &ir->uops[prev->parent_uop];
+        if (prev_uop->type != uop->type || prev_uop->dest_reg_a.reg != dest.reg || prev_uop->imm_data != uop->imm_data || prev_uop->p != uop->p)
+            continue;
+
+        /*A partial write of the next version merges with this one, so the
+          allocator has to see it as the parent*/
+        for (next_write = c + 1; next_write < ir->wr_pos; next_write++) {
+            const ir_reg_t next_dest = ir->uops[next_write].dest_reg_a;
+
+            if (!ir_reg_is_invalid(next_dest) && IREG_GET_REG(next_dest.reg) == reg)
+                break;
+        }
+        if (next_write < ir->wr_pos && !reg_is_native_size(ir->uops[next_write].dest_reg_a))
+            continue;
+
+        for (int d = c + 1; d <= next_write && d < ir->wr_pos; d++) {
+            uop_t *reader = &ir->uops[d];
+
+            if (IREG_GET_REG(reader->src_reg_a.reg) == reg && reader->src_reg_a.version == dest.version)
+                reader->src_reg_a.version = prev_nr;
+            if (IREG_GET_REG(reader->src_reg_b.reg) == reg && reader->src_reg_b.version == dest.version)
+                reader->src_reg_b.version = prev_nr;
+            if (IREG_GET_REG(reader->src_reg_c.reg) == reg && reader->src_reg_c.version == dest.version)
+                reader->src_reg_c.version = prev_nr;
+        }
+
+        prev->refcount += version->refcount;
+        prev->flags |= (version->flags & REG_FLAGS_REQUIRED);
+        version->refcount = 0;
+        version->flags    = REG_FLAGS_DEAD;
+        uop->type         = UOP_INVALID;
+    }
+}
+
 void
 codegen_ir_compile(ir_data_t *ir, codeblock_t *block)
 {
     int jump_target_at_end = -1;
+    int uops               = 0;
     int c;
 
     if (codegen_unroll_count) {
@@ -82,7 +220,12 @@ codegen_ir_compile(ir_data_t *ir, codeblock_t *block)
     }
 
     codegen_reg_mark_as_required();
+#ifdef ENABLE_CODEGEN_IR_LOG
+    int uops_before = ir->wr_pos;
+#endif
+    codegen_ir_fold_constants(ir);
     codegen_reg_process_dead_list(ir);
+    codegen_ir_log("IR: block %08x, %i uOPs, %i after optimisation\n", block->pc, uops_before, count_live_uops(ir));
     block_write_data = codeblock_allocator_get_ptr(block->head_mem_block);
     block_pos        = 0;
     codegen_backend_prologue(block);
@@ -106,6 +249,7 @@ codegen_ir_compile(ir_data_t *ir, codeblock_t *block)
 
         if ((uop->type & UOP_MASK) == UOP_INVALID)
             continue;
+        uops++;
 
 #ifdef CODEGEN_BACKEND_HAS_MOV_IMM
         if ((uop->type & UOP_MASK) == (UOP_MOV_IMM & UOP_MASK) && reg_is_native_size(uop->dest_reg_a) && !codegen_reg_is_loaded(uop->dest_reg_a) && reg_version[IREG_GET_REG(uop->dest_reg_a.reg)][uop->dest_reg_a.version].refcount <= 0) {
@@ -190,6 +334,9 @@ codegen_ir_compile(ir_data_t *ir, codeblock_t *block)
 
     codegen_backend_epilogue(block);
     block_write_data = NULL;
+
+    /*Every mem block but the one being written is counted as full*/
+    codegen_stats_block(uops, (codegen_allocator_count(block->head_mem_block) - 1) * MEM_BLOCK_SIZE + block_pos);
 #if 0
     if (has_ea)
         fatal("IR compilation complete\n");
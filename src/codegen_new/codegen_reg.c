@@ -606,11 +606,18 @@ codegen_reg_alloc_register(ir_reg_t dest_reg_a, ir_reg_t src_reg_a, ir_reg_t src
     host_fp_reg_set.locked = 0;
 
     if (!ir_reg_is_invalid(dest_reg_a)) {
-        if (!ir_reg_is_invalid(src_reg_a) && IREG_GET_REG(src_reg_a.reg) == IREG_GET_REG(dest_reg_a.reg) && src_reg_a.version == dest_reg_a.version - 1)
+        /*Versions folded away by the IR optimiser are marked dead, so the
+          parent of dest is the last live version before it*/
+        int parent_version = dest_reg_a.version - 1;
+
+        while (parent_version > 0 && (reg_version[IREG_GET_REG(dest_reg_a.reg)][parent_version].flags & REG_FLAGS_DEAD) && reg_version[IREG_GET_REG(dest_reg_a.reg)][parent_version].refcount == 0)
+            parent_version--;
+
+        if (!ir_reg_is_invalid(src_reg_a) && IREG_GET_REG(src_reg_a.reg) == IREG_GET_REG(dest_reg_a.reg) && src_reg_a.version == parent_version)
             dest_reference++;
-        if (!ir_reg_is_invalid(src_reg_b) && IREG_GET_REG(src_reg_b.reg) == IREG_GET_REG(dest_reg_a.reg) && src_reg_b.version == dest_reg_a.version - 1)
+        if (!ir_reg_is_invalid(src_reg_b) && IREG_GET_REG(src_reg_b.reg) == IREG_GET_REG(dest_reg_a.reg) && src_reg_b.version == parent_version)
             dest_reference++;
-        if (!ir_reg_is_invalid(src_reg_c) && IREG_GET_REG(src_reg_c.reg) == IREG_GET_REG(dest_reg_a.reg) && src_reg_c.version == dest_reg_a.version - 1)
+        if (!ir_reg_is_invalid(src_reg_c) && IREG_GET_REG(src_reg_c.reg) == IREG_GET_REG(dest_reg_a.reg) && src_reg_c.version == parent_version)
             dest_reference++;
     }
     if (!ir_reg_is_invalid(src_reg_a))
@@ -885,19 +892,19 @@ codegen_reg_process_dead_list(ir_data_t *ir)
             if (uop->src_reg_a.reg != IREG_INVALID) {
                 reg_version_t *src_regv = &reg_version[IREG_GET_REG(uop->src_reg_a.reg)][uop->src_reg_a.version];
                 src_regv->refcount--;
-                if (!src_regv->refcount)
+                if (!src_regv->refcount && !(src_regv->flags & REG_FLAGS_REQUIRED))
                     add_to_dead_list(src_regv, IREG_GET_REG(uop->src_reg_a.reg), uop->src_reg_a.version);
             }
             if (uop->src_reg_b.reg != IREG_INVALID) {
                 reg_version_t *src_regv = &reg_version[IREG_GET_REG(uop->src_reg_b.reg)][uop->src_reg_b.version];
                 src_regv->refcount--;
-                if (!src_regv->refcount)
+                if (!src_regv->refcount && !(src_regv->flags & REG_FLAGS_REQUIRED))
                     add_to_dead_list(src_regv, IREG_GET_REG(uop->src_reg_b.reg), uop->src_reg_b.version);
             }
             if (uop->src_reg_c.reg != IREG_INVALID) {
                 reg_version_t *src_regv = &reg_version[IREG_GET_REG(uop->src_reg_c.reg)][uop->src_reg_c.version];
                 src_regv->refcount--;
-                if (!src_regv->refcount)
+                if (!src_regv->refcount && !(src_regv->flags & REG_FLAGS_REQUIRED))
                     add_to_dead_list(src_regv, IREG_GET_REG(uop->src_reg_c.reg), uop->src_reg_c.version);
             }
             regv->flags |= REG_FLAGS_DEAD;
@@ -0,0 +1,214 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Runtime statistics of the new dynamic recompiler.
+ *
+ *          Counts compiled and recompiled blocks, their size in uOPs
+ *          and host bytes, invalidations caused by writes to code, the
+ *          occupancy of the free and dirty block lists and the hits in
+ *          each way of the block lookup cache, along with the use made
+ *          of the persistent compile hints. They are
+ *          reported once per second in the log, through the GDB stub
+ *          "dynarec" monitor command, and written to a file on exit.
+ *
+ * Authors: 86Box developers
+ *
+ *          Copyright 2026 86Box developers.
+ */
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <wchar.h>
+#define HAVE_STDARG_H
+#include <86box/86box.h>
+#include "cpu.h"
+#include <86box/mem.h>
+#include <86box/path.h>
+#include <86box/plat.h>
+
+#include "codegen.h"
+
+codegen_stats_t codegen_stats;
+
+static codegen_stats_t codegen_stats_last;
+
+static const char *codegen_stats_bucket_names[CODEGEN_STATS_BUCKETS] = {
+    "0-1", "2-3", "4-7", "8-15", "16-31", "32-63", "64-127", "128-255",
+    "256-511", "512-1023", "1024-2047", "2048+"
+};
+
+#ifdef ENABLE_CODEGEN_STATS_LOG
+int codegen_stats_do_log = ENABLE_CODEGEN_STATS_LOG;
+
+static void
+codegen_stats_log(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (codegen_stats_do_log) {
+        va_start(ap, fmt);
+        pclog_ex(fmt, ap);
+        va_end(ap);
+    }
+}
+#else
+#    define codegen_stats_log(fmt, ...)
+#endif
+
+static int
+codegen_stats_bucket(uint32_t val)
+{
+    int bucket = 0;
+
+    while ((val > 1) && (bucket < (CODEGEN_STATS_BUCKETS - 1))) {
+        val >>= 1;
+        bucket++;
+    }
+
+    return bucket;
+}
+
+/* Called once a block has been compiled to host code. */
+void
+codegen_stats_block(int uops, int host_bytes)
+{
+    codegen_stats.uops[codegen_stats_bucket(uops)]++;
+    codegen_stats.host_bytes[codegen_stats_bucket(host_bytes)]++;
+}
+
+/* Called by codegen_check_flush() with the number of blocks it invalidated. */
+void
+codegen_stats_flush(uint32_t page, int invalidated)
+{
+    codegen_stats_page_t *p = &codegen_stats.flush_pages[page & (CODEGEN_STATS_PAGES - 1)];
+
+    codegen_stats.flushes++;
+    codegen_stats.invalidated += invalidated;
+    codegen_stats.flush_invalidated[codegen_stats_bucket(invalidated)]++;
+
+    if (!invalidated)
+        return;
+
+    /* Keep the pages seeing the most invalidations, a new page only takes
+       over a slot once it has worn down the count of the old one. */
+    if (p->page == page)
+        p->count += invalidated;
+    else if (p->count > (uint32_t) invalidated)
+        p->count -= invalidated;
+    else {
+        p->page  = page;
+        p->count = invalidated;
+    }
+}
+
+static int
+codegen_stats_print_hist(char *buf, int size, const char *name, const uint64_t *hist)
+{
+    int pos = snprintf(buf, size, "%s:\n", name);
+
+    for (int c = 0; (c < CODEGEN_STATS_BUCKETS) && (pos < size); c++) {
+        if (hist[c])
+            pos += snprintf(&buf[pos], size - pos, "  %-10s %" PRIu64 "\n", codegen_stats_bucket_names[c], hist[c]);
+    }
+
+    return (pos < size) ? pos : size;
+}
+
+/* Print the statistics into buf, returns the length of the text. */
+int
+codegen_stats_print(char *buf, int size)
+{
+    int free_blocks;
+    int dirty_blocks;
+    int pos;
+
+    codegen_block_list_sizes(&free_blocks, &dirty_blocks);
+
+    pos = snprintf(buf, size,
+                   "Blocks marked:      %" PRIu64 "\n"
+                   "Blocks compiled:    %" PRIu64 "\n"
+                   "Blocks recompiled:  %" PRIu64 "\n"
+                   "Page flushes:       %" PRIu64 " (%" PRIu64 " blocks invalidated)\n"
+                   "Dirty list evicted: %" PRIu64 "\n"
+                   "Free list empty:    %" PRIu64 "\n"
+                   "Free list:          %i blocks\n"
+                   "Dirty list:         %i blocks\n",
+                   codegen_stats.marked, codegen_stats.compiled, codegen_stats.recompiled,
+                   codegen_stats.flushes, codegen_stats.invalidated, codegen_stats.dirty_evicted,
+                   codegen_stats.free_list_empty, free_blocks, dirty_blocks);
+
+    if (pos < size) {
+        pos += snprintf(&buf[pos], size - pos, "Block lookups:      ");
+        for (int c = 0; (c < CODEBLOCK_HASH_WAYS) && (pos < size); c++)
+            pos += snprintf(&buf[pos], size - pos, "%" PRIu64 " way %i, ", codeblock_hash_stats.way_hits[c], c);
+        if (pos < size)
+            pos += snprintf(&buf[pos], size - pos, "%" PRIu64 " victim, %" PRIu64 " missed\n",
+                            codeblock_hash_stats.victim_hits, codeblock_hash_stats.misses);
+    }
+    /* Still there after the hints have been closed on exit. */
+    if ((pos < size) && (codegen_cache_stats.hits || codegen_cache_stats.misses || codegen_cache_stats.added))
+        pos += snprintf(&buf[pos], size - pos,
+                        "Compile hints:      %" PRIu64 " hits, %" PRIu64 " misses, %" PRIu64 " stale, %" PRIu64 " added\n",
+                        codegen_cache_stats.hits, codegen_cache_stats.misses, codegen_cache_stats.stale,
+                        codegen_cache_stats.added);
+    if (pos < size)
+        pos += codegen_stats_print_hist(&buf[pos], size - pos, "uOPs per block", codegen_stats.uops);
+    if (pos < size)
+        pos += codegen_stats_print_hist(&buf[pos], size - pos, "Host bytes per block", codegen_stats.host_bytes);
+    if (pos < size)
+        pos += codegen_stats_print_hist(&buf[pos], size - pos, "Blocks invalidated per page flush", codegen_stats.flush_invalidated);
+    if (pos < size)
+        pos += snprintf(&buf[pos], size - pos, "Most invalidated pages:\n");
+    for (int c = 0; (c < CODEGEN_STATS_PAGES) && (pos < size); c++) {
+        if (codegen_stats.flush_pages[c].count)
+            pos += snprintf(&buf[pos], size - pos, "  %08X %u\n",
+                            codegen_stats.flush_pages[c].page << 12, codegen_stats.flush_pages[c].count);
+    }
+
+    return (pos < size) ? pos : size;
+}
+
+/* Called once per second to log the rates since the last call. */
+void
+codegen_stats_onesec(void)
+{
+#ifdef ENABLE_CODEGEN_STATS_LOG
+    int free_blocks;
+    int dirty_blocks;
+
+    codegen_block_list_sizes(&free_blocks, &dirty_blocks);
+    codegen_stats_log("CODEGEN: %" PRIu64 " compiled/s, %" PRIu64 " recompiled/s, %" PRIu64 " invalidated/s, free %i, dirty %i\n",
+                      codegen_stats.compiled - codegen_stats_last.compiled,
+                      codegen_stats.recompiled - codegen_stats_last.recompiled,
+                      codegen_stats.invalidated - codegen_stats_last.invalidated,
+                      free_blocks, dirty_blocks);
+#endif
+
+    codegen_stats_last = codegen_stats;
+}
+
+/* Write the statistics next to the machine configuration. */
+void
+codegen_stats_dump(void)
+{
+    char  path[1024];
+    char  buf[8192];
+    FILE *fp;
+    int   len;
+
+    path_append_filename(path, usr_path, "dynarec_stats.txt");
+    fp = plat_fopen(path, "w");
+    if (fp == NULL)
+        return;
+
+    len = codegen_stats_print(buf, sizeof(buf));
+    fwrite(buf, 1, len, fp);
+    fclose(fp);
+}
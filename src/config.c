@@ -474,7 +474,12 @@ load_machine(void)
     if (mem_size > machine_get_max_ram(machine))
         mem_size = machine_get_max_ram(machine);
 
+    mem_huge_pages = !!ini_section_get_int(cat, "mem_huge_pages", 0);
+    mem_mergeable  = !!ini_section_get_int(cat, "mem_mergeable", 0);
+
     cpu_use_dynarec = !!ini_section_get_int(cat, "cpu_use_dynarec", 0);
+    cpu_dynarec_cache = !!ini_section_get_int(cat, "cpu_dynarec_cache", 0);
+    cpu_dynarec_stats = !!ini_section_get_int(cat, "cpu_dynarec_stats", 0);
     fpu_softfloat = !!ini_section_get_int(cat, "fpu_softfloat", 0);
     if ((fpu_type != FPU_NONE) && machine_has_flags(machine, MACHINE_SOFTFLOAT_ONLY))
         fpu_softfloat = 1;
@@ -856,6 +861,9 @@ load_network(void)
          sprintf(temp, "net_%02i_promisc", c + 1);
          net_cards_conf[c].promisc_mode = ini_section_get_int(cat, temp, 0);
 
+         sprintf(temp, "net_%02i_switch_shm", c + 1);
+         net_cards_conf[c].switch_shm = ini_section_get_int(cat, temp, 0);
+
          sprintf(temp, "net_%02i_nrs_host", c + 1);
          p = ini_section_get_string(cat, temp, NULL);
          if (p != NULL)
@@ -1339,6 +1347,33 @@ load_hard_disks(void)
         p = ini_section_get_string(cat, temp, "");
         strncpy(hdd[c].vhd_parent, p, sizeof(hdd[c].vhd_parent) - 1);
 
+        memset(hdd[c].overlay, 0x00, sizeof(hdd[c].overlay));
+        sprintf(temp, "hdd_%02i_overlay", c + 1);
+        p = ini_section_get_string(cat, temp, "");
+        if (p[0] != 0x00) {
+            if (path_abs(p)) {
+                if (strlen(p) > 511)
+                    fatal("Configuration: Length of hdd_%02i_overlay is more "
+                          "than 511\n", c + 1);
+                else
+                    strncpy(hdd[c].overlay, p, 511);
+            } else
+                path_append_filename(hdd[c].overlay, usr_path, p);
+            path_normalize(hdd[c].overlay);
+        }
+
+        sprintf(temp, "hdd_%02i_write_cache", c + 1);
+        p = ini_section_get_string(cat, temp, "writeback");
+        if (!strcmp(p, "writethrough"))
+            hdd[c].write_cache = HDD_WRITE_CACHE_THROUGH;
+        else if (!strcmp(p, "unsafe"))
+            hdd[c].write_cache = HDD_WRITE_CACHE_UNSAFE;
+        else
+            hdd[c].write_cache = HDD_WRITE_CACHE_BACK;
+
+        sprintf(temp, "hdd_%02i_flush_timeout", c + 1);
+        hdd[c].flush_timeout = ini_section_get_int(cat, temp, 0);
+
         /* If disk is empty or invalid, mark it for deletion. */
         if (!hdd_is_valid(c)) {
             sprintf(temp, "hdd_%02i_parameters", c + 1);
@@ -1361,6 +1396,15 @@ load_hard_disks(void)
 
             sprintf(temp, "hdd_%02i_fn", c + 1);
             ini_section_delete_var(cat, temp);
+
+            sprintf(temp, "hdd_%02i_overlay", c + 1);
+            ini_section_delete_var(cat, temp);
+
+            sprintf(temp, "hdd_%02i_write_cache", c + 1);
+            ini_section_delete_var(cat, temp);
+
+            sprintf(temp, "hdd_%02i_flush_timeout", c + 1);
+            ini_section_delete_var(cat, temp);
         }
     }
 }
@@ -2187,6 +2231,10 @@ config_load(void)
         /* Unmute the CD audio on the first CD-ROM drive. */
         cdrom[0].sound_on = 1;
         mem_size          = 64;
+        mem_huge_pages    = 0;
+        mem_mergeable     = 0;
+        cpu_dynarec_cache = 0;
+        cpu_dynarec_stats = 0;
         isartc_type       = 0;
         for (i = 0; i < ISAROM_MAX; i++)
             isarom_type[i] = 0;
@@ -2580,8 +2628,28 @@ save_machine(void)
        to display it without having the actual machine table. */
     ini_section_set_int(cat, "mem_size", mem_size);
 
+    if (mem_huge_pages == 0)
+        ini_section_delete_var(cat, "mem_huge_pages");
+    else
+        ini_section_set_int(cat, "mem_huge_pages", mem_huge_pages);
+
+    if (mem_mergeable == 0)
+        ini_section_delete_var(cat, "mem_mergeable");
+    else
+        ini_section_set_int(cat, "mem_mergeable", mem_mergeable);
+
     ini_section_set_int(cat, "cpu_use_dynarec", cpu_use_dynarec);
 
+    if (cpu_dynarec_cache == 0)
+        ini_section_delete_var(cat, "cpu_dynarec_cache");
+    else
+        ini_section_set_int(cat, "cpu_dynarec_cache", cpu_dynarec_cache);
+
+    if (cpu_dynarec_stats == 0)
+        ini_section_delete_var(cat, "cpu_dynarec_stats");
+    else
+        ini_section_set_int(cat, "cpu_dynarec_stats", cpu_dynarec_stats);
+
     if (fpu_softfloat == 0)
         ini_section_delete_var(cat, "fpu_softfloat");
     else
@@ -2908,6 +2976,12 @@ save_network(void)
         else
             ini_section_set_int(cat, temp, net_cards_conf[c].promisc_mode);
 
+        sprintf(temp, "net_%02i_switch_shm", c + 1);
+        if ((nc->device_num == 0) || !net_cards_conf[c].switch_shm)
+            ini_section_delete_var(cat, temp);
+        else
+            ini_section_set_int(cat, temp, net_cards_conf[c].switch_shm);
+
         sprintf(temp, "net_%02i_nrs_host", c + 1);
         if (nc->device_num == 0)
             ini_section_delete_var(cat, temp);
@@ -3369,6 +3443,29 @@ save_hard_disks(void)
         } else
             ini_section_delete_var(cat, temp);
 
+        sprintf(temp, "hdd_%02i_overlay", c + 1);
+        if (hdd_is_valid(c) && hdd[c].overlay[0]) {
+            path_normalize(hdd[c].overlay);
+            if (!strnicmp(hdd[c].overlay, usr_path, strlen(usr_path)))
+                ini_section_set_string(cat, temp, &hdd[c].overlay[strlen(usr_path)]);
+            else
+                ini_section_set_string(cat, temp, hdd[c].overlay);
+        } else
+            ini_section_delete_var(cat, temp);
+
+        sprintf(temp, "hdd_%02i_write_cache", c + 1);
+        if (!hdd_is_valid(c) || (hdd[c].write_cache == HDD_WRITE_CACHE_BACK))
+            ini_section_delete_var(cat, temp);
+        else
+            ini_section_set_string(cat, temp, (hdd[c].write_cache == HDD_WRITE_CACHE_UNSAFE) ?
+                                   "unsafe" : "writethrough");
+
+        sprintf(temp, "hdd_%02i_flush_timeout", c + 1);
+        if (!hdd_is_valid(c) || (hdd[c].flush_timeout == 0))
+            ini_section_delete_var(cat, temp);
+        else
+            ini_section_set_int(cat, temp, hdd[c].flush_timeout);
+
         sprintf(temp, "hdd_%02i_speed", c + 1);
         if (!hdd_is_valid(c) ||
             ((hdd[c].bus_type != HDD_BUS_ESDI) && (hdd[c].bus_type != HDD_BUS_IDE) &&
@@ -237,6 +237,10 @@ fetch_ea_16_long(uint32_t rmdat)
 int32_t         cycles_main = 0;
 static int32_t  cycles_old  = 0;
 static uint64_t tsc_old     = 0;
+#    ifdef USE_NEW_DYNAREC
+/*Linear PC the last translated block returned to the dispatcher with*/
+static uint32_t chain_pc = 0;
+#    endif
 
 #    ifdef USE_ACYCS
 int32_t acycs = 0;
@@ -381,10 +385,10 @@ exec386_dynarec_dyn(void)
 {
     uint32_t start_pc  = 0;
     uint32_t phys_addr = get_phys(cs + cpu_state.pc);
-    int      hash      = HASH(phys_addr);
 #    ifdef USE_NEW_DYNAREC
-    codeblock_t *block = &codeblock[codeblock_hash[hash]];
+    codeblock_t *block = &codeblock[BLOCK_INVALID];
 #    else
+    int          hash  = HASH(phys_addr);
     codeblock_t *block = codeblock_hash[hash];
 #    endif
     int valid_block = 0;
@@ -400,7 +404,14 @@ exec386_dynarec_dyn(void)
         /* Block must match current CS, PC, code segment size,
            and physical address. The physical address check will
            also catch any page faults at this stage */
+#    ifdef USE_NEW_DYNAREC
+        block       = codeblock_hash_find(phys_addr, cs, cs + cpu_state.pc);
+        valid_block = (block != NULL);
+        if (!valid_block)
+            block = &codeblock[BLOCK_INVALID];
+#    else
         valid_block = (block->pc == cs + cpu_state.pc) && (block->_cs == cs) && (block->phys == phys_addr) && !((block->status ^ cpu_cur_status) & CPU_STATUS_FLAGS) && ((block->status & cpu_cur_status & CPU_STATUS_MASK) == (cpu_cur_status & CPU_STATUS_MASK));
+#    endif
         if (!valid_block) {
             uint64_t mask = (uint64_t) 1 << ((phys_addr >> PAGE_MASK_SHIFT) & PAGE_MASK_MASK);
 #    ifdef USE_NEW_DYNAREC
@@ -408,7 +419,7 @@ exec386_dynarec_dyn(void)
             uint64_t byte_mask   = 1ULL << (PAGE_BYTE_MASK_MASK & 0x3f);
 
             if ((page->code_present_mask & mask) ||
-                ((page->mem != page_ff) && (page->byte_code_present_mask[byte_offset] & byte_mask)))
+                ((page->mem != page_ff) && page->byte_code_present_mask && (page->byte_code_present_mask[byte_offset] & byte_mask)))
 #    else
             if (page->code_present_mask[(phys_addr >> PAGE_MASK_INDEX_SHIFT) & PAGE_MASK_INDEX_MASK] & mask)
 #    endif
@@ -420,7 +431,7 @@ exec386_dynarec_dyn(void)
                     if (valid_block) {
                         block = new_block;
 #    ifdef USE_NEW_DYNAREC
-                        codeblock_hash[hash] = get_block_nr(block);
+                        codeblock_hash_add(block);
 #    endif
                     }
                 }
@@ -476,7 +487,8 @@ exec386_dynarec_dyn(void)
 #    ifdef USE_NEW_DYNAREC
         if (valid_block && (block->flags & CODEBLOCK_IN_DIRTY_LIST)) {
             block->flags &= ~CODEBLOCK_WAS_RECOMPILED;
-            if (block->flags & CODEBLOCK_BYTE_MASK)
+            /* Pages without RAM behind them have no byte masks */
+            if ((block->flags & CODEBLOCK_BYTE_MASK) || !page->byte_code_present_mask)
                 block->flags |= CODEBLOCK_NO_IMMEDIATES;
             else
                 block->flags |= CODEBLOCK_BYTE_MASK;
@@ -495,6 +507,17 @@ exec386_dynarec_dyn(void)
             block->was_recompiled = 0;
 #    endif
         }
+#    ifdef USE_NEW_DYNAREC
+        if (!valid_block && codegen_cache_active) {
+            /* Blocks compiled on earlier runs skip the marking pass */
+            codeblock_t *cached = codegen_cache_block_init(phys_addr);
+
+            if (cached != NULL) {
+                block       = cached;
+                valid_block = 1;
+            }
+        }
+#    endif
     }
 
 #    ifdef USE_NEW_DYNAREC
@@ -507,9 +530,24 @@ exec386_dynarec_dyn(void)
 
 #    ifndef USE_NEW_DYNAREC
         codeblock_hash[hash] = block;
+#    else
+#        ifndef USE_GDBSTUB
+        /*Only link the exit the previous block left through if nothing has
+          moved execution elsewhere in between*/
+        if (codegen_chain_exit && ((cs + cpu_state.pc) != chain_pc))
+            codegen_chain_exit = 0;
+        codegen_chain_link(block);
+#        else
+        /*The GDB stub needs to see every block boundary*/
+        codegen_chain_exit = 0;
+#        endif
+        codegen_chain_cycles = cycles;
 #    endif
         inrecomp = 1;
         code();
+#    ifdef USE_NEW_DYNAREC
+        chain_pc = cs + cpu_state.pc;
+#    endif
 #    ifdef USE_ACYCS
         acycs = 0;
 #    endif
@@ -535,8 +573,8 @@ exec386_dynarec_dyn(void)
             pthread_jit_write_protect_np(0);
         }
 #    endif
-        codegen_block_start_recompile(block);
         codegen_in_recompile = 1;
+        codegen_block_start_recompile(block);
 
         while (!cpu_block_end) {
 #    ifndef USE_NEW_DYNAREC
@@ -51,6 +51,13 @@
 
 extern void codegen_init(void);
 extern void codegen_flush(void);
+#ifdef USE_NEW_DYNAREC
+extern void codegen_cache_load(void);
+extern void codegen_cache_save(void);
+extern int  codegen_stats_print(char *buf, int size);
+extern void codegen_stats_onesec(void);
+extern void codegen_stats_dump(void);
+#endif
 
 /*Current physical page of block being recompiled. -1 if no recompilation taking place */
 extern uint32_t recomp_page;
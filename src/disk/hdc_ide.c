@@ -96,14 +96,17 @@
 #define WIN_SETIDLE1                   0xe3
 #define WIN_CHECKPOWERMODE1            0xe5
 #define WIN_SLEEP1                     0xe6
+#define WIN_FLUSH_CACHE                0xe7
 #define WIN_IDENTIFY                   0xec /* Ask drive to identify itself */
 #define WIN_SET_FEATURES               0xef
 #define WIN_READ_NATIVE_MAX            0xf8
 
+#define FEATURE_ENABLE_WRITE_CACHE     0x02
 #define FEATURE_SET_TRANSFER_MODE      0x03
 #define FEATURE_ENABLE_IRQ_OVERLAPPED  0x5d
 #define FEATURE_ENABLE_IRQ_SERVICE     0x5e
 #define FEATURE_DISABLE_REVERT         0x66
+#define FEATURE_DISABLE_WRITE_CACHE    0x82
 #define FEATURE_ENABLE_REVERT          0xcc
 #define FEATURE_DISABLE_IRQ_OVERLAPPED 0xdd
 #define FEATURE_DISABLE_IRQ_SERVICE    0xde
@@ -620,6 +623,19 @@ ide_hd_identify(const ide_t *ide)
     ide->buffer[83] = ide->buffer[84] = 0x4000;
     ide->buffer[86] = 0x0000;
     ide->buffer[87] = 0x4000;
+
+    /* Write cache supported and enabled, completed writes may then be lost
+       on power loss until the cache is flushed. */
+    if (hdd_image_write_cache_supported(ide->hdd_num))
+        ide->buffer[82] |= (1 << 5);
+    if (hdd_image_get_write_cache(ide->hdd_num))
+        ide->buffer[85] |= (1 << 5);
+
+    /* FLUSH CACHE supported and enabled. */
+    if (ide->buffer[80] & 0x10) {
+        ide->buffer[83] |= (1 << 12);
+        ide->buffer[86] |= (1 << 12);
+    }
 }
 
 static void
@@ -904,6 +920,12 @@ ide_set_features(ide_t *ide)
         case FEATURE_ENABLE_REVERT:  /* Enable reverting to power on defaults. */
             return 1;
 
+        case FEATURE_ENABLE_WRITE_CACHE:
+        case FEATURE_DISABLE_WRITE_CACHE:
+            if (ide->type != IDE_HDD)
+                return 0;
+            return (hdd_image_set_write_cache(ide->hdd_num, features == FEATURE_ENABLE_WRITE_CACHE) == 0);
+
         default:
             return 0;
     }
@@ -1880,6 +1902,15 @@ ide_writeb(uint16_t addr, uint8_t val, void *priv)
                     ide_set_callback(ide, 30.0 * IDE_TIME);
                     break;
 
+                case WIN_FLUSH_CACHE:
+                    if (ide->type != IDE_HDD)
+                        bad = 1;
+                    else {
+                        ide->tf->atastat = BSY_STAT;
+                        ide_set_callback(ide, 30.0 * IDE_TIME);
+                    }
+                    break;
+
                 case WIN_DRIVE_DIAGNOSTICS: /* Execute Drive Diagnostics */
                     dev->cur_dev &= ~1;
                     ide                 = ide_drives[ch & ~1];
@@ -2594,6 +2625,20 @@ ide_callback(void *priv)
             }
             break;
 
+        case WIN_FLUSH_CACHE:
+            if (ide->type != IDE_HDD)
+                err = ABRT_ERR;
+            else {
+                ret = hdd_image_flush(ide->hdd_num);
+
+                ide->tf->atastat = DRDY_STAT | DSC_STAT;
+                if (ret < 0)
+                    err = ABRT_ERR;
+                else
+                    ide_irq_raise(ide);
+            }
+            break;
+
         case WIN_SPECIFY: /* Initialize Drive Parameters */
             if (ide->type == IDE_ATAPI)
                 err = ABRT_ERR;
@@ -0,0 +1,506 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Synthetic storage benchmark.
+ *
+ *          Runs a script of ATA and SCSI command sequences against the
+ *          disks of the loaded machine, through the same controller and
+ *          disk code a guest would use, and reports the emulated
+ *          throughput and the host CPU time spent per MB. The emulated
+ *          CPU is stopped while a job runs, so only the storage stack
+ *          is measured.
+ *
+ *          Script lines:
+ *
+ *          run <ms>
+ *              Let the machine run, e.g. for the BIOS to set up the
+ *              controllers, before the next line.
+ *          ram
+ *              Read every hard disk into memory and use it from there
+ *              on, so jobs do not depend on the host disk and writes
+ *              leave the images as they were.
+ *          ata <channel> <drive> pio|dma <seq|rand> <read|write> <sectors> <MB> [bm_base]
+ *              ATA commands through the IDE registers, DMA ones through
+ *              the SFF-8038i bus master at I/O port bm_base (hex).
+ *          scsi <bus> <id> <seq|rand> <read|write> <blocks> <MB> <ha_base>
+ *              READ (10) and WRITE (10) commands in CCBs handed to the
+ *              AHA-154x or BusLogic host adapter at I/O port ha_base
+ *              (hex) through its mailboxes. The job sets up mailboxes
+ *              of its own, so any the guest had are lost.
+ *
+ *          Without ram, jobs that write overwrite the image, so use a
+ *          scratch image or a copy-on-write overlay.
+ *
+ * Authors: 86Box developers
+ *
+ *          Copyright 2026 86Box developers.
+ */
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <wchar.h>
+#include <86box/86box.h>
+#include "cpu.h"
+#include <86box/io.h>
+#include <86box/timer.h>
+#include <86box/mem.h>
+#include <86box/rom.h>
+#include <86box/device.h>
+#include <86box/fdd.h>
+#include <86box/fdc.h>
+#include <86box/hdd.h>
+#include <86box/scsi.h>
+#include <86box/scsi_device.h>
+#include <86box/scsi_x54x.h>
+#include <86box/plat.h>
+
+#define HDD_BENCH_PRD       0x00200000 /* Guest memory the benchmark uses. */
+#define HDD_BENCH_MBX       0x00200800 /* One outgoing and one incoming mailbox. */
+#define HDD_BENCH_CCB       0x00200c00
+#define HDD_BENCH_BUF       0x00201000
+#define HDD_BENCH_MAX_TICKS 1000000    /* Timer runs to wait for a command. */
+
+typedef struct hdd_bench_job_t {
+    int      scsi;
+    int      channel; /* Or SCSI bus. */
+    int      drive;   /* Or SCSI ID. */
+    int      dma;
+    int      random;
+    int      out;
+    uint32_t per_cmd; /* Sectors. */
+    uint32_t total;   /* Sectors. */
+    uint16_t base;
+    uint16_t bm_base; /* Or host adapter base. */
+    uint32_t sectors; /* Size of the disk. */
+} hdd_bench_job_t;
+
+char *hdd_bench_path = NULL;
+
+static FILE    *hdd_bench_fp;
+static int      hdd_bench_wait_ms;
+static int      hdd_bench_line;
+static uint32_t hdd_bench_seed = 0x2545f491;
+
+static void
+hdd_bench_out(const char *fmt, ...)
+{
+    va_list ap;
+
+    printf("[storagebench] ");
+    va_start(ap, fmt);
+    vprintf(fmt, ap);
+    va_end(ap);
+    fflush(stdout);
+}
+
+static uint32_t
+hdd_bench_random(void)
+{
+    hdd_bench_seed ^= hdd_bench_seed << 13;
+    hdd_bench_seed ^= hdd_bench_seed >> 17;
+    hdd_bench_seed ^= hdd_bench_seed << 5;
+
+    return hdd_bench_seed;
+}
+
+/* Let emulated time pass up to the next timer, with the CPU stopped. */
+static void
+hdd_bench_tick(void)
+{
+    if (!TIMER_VAL_LESS_THAN_VAL(timer_target, (uint32_t) tsc))
+        tsc += (uint32_t) (timer_target - (uint32_t) tsc);
+    timer_process();
+}
+
+static int
+hdd_bench_ata_wait(const hdd_bench_job_t *job, const uint8_t mask, const uint8_t val)
+{
+    uint8_t status;
+
+    for (int i = 0; i < HDD_BENCH_MAX_TICKS; i++) {
+        status = inb(job->base + 7);
+        if ((status & (BUSY_STAT | ERR_STAT)) == ERR_STAT)
+            return -1;
+        if ((status & mask) == val)
+            return 0;
+        hdd_bench_tick();
+    }
+
+    return -1;
+}
+
+static int
+hdd_bench_ata_cmd(const hdd_bench_job_t *job, const uint32_t lba, const uint32_t count,
+                  const uint8_t feature, const uint8_t cmd)
+{
+    if (hdd_bench_ata_wait(job, BUSY_STAT, 0) < 0)
+        return -1;
+
+    outb(job->base + 6, 0xe0 | (job->drive << 4) | ((lba >> 24) & 0x0f));
+    outb(job->base + 1, feature);
+    outb(job->base + 2, count & 0xff);
+    outb(job->base + 3, lba & 0xff);
+    outb(job->base + 4, (lba >> 8) & 0xff);
+    outb(job->base + 5, (lba >> 16) & 0xff);
+    outb(job->base + 7, cmd);
+
+    return 0;
+}
+
+static int
+hdd_bench_ata_pio(const hdd_bench_job_t *job, const uint32_t lba, const uint32_t count)
+{
+    if (hdd_bench_ata_cmd(job, lba, count, 0x00, job->out ? 0x30 : 0x20) < 0)
+        return -1;
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (hdd_bench_ata_wait(job, BUSY_STAT | DRQ_STAT, DRQ_STAT) < 0)
+            return -1;
+
+        for (int j = 0; j < 256; j++) {
+            if (job->out)
+                outw(job->base, (uint16_t) (lba + i + j));
+            else
+                (void) inw(job->base);
+        }
+    }
+
+    return hdd_bench_ata_wait(job, BUSY_STAT | DRQ_STAT, 0);
+}
+
+static int
+hdd_bench_ata_dma(const hdd_bench_job_t *job, const uint32_t lba, const uint32_t count)
+{
+    const uint32_t bytes = count << 9;
+    uint32_t       len;
+    uint8_t        status = 0x00;
+    int            i      = 0;
+
+    for (uint32_t pos = 0; pos < bytes; pos += len, i++) {
+        len = MIN(bytes - pos, 65536);
+        mem_writel_phys(HDD_BENCH_PRD + (i << 3), HDD_BENCH_BUF + pos);
+        mem_writel_phys(HDD_BENCH_PRD + (i << 3) + 4,
+                        (len & 0xffff) | (((pos + len) >= bytes) ? 0x80000000 : 0x00000000));
+    }
+
+    outl(job->bm_base + 4, HDD_BENCH_PRD);
+    outb(job->bm_base + 2, 0x06);
+
+    if (hdd_bench_ata_cmd(job, lba, count, 0x00, job->out ? 0xca : 0xc8) < 0)
+        return -1;
+
+    /* Bit 3 set makes the bus master write to memory. */
+    outb(job->bm_base, job->out ? 0x01 : 0x09);
+
+    for (i = 0; i < HDD_BENCH_MAX_TICKS; i++) {
+        status = inb(job->bm_base + 2);
+        if ((status & 0x04) || !(status & 0x01))
+            break;
+        hdd_bench_tick();
+    }
+
+    outb(job->bm_base, job->out ? 0x00 : 0x08);
+    outb(job->bm_base + 2, 0x06);
+
+    if ((i == HDD_BENCH_MAX_TICKS) || (status & 0x02))
+        return -1;
+
+    return hdd_bench_ata_wait(job, BUSY_STAT | DRQ_STAT, 0);
+}
+
+static int
+hdd_bench_ha_wait(const hdd_bench_job_t *job, const uint16_t port, const uint8_t mask, const uint8_t val)
+{
+    for (int i = 0; i < HDD_BENCH_MAX_TICKS; i++) {
+        if ((inb(job->bm_base + port) & mask) == val)
+            return 0;
+        hdd_bench_tick();
+    }
+
+    return -1;
+}
+
+/* Point the host adapter at a single pair of 24-bit mailboxes. */
+static int
+hdd_bench_ha_init(const hdd_bench_job_t *job)
+{
+    if (hdd_bench_ha_wait(job, 0, STAT_STST | STAT_IDLE, STAT_IDLE) < 0)
+        return -1;
+
+    mem_writel_phys(HDD_BENCH_MBX, 0x00000000);
+    mem_writel_phys(HDD_BENCH_MBX + 4, 0x00000000);
+
+    outb(job->bm_base + 1, CMD_MBINIT);
+    outb(job->bm_base + 1, 1);
+    outb(job->bm_base + 1, (HDD_BENCH_MBX >> 16) & 0xff);
+    outb(job->bm_base + 1, (HDD_BENCH_MBX >> 8) & 0xff);
+    outb(job->bm_base + 1, HDD_BENCH_MBX & 0xff);
+
+    if ((hdd_bench_ha_wait(job, 2, INTR_HACC, INTR_HACC) < 0) || (inb(job->bm_base) & STAT_INVCMD))
+        return -1;
+    outb(job->bm_base, CTRL_IRST);
+
+    return 0;
+}
+
+static int
+hdd_bench_scsi(const hdd_bench_job_t *job, const uint32_t lba, const uint32_t count)
+{
+    const uint32_t bytes = count << 9;
+    uint8_t        ccb[30];
+    uint8_t        status;
+
+    /* A 24-bit CCB without automatic request sense, see CCB in scsi_x54x.h. */
+    memset(ccb, 0x00, sizeof(ccb));
+    ccb[0]  = SCSI_INITIATOR_COMMAND;
+    ccb[1]  = (job->drive << 5) | ((job->out ? CCB_DATA_XFER_OUT : CCB_DATA_XFER_IN) << 3);
+    ccb[2]  = 10;
+    ccb[3]  = NO_AUTO_REQUEST_SENSE;
+    ccb[4]  = (bytes >> 16) & 0xff;
+    ccb[5]  = (bytes >> 8) & 0xff;
+    ccb[6]  = bytes & 0xff;
+    ccb[7]  = (HDD_BENCH_BUF >> 16) & 0xff;
+    ccb[8]  = (HDD_BENCH_BUF >> 8) & 0xff;
+    ccb[9]  = HDD_BENCH_BUF & 0xff;
+    ccb[18] = job->out ? GPCMD_WRITE_10 : GPCMD_READ_10;
+    ccb[20] = (lba >> 24) & 0xff;
+    ccb[21] = (lba >> 16) & 0xff;
+    ccb[22] = (lba >> 8) & 0xff;
+    ccb[23] = lba & 0xff;
+    ccb[25] = (count >> 8) & 0xff;
+    ccb[26] = count & 0xff;
+
+    for (uint32_t i = 0; i < sizeof(ccb); i++)
+        mem_writeb_phys(HDD_BENCH_CCB + i, ccb[i]);
+
+    mem_writeb_phys(HDD_BENCH_MBX + 4, MBI_FREE);
+    mem_writeb_phys(HDD_BENCH_MBX, MBO_START);
+    mem_writeb_phys(HDD_BENCH_MBX + 1, (HDD_BENCH_CCB >> 16) & 0xff);
+    mem_writeb_phys(HDD_BENCH_MBX + 2, (HDD_BENCH_CCB >> 8) & 0xff);
+    mem_writeb_phys(HDD_BENCH_MBX + 3, HDD_BENCH_CCB & 0xff);
+
+    outb(job->bm_base + 1, CMD_START_SCSI);
+
+    for (int i = 0; i < HDD_BENCH_MAX_TICKS; i++) {
+        status = mem_readb_phys(HDD_BENCH_MBX + 4);
+        if (status != MBI_FREE) {
+            outb(job->bm_base, CTRL_IRST);
+            return ((status == MBI_SUCCESS) && (mem_readb_phys(HDD_BENCH_CCB + 15) == SCSI_STATUS_OK)) ? 0 : -1;
+        }
+        hdd_bench_tick();
+    }
+
+    return -1;
+}
+
+static int
+hdd_bench_find(hdd_bench_job_t *job)
+{
+    for (int i = 0; i < HDD_NUM; i++) {
+        if (job->scsi) {
+            if ((hdd[i].bus_type != HDD_BUS_SCSI) ||
+                (hdd[i].scsi_id != ((job->channel << 4) | job->drive)))
+                continue;
+        } else if ((hdd[i].bus_type != HDD_BUS_IDE) ||
+                   (hdd[i].ide_channel != ((job->channel << 1) | job->drive)))
+            continue;
+
+        if (job->scsi && !scsi_device_present(&scsi_devices[job->channel][job->drive]))
+            return 0;
+
+        job->sectors = hdd_image_get_last_sector(i) + 1;
+        if (!job->scsi && (job->sectors > 0x0fffffff))
+            job->sectors = 0x0fffffff;
+        return (job->sectors >= job->per_cmd);
+    }
+
+    return 0;
+}
+
+static void
+hdd_bench_run(hdd_bench_job_t *job)
+{
+    const uint64_t tsc_start = tsc;
+    const clock_t  start     = clock();
+    uint32_t       done      = 0;
+    uint32_t       lba       = 0;
+    uint32_t       count;
+    double         emu_sec;
+    double         host_sec;
+    double         mb;
+    int            ret       = 0;
+
+    if (job->scsi)
+        ret = hdd_bench_ha_init(job);
+    else if (job->dma) {
+        /* Multiword DMA mode 2, in case the BIOS did not set one. */
+        if ((hdd_bench_ata_cmd(job, 0, 0x22, 0x03, 0xef) < 0) ||
+            (hdd_bench_ata_wait(job, BUSY_STAT, 0) < 0))
+            ret = -1;
+    }
+
+    while ((ret == 0) && (done < job->total)) {
+        count = MIN(job->per_cmd, job->total - done);
+
+        if (job->random)
+            lba = hdd_bench_random() % (job->sectors - count + 1);
+        else if ((lba + count) > job->sectors)
+            lba = 0;
+
+        if (job->scsi)
+            ret = hdd_bench_scsi(job, lba, count);
+        else if (job->dma)
+            ret = hdd_bench_ata_dma(job, lba, count);
+        else
+            ret = hdd_bench_ata_pio(job, lba, count);
+
+        lba += count;
+        done += count;
+    }
+
+    host_sec = ((double) (clock() - start)) / CLOCKS_PER_SEC;
+    emu_sec  = ((double) (tsc - tsc_start)) / cpu_s->rspeed;
+    mb = ((double) done) / 2048.0;
+
+    if (ret < 0)
+        hdd_bench_out("line %i: command failed after %" PRIu32 " sectors\n", hdd_bench_line, done);
+
+    hdd_bench_out("line %i: %.2f MB in %.3f s emulated (%.2f MB/s), %.3f s host CPU (%.2f ms/MB)\n",
+                  hdd_bench_line, mb, emu_sec, (emu_sec > 0.0) ? (mb / emu_sec) : 0.0,
+                  host_sec, (mb > 0.0) ? ((host_sec * 1000.0) / mb) : 0.0);
+}
+
+/* Parse a job line, returns 0 if it is not valid. */
+static int
+hdd_bench_parse(hdd_bench_job_t *job, const char *line)
+{
+    char     kind[8];
+    char     mode[8];
+    char     order[8];
+    char     dir[8];
+    uint32_t mb;
+    int      n;
+
+    memset(job, 0x00, sizeof(hdd_bench_job_t));
+
+    if (sscanf(line, "%7s", kind) != 1)
+        return 0;
+
+    if (!strcmp(kind, "scsi")) {
+        job->scsi = 1;
+        n = sscanf(line, "%*s %i %i %7s %7s %" SCNu32 " %" SCNu32 " %hx",
+                   &job->channel, &job->drive, order, dir, &job->per_cmd, &mb, &job->bm_base);
+        /* 24-bit CCBs only take IDs up to 7 and transfers below 16 MB. */
+        if ((n != 7) || (job->channel >= SCSI_BUS_MAX) || (job->drive > 7) ||
+            !job->per_cmd || (job->per_cmd > 32767))
+            return 0;
+    } else if (!strcmp(kind, "ata")) {
+        n = sscanf(line, "%*s %i %i %7s %7s %7s %" SCNu32 " %" SCNu32 " %hx",
+                   &job->channel, &job->drive, mode, order, dir, &job->per_cmd, &mb, &job->bm_base);
+        if ((n < 7) || (job->channel < 0) || (job->channel > 1) || (job->drive < 0) || (job->drive > 1) ||
+            !job->per_cmd || (job->per_cmd > 256))
+            return 0;
+        job->dma  = !strcmp(mode, "dma");
+        job->base = job->channel ? 0x0170 : 0x01f0;
+        if (job->dma && (n != 8))
+            return 0;
+    } else
+        return 0;
+
+    if ((job->channel < 0) || (job->drive < 0))
+        return 0;
+
+    job->random = !strcmp(order, "rand");
+    job->out    = !strcmp(dir, "write");
+    job->total  = mb << 11;
+
+    return 1;
+}
+
+static void
+hdd_bench_finish(void)
+{
+    if (hdd_bench_fp != NULL)
+        fclose(hdd_bench_fp);
+    hdd_bench_fp   = NULL;
+    hdd_bench_path = NULL;
+
+    hdd_bench_out("done\n");
+    plat_power_off();
+}
+
+/*
+   Called once per emulated frame. Returns 1 if the frame was spent on the
+   benchmark and the CPU should not run.
+ */
+int
+hdd_bench_frame(void)
+{
+    hdd_bench_job_t job;
+    char            line[256];
+    char            kind[8];
+    int             ms;
+
+    if (hdd_bench_fp == NULL) {
+        hdd_bench_fp = plat_fopen(hdd_bench_path, "r");
+        if (hdd_bench_fp == NULL) {
+            hdd_bench_out("unable to open %s\n", hdd_bench_path);
+            hdd_bench_finish();
+            return 1;
+        }
+    }
+
+    if (hdd_bench_wait_ms > 0) {
+        hdd_bench_wait_ms -= force_10ms ? 10 : 1;
+        return 0;
+    }
+
+    while (fgets(line, sizeof(line), hdd_bench_fp) != NULL) {
+        hdd_bench_line++;
+
+        if ((line[0] == '#') || (strspn(line, " \t\r\n") == strlen(line)))
+            continue;
+
+        if (sscanf(line, " run %i", &ms) == 1) {
+            hdd_bench_wait_ms = ms;
+            return 0;
+        }
+
+        if ((sscanf(line, " %7s", kind) == 1) && !strcmp(kind, "ram")) {
+            for (uint8_t i = 0; i < HDD_NUM; i++) {
+                if ((hdd[i].bus_type != HDD_BUS_DISABLED) && (hdd_image_load_ram(i) < 0))
+                    hdd_bench_out("line %i: unable to hold hard disk %i in memory\n", hdd_bench_line, i);
+            }
+            continue;
+        }
+
+        if (!hdd_bench_parse(&job, line)) {
+            hdd_bench_out("line %i: invalid job\n", hdd_bench_line);
+            continue;
+        }
+
+        /* The buffer for a whole command has to fit in guest RAM. */
+        if (((job.dma || job.scsi) &&
+             ((HDD_BENCH_BUF + ((uint64_t) job.per_cmd << 9)) > ((uint64_t) mem_size << 10))) ||
+            !hdd_bench_find(&job)) {
+            hdd_bench_out("line %i: no suitable disk or not enough memory\n", hdd_bench_line);
+            continue;
+        }
+
+        timer_process();
+        hdd_bench_run(&job);
+        return 1;
+    }
+
+    hdd_bench_finish();
+    return 1;
+}
@@ -15,6 +15,7 @@
  *          Copyright 2017-2018 Fred N. van Kempen.
  */
 #define _GNU_SOURCE
+#include <inttypes.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -24,8 +25,12 @@
 #include <time.h>
 #include <wchar.h>
 #include <errno.h>
-#ifdef __unix__
-#include <unistd.h>
+#ifdef _WIN32
+#    include <windows.h>
+#    include <io.h>
+#else
+#    include <sys/mman.h>
+#    include <unistd.h>
 #endif
 #define HAVE_STDARG_H
 #include <86box/86box.h>
@@ -41,14 +46,72 @@
 #define HDD_IMAGE_HDX 2
 #define HDD_IMAGE_VHD 3
 
+#define HDD_OVERLAY_MAGIC   "86BOXCOW"
+#define HDD_OVERLAY_VERSION 1
+#define HDD_OVERLAY_CLUSTER 64 /* Sectors per cluster in new overlays. */
+#define HDD_OVERLAY_ZERO    0xffffffff
+
+#define HDD_WB_EXTENTS 64   /* Dirty ranges held per image. */
+#define HDD_WB_SECTORS 8192 /* Sectors held per image, 4 MB. */
+
+/* Header at the start of an overlay file, followed by the allocation index
+   at index_offset (one 32-bit entry per cluster, holding the 1-based slot of
+   the cluster in the data area, 0 if the cluster is read from the base
+   image, or HDD_OVERLAY_ZERO if it reads as zeroes and has no data), and by
+   the cluster data at data_offset. */
+typedef struct hdd_overlay_header_t {
+    char     magic[8];
+    uint32_t version;
+    uint32_t cluster_sectors;
+    uint64_t sectors;
+    uint64_t index_offset;
+    uint64_t data_offset;
+} hdd_overlay_header_t;
+
+typedef struct hdd_overlay_t {
+    FILE     *file;
+    uint32_t *index;
+    uint32_t  clusters;
+    uint32_t  cluster_sectors;
+    uint32_t  next_slot;
+    uint64_t  index_offset;
+    uint64_t  data_offset;
+    uint8_t  *buf; /* One cluster, used to copy partially written clusters up from the base. */
+} hdd_overlay_t;
+
+/* A range of sectors written by the emulated machine but not yet to the
+   image. */
+typedef struct hdd_wb_extent_t {
+    uint32_t sector;
+    uint32_t count;
+    uint32_t capacity; /* In sectors. */
+    uint8_t *data;
+} hdd_wb_extent_t;
+
 typedef struct hdd_image_t {
-    FILE     *file; /* Used for HDD_IMAGE_RAW, HDD_IMAGE_HDI, and HDD_IMAGE_HDX. */
-    MVHDMeta *vhd;  /* Used for HDD_IMAGE_VHD. */
-    uint32_t  base;
-    uint32_t  pos;
-    uint32_t  last_sector;
-    uint8_t   type; /* HDD_IMAGE_RAW, HDD_IMAGE_HDI, HDD_IMAGE_HDX, or HDD_IMAGE_VHD */
-    uint8_t   loaded;
+    FILE          *file;    /* Used for HDD_IMAGE_RAW, HDD_IMAGE_HDI, and HDD_IMAGE_HDX. */
+    MVHDMeta      *vhd;     /* Used for HDD_IMAGE_VHD. */
+    hdd_overlay_t *overlay; /* Copy-on-write overlay, the image is then read-only. */
+    uint8_t       *map;     /* Read-only mapping of the whole image file, if any. */
+    uint8_t       *ram;     /* Copy of the whole disk used instead of the image, if any. */
+    uint64_t       map_size;
+#ifdef _WIN32
+    HANDLE         map_handle;
+#endif
+    uint32_t       base;
+    uint32_t       pos;
+    uint32_t       last_sector;
+    uint8_t        type; /* HDD_IMAGE_RAW, HDD_IMAGE_HDI, HDD_IMAGE_HDX, or HDD_IMAGE_VHD */
+    uint8_t        loaded;
+    uint8_t        unsynced; /* Written to the image since the last flush. */
+    uint8_t        wce;      /* Write cache enabled, as the emulated machine sees it. */
+
+    /* Write-back cache, dirty ranges sorted by sector, neither overlapping
+       nor adjacent to each other. */
+    hdd_wb_extent_t wb[HDD_WB_EXTENTS];
+    uint32_t        wb_count;
+    uint32_t        wb_sectors;
+    uint32_t        wb_since; /* plat_get_ticks() of the oldest unflushed write. */
 } hdd_image_t;
 
 hdd_image_t hdd_images[HDD_NUM];
@@ -76,6 +139,8 @@ hdd_image_log(const char *fmt, ...)
 #    define hdd_image_log(fmt, ...)
 #endif
 
+static void hdd_image_wb_discard(uint8_t id);
+
 int
 image_is_hdi(const char *s)
 {
@@ -241,6 +306,177 @@ prepare_new_hard_disk(uint8_t id, uint64_t full_size)
     return 1;
 }
 
+/* Map the base image of an overlay, so its pages are shared by every
+   emulator instance using it. Reads fall back to stdio if this fails. */
+static void
+hdd_image_map(uint8_t id)
+{
+    hdd_image_t *img = &hdd_images[id];
+    uint64_t     size;
+
+    if (img->file == NULL)
+        return;
+
+    if (fseeko64(img->file, 0, SEEK_END) == -1)
+        return;
+    size = ftello64(img->file);
+    if ((size == 0) || (size > (uint64_t) SIZE_MAX))
+        return;
+
+#ifdef _WIN32
+    img->map_handle = CreateFileMapping((HANDLE) _get_osfhandle(_fileno(img->file)), NULL, PAGE_READONLY, 0, 0, NULL);
+    if (img->map_handle == NULL)
+        return;
+    img->map = (uint8_t *) MapViewOfFile(img->map_handle, FILE_MAP_READ, 0, 0, 0);
+    if (img->map == NULL) {
+        CloseHandle(img->map_handle);
+        img->map_handle = NULL;
+        return;
+    }
+#else
+    void *p = mmap(NULL, (size_t) size, PROT_READ, MAP_SHARED, fileno(img->file), 0);
+    if (p == MAP_FAILED)
+        return;
+    img->map = (uint8_t *) p;
+#endif
+    img->map_size = size;
+
+    hdd_image_log("Hard disk image %i: Base image mapped (%" PRIu64 " bytes)\n", id, size);
+}
+
+static void
+hdd_image_unmap(uint8_t id)
+{
+    hdd_image_t *img = &hdd_images[id];
+
+    if (img->map == NULL)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(img->map);
+    CloseHandle(img->map_handle);
+    img->map_handle = NULL;
+#else
+    munmap(img->map, (size_t) img->map_size);
+#endif
+    img->map      = NULL;
+    img->map_size = 0;
+}
+
+static void
+hdd_overlay_close(uint8_t id)
+{
+    hdd_overlay_t *ov = hdd_images[id].overlay;
+
+    hdd_image_unmap(id);
+
+    if (ov == NULL)
+        return;
+
+    if (ov->file != NULL)
+        fclose(ov->file);
+    free(ov->index);
+    free(ov->buf);
+    free(ov);
+    hdd_images[id].overlay = NULL;
+}
+
+/* Open the overlay file of a hard disk, creating an empty one if it does not
+   exist yet, which is all it takes to clone a disk. */
+static int
+hdd_overlay_open(uint8_t id)
+{
+    hdd_overlay_header_t hdr     = { 0 };
+    hdd_overlay_t       *ov;
+    uint64_t             sectors = ((uint64_t) hdd_images[id].last_sector) + 1;
+    uint64_t             index_size;
+    int                  create  = 0;
+
+    ov = (hdd_overlay_t *) calloc(1, sizeof(hdd_overlay_t));
+    if (ov == NULL) {
+        hdd_image_log("Hard disk image %i: Unable to allocate overlay\n", id);
+        return 0;
+    }
+    hdd_images[id].overlay = ov;
+
+    ov->file = plat_fopen(hdd[id].overlay, "rb+");
+    if (ov->file == NULL) {
+        if (errno != ENOENT) {
+            hdd_image_log("Hard disk image %i: Unable to open overlay\n", id);
+            goto fail;
+        }
+
+        ov->file = plat_fopen(hdd[id].overlay, "wb+");
+        if (ov->file == NULL) {
+            hdd_image_log("Hard disk image %i: Unable to create overlay\n", id);
+            goto fail;
+        }
+        create = 1;
+
+        memcpy(hdr.magic, HDD_OVERLAY_MAGIC, sizeof(hdr.magic));
+        hdr.version         = HDD_OVERLAY_VERSION;
+        hdr.cluster_sectors = HDD_OVERLAY_CLUSTER;
+        hdr.sectors         = sectors;
+        hdr.index_offset    = 512;
+        index_size          = ((sectors + HDD_OVERLAY_CLUSTER - 1) / HDD_OVERLAY_CLUSTER) * sizeof(uint32_t);
+        hdr.data_offset     = hdr.index_offset + ((index_size + 511) & ~511ULL);
+    } else if ((fread(&hdr, 1, sizeof(hdr), ov->file) != sizeof(hdr)) ||
+               memcmp(hdr.magic, HDD_OVERLAY_MAGIC, sizeof(hdr.magic)) ||
+               (hdr.version != HDD_OVERLAY_VERSION) || (hdr.cluster_sectors == 0)) {
+        hdd_image_log("Hard disk image %i: Not a valid overlay\n", id);
+        goto fail;
+    } else if (hdr.sectors != sectors) {
+        hdd_image_log("Hard disk image %i: Overlay is for a disk of %" PRIu64 " sectors, not %" PRIu64 "\n",
+                      id, hdr.sectors, sectors);
+        goto fail;
+    }
+
+    ov->cluster_sectors = hdr.cluster_sectors;
+    ov->clusters        = (uint32_t) ((sectors + hdr.cluster_sectors - 1) / hdr.cluster_sectors);
+    ov->index_offset    = hdr.index_offset;
+    ov->data_offset     = hdr.data_offset;
+    ov->index           = (uint32_t *) calloc(ov->clusters, sizeof(uint32_t));
+    ov->buf             = (uint8_t *) malloc(ov->cluster_sectors << 9);
+    ov->next_slot       = 1;
+    if ((ov->index == NULL) || (ov->buf == NULL)) {
+        hdd_image_log("Hard disk image %i: Unable to allocate overlay index\n", id);
+        goto fail;
+    }
+
+    if (create) {
+        if ((fwrite(&hdr, 1, sizeof(hdr), ov->file) != sizeof(hdr)) || fflush(ov->file))
+            goto fail;
+        /* Extending the file reads back as zeroes, which is an empty index,
+           and leaves it sparse where the host file system supports that. */
+#ifdef _WIN32
+        if (_chsize_s(_fileno(ov->file), (__int64) hdr.data_offset))
+#else
+        if (ftruncate(fileno(ov->file), (off_t) hdr.data_offset))
+#endif
+            goto fail;
+    } else {
+        if ((fseeko64(ov->file, ov->index_offset, SEEK_SET) == -1) ||
+            (fread(ov->index, sizeof(uint32_t), ov->clusters, ov->file) != ov->clusters))
+            goto fail;
+        for (uint32_t i = 0; i < ov->clusters; i++) {
+            if ((ov->index[i] != HDD_OVERLAY_ZERO) && (ov->index[i] >= ov->next_slot))
+                ov->next_slot = ov->index[i] + 1;
+        }
+    }
+
+    if (hdd_images[id].type != HDD_IMAGE_VHD)
+        hdd_image_map(id);
+
+    hdd_image_log("Hard disk image %i: Overlay '%s' with %u of %u clusters allocated\n",
+                  id, hdd[id].overlay, ov->next_slot - 1, ov->clusters);
+
+    return 1;
+
+fail:
+    hdd_overlay_close(id);
+    return 0;
+}
+
 void
 hdd_image_init(void)
 {
@@ -271,8 +507,14 @@ hdd_image_load(int id)
     }
 
     hdd_images[id].base = 0;
+    hdd_images[id].wce  = (hdd[id].write_cache != HDD_WRITE_CACHE_THROUGH);
 
     if (hdd_images[id].loaded) {
+        (void) hdd_image_flush(id);
+        hdd_image_wb_discard(id);
+        free(hdd_images[id].ram);
+        hdd_images[id].ram = NULL;
+        hdd_overlay_close(id);
         if (hdd_images[id].file) {
             fclose(hdd_images[id].file);
             hdd_images[id].file = NULL;
@@ -297,7 +539,8 @@ hdd_image_load(int id)
         memset(hdd[id].fn, 0, sizeof(hdd[id].fn));
         goto fail_raw;
     }
-    hdd_images[id].file = plat_fopen(fn, "rb+");
+    /* The base image of an overlay is never written to. */
+    hdd_images[id].file = plat_fopen(fn, hdd[id].overlay[0] ? "rb" : "rb+");
     if (hdd_images[id].file == NULL) {
         /* Failed to open existing hard disk image */
         if (errno == ENOENT) {
@@ -308,6 +551,11 @@ hdd_image_load(int id)
                 memset(hdd[id].fn, 0, sizeof(hdd[id].fn));
                 goto fail_raw;
             }
+            if (hdd[id].overlay[0]) {
+                hdd_image_log("The base image of an overlay must exist\n");
+                memset(hdd[id].fn, 0, sizeof(hdd[id].fn));
+                goto fail_raw;
+            }
 
             hdd_images[id].file = plat_fopen(fn, "wb+");
             if (hdd_images[id].file == NULL) {
@@ -464,7 +712,7 @@ fail_raw:
         } else if (is_vhd[1]) {
             fclose(hdd_images[id].file);
             hdd_images[id].file = NULL;
-            hdd_images[id].vhd  = mvhd_open(fn, (bool) 0, &vhd_error);
+            hdd_images[id].vhd  = mvhd_open(fn, hdd[id].overlay[0] != 0, &vhd_error);
             if (hdd_images[id].vhd == NULL) {
                 if (vhd_error == MVHD_ERR_FILE)
                     fatal("hdd_image_load(): VHD: Error opening VHD file '%s': %s\n", fn, strerror(mvhd_errno));
@@ -487,7 +735,8 @@ fail_raw:
                are there. */
             hdd_images[id].last_sector = (uint32_t) (full_size >> 9) - 1;
             hdd_images[id].loaded      = 1;
-            return 1;
+            ret                        = 1;
+            goto load_overlay;
         } else {
             full_size           = ((uint64_t) hdd[id].spt) * ((uint64_t) hdd[id].hpc) * ((uint64_t) hdd[id].tracks) << 9LL;
             hdd_images[id].type = HDD_IMAGE_RAW;
@@ -497,7 +746,8 @@ fail_raw:
     if (fseeko64(hdd_images[id].file, 0, SEEK_END) == -1)
         fatal("hdd_image_load(): Error seeking to the end of file\n");
     s = ftello64(hdd_images[id].file);
-    if (s < (full_size + hdd_images[id].base))
+    /* A short base image of an overlay reads as zeroes past its end. */
+    if ((s < (full_size + hdd_images[id].base)) && !hdd[id].overlay[0])
         ret = prepare_new_hard_disk(id, full_size);
     else {
         hdd_images[id].last_sector = (uint32_t) (full_size >> 9) - 1;
@@ -505,6 +755,10 @@ fail_raw:
         ret                        = 1;
     }
 
+load_overlay:
+    if (hdd[id].overlay[0] && !hdd_overlay_open(id))
+        fatal("hdd_image_load(): Overlay: Error opening overlay file '%s'\n", hdd[id].overlay);
+
     return ret;
 }
 
@@ -525,16 +779,31 @@ hdd_image_seek(uint8_t id, uint32_t sector)
     return 0;
 }
 
-int
-hdd_image_read(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+static int
+hdd_image_read_base(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
 {
     int    non_transferred_sectors;
     size_t num_read;
 
-    if (hdd_images[id].type == HDD_IMAGE_VHD) {
+    if (hdd_images[id].map != NULL) {
+        uint64_t addr  = ((uint64_t) sector << 9LL) + hdd_images[id].base;
+        uint64_t len   = (uint64_t) count << 9LL;
+        uint64_t avail = 0;
+
+        if (addr < hdd_images[id].map_size)
+            avail = hdd_images[id].map_size - addr;
+        if (avail > len)
+            avail = len;
+
+        memcpy(buffer, hdd_images[id].map + addr, (size_t) avail);
+        memset(buffer + avail, 0, (size_t) (len - avail));
+        hdd_images[id].pos = sector + count;
+    } else if (hdd_images[id].type == HDD_IMAGE_VHD) {
         hdd_images[id].vhd->error = 0;
         non_transferred_sectors   = mvhd_read_sectors(hdd_images[id].vhd, sector, count, buffer);
         hdd_images[id].pos        = sector + count - non_transferred_sectors - 1;
+        if (non_transferred_sectors > 0)
+            memset(buffer + ((count - non_transferred_sectors) << 9), 0, non_transferred_sectors << 9);
         if (hdd_images[id].vhd->error)
             return -1;
     } else {
@@ -545,13 +814,448 @@ hdd_image_read(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
 
         num_read           = fread(buffer, 512, count, hdd_images[id].file);
         hdd_images[id].pos = sector + num_read;
-        if ((num_read < count) && !feof(hdd_images[id].file))
+        if (num_read < count) {
+            if (!feof(hdd_images[id].file))
+                return -1;
+            memset(buffer + (num_read << 9), 0, (count - num_read) << 9);
+        }
+    }
+
+    return 0;
+}
+
+/* Read from an overlay, in runs of clusters that are either all held by the
+   overlay in consecutive slots, all zeroed, or all read from the base image. */
+static int
+hdd_overlay_read(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    hdd_overlay_t *ov = hdd_images[id].overlay;
+    uint32_t       cluster;
+    uint32_t       slot;
+    uint32_t       n;
+
+    while (count > 0) {
+        cluster = sector / ov->cluster_sectors;
+        if (cluster >= ov->clusters)
+            return hdd_image_read_base(id, sector, count, buffer);
+
+        slot = ov->index[cluster];
+        n    = ov->cluster_sectors - (sector % ov->cluster_sectors);
+        while ((n < count) && ((cluster + 1) < ov->clusters) &&
+               (ov->index[cluster + 1] == (((slot == 0) || (slot == HDD_OVERLAY_ZERO)) ? slot : (ov->index[cluster] + 1)))) {
+            cluster++;
+            n += ov->cluster_sectors;
+        }
+        if (n > count)
+            n = count;
+
+        if (slot == HDD_OVERLAY_ZERO)
+            memset(buffer, 0, n << 9);
+        else if (slot) {
+            uint64_t addr = ov->data_offset + ((((uint64_t) (slot - 1) * ov->cluster_sectors) +
+                                                (sector % ov->cluster_sectors)) << 9LL);
+
+            if ((fseeko64(ov->file, addr, SEEK_SET) == -1) ||
+                (fread(buffer, 512, n, ov->file) != n)) {
+                hdd_image_log("Hard disk image %i: Overlay read error\n", id);
+                return -1;
+            }
+        } else if (hdd_image_read_base(id, sector, n, buffer) < 0)
+            return -1;
+
+        sector += n;
+        count -= n;
+        buffer += (n << 9);
+    }
+
+    hdd_images[id].pos = sector;
+
+    return 0;
+}
+
+/* Write to an overlay, giving each cluster written to for the first time a
+   slot at the end of the overlay, filled from the base image (or with
+   zeroes for a zeroed cluster) if the write does not cover the whole
+   cluster. */
+static int
+hdd_overlay_write(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    hdd_overlay_t *ov = hdd_images[id].overlay;
+    uint32_t       cluster;
+    uint32_t       offset;
+    uint32_t       slot;
+    uint32_t       n;
+    uint64_t       addr;
+
+    while (count > 0) {
+        cluster = sector / ov->cluster_sectors;
+        offset  = sector % ov->cluster_sectors;
+        n       = ov->cluster_sectors - offset;
+        if (n > count)
+            n = count;
+
+        if (cluster >= ov->clusters)
+            return -1;
+
+        slot = ov->index[cluster];
+        if (slot && (slot != HDD_OVERLAY_ZERO)) {
+            addr = ov->data_offset + ((((uint64_t) (slot - 1) * ov->cluster_sectors) + offset) << 9LL);
+            if ((fseeko64(ov->file, addr, SEEK_SET) == -1) ||
+                (fwrite(buffer, 512, n, ov->file) != n))
+                goto fail;
+        } else {
+            const uint8_t *src = buffer;
+
+            if (n < ov->cluster_sectors) {
+                if (slot == HDD_OVERLAY_ZERO)
+                    memset(ov->buf, 0, ov->cluster_sectors << 9);
+                else if (hdd_image_read_base(id, cluster * ov->cluster_sectors, ov->cluster_sectors, ov->buf) < 0)
+                    return -1;
+                memcpy(ov->buf + (offset << 9), buffer, n << 9);
+                src = ov->buf;
+            }
+
+            slot = ov->next_slot;
+            addr = ov->data_offset + (((uint64_t) (slot - 1) * ov->cluster_sectors) << 9LL);
+            if ((fseeko64(ov->file, addr, SEEK_SET) == -1) ||
+                (fwrite(src, 512, ov->cluster_sectors, ov->file) != ov->cluster_sectors))
+                goto fail;
+
+            /* Only point the index at the cluster once its data is in place. */
+            if ((fseeko64(ov->file, ov->index_offset + ((uint64_t) cluster * sizeof(uint32_t)), SEEK_SET) == -1) ||
+                (fwrite(&slot, sizeof(uint32_t), 1, ov->file) != 1))
+                goto fail;
+
+            ov->index[cluster] = slot;
+            ov->next_slot++;
+        }
+
+        sector += n;
+        count -= n;
+        buffer += (n << 9);
+    }
+
+    hdd_images[id].pos = sector;
+
+    return 0;
+
+fail:
+    hdd_image_log("Hard disk image %i: Overlay write error\n", id);
+    return -1;
+}
+
+/* Zero sectors of an overlay. Whole clusters without data of their own are
+   only marked as zeroed in the index, the rest are written a cluster at a
+   time. */
+static int
+hdd_overlay_zero(uint8_t id, uint32_t sector, uint32_t count)
+{
+    hdd_overlay_t *ov    = hdd_images[id].overlay;
+    uint8_t       *zeros = NULL;
+    uint32_t       cluster;
+    uint32_t       slot;
+    uint32_t       n;
+    int            ret   = 0;
+
+    while (count > 0) {
+        cluster = sector / ov->cluster_sectors;
+        n       = ov->cluster_sectors - (sector % ov->cluster_sectors);
+        if (n > count)
+            n = count;
+
+        if (cluster >= ov->clusters) {
+            ret = -1;
+            break;
+        }
+
+        slot = ov->index[cluster];
+        if ((n == ov->cluster_sectors) && ((slot == 0) || (slot == HDD_OVERLAY_ZERO))) {
+            if (slot == 0) {
+                slot = HDD_OVERLAY_ZERO;
+                if ((fseeko64(ov->file, ov->index_offset + ((uint64_t) cluster * sizeof(uint32_t)), SEEK_SET) == -1) ||
+                    (fwrite(&slot, sizeof(uint32_t), 1, ov->file) != 1)) {
+                    hdd_image_log("Hard disk image %i: Overlay write error\n", id);
+                    ret = -1;
+                    break;
+                }
+                ov->index[cluster] = slot;
+            }
+        } else if (slot != HDD_OVERLAY_ZERO) {
+            if (zeros == NULL) {
+                zeros = (uint8_t *) calloc(ov->cluster_sectors, 512);
+                if (zeros == NULL) {
+                    ret = -1;
+                    break;
+                }
+            }
+            if (hdd_overlay_write(id, sector, n, zeros) < 0) {
+                ret = -1;
+                break;
+            }
+        }
+
+        sector += n;
+        count -= n;
+    }
+
+    free(zeros);
+
+    hdd_images[id].pos = sector;
+
+    return ret;
+}
+
+static int
+hdd_image_write_base(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    int    non_transferred_sectors;
+    size_t num_write;
+
+    if (hdd_images[id].overlay != NULL)
+        return hdd_overlay_write(id, sector, count, buffer);
+
+    if (hdd_images[id].type == HDD_IMAGE_VHD) {
+        hdd_images[id].vhd->error = 0;
+        non_transferred_sectors   = mvhd_write_sectors(hdd_images[id].vhd, sector, count, buffer);
+        hdd_images[id].pos        = sector + count - non_transferred_sectors - 1;
+        if (hdd_images[id].vhd->error)
+            return -1;
+    } else {
+        if (!hdd_images[id].file || (fseeko64(hdd_images[id].file, ((uint64_t) (sector) << 9LL) + hdd_images[id].base, SEEK_SET) == -1)) {
+            hdd_image_log("Hard disk image %i: Write error during seek\n", id);
+            return -1;
+        }
+
+        num_write          = fwrite(buffer, 512, count, hdd_images[id].file);
+        hdd_images[id].pos = sector + num_write;
+        if (num_write < count)
+            return -1;
+    }
+
+    return 0;
+}
+
+/* Hand everything written to the image over to the host and, unless the
+   write cache is unsafe, have the host write it to its disk. */
+static int
+hdd_image_sync(uint8_t id)
+{
+    hdd_image_t *img = &hdd_images[id];
+    FILE        *fp  = img->file;
+    int          ret = 0;
+
+    if (img->overlay != NULL)
+        fp = img->overlay->file;
+    else if (img->type == HDD_IMAGE_VHD) {
+        if (mvhd_flush(img->vhd) < 0)
+            ret = -1;
+        fp = img->vhd->f;
+    }
+
+    if ((fp != NULL) && (fflush(fp) != 0))
+        ret = -1;
+    else if ((fp != NULL) && (hdd[id].write_cache != HDD_WRITE_CACHE_UNSAFE)) {
+#ifdef _WIN32
+        if (_commit(_fileno(fp)) != 0)
+            ret = -1;
+#else
+        if (fsync(fileno(fp)) != 0)
+            ret = -1;
+#endif
+    }
+
+    img->unsynced = 0;
+
+    return ret;
+}
+
+/* Write the dirty ranges out to the image, in order of sector. */
+static int
+hdd_image_wb_write_back(uint8_t id)
+{
+    hdd_image_t     *img = &hdd_images[id];
+    hdd_wb_extent_t *e;
+    uint32_t         i;
+
+    for (i = 0; i < img->wb_count; i++) {
+        e = &img->wb[i];
+        if (hdd_image_write_base(id, e->sector, e->count, e->data) < 0) {
+            hdd_image_log("Hard disk image %i: Error writing back sectors %08X-%08X\n",
+                          id, e->sector, e->sector + e->count - 1);
+            break;
+        }
+        img->unsynced = 1;
+        img->wb_sectors -= e->count;
+        free(e->data);
+        e->data = NULL;
+    }
+
+    if (i == img->wb_count) {
+        img->wb_count = 0;
+        return 0;
+    }
+
+    /* Keep what could not be written back, for the next flush to retry. */
+    memmove(&img->wb[0], &img->wb[i], (img->wb_count - i) * sizeof(hdd_wb_extent_t));
+    img->wb_count -= i;
+
+    return -1;
+}
+
+/* Drop the dirty ranges, only once the image is closed and they can no
+   longer be written back. */
+static void
+hdd_image_wb_discard(uint8_t id)
+{
+    hdd_image_t *img = &hdd_images[id];
+
+    if (img->wb_count > 0)
+        hdd_image_log("Hard disk image %i: Discarding %u sectors that could not be written back\n",
+                      id, img->wb_sectors);
+
+    for (uint32_t i = 0; i < img->wb_count; i++)
+        free(img->wb[i].data);
+
+    img->wb_count   = 0;
+    img->wb_sectors = 0;
+}
+
+/* Merge a write into the dirty ranges, writing them back first if they
+   would grow past the limits of the cache. */
+static int
+hdd_image_wb_write(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    hdd_image_t     *img = &hdd_images[id];
+    hdd_wb_extent_t *e;
+    uint32_t         first;
+    uint32_t         last;
+    uint32_t         start  = sector;
+    uint32_t         end    = sector + count;
+    uint32_t         merged = 0;
+    uint32_t         capacity;
+    uint8_t         *data;
+
+    if ((img->wb_count == HDD_WB_EXTENTS) || ((img->wb_sectors + count) > HDD_WB_SECTORS)) {
+        if (hdd_image_wb_write_back(id) < 0)
             return -1;
     }
 
+    if (count > HDD_WB_SECTORS) {
+        img->unsynced = 1;
+        return hdd_image_write_base(id, sector, count, buffer);
+    }
+
+    /* Find the ranges the write overlaps or touches. */
+    for (first = 0; first < img->wb_count; first++) {
+        if ((img->wb[first].sector + img->wb[first].count) >= sector)
+            break;
+    }
+    for (last = first; (last < img->wb_count) && (img->wb[last].sector <= end); last++) {
+        e = &img->wb[last];
+        if (e->sector < start)
+            start = e->sector;
+        if ((e->sector + e->count) > end)
+            end = e->sector + e->count;
+        merged += e->count;
+    }
+
+    e = &img->wb[first];
+    if (((last - first) == 1) && (e->sector == start)) {
+        /* Grow a single range in place, this is where sequential writes go. */
+        if ((end - start) > e->capacity) {
+            capacity = e->capacity << 1;
+            if (capacity < (end - start))
+                capacity = end - start;
+            if (capacity > HDD_WB_SECTORS)
+                capacity = HDD_WB_SECTORS;
+            data = (uint8_t *) realloc(e->data, (size_t) capacity << 9);
+            if (data == NULL)
+                return -1;
+            e->data     = data;
+            e->capacity = capacity;
+        }
+    } else {
+        data = (uint8_t *) malloc((size_t) (end - start) << 9);
+        if (data == NULL)
+            return -1;
+
+        for (uint32_t i = first; i < last; i++) {
+            memcpy(data + ((img->wb[i].sector - start) << 9), img->wb[i].data, img->wb[i].count << 9);
+            free(img->wb[i].data);
+        }
+
+        if (last == first)
+            memmove(&img->wb[first + 1], &img->wb[first], (img->wb_count - first) * sizeof(hdd_wb_extent_t));
+        else
+            memmove(&img->wb[first + 1], &img->wb[last], (img->wb_count - last) * sizeof(hdd_wb_extent_t));
+        img->wb_count = img->wb_count + 1 - (last - first);
+
+        e->sector   = start;
+        e->capacity = end - start;
+        e->data     = data;
+    }
+
+    memcpy(e->data + ((sector - start) << 9), buffer, count << 9);
+    e->count = end - start;
+
+    img->wb_sectors = img->wb_sectors - merged + (end - start);
+    img->pos        = sector + count;
+
     return 0;
 }
 
+/* Patch what was read from the image with the dirty ranges covering it. */
+static void
+hdd_image_wb_read(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    const hdd_image_t     *img = &hdd_images[id];
+    const hdd_wb_extent_t *e;
+    uint32_t               from;
+    uint32_t               to;
+
+    for (uint32_t i = 0; i < img->wb_count; i++) {
+        e = &img->wb[i];
+        if (e->sector >= (sector + count))
+            break;
+
+        from = (e->sector > sector) ? e->sector : sector;
+        to   = ((e->sector + e->count) < (sector + count)) ? (e->sector + e->count) : (sector + count);
+        if (from < to)
+            memcpy(buffer + ((from - sector) << 9), e->data + ((from - e->sector) << 9), (to - from) << 9);
+    }
+}
+
+/* Bounds check for disks held in memory. */
+static int
+hdd_image_ram_range(uint8_t id, uint32_t sector, uint32_t count)
+{
+    return (((uint64_t) sector + count) <= ((uint64_t) hdd_images[id].last_sector + 1));
+}
+
+int
+hdd_image_read(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    int ret;
+
+    if (hdd_images[id].ram != NULL) {
+        if (!hdd_image_ram_range(id, sector, count))
+            return -1;
+        memcpy(buffer, hdd_images[id].ram + ((uint64_t) sector << 9), (size_t) count << 9);
+        hdd_images[id].pos = sector + count;
+        return 0;
+    }
+
+    if (hdd_images[id].overlay != NULL)
+        ret = hdd_overlay_read(id, sector, count, buffer);
+    else
+        ret = hdd_image_read_base(id, sector, count, buffer);
+
+    if ((ret == 0) && (hdd_images[id].wb_count > 0))
+        hdd_image_wb_read(id, sector, count, buffer);
+
+    return ret;
+}
+
 uint32_t
 hdd_image_get_last_sector(uint8_t id)
 {
@@ -584,29 +1288,35 @@ hdd_image_read_ex(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
 int
 hdd_image_write(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
 {
-    int    non_transferred_sectors;
-    size_t num_write;
+    hdd_image_t *img = &hdd_images[id];
+    int          ret;
 
-    if (hdd_images[id].type == HDD_IMAGE_VHD) {
-        hdd_images[id].vhd->error = 0;
-        non_transferred_sectors   = mvhd_write_sectors(hdd_images[id].vhd, sector, count, buffer);
-        hdd_images[id].pos        = sector + count - non_transferred_sectors - 1;
-        if (hdd_images[id].vhd->error)
-            return -1;
-    } else {
-        if (!hdd_images[id].file || (fseeko64(hdd_images[id].file, ((uint64_t) (sector) << 9LL) + hdd_images[id].base, SEEK_SET) == -1)) {
-            hdd_image_log("Hard disk image %i: Write error during seek\n", id);
-            return -1;
-        }
-
-        num_write          = fwrite(buffer, 512, count, hdd_images[id].file);
-        hdd_images[id].pos = sector + num_write;
-        fflush(hdd_images[id].file);
-        if (num_write < count)
+    if (img->ram != NULL) {
+        if (!hdd_image_ram_range(id, sector, count))
             return -1;
+        memcpy(img->ram + ((uint64_t) sector << 9), buffer, (size_t) count << 9);
+        img->pos = sector + count;
+        return 0;
     }
 
-    return 0;
+    if ((img->wb_count == 0) && !img->unsynced)
+        img->wb_since = plat_get_ticks();
+
+    if (img->wce)
+        return hdd_image_wb_write(id, sector, count, buffer);
+
+    ret = hdd_image_write_base(id, sector, count, buffer);
+
+    /* Keep the image consistent on the host after every write. */
+    if (img->overlay != NULL)
+        fflush(img->overlay->file);
+    else if (img->type == HDD_IMAGE_VHD)
+        (void) mvhd_flush(img->vhd);
+    else if (img->file != NULL)
+        fflush(img->file);
+    img->unsynced = 1;
+
+    return ret;
 }
 
 int
@@ -629,7 +1339,25 @@ hdd_image_write_ex(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
 int
 hdd_image_zero(uint8_t id, uint32_t sector, uint32_t count)
 {
-    if (hdd_images[id].type == HDD_IMAGE_VHD) {
+    if (hdd_images[id].ram != NULL) {
+        if (!hdd_image_ram_range(id, sector, count))
+            return -1;
+        memset(hdd_images[id].ram + ((uint64_t) sector << 9), 0, (size_t) count << 9);
+        hdd_images[id].pos = sector + count;
+        return 0;
+    }
+
+    if (hdd_image_wb_write_back(id) < 0)
+        return -1;
+
+    if ((hdd_images[id].wb_count == 0) && !hdd_images[id].unsynced)
+        hdd_images[id].wb_since = plat_get_ticks();
+    hdd_images[id].unsynced = 1;
+
+    if (hdd_images[id].overlay != NULL) {
+        if (hdd_overlay_zero(id, sector, count) < 0)
+            return -1;
+    } else if (hdd_images[id].type == HDD_IMAGE_VHD) {
         hdd_images[id].vhd->error   = 0;
         int non_transferred_sectors = mvhd_format_sectors(hdd_images[id].vhd, sector, count);
         hdd_images[id].pos          = sector + count - non_transferred_sectors - 1;
@@ -651,8 +1379,6 @@ hdd_image_zero(uint8_t id, uint32_t sector, uint32_t count)
             if (!fwrite(empty_sector, 512, 1, hdd_images[id].file))
                 return -1;
         }
-
-        fflush(hdd_images[id].file);
     }
 
     return 0;
@@ -674,6 +1400,116 @@ hdd_image_zero_ex(uint8_t id, uint32_t sector, uint32_t count)
     return 0;
 }
 
+/* Write everything the emulated machine wrote out to the host disk, for
+   cache flush commands and before the image is closed. */
+int
+hdd_image_flush(uint8_t id)
+{
+    hdd_image_t *img = &hdd_images[id];
+    int          ret;
+
+    if (!img->loaded)
+        return 0;
+
+    ret = hdd_image_wb_write_back(id);
+
+    if (img->unsynced && (hdd_image_sync(id) < 0))
+        ret = -1;
+
+    if (ret < 0)
+        hdd_image_log("Hard disk image %i: Flush error\n", id);
+
+    return ret;
+}
+
+/* Whether the emulated machine may enable the write cache, not so for
+   disks set to write through. */
+int
+hdd_image_write_cache_supported(uint8_t id)
+{
+    return (hdd[id].write_cache != HDD_WRITE_CACHE_THROUGH);
+}
+
+int
+hdd_image_get_write_cache(uint8_t id)
+{
+    return hdd_images[id].wce;
+}
+
+/* Enable or disable the write cache at the request of the emulated
+   machine, writing back what it holds when disabled. */
+int
+hdd_image_set_write_cache(uint8_t id, int enable)
+{
+    if (enable && !hdd_image_write_cache_supported(id))
+        return -1;
+
+    if (!enable && hdd_images[id].wce && (hdd_image_flush(id) < 0))
+        return -1;
+
+    hdd_images[id].wce = !!enable;
+
+    return 0;
+}
+
+/* Called once per frame, flushes the images written to longer ago than the
+   flush timeout of their hard disk. Images without the write cache enabled
+   are only synced when the emulated machine asks for it. */
+void
+hdd_image_process(void)
+{
+    uint32_t now = plat_get_ticks();
+    uint32_t timeout;
+
+    for (uint8_t i = 0; i < HDD_NUM; i++) {
+        if (!hdd_images[i].loaded || !hdd_images[i].wce ||
+            ((hdd_images[i].wb_count == 0) && !hdd_images[i].unsynced))
+            continue;
+
+        timeout = hdd[i].flush_timeout ? hdd[i].flush_timeout : HDD_FLUSH_TIMEOUT;
+        if ((now - hdd_images[i].wb_since) >= timeout)
+            (void) hdd_image_flush(i);
+    }
+}
+
+/* Read the whole disk into memory and serve it from there from now on, the
+   image is left as it is. Used by the storage benchmark to measure the
+   emulation without the host disk, and to keep write jobs off the image. */
+int
+hdd_image_load_ram(uint8_t id)
+{
+    hdd_image_t *img = &hdd_images[id];
+    uint64_t     size;
+    uint32_t     count;
+    uint8_t     *ram;
+
+    if (!img->loaded)
+        return -1;
+
+    if (img->ram != NULL)
+        return 0;
+
+    size = ((uint64_t) img->last_sector + 1) << 9;
+    if ((size > (uint64_t) SIZE_MAX) || ((ram = (uint8_t *) malloc((size_t) size)) == NULL))
+        return -1;
+
+    (void) hdd_image_flush(id);
+
+    for (uint32_t i = 0; i <= img->last_sector; i += count) {
+        count = MIN(img->last_sector + 1 - i, 2048);
+        if (hdd_image_read(id, i, count, ram + ((uint64_t) i << 9)) < 0) {
+            free(ram);
+            return -1;
+        }
+    }
+
+    img->ram = ram;
+
+    hdd_image_log("Hard disk image %i: Held in memory (%" PRIu64 " bytes)\n", id, size);
+
+    return 0;
+}
+
 uint32_t
 hdd_image_get_pos(uint8_t id)
 {
@@ -693,6 +1529,11 @@ hdd_image_unload(uint8_t id, UNUSED(int fn_preserve))
         return;
 
     if (hdd_images[id].loaded) {
+        (void) hdd_image_flush(id);
+        hdd_image_wb_discard(id);
+        free(hdd_images[id].ram);
+        hdd_images[id].ram = NULL;
+        hdd_overlay_close(id);
         if (hdd_images[id].file != NULL) {
             fclose(hdd_images[id].file);
             hdd_images[id].file = NULL;
@@ -716,6 +1557,10 @@ hdd_image_close(uint8_t id)
     if (!hdd_images[id].loaded)
         return;
 
+    (void) hdd_image_flush(id);
+    hdd_image_wb_discard(id);
+    free(hdd_images[id].ram);
+    hdd_overlay_close(id);
     if (hdd_images[id].file != NULL) {
         fclose(hdd_images[id].file);
         hdd_images[id].file = NULL;
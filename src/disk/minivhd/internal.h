@@ -48,6 +48,9 @@
 
 #define MVHD_SPARSE_BLK        0xffffffff
 
+/* Number of block sector bitmaps kept in memory per image */
+#define MVHD_BITMAP_CACHE      16
+
 /* For simplicity, we don't handle paths longer than this
  * Note, this is the max path in characters, as that is what
  * Windows uses
@@ -61,10 +64,18 @@
 #define MVHD_START_TS          946684800
 
 
+typedef struct MVHDBitmapEntry {
+    uint8_t* bitmap;
+    int      block;
+    bool     dirty;
+    uint64_t last_used;
+} MVHDBitmapEntry;
+
 typedef struct MVHDSectorBitmap {
-    uint8_t* curr_bitmap;
-    int      sector_count;
-    int      curr_block;
+    uint8_t*        data;
+    int             sector_count;
+    uint64_t        use_count;
+    MVHDBitmapEntry cache[MVHD_BITMAP_CACHE];
 } MVHDSectorBitmap;
 
 typedef struct MVHDFooter {
@@ -121,6 +132,10 @@ struct MVHDMeta {
     MVHDFooter       footer;
     MVHDSparseHeader sparse;
     uint32_t*        block_offset;
+    struct {
+        uint32_t first;
+        uint32_t last;
+    } bat_dirty;
     int              sect_per_block;
     MVHDSectorBitmap bitmap;
     int (*read_sectors)(struct MVHDMeta*, uint32_t, int, void*);
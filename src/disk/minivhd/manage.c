@@ -179,7 +179,7 @@ calc_sparse_values(MVHDMeta* vhdm)
 
 
 /**
- * \brief Allocate memory for a sector bitmap.
+ * \brief Allocate memory for the sector bitmap cache.
  *
  * Each data block is preceded by a sector bitmap. Each bit indicates whether the corresponding sector
  * is considered 'clean' or 'dirty' (for sparse VHD images), or whether to read from the parent or current
@@ -194,13 +194,19 @@ calc_sparse_values(MVHDMeta* vhdm)
 static int
 init_sector_bitmap(MVHDMeta* vhdm, MVHDError* err)
 {
-    vhdm->bitmap.curr_bitmap = calloc(vhdm->bitmap.sector_count, MVHD_SECTOR_SIZE);
-    if (vhdm->bitmap.curr_bitmap == NULL) {
+    vhdm->bitmap.data = calloc(MVHD_BITMAP_CACHE * vhdm->bitmap.sector_count, MVHD_SECTOR_SIZE);
+    if (vhdm->bitmap.data == NULL) {
         *err = MVHD_ERR_MEM;
         return -1;
     }
 
-    vhdm->bitmap.curr_block = -1;
+    for (int i = 0; i < MVHD_BITMAP_CACHE; i++) {
+        vhdm->bitmap.cache[i].bitmap = vhdm->bitmap.data + (i * vhdm->bitmap.sector_count * MVHD_SECTOR_SIZE);
+        vhdm->bitmap.cache[i].block = -1;
+    }
+
+    vhdm->bat_dirty.first = vhdm->sparse.max_bat_ent;
+    vhdm->bat_dirty.last = 0;
 
     return 0;
 }
@@ -595,8 +601,8 @@ cleanup_format_buff:
     vhdm->format_buffer.zero_data = NULL;
 
 cleanup_bitmap:
-    free(vhdm->bitmap.curr_bitmap);
-    vhdm->bitmap.curr_bitmap = NULL;
+    free(vhdm->bitmap.data);
+    vhdm->bitmap.data = NULL;
 
 cleanup_bat:
     free(vhdm->block_offset);
@@ -624,15 +630,18 @@ mvhd_close(MVHDMeta* vhdm)
     if (vhdm->parent != NULL)
         mvhd_close(vhdm->parent);
 
+    if (!vhdm->readonly)
+        (void) mvhd_flush(vhdm);
+
     fclose(vhdm->f);
 
     if (vhdm->block_offset != NULL) {
         free(vhdm->block_offset);
         vhdm->block_offset = NULL;
     }
-    if (vhdm->bitmap.curr_bitmap != NULL) {
-        free(vhdm->bitmap.curr_bitmap);
-        vhdm->bitmap.curr_bitmap = NULL;
+    if (vhdm->bitmap.data != NULL) {
+        free(vhdm->bitmap.data);
+        vhdm->bitmap.data = NULL;
     }
     if (vhdm->format_buffer.zero_data != NULL) {
         free(vhdm->format_buffer.zero_data);
@@ -380,6 +380,20 @@ MVHDAPI int mvhd_read_sectors(MVHDMeta* vhdm, uint32_t offset, int num_sectors,
  */
 MVHDAPI int mvhd_write_sectors(MVHDMeta* vhdm, uint32_t offset, int num_sectors, void* in_buff);
 
+/**
+ * \brief Write cached metadata to the VHD file
+ *
+ * Sector bitmaps and Block Allocation Table entries changed by writes are
+ * kept in memory, and only written to the file when they are evicted from
+ * the cache, when this function is called, or when the image is closed.
+ *
+ * \param [in] vhdm MiniVHD data structure
+ *
+ * \retval 0 the metadata was written and the file flushed
+ * \retval -1 an error occurred while writing
+ */
+MVHDAPI int mvhd_flush(MVHDMeta* vhdm);
+
 /**
  * \brief Write zeroed sectors to VHD file
  *
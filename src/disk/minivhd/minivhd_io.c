@@ -85,73 +85,131 @@ check_sectors(uint32_t offset, int num_sectors, uint32_t total_sectors, int *tra
 bool
 mvhd_write_empty_sectors(FILE *f, int sector_count)
 {
-    uint8_t zero_bytes[MVHD_SECTOR_SIZE] = {0};
+    static const uint8_t zero_bytes[MVHD_SECTOR_SIZE * 64] = {0};
+    int                  n;
 
-    for (int i = 0; i < sector_count; i++) {
-        if (!fwrite(zero_bytes, sizeof zero_bytes, 1, f))
+    while (sector_count > 0) {
+        n = (sector_count > 64) ? 64 : sector_count;
+        if (fwrite(zero_bytes, MVHD_SECTOR_SIZE, n, f) != (size_t) n)
             return 0;
+        sector_count -= n;
     }
 
-    fflush(f);
     return 1;
 }
 
 /**
- * \brief Read the sector bitmap for a block.
- *
- * If the block is sparse, the sector bitmap in memory will be
- * zeroed. Otherwise, the sector bitmap is read from the VHD file.
+ * \brief Write a cached sector bitmap to file
  *
  * \param [in] vhdm MiniVHD data structure
- * \param [in] blk The block for which to read the sector bitmap from
+ * \param [in] entry The cache entry holding the bitmap
  */
 static void
-read_sect_bitmap(MVHDMeta *vhdm, int blk)
+write_sect_bitmap(MVHDMeta *vhdm, MVHDBitmapEntry *entry)
 {
+    int64_t abs_offset = (int64_t)vhdm->block_offset[entry->block] * MVHD_SECTOR_SIZE;
+
+    if (mvhd_fseeko64(vhdm->f, abs_offset, SEEK_SET) == -1)
+        vhdm->error = 1;
+    if (!fwrite(entry->bitmap, MVHD_SECTOR_SIZE, vhdm->bitmap.sector_count, vhdm->f))
+        vhdm->error = 1;
+
+    entry->dirty = false;
+}
+
+/**
+ * \brief Get the sector bitmap for a block.
+ *
+ * The most recently used bitmaps are kept in memory. On a miss, the least
+ * recently used entry is written back if it was modified, and replaced.
+ * If the block is sparse, the sector bitmap in memory will be zeroed.
+ * Otherwise, the sector bitmap is read from the VHD file.
+ *
+ * \param [in] vhdm MiniVHD data structure
+ * \param [in] blk The block for which to get the sector bitmap
+ *
+ * \return The cache entry holding the bitmap of the block
+ */
+static MVHDBitmapEntry *
+get_sect_bitmap(MVHDMeta *vhdm, int blk)
+{
+    MVHDSectorBitmap *bm     = &vhdm->bitmap;
+    MVHDBitmapEntry  *victim = &bm->cache[0];
+
+    for (int i = 0; i < MVHD_BITMAP_CACHE; i++) {
+        MVHDBitmapEntry *entry = &bm->cache[i];
+
+        if (entry->block == blk) {
+            entry->last_used = ++bm->use_count;
+            return entry;
+        }
+        if (entry->last_used < victim->last_used)
+            victim = entry;
+    }
+
+    if (victim->dirty)
+        write_sect_bitmap(vhdm, victim);
+
     if (vhdm->block_offset[blk] != MVHD_SPARSE_BLK) {
         mvhd_fseeko64(vhdm->f, (uint64_t)vhdm->block_offset[blk] * MVHD_SECTOR_SIZE, SEEK_SET);
-        if (!fread(vhdm->bitmap.curr_bitmap, vhdm->bitmap.sector_count * MVHD_SECTOR_SIZE, 1, vhdm->f))
+        if (!fread(victim->bitmap, bm->sector_count * MVHD_SECTOR_SIZE, 1, vhdm->f))
             vhdm->error = 1;
     } else
-        memset(vhdm->bitmap.curr_bitmap, 0, vhdm->bitmap.sector_count * MVHD_SECTOR_SIZE);
+        memset(victim->bitmap, 0, bm->sector_count * MVHD_SECTOR_SIZE);
+
+    victim->block     = blk;
+    victim->dirty     = false;
+    victim->last_used = ++bm->use_count;
 
-    vhdm->bitmap.curr_block = blk;
+    return victim;
 }
 
 /**
- * \brief Write the current sector bitmap in memory to file
+ * \brief Write the modified range of the BAT from memory into file
  *
  * \param [in] vhdm MiniVHD data structure
  */
 static void
-write_curr_sect_bitmap(MVHDMeta* vhdm)
+write_bat_entries(MVHDMeta *vhdm)
 {
-    if (vhdm->bitmap.curr_block >= 0) {
-        int64_t abs_offset = (int64_t)vhdm->block_offset[vhdm->bitmap.curr_block] * MVHD_SECTOR_SIZE;
-        if (mvhd_fseeko64(vhdm->f, abs_offset, SEEK_SET) == -1)
-            vhdm->error = 1;
-        if (!fwrite(vhdm->bitmap.curr_bitmap, MVHD_SECTOR_SIZE, vhdm->bitmap.sector_count, vhdm->f))
+    uint32_t first = vhdm->bat_dirty.first;
+    uint32_t last  = vhdm->bat_dirty.last;
+    uint32_t buff[MVHD_BAT_ENT_PER_SECT];
+
+    if (first > last)
+        return;
+
+    if (mvhd_fseeko64(vhdm->f, vhdm->sparse.bat_offset + ((uint64_t)first * sizeof *vhdm->block_offset), SEEK_SET) == -1)
+        vhdm->error = 1;
+
+    while (first <= last) {
+        uint32_t n = last - first + 1;
+        if (n > MVHD_BAT_ENT_PER_SECT)
+            n = MVHD_BAT_ENT_PER_SECT;
+        for (uint32_t i = 0; i < n; i++)
+            buff[i] = mvhd_to_be32(vhdm->block_offset[first + i]);
+        if (fwrite(buff, sizeof *buff, n, vhdm->f) != n)
             vhdm->error = 1;
+        first += n;
     }
+
+    vhdm->bat_dirty.first = vhdm->sparse.max_bat_ent;
+    vhdm->bat_dirty.last  = 0;
 }
 
 /**
- * \brief Write block offset from memory into file
+ * \brief Mark a block offset in memory as needing to be written to file
  *
  * \param [in] vhdm MiniVHD data structure
- * \param [in] blk The block for which to write the offset for
+ * \param [in] blk The block for which the offset changed
  */
 static void
-write_bat_entry(MVHDMeta *vhdm, int blk)
+mark_bat_entry(MVHDMeta *vhdm, uint32_t blk)
 {
-    uint64_t table_offset = vhdm->sparse.bat_offset + ((uint64_t)blk * sizeof *vhdm->block_offset);
-    uint32_t offset = mvhd_to_be32(vhdm->block_offset[blk]);
-
-    if (mvhd_fseeko64(vhdm->f, table_offset, SEEK_SET) == -1)
-        vhdm->error = 1;
-    if (!fwrite(&offset, sizeof offset, 1, vhdm->f))
-        vhdm->error = 1;
-    fflush(vhdm->f);
+    if (blk < vhdm->bat_dirty.first)
+        vhdm->bat_dirty.first = blk;
+    if (blk > vhdm->bat_dirty.last)
+        vhdm->bat_dirty.last = blk;
 }
 
 /**
@@ -163,7 +221,7 @@ write_bat_entry(MVHDMeta *vhdm, int blk)
  *
  * This function creates new, empty blocks, by replacing the footer at the end of the file
  * and then re-inserting the footer at the new file end. The BAT table entry for the
- * new block is updated with the new offset.
+ * new block is updated in memory, and written to file by mvhd_flush().
  *
  * \param [in] vhdm MiniVHD data structure
  * \param [in] blk The block number to create
@@ -213,9 +271,28 @@ create_block(MVHDMeta *vhdm, int blk)
 
     /* We no longer have a sparse block. Update that BAT! */
     vhdm->block_offset[blk] = sect_offset;
-    write_bat_entry(vhdm, blk);
+    mark_bat_entry(vhdm, blk);
+}
 
-    fflush(vhdm->f);
+MVHDAPI int
+mvhd_flush(MVHDMeta *vhdm)
+{
+    if (vhdm->readonly)
+        return 0;
+
+    if (vhdm->block_offset != NULL) {
+        for (int i = 0; i < MVHD_BITMAP_CACHE; i++) {
+            if (vhdm->bitmap.cache[i].dirty)
+                write_sect_bitmap(vhdm, &vhdm->bitmap.cache[i]);
+        }
+
+        write_bat_entries(vhdm);
+    }
+
+    if (fflush(vhdm->f) != 0)
+        vhdm->error = 1;
+
+    return vhdm->error ? -1 : 0;
 }
 
 int
@@ -236,6 +313,27 @@ mvhd_fixed_read(MVHDMeta *vhdm, uint32_t offset, int num_sectors, void *out_buff
     return truncated_sectors;
 }
 
+/**
+ * \brief Read a run of sectors that are all present in one block
+ *
+ * \param [in] vhdm MiniVHD data structure
+ * \param [in] blk The block to read from
+ * \param [in] sib The first sector in the block
+ * \param [in] count The number of sectors to read
+ * \param [out] buff The buffer to read into
+ */
+static void
+read_block_sectors(MVHDMeta *vhdm, int blk, int sib, int count, uint8_t *buff)
+{
+    int64_t addr = (((int64_t) vhdm->block_offset[blk]) + vhdm->bitmap.sector_count + sib) *
+                   MVHD_SECTOR_SIZE;
+
+    if (mvhd_fseeko64(vhdm->f, addr, SEEK_SET) == -1)
+        vhdm->error = 1;
+    if (!fread(buff, (size_t) count * MVHD_SECTOR_SIZE, 1, vhdm->f) && !feof(vhdm->f))
+        vhdm->error = 1;
+}
+
 int
 mvhd_sparse_read(MVHDMeta *vhdm, uint32_t offset, int num_sectors, void *out_buff)
 {
@@ -246,44 +344,77 @@ mvhd_sparse_read(MVHDMeta *vhdm, uint32_t offset, int num_sectors, void *out_buf
     check_sectors(offset, num_sectors, total_sectors, &transfer_sectors, &truncated_sectors);
 
     uint8_t* buff = (uint8_t*)out_buff;
-    int64_t addr = 0ULL;
-    uint32_t s = 0;
-    uint32_t ls = 0;
+    uint32_t s = offset;
+    uint32_t ls = offset + transfer_sectors;
     int blk = 0;
-    int prev_blk = -1;
     int sib = 0;
-    ls = offset + transfer_sectors;
+    int n = 0;
 
-    for (s = offset; s < ls; s++) {
+    while (s < ls) {
         blk = s / vhdm->sect_per_block;
         sib = s % vhdm->sect_per_block;
-        if (blk != prev_blk) {
-            prev_blk = blk;
-            if (vhdm->bitmap.curr_block != blk) {
-                read_sect_bitmap(vhdm, blk);
-                if (mvhd_fseeko64(vhdm->f, (uint64_t)sib * MVHD_SECTOR_SIZE, SEEK_CUR) == -1)
-                    vhdm->error = 1;
-            } else {
-                addr = (((int64_t) vhdm->block_offset[blk]) + vhdm->bitmap.sector_count + sib) *
-                       MVHD_SECTOR_SIZE;
-                if (mvhd_fseeko64(vhdm->f, addr, SEEK_SET) == -1)
-                    vhdm->error = 1;
+        n = vhdm->sect_per_block - sib;
+        if ((uint32_t) n > (ls - s))
+            n = ls - s;
+
+        if (vhdm->block_offset[blk] == MVHD_SPARSE_BLK)
+            memset(buff, 0, (size_t) n * MVHD_SECTOR_SIZE);
+        else {
+            const uint8_t *bitmap = get_sect_bitmap(vhdm, blk)->bitmap;
+
+            /* Read each run of present sectors at once, and zero each run of absent ones. */
+            for (int i = 0; i < n; ) {
+                int k = sib + i;
+                int present = !!VHD_TESTBIT(bitmap, k);
+                int run = 1;
+
+                for (k++; ((i + run) < n) && (!!VHD_TESTBIT(bitmap, k) == present); k++)
+                    run++;
+
+                if (present)
+                    read_block_sectors(vhdm, blk, sib + i, run, buff + ((size_t) i * MVHD_SECTOR_SIZE));
+                else
+                    memset(buff + ((size_t) i * MVHD_SECTOR_SIZE), 0, (size_t) run * MVHD_SECTOR_SIZE);
+
+                i += run;
             }
         }
 
-        if (VHD_TESTBIT(vhdm->bitmap.curr_bitmap, sib)) {
-            if (!fread(buff, MVHD_SECTOR_SIZE, 1, vhdm->f) && !feof(vhdm->f))
-                vhdm->error = 1;
-        } else {
-            memset(buff, 0, MVHD_SECTOR_SIZE);
-            mvhd_fseeko64(vhdm->f, MVHD_SECTOR_SIZE, SEEK_CUR);
-        }
-        buff += MVHD_SECTOR_SIZE;
+        buff += (size_t) n * MVHD_SECTOR_SIZE;
+        s += n;
     }
 
     return truncated_sectors;
 }
 
+/**
+ * \brief Find the image in a differencing chain that holds a sector
+ *
+ * \param [in] vhdm MiniVHD data structure of the child image
+ * \param [in] s The sector to look up
+ *
+ * \return The first image in the chain that has the sector present, or the
+ * base image if none of the differencing images has it
+ */
+static MVHDMeta *
+diff_resolve_sector(MVHDMeta *vhdm, uint32_t s)
+{
+    MVHDMeta *curr_vhdm = vhdm;
+    int blk = 0;
+    int sib = 0;
+
+    while (curr_vhdm->footer.disk_type == MVHD_TYPE_DIFF) {
+        blk = s / curr_vhdm->sect_per_block;
+        sib = s % curr_vhdm->sect_per_block;
+        if ((curr_vhdm->block_offset[blk] != MVHD_SPARSE_BLK) &&
+            VHD_TESTBIT(get_sect_bitmap(curr_vhdm, blk)->bitmap, sib))
+            break;
+        curr_vhdm = curr_vhdm->parent;
+    }
+
+    return curr_vhdm;
+}
+
 int
 mvhd_diff_read(MVHDMeta *vhdm, uint32_t offset, int num_sectors, void *out_buff)
 {
@@ -294,39 +425,32 @@ mvhd_diff_read(MVHDMeta *vhdm, uint32_t offset, int num_sectors, void *out_buff)
     check_sectors(offset, num_sectors, total_sectors, &transfer_sectors, &truncated_sectors);
 
     uint8_t *buff = (uint8_t*)out_buff;
-    MVHDMeta *curr_vhdm = vhdm;
-    uint32_t s = 0;
-    uint32_t ls = 0;
-    int blk = 0;
-    int sib = 0;
-    ls = offset + transfer_sectors;
-
-    for (s = offset; s < ls; s++) {
-        while (curr_vhdm->footer.disk_type == MVHD_TYPE_DIFF) {
-            blk = s / curr_vhdm->sect_per_block;
-            sib = s % curr_vhdm->sect_per_block;
-            if (curr_vhdm->bitmap.curr_block != blk) {
-                read_sect_bitmap(curr_vhdm, blk);
-            }
-            if (!VHD_TESTBIT(curr_vhdm->bitmap.curr_bitmap, sib)) {
-                curr_vhdm = curr_vhdm->parent;
-            } else { break; }
-        }
+    MVHDMeta *curr_vhdm = NULL;
+    uint32_t s = offset;
+    uint32_t ls = offset + transfer_sectors;
+    uint32_t run = 0;
+
+    while (s < ls) {
+        /* Resolve the run of sectors that come from the same image in the chain,
+           the sector bitmaps involved stay cached in each image. */
+        curr_vhdm = diff_resolve_sector(vhdm, s);
+        for (run = 1; ((s + run) < ls) && (diff_resolve_sector(vhdm, s + run) == curr_vhdm); run++)
+            ;
 
         /* We handle actual sector reading using the fixed or sparse functions,
            as a differencing VHD is also a sparse VHD */
         if ((curr_vhdm->footer.disk_type == MVHD_TYPE_DIFF) ||
             (curr_vhdm->footer.disk_type == MVHD_TYPE_DYNAMIC))
-            mvhd_sparse_read(curr_vhdm, s, 1, buff);
+            mvhd_sparse_read(curr_vhdm, s, run, buff);
         else
-            mvhd_fixed_read(curr_vhdm, s, 1, buff);
+            mvhd_fixed_read(curr_vhdm, s, run, buff);
         if (curr_vhdm->error) {
             curr_vhdm->error = 0;
             vhdm->error = 1;
         }
 
-        curr_vhdm = vhdm;
-        buff += MVHD_SECTOR_SIZE;
+        buff += (size_t) run * MVHD_SECTOR_SIZE;
+        s += run;
     }
 
     return truncated_sectors;
@@ -347,7 +471,6 @@ mvhd_fixed_write(MVHDMeta *vhdm, uint32_t offset, int num_sectors, void *in_buff
         vhdm->error = 1;
     if (!fwrite(in_buff, transfer_sectors * MVHD_SECTOR_SIZE, 1, vhdm->f))
         vhdm->error = 1;
-    fflush(vhdm->f);
 
     return truncated_sectors;
 }
@@ -362,56 +485,48 @@ mvhd_sparse_diff_write(MVHDMeta *vhdm, uint32_t offset, int num_sectors, void *i
     check_sectors(offset, num_sectors, total_sectors, &transfer_sectors, &truncated_sectors);
 
     uint8_t* buff = (uint8_t *) in_buff;
+    MVHDBitmapEntry *entry = NULL;
     int64_t addr = 0ULL;
-    uint32_t s = 0;
-    uint32_t ls = 0;
+    uint32_t s = offset;
+    uint32_t ls = offset + transfer_sectors;
     int blk = 0;
-    int prev_blk = -1;
     int sib = 0;
-    ls = offset + transfer_sectors;
+    int n = 0;
 
     if (offset < total_sectors) {
-        for (s = offset; s < ls; s++) {
+        while (s < ls) {
             blk = s / vhdm->sect_per_block;
             sib = s % vhdm->sect_per_block;
-            if (vhdm->bitmap.curr_block != blk && prev_blk >= 0) {
-                /* Write the sector bitmap for the previous block, before we replace it. */
-                write_curr_sect_bitmap(vhdm);
-            }
-
-            if (vhdm->block_offset[blk] == MVHD_SPARSE_BLK) {
-                /* "read" the sector bitmap first, before creating a new block, as the bitmap will be
-                   zero either way */
-                read_sect_bitmap(vhdm, blk);
+            n = vhdm->sect_per_block - sib;
+            if ((uint32_t) n > (ls - s))
+                n = ls - s;
+
+            /* Get the sector bitmap first, before creating a new block, as the bitmap
+               will be zero either way */
+            entry = get_sect_bitmap(vhdm, blk);
+            if (vhdm->block_offset[blk] == MVHD_SPARSE_BLK)
                 create_block(vhdm, blk);
-            }
 
-            if (blk != prev_blk) {
-                if (vhdm->bitmap.curr_block != blk) {
-                    read_sect_bitmap(vhdm, blk);
-                    if (mvhd_fseeko64(vhdm->f, (uint64_t)sib * MVHD_SECTOR_SIZE, SEEK_CUR) == -1)
-                        vhdm->error = 1;
-                } else {
-                    addr = (((int64_t) vhdm->block_offset[blk]) + vhdm->bitmap.sector_count + sib) *
-                           MVHD_SECTOR_SIZE;
-                    if (mvhd_fseeko64(vhdm->f, addr, SEEK_SET) == -1)
-                        vhdm->error = 1;
+            addr = (((int64_t) vhdm->block_offset[blk]) + vhdm->bitmap.sector_count + sib) *
+                   MVHD_SECTOR_SIZE;
+            if (mvhd_fseeko64(vhdm->f, addr, SEEK_SET) == -1)
+                vhdm->error = 1;
+            if (fwrite(buff, MVHD_SECTOR_SIZE, n, vhdm->f) != (size_t) n)
+                vhdm->error = 1;
+
+            /* The bitmap only needs writing back if a sector became present. */
+            for (int k = sib; k < (sib + n); k++) {
+                if (!VHD_TESTBIT(entry->bitmap, k)) {
+                    VHD_SETBIT(entry->bitmap, k);
+                    entry->dirty = true;
                 }
-                prev_blk = blk;
             }
 
-            if (!fwrite(buff, MVHD_SECTOR_SIZE, 1, vhdm->f))
-                vhdm->error = 1;
-            VHD_SETBIT(vhdm->bitmap.curr_bitmap, sib);
-            buff += MVHD_SECTOR_SIZE;
+            buff += (size_t) n * MVHD_SECTOR_SIZE;
+            s += n;
         }
     }
 
-    /* And write the sector bitmap for the last block we visited to disk */
-    write_curr_sect_bitmap(vhdm);
-
-    fflush(vhdm->f);
-
     return truncated_sectors;
 }
 
@@ -1863,53 +1863,105 @@ dma_mode(int channel)
     return (dma[channel].mode);
 }
 
-/* DMA Bus Master Page Read/Write */
+/*
+ * DMA Bus Master Page Read/Write
+ *
+ * Runs of plain memory are copied in one go, everything else goes through
+ * the mapping handlers in TransferSize chunks counted from PhysAddress, so
+ * MMIO sees the same accesses as before.
+ */
+static uint32_t
+dma_bm_run(uint32_t PhysAddress, uint32_t size, int TransferSize, uint8_t **p, int write)
+{
+    uint32_t len;
+
+    *p = mem_get_phys_ptr(PhysAddress, size, &len, write);
+
+    /* Stop a run ending on MMIO on a transfer boundary. */
+    if ((*p != NULL) && (len < size))
+        len &= ~((uint32_t) TransferSize - 1);
+
+    return len;
+}
+
 void
 dma_bm_read(uint32_t PhysAddress, uint8_t *DataRead, uint32_t TotalSize, int TransferSize)
 {
-    uint32_t n;
-    uint32_t n2;
+    uint32_t pos      = 0;
+    uint32_t len;
+    uint8_t *p;
     uint8_t  bytes[4] = { 0, 0, 0, 0 };
 
-    n  = TotalSize & ~(TransferSize - 1);
-    n2 = TotalSize - n;
-
-    /* Do the divisible block, if there is one. */
-    if (n) {
-        for (uint32_t i = 0; i < n; i += TransferSize)
-            mem_read_phys((void *) &(DataRead[i]), PhysAddress + i, TransferSize);
-    }
+    while (pos < TotalSize) {
+        len = dma_bm_run(PhysAddress + pos, TotalSize - pos, TransferSize, &p, 0);
 
-    /* Do the non-divisible block, if there is one. */
-    if (n2) {
-        mem_read_phys((void *) bytes, PhysAddress + n, TransferSize);
-        memcpy((void *) &(DataRead[n]), bytes, n2);
+        if (len) {
+            memcpy(&DataRead[pos], p, len);
+            pos += len;
+        } else if ((TotalSize - pos) >= (uint32_t) TransferSize) {
+            mem_read_phys((void *) &(DataRead[pos]), PhysAddress + pos, TransferSize);
+            pos += TransferSize;
+        } else {
+            /* Do the non-divisible block. */
+            mem_read_phys((void *) bytes, PhysAddress + pos, TransferSize);
+            memcpy((void *) &(DataRead[pos]), bytes, TotalSize - pos);
+            pos = TotalSize;
+        }
     }
 }
 
 void
 dma_bm_write(uint32_t PhysAddress, const uint8_t *DataWrite, uint32_t TotalSize, int TransferSize)
 {
-    uint32_t n;
-    uint32_t n2;
+    uint32_t pos      = 0;
+    uint32_t len;
+    uint8_t *p;
     uint8_t  bytes[4] = { 0, 0, 0, 0 };
 
-    n  = TotalSize & ~(TransferSize - 1);
-    n2 = TotalSize - n;
-
-    /* Do the divisible block, if there is one. */
-    if (n) {
-        for (uint32_t i = 0; i < n; i += TransferSize)
-            mem_write_phys((void *) &(DataWrite[i]), PhysAddress + i, TransferSize);
-    }
+    while (pos < TotalSize) {
+        len = dma_bm_run(PhysAddress + pos, TotalSize - pos, TransferSize, &p, 1);
 
-    /* Do the non-divisible block, if there is one. */
-    if (n2) {
-        mem_read_phys((void *) bytes, PhysAddress + n, TransferSize);
-        memcpy(bytes, (void *) &(DataWrite[n]), n2);
-        mem_write_phys((void *) bytes, PhysAddress + n, TransferSize);
+        if (len) {
+            memcpy(p, &DataWrite[pos], len);
+            pos += len;
+        } else if ((TotalSize - pos) >= (uint32_t) TransferSize) {
+            mem_write_phys((void *) &(DataWrite[pos]), PhysAddress + pos, TransferSize);
+            pos += TransferSize;
+        } else {
+            /* Do the non-divisible block. */
+            mem_read_phys((void *) bytes, PhysAddress + pos, TransferSize);
+            memcpy(bytes, (void *) &(DataWrite[pos]), TotalSize - pos);
+            mem_write_phys((void *) bytes, PhysAddress + pos, TransferSize);
+            pos = TotalSize;
+        }
     }
 
+    /* Mark the code in the whole range dirty at once. */
     if (dma_at)
         mem_invalidate_range(PhysAddress, PhysAddress + TotalSize - 1);
 }
+
+/*
+ * For bus master devices that move data to or from guest memory without
+ * a buffer of their own, e.g. straight from a disk image. Returns the
+ * host memory backing a run of plain memory at PhysAddress, with its
+ * length in len, or NULL if the address has to go through dma_bm_read()
+ * or dma_bm_write(). Once the device has written to the run, it must
+ * call dma_bm_written().
+ */
+uint8_t *
+dma_bm_get_ptr(uint32_t PhysAddress, uint32_t TotalSize, int TransferSize, uint32_t *len, int write)
+{
+    uint8_t *p;
+
+    *len = dma_bm_run(PhysAddress, TotalSize, TransferSize, &p, write);
+
+    return *len ? p : NULL;
+}
+
+void
+dma_bm_written(uint32_t PhysAddress, uint32_t TotalSize)
+{
+    if (dma_at && TotalSize)
+        mem_invalidate_range(PhysAddress, PhysAddress + TotalSize - 1);
+}
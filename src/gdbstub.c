@@ -41,6 +41,9 @@
 #include "x87_sf.h"
 #include "x87.h"
 #include "x87_ops_conv.h"
+#ifdef USE_DYNAREC
+#    include "codegen_public.h"
+#endif
 #include <86box/io.h>
 #include <86box/mem.h>
 #include <86box/plat.h>
@@ -1220,12 +1223,23 @@ e00:
                     }
                 } else if (p[0] == 'r') {
                     pc_reset_hard();
+#if defined(USE_DYNAREC) && defined(USE_NEW_DYNAREC)
+                } else if (!strcmp(p, "dynarec")) {
+                    /* Hex encoding doubles the size, keep it within the response buffer. */
+                    client->packet_pos = codegen_stats_print(client->packet, (sizeof(client->response) / 2) - 16);
+                    gdbstub_client_respond_hex(client, (uint8_t *) client->packet, client->packet_pos);
+                    break;
+#endif
                 } else if ((p[0] == '?') || !strcmp(p, "help")) {
                     FAST_RESPONSE_HEX(
                         "Commands:\n"
                         "- ib/iw/il [port [length]] - Read {length} (default 1) I/O ports starting from {port} (default last)\n"
                         "- ob/ow/ol [[port] value] - Write {value} to I/O {port} (both default last)\n"
-                        "- r - Hard reset the emulated machine\n");
+                        "- r - Hard reset the emulated machine\n"
+#if defined(USE_DYNAREC) && defined(USE_NEW_DYNAREC)
+                        "- dynarec - Show dynamic recompiler statistics\n"
+#endif
+                        );
                     break;
                 } else {
 unknown:
@@ -169,8 +169,12 @@ extern int      xga_standalone_enabled;     /* (C) video option */
 extern int      da2_standalone_enabled;     /* (C) video option */
 extern uint32_t mem_size;                   /* (C) memory size (Installed on system board) */
 extern uint32_t isa_mem_size;               /* (C) memory size (ISA Memory Cards) */
+extern int      mem_huge_pages;             /* (C) back guest RAM with huge pages */
+extern int      mem_mergeable;              /* (C) let the host merge identical guest RAM pages */
 extern int      cpu;                        /* (C) cpu type */
 extern int      cpu_use_dynarec;            /* (C) cpu uses/needs Dyna */
+extern int      cpu_dynarec_cache;          /* (C) keep compiled block list across runs */
+extern int      cpu_dynarec_stats;          /* (C) write dynarec statistics on exit */
 extern int      fpu_type;                   /* (C) fpu type */
 extern int      fpu_softfloat;              /* (C) fpu uses softfloat */
 extern int      time_sync;                  /* (C) enable time sync */
@@ -52,6 +52,11 @@
 
 #define CD_IMAGE_HISTORY         10
 
+/* Readers of the sector cache, each detected as sequential on its own. */
+#define CDROM_CACHE_DATA         0
+#define CDROM_CACHE_AUDIO        1
+#define CDROM_CACHE_STREAMS      2
+
 #define CDROM_IMAGE              200
 
 /* This is so that if/when this is changed to something else,
@@ -340,6 +345,8 @@ typedef struct cdrom {
 
     void              *local;
     void              *log;
+    void              *cache;        /* Sector cache and read-ahead, NULL if none. */
+    void              *audio_stream; /* Audio decoded ahead of playback, NULL if none. */
 
     void               (*insert)(void *priv);
     void               (*close)(void *priv);
@@ -481,6 +488,24 @@ extern unsigned long   cdrom_crc32(unsigned long crc, const unsigned char *buf,
 
 extern int             cdrom_assigned_letters;
 
+/* CD-ROM sector cache. */
+extern int             cdrom_cache_read(cdrom_t *dev, uint8_t *buffer, const uint32_t sector,
+                                        const int stream);
+extern void            cdrom_cache_flush(cdrom_t *dev);
+extern void            cdrom_cache_io_lock(const cdrom_t *dev);
+extern void            cdrom_cache_io_unlock(const cdrom_t *dev);
+extern void            cdrom_cache_get_stats(const cdrom_t *dev, uint64_t *hits, uint64_t *misses,
+                                             uint64_t *prefetched);
+extern void            cdrom_cache_open(cdrom_t *dev);
+extern void            cdrom_cache_close(cdrom_t *dev);
+
+/* CD-ROM audio decoding ahead of playback. */
+extern int             cdrom_audio_stream_read(cdrom_t *dev, const uint32_t lba, const uint32_t end,
+                                               uint8_t *raw, int16_t *samples);
+extern void            cdrom_audio_stream_flush(cdrom_t *dev);
+extern void            cdrom_audio_stream_open(cdrom_t *dev);
+extern void            cdrom_audio_stream_close(cdrom_t *dev);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,34 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          CHD CD-ROM image back-end header.
+ *
+ * Authors: 86Box developers
+ *
+ *          Copyright 2026 86Box developers.
+ */
+#ifndef CDROM_IMAGE_CHD_H
+#define CDROM_IMAGE_CHD_H
+
+#define CHD_MAX_TRACKS 99
+
+/* A track of a CHD image, as described by its metadata. */
+typedef struct chd_track_info_t {
+    track_file_t *file;        /* Track file, reading only this track's sectors */
+    uint8_t       attr;        /* DATA_TRACK or AUDIO_TRACK */
+    uint8_t       mode;
+    uint32_t      sector_size; /* Bytes per sector stored in the track file */
+    uint32_t      pregap;      /* Pre-gap frames */
+    uint32_t      postgap;     /* Post-gap frames */
+    int           pregap_data; /* Pre-gap frames are stored at the start of the track file */
+} chd_track_info_t;
+
+/* CHD functions. */
+extern int chd_image_open(const uint8_t id, const char *filename, chd_track_info_t *tracks, int max);
+
+#endif /*CDROM_IMAGE_CHD_H*/
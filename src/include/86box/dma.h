@@ -108,6 +108,8 @@ extern void dma_alias_remove_piix(void);
 
 extern void dma_bm_read(uint32_t PhysAddress, uint8_t *DataRead, uint32_t TotalSize, int TransferSize);
 extern void dma_bm_write(uint32_t PhysAddress, const uint8_t *DataWrite, uint32_t TotalSize, int TransferSize);
+extern uint8_t *dma_bm_get_ptr(uint32_t PhysAddress, uint32_t TotalSize, int TransferSize, uint32_t *len, int write);
+extern void dma_bm_written(uint32_t PhysAddress, uint32_t TotalSize);
 
 void dma_set_params(uint8_t advanced, uint32_t mask);
 void dma_set_mask(uint32_t mask);
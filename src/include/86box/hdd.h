@@ -137,6 +137,15 @@ typedef struct hdd_zone_t {
     uint32_t start_track;
 } hdd_zone_t;
 
+/* Handling of writes to the image of a hard disk. */
+enum {
+    HDD_WRITE_CACHE_BACK = 0, /* Held in memory until flushed */
+    HDD_WRITE_CACHE_THROUGH,  /* Written to the image right away */
+    HDD_WRITE_CACHE_UNSAFE    /* As BACK, but never synced to the host disk */
+};
+
+#define HDD_FLUSH_TIMEOUT 1000 /* Milliseconds */
+
 /* Define the virtual Hard Disk. */
 typedef struct hard_disk_t {
     uint8_t           id;
@@ -158,13 +167,16 @@ typedef struct hard_disk_t {
     uint8_t            wp;           /* Disk has been mounted
                                         READ-ONLY */
     uint8_t            pad;
-    uint8_t            pad0;
+    uint8_t            write_cache;  /* HDD_WRITE_CACHE_* */
 
     void              *priv;
 
     char               fn[1024];     /* Name of current image file */
     /* Differential VHD parent file */
     char               vhd_parent[1280];
+    /* Copy-on-write overlay file, the image
+       in fn is then only read from */
+    char               overlay[1024];
 
     uint32_t           seek_pos;
     uint32_t           seek_len;
@@ -182,6 +194,7 @@ typedef struct hard_disk_t {
     uint32_t           cur_track;
     uint32_t           cur_addr;
     uint32_t           vhd_blocksize;
+    uint32_t           flush_timeout; /* Milliseconds, 0 = HDD_FLUSH_TIMEOUT */
 
     uint8_t            max_multiple_block;
     uint8_t            pad1[3];
@@ -215,6 +228,12 @@ extern int      hdd_image_write(uint8_t id, uint32_t sector, uint32_t count, uin
 extern int      hdd_image_write_ex(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer);
 extern int      hdd_image_zero(uint8_t id, uint32_t sector, uint32_t count);
 extern int      hdd_image_zero_ex(uint8_t id, uint32_t sector, uint32_t count);
+extern int      hdd_image_flush(uint8_t id);
+extern int      hdd_image_write_cache_supported(uint8_t id);
+extern int      hdd_image_get_write_cache(uint8_t id);
+extern int      hdd_image_set_write_cache(uint8_t id, int enable);
+extern void     hdd_image_process(void);
+extern int      hdd_image_load_ram(uint8_t id);
 extern uint32_t hdd_image_get_last_sector(uint8_t id);
 extern uint32_t hdd_image_get_pos(uint8_t id);
 extern uint8_t  hdd_image_get_type(uint8_t id);
@@ -235,4 +254,10 @@ extern const char *hdd_preset_get_internal_name(int preset);
 extern int         hdd_preset_get_from_internal_name(char *s);
 extern void        hdd_preset_apply(int hdd_id);
 
+#ifdef USE_INSTRUMENT
+/* Storage benchmark. */
+extern char *hdd_bench_path;
+extern int   hdd_bench_frame(void);
+#endif
+
 #endif /*EMU_HDD_H*/
@@ -119,6 +119,7 @@
 #define MEM_MAPPING_SMRAM     32 /* On internal bus (RAM) but SMRAM. */
 #define MEM_MAPPING_CACHE     64 /* Cache or MTRR - please avoid such mappings unless \
                                     stricly necessary (eg. for CoreBoot). */
+#define MEM_MAPPING_DIRECT    128 /* Reads have no side effects and return the contents of exec. */
 
 /* #define's for memory granularity, currently 4k, less does
    not work because of internal 4k pages. */
@@ -190,6 +191,7 @@ typedef struct _mem_mapping_ {
     void (*write_l)(uint32_t addr, uint32_t val, void *priv);
 
     uint8_t *exec;
+    uint32_t exec_size; /* Bytes behind exec that MEM_MAPPING_DIRECT reads may use. */
 
     uint32_t flags;
 
@@ -206,7 +208,10 @@ extern uint64_t *byte_code_present_mask;
 #    define PAGE_BYTE_MASK_OFFSET_MASK 63
 #    define PAGE_BYTE_MASK_MASK        63
 
+/* Outside the range of page indices, also marks the end of the list. */
 #    define EVICT_NOT_IN_LIST          ((uint32_t) -1)
+/* evict_prev of the first page in the list. */
+#    define EVICT_LIST_HEAD            ((uint32_t) -2)
 typedef struct page_t {
     void (*write_b)(uint32_t addr, uint8_t val, struct page_t *page);
     void (*write_w)(uint32_t addr, uint16_t val, struct page_t *page);
@@ -233,7 +238,9 @@ extern uint32_t purgable_page_list_head;
 __attribute__((always_inline)) static inline int
 page_in_evict_list(page_t *page)
 {
-    return (page->evict_prev != EVICT_NOT_IN_LIST);
+    /* Entries of the page table that were never set up have no memory
+       pointer, and are not in the list. */
+    return (page->mem != NULL) && (page->evict_prev != EVICT_NOT_IN_LIST);
 }
 void page_remove_from_evict_list(page_t *page);
 void page_add_to_evict_list(page_t *page);
@@ -264,11 +271,34 @@ extern uint8_t *rom;
 extern uint32_t biosmask;
 extern uint32_t biosaddr;
 
-extern int        readlookup[256];
-extern uintptr_t  old_rl2;
-extern uint8_t    uncached;
-extern int        readlnext;
-extern int        writelookup[256];
+/* Number of entries in each of the software TLB rings. */
+#define MMU_TLB_SIZE 1024
+
+typedef struct mmu_tlb_stats_t {
+    uint64_t read_fills;        /* Read TLB misses */
+    uint64_t write_fills;       /* Write TLB misses */
+    uint64_t flushes;           /* Full flushes */
+    uint64_t nonglobal_flushes; /* CR3 loads keeping global pages */
+    uint64_t page_flushes;      /* INVLPG */
+    uint64_t range_flushes;     /* Mapping changes */
+} mmu_tlb_stats_t;
+
+extern int             readlookup[MMU_TLB_SIZE];
+extern uintptr_t       old_rl2;
+extern uint8_t         uncached;
+extern int             readlnext;
+extern int             writelookup[MMU_TLB_SIZE];
+extern mmu_tlb_stats_t mmu_tlb_stats;
+
+typedef struct mem_recalc_stats_t {
+    uint64_t recalcs;  /* Mapping table rebuilds */
+    uint64_t granules; /* 4K granules rebuilt */
+    uint64_t batched;  /* Recalcs deferred to a mem_recalc_commit() */
+    uint64_t skipped;  /* State changes that changed nothing */
+    uint64_t per_sec;  /* Rebuilds during the last second */
+} mem_recalc_stats_t;
+
+extern mem_recalc_stats_t mem_recalc_stats;
 
 extern int        writelnext;
 extern uint32_t   ram_mapped_addr[64];
@@ -407,6 +437,9 @@ extern void mem_mapping_set_mask(mem_mapping_t *, uint32_t mask);
 extern void mem_mapping_disable(mem_mapping_t *);
 extern void mem_mapping_enable(mem_mapping_t *);
 extern void mem_mapping_recalc(uint64_t base, uint64_t size);
+extern void mem_recalc_begin(void);
+extern void mem_recalc_commit(void);
+extern void mem_recalc_onesec(void);
 
 extern void mem_set_wp(uint64_t base, uint64_t size, uint8_t flags, uint8_t wp);
 extern void mem_set_access(uint8_t bitmap, int mode, uint32_t base, uint32_t size, uint16_t access);
@@ -419,6 +452,7 @@ extern void     mem_writeb_phys(uint32_t addr, uint8_t val);
 extern void     mem_writew_phys(uint32_t addr, uint16_t val);
 extern void     mem_writel_phys(uint32_t addr, uint32_t val);
 extern void     mem_write_phys(void *src, uint32_t addr, int tranfer_size);
+extern uint8_t *mem_get_phys_ptr(uint32_t addr, uint32_t max, uint32_t *len, int write);
 
 extern uint8_t  mem_read_ram(uint32_t addr, void *priv);
 extern uint16_t mem_read_ramw(uint32_t addr, void *priv);
@@ -451,6 +485,8 @@ extern void flushmmucache(void);
 extern void flushmmucache_write(void);
 extern void flushmmucache_pc(void);
 extern void flushmmucache_nopc(void);
+extern void flushmmucache_nonglobal(void);
+extern void flushmmucache_page(uint32_t addr);
 
 extern void mem_debug_check_addr(uint32_t addr, int write);
 
@@ -460,6 +496,7 @@ extern void mem_a20_recalc(void);
 extern void mem_init(void);
 extern void mem_close(void);
 extern void mem_zero(void);
+extern int  mem_get_usage(size_t *allocated, size_t *resident);
 extern void mem_reset(void);
 extern void mem_remap_top_ex(int kb, uint32_t start);
 extern void mem_remap_top_ex_nomid(int kb, uint32_t start);
@@ -101,6 +101,7 @@ typedef struct netcard_conf_t {
     uint8_t  switch_group;
     uint8_t  promisc_mode;
     char     nrs_hostname[128];
+    uint8_t  switch_shm;
 } netcard_conf_t;
 
 extern netcard_conf_t net_cards_conf[NET_CARD_MAX];
@@ -214,6 +215,7 @@ extern int network_rx_put(netcard_t *card, uint8_t *bufp, int len);
 extern int network_rx_on_tx_popv(netcard_t *card, netpkt_t *pkt_vec, int vec_size);
 extern int network_rx_on_tx_put(netcard_t *card, uint8_t *bufp, int len);
 extern int network_rx_put_pkt(netcard_t *card, netpkt_t *pkt);
+extern int network_rx_put_pktv(netcard_t *card, netpkt_t *pkt_vec, int vec_size);
 extern int network_rx_on_tx_put_pkt(netcard_t *card, netpkt_t *pkt);
 
 #ifdef EMU_DEVICE_H
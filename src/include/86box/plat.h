@@ -117,6 +117,10 @@ extern "C" {
 # endif
 #endif
 
+/* Hints for plat_mmap_advise(). */
+#define PLAT_MMAP_HUGEPAGE  1 /* Back with huge pages where possible */
+#define PLAT_MMAP_MERGEABLE 2 /* Identical pages may be merged by the host */
+
 /* Global variables residing in the platform module. */
 extern int          dopause;       /* system is paused */
 extern int          mouse_capture; /* mouse is captured in app */
@@ -154,6 +158,9 @@ extern int      plat_file_check(const char *path);
 extern int      plat_dir_create(char *path);
 extern void    *plat_mmap(size_t size, uint8_t executable);
 extern void     plat_munmap(void *ptr, size_t size);
+extern void     plat_mmap_advise(void *ptr, size_t size, int flags);
+extern int      plat_mmap_discard(void *ptr, size_t size);
+extern int      plat_mmap_resident(void *ptr, size_t size, size_t *resident);
 extern uint64_t plat_timer_read(void);
 extern uint32_t plat_get_ticks(void);
 extern void     plat_delay_ms(uint32_t count);
@@ -54,7 +54,8 @@ extern int png_write_gray(char *path, int invert,
                           uint8_t *pix, int16_t w, int16_t h);
 
 extern void png_write_rgb(char    *fn,
-                          uint8_t *pix, int16_t w, int16_t h, uint16_t pitch, PALETTE palcol);
+                          uint8_t *pix, int16_t w, int16_t h, uint16_t pitch, PALETTE palcol,
+                          int level);
 
 #ifdef __cplusplus
 }
@@ -56,7 +56,16 @@
 #define FONT_FILE_OCRA      "ocra.ttf"
 #define FONT_FILE_OCRB      "ocra.ttf"
 
+/* Maximum number of pages waiting for the output worker. */
+#define PRT_OUTPUT_MAX_PENDING 4
+
 extern void
 select_codepage(uint16_t code, uint16_t *curmap);
 
+extern void prt_output_init(void);
+extern void prt_output_close(void);
+extern void prt_output_queue(void (*func)(void *priv), void *priv);
+extern int  prt_output_pending(void);
+extern void prt_output_wait(void);
+
 #endif /*PRINTER_H*/
@@ -75,6 +75,7 @@
 #define GPCMD_ERASE_10                                0x2c
 #define GPCMD_WRITE_AND_VERIFY_10                     0x2e
 #define GPCMD_VERIFY_10                               0x2f
+#define GPCMD_SYNCHRONIZE_CACHE                       0x35
 #define GPCMD_READ_BUFFER                             0x3c
 #define GPCMD_WRITE_SAME_10                           0x41
 #define GPCMD_READ_SUBCHANNEL                         0x42
@@ -424,6 +425,31 @@ typedef struct scsi_common_s {
     uint8_t            (*ven_cmd)(void *sc, uint8_t *cdb, int32_t *BufLen);
 } scsi_common_t;
 
+/* A segment of guest memory holding data of a command. */
+typedef struct scsi_sg_t {
+    uint32_t           addr;
+    uint32_t           len;
+} scsi_sg_t;
+
+/*
+   Guest memory a host adapter offers for the data of the current command,
+   so a device can move the data there itself instead of through its
+   buffer. The device sets 'done' once it has claimed the transfer, the
+   host adapter then must not copy the data.
+ */
+typedef struct scsi_sg_list_t {
+    scsi_sg_t *        entries;
+    int                count;
+    int                size;
+
+    uint32_t           length;        /* Sum of the segment lengths. */
+    int                transfer_size;
+    uint8_t            in;            /* Data may go to guest memory. */
+    uint8_t            out;           /* Data may come from guest memory. */
+    uint8_t            done;
+    uint8_t            pad;
+} scsi_sg_list_t;
+
 typedef struct scsi_device_t {
     int32_t            buffer_length;
 
@@ -434,6 +460,8 @@ typedef struct scsi_device_t {
 
     scsi_common_t *    sc;
 
+    scsi_sg_list_t *   sg;            /* Set by the host adapter, NULL if none. */
+
     void               (*command)(scsi_common_t *sc, const uint8_t *cdb);
     void               (*request_sense)(scsi_common_t *sc, uint8_t *buffer,
                                         uint8_t alloc_length);
@@ -505,6 +533,9 @@ extern void     scsi_device_command_stop(scsi_device_t *dev);
 extern void     scsi_device_command_phase1(scsi_device_t *dev);
 extern void     scsi_device_identify(scsi_device_t *dev, uint8_t lun);
 extern void     scsi_device_close_all(void);
+extern void     scsi_sg_reset(scsi_sg_list_t *sg, int transfer_size, int in, int out);
+extern void     scsi_sg_add(scsi_sg_list_t *sg, uint32_t addr, uint32_t len);
+extern void     scsi_sg_free(scsi_sg_list_t *sg);
 extern void     scsi_device_init(void);
 
 extern void    scsi_reset(void);
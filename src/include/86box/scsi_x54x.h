@@ -520,6 +520,8 @@ typedef struct x54x_t {
 
     Req_t Req;
 
+    scsi_sg_list_t sg; /* Guest memory of the current command's data. */
+
     fdc_t *fdc;
 } x54x_t;
 
@@ -118,7 +118,8 @@ typedef struct monitor_t {
     double                   mon_res_x;
     double                   mon_res_y;
     int                      mon_bpp;
-    bitmap_t                *target_buffer;
+    bitmap_t                *target_buffer; /* Back buffer the emulated card draws into. */
+    bitmap_t                *front_buffer;  /* Frame currently handed to the blitter. */
     int                      mon_video_timing_read_b;
     int                      mon_video_timing_read_w;
     int                      mon_video_timing_read_l;
@@ -133,6 +134,8 @@ typedef struct monitor_t {
     int                      mon_renderedframes;
     atomic_int               mon_actualrenderedframes;
     atomic_int               mon_screenshots;
+    atomic_int               mon_frames_presented; /* Frames handed to the blitter. */
+    atomic_int               mon_frames_dropped;   /* Frames replaced before the blitter got to them. */
     uint32_t                *mon_pal_lookup;
     int                     *mon_cga_palette;
     int                      mon_pal_lookup_static;  /* Whether it should not be freed by the API. */
@@ -270,7 +273,6 @@ extern void video_process_8_monitor(int x, int y, int monitor_index);
 extern void video_blit_memtoscreen_monitor(int x, int y, int w, int h, int monitor_index);
 extern void video_blit_complete_monitor(int monitor_index);
 extern void video_wait_for_blit_monitor(int monitor_index);
-extern void video_wait_for_buffer_monitor(int monitor_index);
 
 extern bitmap_t *create_bitmap(int w, int h);
 extern void      destroy_bitmap(bitmap_t *b);
@@ -306,7 +308,6 @@ extern uint32_t video_color_transform(uint32_t color);
 #define video_process_8(x, y)                 video_process_8_monitor(x, y, monitor_index_global)
 #define video_blit_complete()                 video_blit_complete_monitor(monitor_index_global)
 #define video_wait_for_blit()                 video_wait_for_blit_monitor(monitor_index_global)
-#define video_wait_for_buffer()               video_wait_for_buffer_monitor(monitor_index_global)
 #define cgapal_rebuild()                      cgapal_rebuild_monitor(monitor_index_global)
 #define video_force_resize_get()              video_force_resize_get_monitor(monitor_index_global)
 #define video_force_resize_set(val)           video_force_resize_set_monitor(val, monitor_index_global)
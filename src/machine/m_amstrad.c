@@ -502,7 +502,6 @@ vid_poll_1512(void *priv)
         if (vid->dispon) {
             if (vid->displine < vid->firstline) {
                 vid->firstline = vid->displine;
-                video_wait_for_buffer();
             }
             vid->lastline = vid->displine;
             switch (vid->double_type) {
@@ -1504,7 +1503,6 @@ lcdc_poll(amsvid_t *vid)
         if (cga->cgadispon) {
             if (cga->displine < cga->firstline) {
                 cga->firstline = cga->displine;
-                video_wait_for_buffer();
             }
             cga->lastline = cga->displine;
 
@@ -83,11 +83,26 @@ uint32_t pccache;
 uint8_t *pccache2;
 
 int        readlnext;
-int        readlookup[256];
+int        readlookup[MMU_TLB_SIZE];
 uintptr_t  old_rl2;
 uint8_t    uncached = 0;
 int        writelnext;
-int        writelookup[256];
+int        writelookup[MMU_TLB_SIZE];
+
+mmu_tlb_stats_t        mmu_tlb_stats;
+static mmu_tlb_stats_t mmu_tlb_stats_last;
+
+/* Per-entry flags of the software TLB rings. */
+#define TLB_GLOBAL 1 /* Mapped by a global page, survives CR3 loads with CR4.PGE set */
+#define TLB_LARGE  2 /* Part of a 2M or 4M page, INVLPG drops the whole page */
+
+static uint8_t  readlookup_flags[MMU_TLB_SIZE];
+static uint8_t  writelookup_flags[MMU_TLB_SIZE];
+static int      tlb_has_large;
+/* Virtual page and flags of the last successful page walk, picked up by the
+   next TLB fill of that page. */
+static uint32_t tlb_walk_virt = 0xffffffff;
+static uint8_t  tlb_walk_flags;
 
 /* The lookup tables. */
 page_t *page_lookup[1048576] = { 0 };
@@ -101,7 +116,7 @@ int shadowbios = 0;
 int shadowbios_write;
 int readlnum  = 0;
 int writelnum = 0;
-int cachesize = 256;
+int cachesize = MMU_TLB_SIZE;
 
 uint32_t get_phys_virt;
 uint32_t get_phys_phys;
@@ -116,7 +131,7 @@ int mmuflush = 0;
 uint64_t *byte_dirty_mask;
 uint64_t *byte_code_present_mask;
 
-uint32_t purgable_page_list_head = 0;
+uint32_t purgable_page_list_head = EVICT_NOT_IN_LIST;
 int      purgeable_page_count    = 0;
 #endif
 
@@ -126,6 +141,8 @@ mem_mapping_t        *read_mapping[MEM_MAPPINGS_NO];
 mem_mapping_t        *write_mapping[MEM_MAPPINGS_NO];
 
 uint8_t              *_mem_exec[MEM_MAPPINGS_NO];
+/* Host pointers for granules whose read mapping is MEM_MAPPING_DIRECT. */
+static uint8_t       *_mem_read_direct[MEM_MAPPINGS_NO];
 
 static mem_mapping_t *base_mapping;
 static mem_mapping_t *last_mapping;
@@ -135,6 +152,13 @@ static uint8_t       _mem_wp[MEM_MAPPINGS_NO];
 static uint8_t       _mem_wp_bus[MEM_MAPPINGS_NO];
 static uint8_t        ff_pccache[4] = { 0xff, 0xff, 0xff, 0xff };
 static mem_state_t    _mem_state[MEM_MAPPINGS_NO];
+static uint32_t       _mem_recalc_smm[MEM_MAPPINGS_NO >> 5];   /* Granules last recalculated in SMM */
+static uint32_t       _mem_recalc_dirty[MEM_MAPPINGS_NO >> 5]; /* Granules pending a batched recalc */
+static uint32_t       recalc_dirty_lo;
+static uint32_t       recalc_dirty_hi;
+static int            recalc_depth;
+static uint64_t       recalc_last;
+mem_recalc_stats_t    mem_recalc_stats;
 static uint32_t       remap_start_addr;
 static uint32_t       remap_start_addr2;
 static size_t ram_size = 0;
@@ -166,33 +190,55 @@ mem_addr_is_ram(uint32_t addr)
            (mapping == &ram_mid_mapping2) || (mapping == &ram_remapped_mapping);
 }
 
-void
-resetreadlookup(void)
+static void flushmmucache_all(void);
+
+/*
+ * Bring the lookup tables to their all-invalid state. Entries only ever
+ * become valid through the TLB rings, so after the initial fill it is
+ * enough to flush what the rings hold instead of rewriting the 24 MB of
+ * tables, and page_lookup (zero when invalid) is never written as a whole,
+ * leaving the untouched parts of it uncommitted.
+ */
+static void
+mem_lookup_reset(void)
 {
-    /* Initialize the page lookup table. */
-    memset(page_lookup, 0x00, (1 << 20) * sizeof(page_t *));
+    static int lookup_init = 0;
 
-    /* Initialize the tables for lower (<= 1024K) RAM. */
-    for (uint16_t c = 0; c < 256; c++) {
-        readlookup[c]  = 0xffffffff;
-        writelookup[c] = 0xffffffff;
-    }
+    if (!lookup_init) {
+        for (uint16_t c = 0; c < MMU_TLB_SIZE; c++) {
+            readlookup[c]  = 0xffffffff;
+            writelookup[c] = 0xffffffff;
+        }
 
-    /* Initialize the tables for high (> 1024K) RAM. */
-    memset(readlookup2, 0xff, (1 << 20) * sizeof(uintptr_t));
+        memset(readlookup2, 0xff, (1 << 20) * sizeof(uintptr_t));
+        memset(writelookup2, 0xff, (1 << 20) * sizeof(uintptr_t));
 
-    memset(writelookup2, 0xff, (1 << 20) * sizeof(uintptr_t));
+        lookup_init = 1;
+    } else
+        flushmmucache_all();
+
+    memset(readlookup_flags, 0x00, sizeof(readlookup_flags));
+    memset(writelookup_flags, 0x00, sizeof(writelookup_flags));
+    tlb_has_large = 0;
+    tlb_walk_virt = 0xffffffff;
 
     readlnext  = 0;
     writelnext = 0;
-    pccache    = 0xffffffff;
-    high_page  = 0;
 }
 
 void
-flushmmucache(void)
+resetreadlookup(void)
+{
+    mem_lookup_reset();
+
+    pccache   = 0xffffffff;
+    high_page = 0;
+}
+
+static void
+flushmmucache_all(void)
 {
-    for (uint16_t c = 0; c < 256; c++) {
+    for (uint16_t c = 0; c < MMU_TLB_SIZE; c++) {
         if (readlookup[c] != (int) 0xffffffff) {
             readlookup2[readlookup[c]] = LOOKUP_INV;
             readlookup[c]              = 0xffffffff;
@@ -203,6 +249,15 @@ flushmmucache(void)
             writelookup[c]               = 0xffffffff;
         }
     }
+    tlb_has_large = 0;
+    tlb_walk_virt = 0xffffffff;
+    mmu_tlb_stats.flushes++;
+}
+
+void
+flushmmucache(void)
+{
+    flushmmucache_all();
     mmuflush++;
 
     pccache  = (uint32_t) 0xffffffff;
@@ -213,46 +268,153 @@ flushmmucache(void)
 #endif
 }
 
+/* CR3 load: with CR4.PGE set, translations of global pages are kept. */
 void
-flushmmucache_write(void)
+flushmmucache_nonglobal(void)
 {
-    for (uint16_t c = 0; c < 256; c++) {
-        if (writelookup[c] != (int) 0xffffffff) {
+    if (!(cr4 & CR4_PGE)) {
+        flushmmucache();
+        return;
+    }
+
+    for (uint16_t c = 0; c < MMU_TLB_SIZE; c++) {
+        if ((readlookup[c] != (int) 0xffffffff) && !(readlookup_flags[c] & TLB_GLOBAL)) {
+            readlookup2[readlookup[c]] = LOOKUP_INV;
+            readlookup[c]              = 0xffffffff;
+        }
+        if ((writelookup[c] != (int) 0xffffffff) && !(writelookup_flags[c] & TLB_GLOBAL)) {
             page_lookup[writelookup[c]]  = NULL;
             writelookup2[writelookup[c]] = LOOKUP_INV;
             writelookup[c]               = 0xffffffff;
         }
     }
+    tlb_walk_virt = 0xffffffff;
+    get_phys_virt = 0xffffffff;
+    mmu_tlb_stats.nonglobal_flushes++;
     mmuflush++;
+
+    pccache  = (uint32_t) 0xffffffff;
+    pccache2 = (uint8_t *) 0xffffffff;
+
+#ifdef USE_DYNAREC
+    codegen_flush();
+#endif
 }
 
+/* INVLPG: drop the translation of a single page. */
 void
-flushmmucache_pc(void)
+flushmmucache_page(uint32_t addr)
 {
-    mmuflush++;
+    uint32_t virt = addr >> 12;
 
-    pccache  = (uint32_t) 0xffffffff;
-    pccache2 = (uint8_t *) 0xffffffff;
+    readlookup2[virt]  = LOOKUP_INV;
+    writelookup2[virt] = LOOKUP_INV;
+    page_lookup[virt]  = NULL;
+
+    /* The whole large page goes; the 4M boundary covers the 2M PAE case. */
+    if (tlb_has_large) {
+        for (uint16_t c = 0; c < MMU_TLB_SIZE; c++) {
+            if ((readlookup[c] != (int) 0xffffffff) && (readlookup_flags[c] & TLB_LARGE) && !((readlookup[c] ^ virt) & ~0x3ff)) {
+                readlookup2[readlookup[c]] = LOOKUP_INV;
+                readlookup[c]              = 0xffffffff;
+            }
+            if ((writelookup[c] != (int) 0xffffffff) && (writelookup_flags[c] & TLB_LARGE) && !((writelookup[c] ^ virt) & ~0x3ff)) {
+                page_lookup[writelookup[c]]  = NULL;
+                writelookup2[writelookup[c]] = LOOKUP_INV;
+                writelookup[c]               = 0xffffffff;
+            }
+        }
+    }
+
+    tlb_walk_virt = 0xffffffff;
+    if (!((get_phys_virt ^ addr) & ~0xfff))
+        get_phys_virt = 0xffffffff;
+    mmu_tlb_stats.page_flushes++;
 
 #ifdef USE_DYNAREC
     codegen_flush();
 #endif
 }
 
-void
-flushmmucache_nopc(void)
+/*
+ * A mapping change only affects the physical range that was recalculated,
+ * so only drop the translations that point into it. Every TLB entry is a
+ * pointer into ram (or a page_t for pages holding code), which gives back
+ * the physical page it translates to.
+ */
+static void
+flushmmucache_range(uint64_t base, uint64_t size)
 {
-    for (uint16_t c = 0; c < 256; c++) {
+    uint64_t  end = base + size;
+    uint64_t  phys;
+    uint32_t  virt;
+
+    if (ram == NULL)
+        return;
+
+    for (uint16_t c = 0; c < MMU_TLB_SIZE; c++) {
         if (readlookup[c] != (int) 0xffffffff) {
-            readlookup2[readlookup[c]] = LOOKUP_INV;
-            readlookup[c]              = 0xffffffff;
+            virt = readlookup[c];
+            phys = (uint64_t) (readlookup2[virt] + ((uintptr_t) virt << 12) - (uintptr_t) ram);
+            if (((phys + 0x1000) > base) && (phys < end)) {
+                readlookup2[virt] = LOOKUP_INV;
+                readlookup[c]     = 0xffffffff;
+            }
+        }
+        if (writelookup[c] != (int) 0xffffffff) {
+            virt = writelookup[c];
+            if (page_lookup[virt] != NULL)
+                phys = (uint64_t) (page_lookup[virt] - pages) << 12;
+            else
+                phys = (uint64_t) (writelookup2[virt] + ((uintptr_t) virt << 12) - (uintptr_t) ram);
+            if (((phys + 0x1000) > base) && (phys < end)) {
+                page_lookup[virt]  = NULL;
+                writelookup2[virt] = LOOKUP_INV;
+                writelookup[c]     = 0xffffffff;
+            }
         }
+    }
+    mmu_tlb_stats.range_flushes++;
+
+#ifdef USE_DYNAREC
+    codegen_flush();
+#endif
+}
+
+void
+flushmmucache_write(void)
+{
+    for (uint16_t c = 0; c < MMU_TLB_SIZE; c++) {
         if (writelookup[c] != (int) 0xffffffff) {
             page_lookup[writelookup[c]]  = NULL;
             writelookup2[writelookup[c]] = LOOKUP_INV;
             writelookup[c]               = 0xffffffff;
         }
     }
+    mmuflush++;
+}
+
+void
+flushmmucache_pc(void)
+{
+    mmuflush++;
+
+    pccache  = (uint32_t) 0xffffffff;
+    pccache2 = (uint8_t *) 0xffffffff;
+
+#ifdef USE_DYNAREC
+    codegen_flush();
+#endif
+}
+
+void
+flushmmucache_nopc(void)
+{
+    flushmmucache_all();
+
+#ifdef USE_DYNAREC
+    codegen_flush();
+#endif
 }
 
 void
@@ -260,7 +422,7 @@ mem_flush_write_page(uint32_t addr, uint32_t virt)
 {
     const page_t *page_target = &pages[addr >> 12];
 
-    for (uint16_t c = 0; c < 256; c++) {
+    for (uint16_t c = 0; c < MMU_TLB_SIZE; c++) {
         if (writelookup[c] != (int) 0xffffffff) {
             uintptr_t target = (uintptr_t) &ram[(uintptr_t) (addr & ~0xfff) - (virt & ~0xfff)];
             if (writelookup2[writelookup[c]] == target || page_lookup[writelookup[c]] == page_target) {
@@ -272,6 +434,15 @@ mem_flush_write_page(uint32_t addr, uint32_t virt)
     }
 }
 
+static __inline void
+mmu_tlb_walk(uint32_t addr, uint64_t entry, uint8_t flags)
+{
+    tlb_walk_virt  = addr >> 12;
+    tlb_walk_flags = flags;
+    if ((entry & 0x100) && (cr4 & CR4_PGE))
+        tlb_walk_flags |= TLB_GLOBAL;
+}
+
 #define mmutranslate_read(addr)  mmutranslatereal(addr, 0)
 #define mmutranslate_write(addr) mmutranslatereal(addr, 1)
 #define rammap(x)                ((uint32_t *) (_mem_exec[(x) >> MEM_GRANULARITY_BITS]))[((x) >> 2) & MEM_GRANULARITY_QMASK]
@@ -318,6 +489,7 @@ mmutranslatereal_normal(uint32_t addr, int rw)
         }
 
         rammap(addr2) |= (rw ? 0x60 : 0x20);
+        mmu_tlb_walk(addr, temp, TLB_LARGE);
 
         uint64_t page = temp & ~0x3fffff;
         if (cpu_features & CPU_FEATURE_PSE36)
@@ -341,6 +513,7 @@ mmutranslatereal_normal(uint32_t addr, int rw)
 
     rammap(addr2) |= 0x20;
     rammap((temp2 & ~0xfff) + ((addr >> 10) & 0xffc)) |= (rw ? 0x60 : 0x20);
+    mmu_tlb_walk(addr, temp, 0);
 
     return (uint64_t) ((temp & ~0xfff) + (addr & 0xfff));
 }
@@ -403,6 +576,7 @@ mmutranslatereal_pae(uint32_t addr, int rw)
             return 0xffffffffffffffffULL;
         }
         rammap64(addr3) |= (rw ? 0x60 : 0x20);
+        mmu_tlb_walk(addr, temp, TLB_LARGE);
 
         return ((temp & ~0x1fffffULL) + (addr & 0x1fffffULL)) & 0x000000ffffffffffULL;
     }
@@ -424,6 +598,7 @@ mmutranslatereal_pae(uint32_t addr, int rw)
 
     rammap64(addr3) |= 0x20;
     rammap64(addr4) |= (rw ? 0x60 : 0x20);
+    mmu_tlb_walk(addr, temp, 0);
 
     return ((temp & ~0xfffULL) + ((uint64_t) (addr & 0xfff))) & 0x000000ffffffffffULL;
 }
@@ -473,6 +648,7 @@ mmutranslate_noabrt_normal(uint32_t addr, int rw)
         /*4MB page*/
         if (((CPL == 3) && !(temp & 4) && !cpl_override) || (rw && !cpl_override && !(temp & 2) && ((CPL == 3) || (cr0 & WP_FLAG))))
             return 0xffffffffffffffffULL;
+        mmu_tlb_walk(addr, temp, TLB_LARGE);
 
         uint64_t page = temp & ~0x3fffff;
         if (cpu_features & CPU_FEATURE_PSE36)
@@ -485,6 +661,7 @@ mmutranslate_noabrt_normal(uint32_t addr, int rw)
 
     if (!(temp & 1) || ((CPL == 3) && !(temp3 & 4) && !cpl_override) || (rw && !cpl_override && !(temp3 & 2) && ((CPL == 3) || (cr0 & WP_FLAG))))
         return 0xffffffffffffffffULL;
+    mmu_tlb_walk(addr, temp, 0);
 
     return (uint64_t) ((temp & ~0xfff) + (addr & 0xfff));
 }
@@ -520,6 +697,7 @@ mmutranslate_noabrt_pae(uint32_t addr, int rw)
         /*2MB page*/
         if (((CPL == 3) && !(temp & 4) && !cpl_override) || (rw && !cpl_override && !(temp & 2) && ((CPL == 3) || (cr0 & WP_FLAG))))
             return 0xffffffffffffffffULL;
+        mmu_tlb_walk(addr, temp, TLB_LARGE);
 
         return ((temp & ~0x1fffffULL) + (addr & 0x1fffff)) & 0x000000ffffffffffULL;
     }
@@ -531,6 +709,7 @@ mmutranslate_noabrt_pae(uint32_t addr, int rw)
 
     if (!(temp & 1) || ((CPL == 3) && !(temp3 & 4) && !cpl_override) || (rw && !cpl_override && !(temp3 & 2) && ((CPL == 3) || (cr0 & WP_FLAG))))
         return 0xffffffffffffffffULL;
+    mmu_tlb_walk(addr, temp, 0);
 
     return ((temp & ~0xfffULL) + ((uint64_t) (addr & 0xfff))) & 0x000000ffffffffffULL;
 }
@@ -584,8 +763,11 @@ addreadlookup(uint32_t virt, uint32_t phys)
 
     readlookup2[virt >> 12] = (uintptr_t) &ram[(uintptr_t) (phys & ~0xFFF) - (uintptr_t) (virt & ~0xfff)];
 
-    readlookup[readlnext++] = virt >> 12;
+    readlookup_flags[readlnext] = ((virt >> 12) == tlb_walk_virt) ? tlb_walk_flags : 0;
+    tlb_has_large |= readlookup_flags[readlnext] & TLB_LARGE;
+    readlookup[readlnext++]     = virt >> 12;
     readlnext &= (cachesize - 1);
+    mmu_tlb_stats.read_fills++;
 
     cycles -= 9;
 }
@@ -623,8 +805,11 @@ addwritelookup(uint32_t virt, uint32_t phys)
         writelookup2[virt >> 12] = (uintptr_t) &ram[(uintptr_t) (phys & ~0xFFF) - (uintptr_t) (virt & ~0xfff)];
     }
 
-    writelookup[writelnext++] = virt >> 12;
+    writelookup_flags[writelnext] = ((virt >> 12) == tlb_walk_virt) ? tlb_walk_flags : 0;
+    tlb_has_large |= writelookup_flags[writelnext] & TLB_LARGE;
+    writelookup[writelnext++]     = virt >> 12;
     writelnext &= (cachesize - 1);
+    mmu_tlb_stats.write_fills++;
 
     cycles -= 9;
 }
@@ -674,7 +859,9 @@ read_mem_b(uint32_t addr)
     addr &= rammask;
 
     map = read_mapping[addr >> MEM_GRANULARITY_BITS];
-    if (map && map->read_b)
+    if (_mem_read_direct[addr >> MEM_GRANULARITY_BITS] != NULL)
+        ret = _mem_read_direct[addr >> MEM_GRANULARITY_BITS][addr & MEM_GRANULARITY_MASK];
+    else if (map && map->read_b)
         ret = map->read_b(addr, map->priv);
 
     resub_cycles(old_cycles);
@@ -697,7 +884,9 @@ read_mem_w(uint32_t addr)
     else {
         map = read_mapping[addr >> MEM_GRANULARITY_BITS];
 
-        if (map && map->read_w)
+        if (_mem_read_direct[addr >> MEM_GRANULARITY_BITS] != NULL)
+            ret = *(uint16_t *) &_mem_read_direct[addr >> MEM_GRANULARITY_BITS][addr & MEM_GRANULARITY_MASK];
+        else if (map && map->read_w)
             ret = map->read_w(addr, map->priv);
         else if (map && map->read_b)
             ret = map->read_b(addr, map->priv) | (map->read_b(addr + 1, map->priv) << 8);
@@ -776,6 +965,9 @@ readmembl(uint32_t addr)
     }
     addr = (uint32_t) (addr64 & rammask);
 
+    if (_mem_read_direct[addr >> MEM_GRANULARITY_BITS] != NULL)
+        return _mem_read_direct[addr >> MEM_GRANULARITY_BITS][addr & MEM_GRANULARITY_MASK];
+
     map = read_mapping[addr >> MEM_GRANULARITY_BITS];
     if (map && map->read_b)
         return map->read_b(addr, map->priv);
@@ -836,6 +1028,9 @@ readmembl_no_mmut(uint32_t addr, uint32_t a64)
     } else
         addr &= rammask;
 
+    if (_mem_read_direct[addr >> MEM_GRANULARITY_BITS] != NULL)
+        return _mem_read_direct[addr >> MEM_GRANULARITY_BITS][addr & MEM_GRANULARITY_MASK];
+
     map = read_mapping[addr >> MEM_GRANULARITY_BITS];
     if (map && map->read_b)
         return map->read_b(addr, map->priv);
@@ -919,6 +1114,9 @@ readmemwl(uint32_t addr)
 
     addr = addr64a[0] & rammask;
 
+    if (_mem_read_direct[addr >> MEM_GRANULARITY_BITS] != NULL)
+        return *(uint16_t *) &_mem_read_direct[addr >> MEM_GRANULARITY_BITS][addr & MEM_GRANULARITY_MASK];
+
     map = read_mapping[addr >> MEM_GRANULARITY_BITS];
 
     if (map && map->read_w)
@@ -1039,6 +1237,9 @@ readmemwl_no_mmut(uint32_t addr, uint32_t *a64)
     } else
         addr &= rammask;
 
+    if (_mem_read_direct[addr >> MEM_GRANULARITY_BITS] != NULL)
+        return *(uint16_t *) &_mem_read_direct[addr >> MEM_GRANULARITY_BITS][addr & MEM_GRANULARITY_MASK];
+
     map = read_mapping[addr >> MEM_GRANULARITY_BITS];
 
     if (map && map->read_w)
@@ -1168,6 +1369,9 @@ readmemll(uint32_t addr)
 
     addr = addr64a[0] & rammask;
 
+    if (_mem_read_direct[addr >> MEM_GRANULARITY_BITS] != NULL)
+        return *(uint32_t *) &_mem_read_direct[addr >> MEM_GRANULARITY_BITS][addr & MEM_GRANULARITY_MASK];
+
     map = read_mapping[addr >> MEM_GRANULARITY_BITS];
 
     if (map && map->read_l)
@@ -1309,6 +1513,9 @@ readmemll_no_mmut(uint32_t addr, uint32_t *a64)
     } else
         addr &= rammask;
 
+    if (_mem_read_direct[addr >> MEM_GRANULARITY_BITS] != NULL)
+        return *(uint32_t *) &_mem_read_direct[addr >> MEM_GRANULARITY_BITS][addr & MEM_GRANULARITY_MASK];
+
     map = read_mapping[addr >> MEM_GRANULARITY_BITS];
 
     if (map && map->read_l)
@@ -1445,6 +1652,9 @@ readmemql(uint32_t addr)
 
     addr = addr64a[0] & rammask;
 
+    if (_mem_read_direct[addr >> MEM_GRANULARITY_BITS] != NULL)
+        return *(uint64_t *) &_mem_read_direct[addr >> MEM_GRANULARITY_BITS][addr & MEM_GRANULARITY_MASK];
+
     map = read_mapping[addr >> MEM_GRANULARITY_BITS];
 
     if (map && map->read_l)
@@ -1772,6 +1982,55 @@ mem_write_phys(void *src, uint32_t addr, int transfer_size)
     }
 }
 
+/*
+ * Only plain RAM can be accessed directly, ROM and flash mappings also
+ * have an exec pointer but writes (and some reads) must go through their
+ * handlers so the flash command state machines see them.
+ */
+static int
+mem_mapping_is_ram(const mem_mapping_t *map, int write)
+{
+    if (write)
+        return (map->write_b == mem_write_ram);
+
+    return (map->read_b == mem_read_ram) || (map->read_b == mem_read_ram_2gb);
+}
+
+/*
+ * Return the host memory backing physical address addr for bus master
+ * accesses, and in len how many contiguous bytes (at most max) it covers,
+ * or NULL if the address has to go through the mapping handlers.
+ */
+uint8_t *
+mem_get_phys_ptr(uint32_t addr, uint32_t max, uint32_t *len, int write)
+{
+    mem_mapping_t **mappings = write ? write_mapping_bus : read_mapping_bus;
+    mem_mapping_t  *map      = mappings[addr >> MEM_GRANULARITY_BITS];
+    uint8_t        *p;
+    uint32_t        cur;
+
+    mem_logical_addr = 0xffffffff;
+
+    *len = 0;
+    if (!cpu_use_exec || !map || !map->exec || (map->mask < MEM_GRANULARITY_MASK) || !mem_mapping_is_ram(map, write))
+        return NULL;
+
+    p = &map->exec[(addr - map->base) & map->mask];
+
+    /* Extend the run for as long as the next granule continues it. */
+    do {
+        cur = addr + *len;
+        if ((mappings[cur >> MEM_GRANULARITY_BITS] != map) || (&map->exec[(cur - map->base) & map->mask] != &p[*len]))
+            break;
+        *len += MEM_GRANULARITY_SIZE - (cur & MEM_GRANULARITY_MASK);
+    } while ((*len < max) && ((addr + *len) != 0));
+
+    if (*len > max)
+        *len = max;
+
+    return p;
+}
+
 uint8_t
 mem_read_ram(uint32_t addr, UNUSED(void *priv))
 {
@@ -1866,10 +2125,15 @@ page_index(page_t *page)
 void
 page_add_to_evict_list(page_t *page)
 {
-    pages[purgable_page_list_head].evict_prev = page_index(page);
-    page->evict_next                          = purgable_page_list_head;
-    page->evict_prev                          = 0;
-    purgable_page_list_head                   = pages[purgable_page_list_head].evict_prev;
+    /* Set up an entry of the page table that was never touched. */
+    if (page->mem == NULL)
+        page->mem = page_ff;
+
+    page->evict_next = purgable_page_list_head;
+    page->evict_prev = EVICT_LIST_HEAD;
+    if (purgable_page_list_head != EVICT_NOT_IN_LIST)
+        pages[purgable_page_list_head].evict_prev = page_index(page);
+    purgable_page_list_head = page_index(page);
     purgeable_page_count++;
 }
 
@@ -1878,11 +2142,11 @@ page_remove_from_evict_list(page_t *page)
 {
     if (!page_in_evict_list(page))
         fatal("page_remove_from_evict_list: not in evict list!\n");
-    if (page->evict_prev)
+    if (page->evict_prev != EVICT_LIST_HEAD)
         pages[page->evict_prev].evict_next = page->evict_next;
     else
         purgable_page_list_head = page->evict_next;
-    if (page->evict_next)
+    if (page->evict_next != EVICT_NOT_IN_LIST)
         pages[page->evict_next].evict_prev = page->evict_prev;
     page->evict_prev = EVICT_NOT_IN_LIST;
     purgeable_page_count--;
@@ -2279,22 +2543,40 @@ mem_mapping_access_allowed(uint32_t flags, uint16_t access)
     return ret;
 }
 
-void
-mem_mapping_recalc(uint64_t base, uint64_t size)
+/* Whether the granule at c (an alias at offset i_c) can be read straight
+   from exec: it has to start on the granule and lie entirely inside both
+   the mapping and the buffer behind exec. */
+static __inline int
+mem_mapping_direct_ok(const mem_mapping_t *map, uint64_t c, uint64_t i_c)
+{
+    uint64_t offset = c - i_c - map->base;
+
+    return (map->flags & MEM_MAPPING_DIRECT) && (map->exec != NULL) && !(c & MEM_GRANULARITY_MASK) &&
+           ((offset + MEM_GRANULARITY_SIZE) <= map->size) && ((offset + MEM_GRANULARITY_SIZE) <= map->exec_size);
+}
+
+static void
+mem_mapping_recalc_range(uint64_t base, uint64_t size)
 {
     mem_mapping_t *map;
     int            n;
     uint64_t       c;
     uint8_t        wp;
 
-    if (!size || (base_mapping == NULL))
-        return;
-
     map = base_mapping;
+    n   = (!!in_smm) || (is_cxsmm && (ccr1 & CCR1_SMAC));
+
+    mem_recalc_stats.recalcs++;
+    mem_recalc_stats.granules += size >> MEM_GRANULARITY_BITS;
 
     /* Clear out old mappings. */
     for (c = base; c < base + size; c += MEM_GRANULARITY_SIZE) {
+        if (n)
+            _mem_recalc_smm[c >> (MEM_GRANULARITY_BITS + 5)] |= (1U << ((c >> MEM_GRANULARITY_BITS) & 0x1f));
+        else
+            _mem_recalc_smm[c >> (MEM_GRANULARITY_BITS + 5)] &= ~(1U << ((c >> MEM_GRANULARITY_BITS) & 0x1f));
         _mem_exec[c >> MEM_GRANULARITY_BITS]         = NULL;
+        _mem_read_direct[c >> MEM_GRANULARITY_BITS]  = NULL;
         write_mapping[c >> MEM_GRANULARITY_BITS]     = NULL;
         read_mapping[c >> MEM_GRANULARITY_BITS]      = NULL;
         write_mapping_bus[c >> MEM_GRANULARITY_BITS] = NULL;
@@ -2331,8 +2613,11 @@ mem_mapping_recalc(uint64_t base, uint64_t size)
                         write_mapping[c >> MEM_GRANULARITY_BITS] = map;
                     if ((map->read_b || map->read_w || map->read_l) &&
                         mem_mapping_access_allowed(map->flags,
-                                                   _mem_state[c >> MEM_GRANULARITY_BITS].states[n].r))
-                        read_mapping[c >> MEM_GRANULARITY_BITS] = map;
+                                                   _mem_state[c >> MEM_GRANULARITY_BITS].states[n].r)) {
+                        read_mapping[c >> MEM_GRANULARITY_BITS]     = map;
+                        _mem_read_direct[c >> MEM_GRANULARITY_BITS] = mem_mapping_direct_ok(map, c, i_c) ?
+                                                                      (map->exec + (c - i_c - map->base)) : NULL;
+                    }
 
                     /* Bus */
                     n |= STATE_BUS;
@@ -2352,7 +2637,7 @@ mem_mapping_recalc(uint64_t base, uint64_t size)
         map = map->next;
     }
 
-    flushmmucache_nopc();
+    flushmmucache_range(base, size);
 
 #ifdef ENABLE_MEM_LOG
     pclog("\nMemory map:\n");
@@ -2405,6 +2690,104 @@ mem_mapping_recalc(uint64_t base, uint64_t size)
 #endif
 }
 
+void
+mem_mapping_recalc(uint64_t base, uint64_t size)
+{
+    uint32_t first;
+    uint32_t last;
+
+    if (!size || (base_mapping == NULL))
+        return;
+
+    if (recalc_depth == 0) {
+        mem_mapping_recalc_range(base, size);
+        return;
+    }
+
+    /* Inside a batch, only remember which granules need recalculating. */
+    if ((base + size) > (1ULL << 32))
+        size = (1ULL << 32) - base;
+    first = (uint32_t) (base >> MEM_GRANULARITY_BITS);
+    last  = (uint32_t) ((base + size - 1) >> MEM_GRANULARITY_BITS);
+
+    for (uint32_t g = first; g <= last; g++)
+        _mem_recalc_dirty[g >> 5] |= (1U << (g & 0x1f));
+
+    if ((first >> 5) < recalc_dirty_lo)
+        recalc_dirty_lo = first >> 5;
+    if ((last >> 5) > recalc_dirty_hi)
+        recalc_dirty_hi = last >> 5;
+
+    mem_recalc_stats.batched++;
+}
+
+/*
+ * Batch mapping recalculations: chipsets rewriting several shadow or SMRAM
+ * registers in a row call this first, and everything that changed is then
+ * recalculated once by mem_recalc_commit(). Batches may be nested.
+ */
+void
+mem_recalc_begin(void)
+{
+    if (recalc_depth++ == 0) {
+        recalc_dirty_lo = MEM_MAPPINGS_NO >> 5;
+        recalc_dirty_hi = 0;
+    }
+}
+
+void
+mem_recalc_commit(void)
+{
+    uint32_t start = 0;
+    int      run   = 0;
+
+    if ((recalc_depth == 0) || (--recalc_depth > 0))
+        return;
+
+    for (uint32_t w = recalc_dirty_lo; w <= recalc_dirty_hi; w++) {
+        for (uint8_t b = 0; b < 32; b++) {
+            if (_mem_recalc_dirty[w] & (1U << b)) {
+                if (!run)
+                    start = (w << 5) | b;
+                run = 1;
+            } else if (run) {
+                mem_mapping_recalc((uint64_t) start << MEM_GRANULARITY_BITS,
+                                   (uint64_t) (((w << 5) | b) - start) << MEM_GRANULARITY_BITS);
+                run = 0;
+            }
+        }
+        _mem_recalc_dirty[w] = 0;
+    }
+
+    if (run)
+        mem_mapping_recalc((uint64_t) start << MEM_GRANULARITY_BITS,
+                           (uint64_t) (((recalc_dirty_hi + 1) << 5) - start) << MEM_GRANULARITY_BITS);
+}
+
+/* Called once per second to update the recalculation rate. */
+void
+mem_recalc_onesec(void)
+{
+    mem_recalc_stats.per_sec = mem_recalc_stats.recalcs - recalc_last;
+    recalc_last              = mem_recalc_stats.recalcs;
+
+    if (mem_recalc_stats.per_sec != 0)
+        mem_log("MEM: %" PRIu64 " mapping recalcs/s (%" PRIu64 " batched, %" PRIu64 " skipped in total)\n",
+                mem_recalc_stats.per_sec, mem_recalc_stats.batched, mem_recalc_stats.skipped);
+
+    if ((mmu_tlb_stats.read_fills != mmu_tlb_stats_last.read_fills) ||
+        (mmu_tlb_stats.write_fills != mmu_tlb_stats_last.write_fills))
+        mem_log("MEM: %" PRIu64 " TLB read fills/s, %" PRIu64 " write fills/s, flushes/s: %" PRIu64 " full, %" PRIu64
+                " keeping global pages, %" PRIu64 " INVLPG, %" PRIu64 " mapping changes\n",
+                mmu_tlb_stats.read_fills - mmu_tlb_stats_last.read_fills,
+                mmu_tlb_stats.write_fills - mmu_tlb_stats_last.write_fills,
+                mmu_tlb_stats.flushes - mmu_tlb_stats_last.flushes,
+                mmu_tlb_stats.nonglobal_flushes - mmu_tlb_stats_last.nonglobal_flushes,
+                mmu_tlb_stats.page_flushes - mmu_tlb_stats_last.page_flushes,
+                mmu_tlb_stats.range_flushes - mmu_tlb_stats_last.range_flushes);
+    mmu_tlb_stats_last = mmu_tlb_stats;
+}
+
 void
 mem_set_wp(uint64_t base, uint64_t size, uint8_t flags, uint8_t wp)
 {
@@ -2452,6 +2835,8 @@ mem_mapping_set(mem_mapping_t *map,
     map->flags   = fl;
     map->priv    = priv;
     map->next    = NULL;
+    /* Direct reads never go past what the mapping covered when added. */
+    map->exec_size = (fl & MEM_MAPPING_DIRECT) ? size : 0;
     mem_log("mem_mapping_add(): Linked list structure: %08X -> %08X -> %08X\n", map->prev, map, map->next);
 
     /* If the mapping is disabled, there is no need to recalc anything. */
@@ -2526,6 +2911,8 @@ mem_mapping_set_handler(mem_mapping_t *map,
     map->write_b = write_b;
     map->write_w = write_w;
     map->write_l = write_l;
+    /* The new handlers may no longer read straight from exec. */
+    map->flags &= ~MEM_MAPPING_DIRECT;
 
     mem_mapping_recalc(map->base, map->size);
 }
@@ -2554,6 +2941,9 @@ mem_mapping_set_addr(mem_mapping_t *map, uint32_t base, uint32_t size)
     map->enable = 1;
     map->base   = base;
     map->size   = size;
+    /* A window larger than the buffer behind exec needs the handlers. */
+    if (size > map->exec_size)
+        map->flags &= ~MEM_MAPPING_DIRECT;
 
     mem_mapping_recalc(map->base, map->size);
 }
@@ -2576,6 +2966,7 @@ void
 mem_mapping_set_exec(mem_mapping_t *map, uint8_t *exec)
 {
     map->exec = exec;
+    map->flags &= ~MEM_MAPPING_DIRECT;
 
     mem_mapping_recalc(map->base, map->size);
 }
@@ -2584,6 +2975,9 @@ void
 mem_mapping_set_mask(mem_mapping_t *map, uint32_t mask)
 {
     map->mask = mask;
+    /* Direct reads do not wrap around the mask. */
+    if (map->size && (mask < (map->size - 1)))
+        map->flags &= ~MEM_MAPPING_DIRECT;
 
     mem_mapping_recalc(map->base, map->size);
 }
@@ -2617,6 +3011,11 @@ mem_set_access(uint8_t bitmap, int mode, uint32_t base, uint32_t size, uint16_t
     uint16_t       smstate = 0x0000;
     const uint16_t smstates[4] = { 0x0000, (MEM_READ_SMRAM | MEM_WRITE_SMRAM),
                                    MEM_READ_SMRAM_EX, (MEM_READ_DISABLED_EX | MEM_WRITE_DISABLED_EX) };
+    const int      n           = (!!in_smm) || (is_cxsmm && (ccr1 & CCR1_SMAC));
+    uint32_t       first       = 0xffffffff;
+    uint32_t       last        = 0;
+    uint32_t       g;
+    mem_state_t    old;
 
     if (mode)
         mask = 0x2d6b;
@@ -2640,12 +3039,22 @@ mem_set_access(uint8_t bitmap, int mode, uint32_t base, uint32_t size, uint16_t
         smstate = access & 0x6f7b;
 
     for (uint32_t c = 0; c < size; c += MEM_GRANULARITY_SIZE) {
+        g   = (c + base) >> MEM_GRANULARITY_BITS;
+        old = _mem_state[g];
+
         for (uint8_t i = 0; i < 4; i++) {
             if (bitmap & (1 << i)) {
-                _mem_state[(c + base) >> MEM_GRANULARITY_BITS].vals[i] = (_mem_state[(c + base) >> MEM_GRANULARITY_BITS].vals[i] & mask) | smstate;
+                _mem_state[g].vals[i] = (_mem_state[g].vals[i] & mask) | smstate;
             }
         }
 
+        /* Granules recalculated under a different SMM state are stale too. */
+        if (memcmp(&_mem_state[g], &old, sizeof(mem_state_t)) || (!!(_mem_recalc_smm[g >> 5] & (1U << (g & 0x1f))) != n)) {
+            if (first == 0xffffffff)
+                first = g;
+            last = g;
+        }
+
 #ifdef ENABLE_MEM_LOG
         if (((c + base) >= 0xa0000) && ((c + base) <= 0xbffff)) {
             mem_log("Set mem state for block at %08X to %04X with bitmap %02X\n",
@@ -2654,7 +3063,11 @@ mem_set_access(uint8_t bitmap, int mode, uint32_t base, uint32_t size, uint16_t
 #endif
     }
 
-    mem_mapping_recalc(base, size);
+    if (first != 0xffffffff)
+        mem_mapping_recalc((uint64_t) first << MEM_GRANULARITY_BITS,
+                           (uint64_t) (last - first + 1) << MEM_GRANULARITY_BITS);
+    else
+        mem_recalc_stats.skipped++;
 }
 
 void
@@ -2676,12 +3089,35 @@ mem_a20_init(void)
     }
 }
 
+/*
+ * Report how much of the guest RAM is actually backed by host memory.
+ * Returns 0 on success, or -1 if the host can not tell, in which case
+ * only the allocated size is valid.
+ */
+int
+mem_get_usage(size_t *allocated, size_t *resident)
+{
+    *allocated = (ram != NULL) ? ram_size : 0;
+    *resident  = 0;
+
+    if (ram == NULL)
+        return 0;
+
+    return plat_mmap_resident(ram, ram_size, resident);
+}
+
 /* Close all the memory mappings. */
 void
 mem_close(void)
 {
     mem_mapping_t *map = base_mapping;
     mem_mapping_t *next;
+    size_t         allocated;
+    size_t         resident;
+
+    if ((ram != NULL) && !mem_get_usage(&allocated, &resident))
+        pclog("MEM: %" PRIu64 " KB of guest RAM allocated, %" PRIu64 " KB resident\n",
+              (uint64_t) (allocated >> 10), (uint64_t) (resident >> 10));
 
     while (map != NULL) {
         next      = map->next;
@@ -2711,7 +3147,9 @@ mem_init_ram_mapping(mem_mapping_t *mapping, uint32_t base, uint32_t size)
 void
 mem_zero(void)
 {
-    memset(ram, 0x00, ram_size + 16);
+    /* Prefer handing the pages back to the host over writing them. */
+    if (plat_mmap_discard(ram, ram_size + 16))
+        memset(ram, 0x00, ram_size + 16);
 }
 
 /* Reset the memory state. */
@@ -2734,9 +3172,12 @@ mem_reset(void)
     }
 #endif
 
+    /* Drop the page lookups into the old pages array. */
+    mem_lookup_reset();
+
     /* Free the old pages array, if necessary. */
     if (pages) {
-        free(pages);
+        plat_munmap(pages, pages_sz * sizeof(page_t));
         pages = NULL;
     }
 
@@ -2750,12 +3191,13 @@ mem_reset(void)
 
     ram_size = m;
     /* Allocate 16 extra bytes of RAM to mitigate some dynarec recompiler memory access quirks. */
-    ram      = (uint8_t *) plat_mmap(ram_size + 16, 0); /* allocate and clear the RAM block */
+    ram      = (uint8_t *) plat_mmap(ram_size + 16, 0); /* allocate the RAM block, demand-zero */
     if (ram == NULL) {
         fatal("Failed to allocate RAM block. Make sure you have enough RAM available.\n");
         return;
     }
-    memset(ram, 0x00, ram_size + 16);
+    if (mem_huge_pages || mem_mergeable)
+        plat_mmap_advise(ram, ram_size + 16, (mem_huge_pages ? PLAT_MMAP_HUGEPAGE : 0) | (mem_mergeable ? PLAT_MMAP_MERGEABLE : 0));
 
     /*
      * Allocate the page table based on how much RAM we have.
@@ -2782,34 +3224,30 @@ mem_reset(void)
 
     /*
      * Allocate and initialize the (new) page table.
+     *
+     * The table covers the whole address space, but only the pages backed
+     * by RAM are set up here. The rest is left demand-zero, an all-zero
+     * page having no memory, no write handlers and no byte masks, so only
+     * the few of them that ever get touched (ROM code, DMA targets) are
+     * committed.
      */
     pages_sz = m;
-    pages    = (page_t *) malloc(m * sizeof(page_t));
-
-    memset(page_lookup, 0x00, (1 << 20) * sizeof(page_t *));
-
-    memset(pages, 0x00, pages_sz * sizeof(page_t));
+    pages    = (page_t *) plat_mmap(m * sizeof(page_t), 0);
+    if (pages == NULL) {
+        fatal("Failed to allocate the page table.\n");
+        return;
+    }
 
 #ifdef USE_NEW_DYNAREC
-    byte_dirty_mask = malloc((mem_size * 1024) / 8);
-    memset(byte_dirty_mask, 0, (mem_size * 1024) / 8);
-
-    byte_code_present_mask = malloc((mem_size * 1024) / 8);
-    memset(byte_code_present_mask, 0, (mem_size * 1024) / 8);
+    byte_dirty_mask        = calloc((mem_size * 1024) / 8, 1);
+    byte_code_present_mask = calloc((mem_size * 1024) / 8, 1);
 #endif
 
-    for (uint32_t c = 0; c < pages_sz; c++) {
-        if ((c << 12) >= (mem_size << 10))
-            pages[c].mem = page_ff;
-        else {
-
-            pages[c].mem = &ram[c << 12];
-        }
-        if (c < m) {
-            pages[c].write_b = mem_write_ramb_page;
-            pages[c].write_w = mem_write_ramw_page;
-            pages[c].write_l = mem_write_raml_page;
-        }
+    for (uint32_t c = 0; (c < pages_sz) && ((c << 12) < (mem_size << 10)); c++) {
+        pages[c].mem     = &ram[c << 12];
+        pages[c].write_b = mem_write_ramb_page;
+        pages[c].write_w = mem_write_ramw_page;
+        pages[c].write_l = mem_write_raml_page;
 #ifdef USE_NEW_DYNAREC
         pages[c].evict_prev             = EVICT_NOT_IN_LIST;
         pages[c].byte_dirty_mask        = &byte_dirty_mask[c * 64];
@@ -2822,6 +3260,7 @@ mem_reset(void)
     memset(_mem_wp_bus, 0x00, sizeof(_mem_wp_bus));
     memset(write_mapping, 0x00, sizeof(write_mapping));
     memset(read_mapping, 0x00, sizeof(read_mapping));
+    memset(_mem_read_direct, 0x00, sizeof(_mem_read_direct));
     memset(write_mapping_bus, 0x00, sizeof(write_mapping_bus));
     memset(read_mapping_bus, 0x00, sizeof(read_mapping_bus));
 
@@ -2829,6 +3268,7 @@ mem_reset(void)
 
     /* Set the entire memory space as external. */
     memset(_mem_state, 0x00, sizeof(_mem_state));
+    memset(_mem_recalc_smm, 0x00, sizeof(_mem_recalc_smm));
 
     /* Set the low RAM space as internal. */
     mem_init_ram_mapping(&ram_low_mapping, 0x000000, (mem_size > 640) ? 0xa0000 : mem_size * 1024);
@@ -2866,7 +3306,7 @@ mem_reset(void)
     mem_a20_init();
 
 #ifdef USE_NEW_DYNAREC
-    purgable_page_list_head = 0;
+    purgable_page_list_head = EVICT_NOT_IN_LIST;
     purgeable_page_count    = 0;
 #endif
 }
@@ -3067,6 +3507,11 @@ mem_reset_page_blocks(void)
         return;
 
     for (uint32_t c = 0; c < pages_sz; c++) {
+#ifdef USE_NEW_DYNAREC
+        /* Don't commit pages of the table that were never touched. */
+        if (!pages[c].mem && !pages[c].block && !pages[c].block_2 && !pages[c].head)
+            continue;
+#endif
         pages[c].write_b = mem_write_ramb_page;
         pages[c].write_w = mem_write_ramw_page;
         pages[c].write_l = mem_write_raml_page;
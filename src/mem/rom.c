@@ -566,7 +566,7 @@ bios_add(void)
         mem_mapping_add(&bios_mapping, biosaddr, biosmask + 1,
                         bios_read, bios_readw, bios_readl,
                         NULL, NULL, NULL,
-                        rom, MEM_MAPPING_EXTERNAL | MEM_MAPPING_ROM | MEM_MAPPING_ROMCS, 0);
+                        rom, MEM_MAPPING_EXTERNAL | MEM_MAPPING_ROM | MEM_MAPPING_ROMCS | MEM_MAPPING_DIRECT, 0);
 
         mem_set_mem_state_both(biosaddr, biosmask + 1,
                                MEM_READ_ROMCS | MEM_WRITE_ROMCS);
@@ -576,7 +576,7 @@ bios_add(void)
         mem_mapping_add(&bios_high_mapping, biosaddr | 0x03f00000, biosmask + 1,
                         bios_read, bios_readw, bios_readl,
                         NULL, NULL, NULL,
-                        rom, MEM_MAPPING_EXTERNAL | MEM_MAPPING_ROM | MEM_MAPPING_ROMCS, 0);
+                        rom, MEM_MAPPING_EXTERNAL | MEM_MAPPING_ROM | MEM_MAPPING_ROMCS | MEM_MAPPING_DIRECT, 0);
 
         mem_set_mem_state_both(biosaddr | 0x03f00000, biosmask + 1,
                                MEM_READ_ROMCS | MEM_WRITE_ROMCS);
@@ -584,7 +584,7 @@ bios_add(void)
         mem_mapping_add(&bios_high_mapping, biosaddr | (temp_cpu_16bitbus ? 0x00f00000 : 0xfff00000), biosmask + 1,
                         bios_read, bios_readw, bios_readl,
                         NULL, NULL, NULL,
-                        rom, MEM_MAPPING_EXTERNAL | MEM_MAPPING_ROM | MEM_MAPPING_ROMCS, 0);
+                        rom, MEM_MAPPING_EXTERNAL | MEM_MAPPING_ROM | MEM_MAPPING_ROMCS | MEM_MAPPING_DIRECT, 0);
 
         mem_set_mem_state_both(biosaddr | (temp_cpu_16bitbus ? 0x00f00000 : 0xfff00000), biosmask + 1,
                                MEM_READ_ROMCS | MEM_WRITE_ROMCS);
@@ -691,7 +691,7 @@ rom_init(rom_t *rom, const char *fn, uint32_t addr, int sz, int mask, int off, u
                     addr, sz,
                     rom_read, rom_readw, rom_readl,
                     NULL, NULL, NULL,
-                    rom->rom, flags | MEM_MAPPING_ROM_WS, rom);
+                    rom->rom, flags | MEM_MAPPING_ROM_WS | ((mask == (sz - 1)) ? MEM_MAPPING_DIRECT : 0), rom);
 
     return 0;
 }
@@ -720,7 +720,7 @@ rom_init_oddeven(rom_t *rom, const char *fn, uint32_t addr, int sz, int mask, in
                     addr, sz,
                     rom_read, rom_readw, rom_readl,
                     NULL, NULL, NULL,
-                    rom->rom, flags | MEM_MAPPING_ROM_WS, rom);
+                    rom->rom, flags | MEM_MAPPING_ROM_WS | ((mask == (sz - 1)) ? MEM_MAPPING_DIRECT : 0), rom);
 
     return 0;
 }
@@ -747,7 +747,7 @@ rom_init_interleaved(rom_t *rom, const char *fnl, const char *fnh, uint32_t addr
                     addr, sz,
                     rom_read, rom_readw, rom_readl,
                     NULL, NULL, NULL,
-                    rom->rom, flags | MEM_MAPPING_ROM_WS, rom);
+                    rom->rom, flags | MEM_MAPPING_ROM_WS | ((mask == (sz - 1)) ? MEM_MAPPING_DIRECT : 0), rom);
 
     return 0;
 }
@@ -260,7 +260,11 @@ row_init(const device_t *info)
     mem_mapping_disable(&ram_mid_mapping);
     mem_mapping_disable(&ram_high_mapping);
 
+    /* Entries of the page table that were never set up already have no
+       memory behind them, leave them uncommitted. */
     for (uint32_t c = 0; c < pages_sz; c++) {
+        if (pages[c].mem == NULL)
+            continue;
         pages[c].mem = page_ff;
         pages[c].write_b = NULL;
         pages[c].write_w = NULL;
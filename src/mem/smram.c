@@ -152,6 +152,9 @@ smram_recalc_all(int ret)
     if (base_smram == NULL)
         return;
 
+    /* The backup and current ranges usually overlap, recalculate them once. */
+    mem_recalc_begin();
+
     if (ret) {
         while (temp_smram != NULL) {
             if (temp_smram->old_size != 0x00000000)
@@ -173,6 +176,7 @@ smram_recalc_all(int ret)
         temp_smram = next;
     }
 
+    mem_recalc_commit();
     flushmmucache();
 }
 
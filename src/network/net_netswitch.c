@@ -56,6 +56,8 @@ enum {
 #define SWITCH_KEEPALIVE_INTERVAL 5000000
 /* In ms, how long until we consider a connection gone? */
 #define SWITCH_MAX_INTERVAL 10000
+/* In ms, how long the shared memory receive thread sleeps before checking for shutdown */
+#define SWITCH_SHM_WAIT 100
 
 typedef struct {
     void           *nsconn;
@@ -65,10 +67,14 @@ typedef struct {
     net_evt_t       tx_event;
     net_evt_t       stop_event;
     netpkt_t        pktv[SWITCH_PKT_BATCH];
+    netpkt_t        rx_pktv[SWITCH_PKT_BATCH];
     pc_timer_t      stats_timer;
     pc_timer_t      maintenance_timer;
     ns_rx_packet_t  rx_packet;
     char            switch_type[16];
+    thread_t       *shm_tid;
+    netpkt_t        shm_rx_pktv[SWITCH_PKT_BATCH];
+    volatile int    shm_running;
 #ifdef _WIN32
     HANDLE sock_event;
 #endif
@@ -168,13 +174,27 @@ stats_timer(void *priv)
     /* Get the device state structure. */
     net_netswitch_t *netswitch = priv;
     const NSCONN    *nsconn    = netswitch->nsconn;
+    /* Frames from the shared memory ring are counted by its own receiver
+       thread, the switch connection counter is only bumped by the poller */
+    u_long           rx_packets = nsconn->stats.total_rx_packets;
+    if (nsconn->shm != NULL)
+        rx_packets += (u_long) ns_shm_get_stats(nsconn->shm)->rx_frames;
     net_switch_log("Max (frame / packet)  TX (%zu/%zu)  RX (%zu/%zu)\n",
            nsconn->stats.max_tx_frame, nsconn->stats.max_tx_packet,
            nsconn->stats.max_rx_frame, nsconn->stats.max_rx_packet);
     net_switch_log("Last ethertype (TX/RX) (%02x%02x/%02x%02x)\n", nsconn->stats.last_tx_ethertype[0], nsconn->stats.last_tx_ethertype[1],
            nsconn->stats.last_rx_ethertype[0], nsconn->stats.last_rx_ethertype[1]);
-    net_switch_log("Packet totals (all/tx/rx/would fragment/max vec) (%zu/%zu/%zu/%zu/%i)\n", nsconn->stats.total_tx_packets + nsconn->stats.total_rx_packets,
-           nsconn->stats.total_tx_packets, nsconn->stats.total_rx_packets, nsconn->stats.total_fragments, nsconn->stats.max_vec);
+    net_switch_log("Packet totals (all/tx/rx/would fragment/max vec) (%zu/%zu/%zu/%zu/%i)\n", nsconn->stats.total_tx_packets + rx_packets,
+           nsconn->stats.total_tx_packets, rx_packets, nsconn->stats.total_fragments, nsconn->stats.max_vec);
+    if (nsconn->shm != NULL) {
+        /* Run two instances on the same group to benchmark the shared memory transport */
+        const struct ns_shm_stats *shm_stats = ns_shm_get_stats(nsconn->shm);
+        net_switch_log("Shared memory frames (tx/rx/dropped) (%llu/%llu/%llu), latency (avg/max) (%lld/%lld ns)\n",
+               (unsigned long long) shm_stats->tx_frames, (unsigned long long) shm_stats->rx_frames,
+               (unsigned long long) shm_stats->dropped,
+               (long long) (shm_stats->rx_frames ? (shm_stats->latency_total / (int64_t) shm_stats->rx_frames) : 0),
+               (long long) shm_stats->latency_max);
+    }
     net_switch_log("---\n");
     /* Restart the timer */
     timer_on_auto(&netswitch->stats_timer, 60000000);
@@ -208,6 +228,69 @@ maintenance_timer(void *priv)
     timer_on_auto(&netswitch->maintenance_timer, SWITCH_KEEPALIVE_INTERVAL);
 }
 
+/*
+ * Accept packets that are
+   * Unicast for us
+   * Broadcasts that are not from us
+   * All other packets *if* promiscuous mode is enabled (excluding our own)
+ * Accepted packets are left for the caller to queue in a batch.
+ */
+static bool
+net_netswitch_rx(net_netswitch_t *net_netswitch, const netpkt_t *pkt)
+{
+    const char *switch_type = net_netswitch->switch_type;
+
+    data_packet_info_t packet_info = get_data_packet_info(pkt, net_netswitch->mac_addr);
+#if defined(NET_PRINT_PACKET_RX) || defined(NET_PRINT_PACKET_ALL)
+    print_packet(*pkt);
+#endif
+    if (packet_info.is_packet_for_me || (packet_info.is_broadcast && !packet_info.is_packet_from_me)) {
+        /* Temporarily disable log suppression for packet logging */
+        pclog_toggle_suppr();
+        net_switch_log("%s Net Switch: RX: %s\n", switch_type, packet_info.printable);
+        pclog_toggle_suppr();
+        return true;
+    } else if (packet_info.is_packet_from_me) {
+        net_switch_log("%s Net Switch: Got my own packet... ignoring\n", switch_type);
+    } else {
+        /* Not our packet. Pass it along if promiscuous mode is enabled. */
+        if (ns_flags(net_netswitch->nsconn) & FLAGS_PROMISC) {
+            net_switch_log("%s Net Switch: Got packet from %s (not mine, promiscuous is set, getting)\n", switch_type, packet_info.src_mac_h);
+            return true;
+        } else {
+            net_switch_log("%s Net Switch: RX: %s (not mine, dest %s != %s, promiscuous not set, ignoring)\n", switch_type, packet_info.printable, packet_info.dest_mac_h, packet_info.my_mac_h);
+        }
+    }
+
+    return false;
+}
+
+/* Receives raw frames from same-host peers over the shared memory ring */
+static void
+net_netswitch_shm_thread(void *priv)
+{
+    net_netswitch_t *net_netswitch = (net_netswitch_t *) priv;
+    NSCONN          *nsconn        = (NSCONN *) net_netswitch->nsconn;
+
+    net_switch_log("%s Net Switch: shared memory receiver started.\n", net_netswitch->switch_type);
+
+    while (net_netswitch->shm_running) {
+        /* Wait for the first frame, then drain everything else that is
+           already on the ring and queue it in one go */
+        int packets = 0;
+        int timeout = SWITCH_SHM_WAIT;
+        while ((packets < SWITCH_PKT_BATCH) && ns_shm_recv(nsconn->shm, &net_netswitch->shm_rx_pktv[packets], timeout)) {
+            timeout = 0;
+            if (net_netswitch_rx(net_netswitch, &net_netswitch->shm_rx_pktv[packets]))
+                packets++;
+        }
+        if (packets > 0)
+            network_rx_put_pktv(net_netswitch->card, net_netswitch->shm_rx_pktv, packets);
+    }
+
+    net_switch_log("%s Net Switch: shared memory receiver stopped.\n", net_netswitch->switch_type);
+}
+
 /* Lots of #ifdef madness here thanks to the polling differences on windows */
 static void
 net_netswitch_thread(void *priv)
@@ -215,6 +298,7 @@ net_netswitch_thread(void *priv)
     net_netswitch_t *net_netswitch = (net_netswitch_t *) priv;
     NSCONN         *nsconn        = (NSCONN *) net_netswitch->nsconn;
     bool status;
+    int  rx_packets;
     char switch_type[32];
     snprintf(switch_type, sizeof(switch_type), "%s", nsconn->switch_type == SWITCH_TYPE_REMOTE ? "Remote" : "Local");
 
@@ -280,15 +364,24 @@ net_netswitch_thread(void *priv)
                     pclog_toggle_suppr();
                     print_packet(net_netswitch->pktv[i]);
 #endif
+                    /* Raw frames for same-host peers, no protobuf needed */
+                    if (nsconn->shm != NULL) {
+                        ns_shm_send(nsconn->shm, &net_netswitch->pktv[i]);
+                        continue;
+                    }
                     /* Only send if we're in a connected state (always true for local) */
                     if(ns_connected(net_netswitch->nsconn)) {
-                        const ssize_t nc = ns_send_pb(net_netswitch->nsconn, &net_netswitch->pktv[i], 0);
+                        const ssize_t nc = ns_send_pb(net_netswitch->nsconn, &net_netswitch->pktv[i], NS_SEND_BATCH);
                         if (nc < 1) {
                             perror("Got");
                             net_switch_log("%s Net Switch: Problem, no bytes sent. Got back %i\n", switch_type, nc);
                         }
                     }
                 }
+                /* Everything popped above goes out in as few syscalls as possible */
+                if (!ns_send_flush(net_netswitch->nsconn)) {
+                    net_switch_log("%s Net Switch: Problem sending the batch\n", switch_type);
+                }
 #ifdef _WIN32
                 break;
             case NET_EVENT_RX:
@@ -297,43 +390,29 @@ net_netswitch_thread(void *priv)
         if (pfd[NET_EVENT_RX].revents & POLLIN) {
 #endif
 
-                /* Packets are available for reading */
-                status = ns_recv_pb(net_netswitch->nsconn, &net_netswitch->rx_packet, NET_MAX_FRAME, 0);
-                if (!status) {
-                    net_switch_log("Receive packet failed. Skipping.\n");
-                    continue;
-                }
+                /* Packets are available for reading. Decode everything the
+                   backend pulled in with this wakeup and queue it in one go */
+                rx_packets = 0;
+                do {
+                    status = ns_recv_pb(net_netswitch->nsconn, &net_netswitch->rx_packet, NET_MAX_FRAME, 0);
+                    if (!status) {
+                        net_switch_log("Receive packet failed. Skipping.\n");
+                        continue;
+                    }
 
-                /* These types are handled in the backend and don't need to be considered */
-                if (is_control_packet(&net_netswitch->rx_packet) || is_fragment_packet(&net_netswitch->rx_packet)) {
-                    continue;
-                }
-                data_packet_info_t packet_info = get_data_packet_info(&net_netswitch->rx_packet.pkt, net_netswitch->mac_addr);
-#if defined(NET_PRINT_PACKET_RX) || defined(NET_PRINT_PACKET_ALL)
-                print_packet(net_netswitch->rx_packet.pkt);
-#endif
-                /*
-                 * Accept packets that are
-                   * Unicast for us
-                   * Broadcasts that are not from us
-                   * All other packets *if* promiscuous mode is enabled (excluding our own)
-                 */
-                if (packet_info.is_packet_for_me || (packet_info.is_broadcast && !packet_info.is_packet_from_me)) {
-                    /* Temporarily disable log suppression for packet logging */
-                    pclog_toggle_suppr();
-                    net_switch_log("%s Net Switch: RX: %s\n", switch_type, packet_info.printable);
-                    pclog_toggle_suppr();
-                    network_rx_put_pkt(net_netswitch->card, &net_netswitch->rx_packet.pkt);
-                } else if (packet_info.is_packet_from_me) {
-                    net_switch_log("%s Net Switch: Got my own packet... ignoring\n", switch_type);
-                } else {
-                    /* Not our packet. Pass it along if promiscuous mode is enabled. */
-                    if (ns_flags(net_netswitch->nsconn) & FLAGS_PROMISC) {
-                        net_switch_log("%s Net Switch: Got packet from %s (not mine, promiscuous is set, getting)\n", switch_type, packet_info.src_mac_h);
-                        network_rx_put_pkt(net_netswitch->card, &net_netswitch->rx_packet.pkt);
-                    } else {
-                        net_switch_log("%s Net Switch: RX: %s (not mine, dest %s != %s, promiscuous not set, ignoring)\n", switch_type, packet_info.printable, packet_info.dest_mac_h, packet_info.my_mac_h);
+                    /* These types are handled in the backend and don't need to be considered */
+                    if (is_control_packet(&net_netswitch->rx_packet) || is_fragment_packet(&net_netswitch->rx_packet)) {
+                        continue;
                     }
+                    if (net_netswitch_rx(net_netswitch, &net_netswitch->rx_packet.pkt)) {
+                        /* Swap the buffers so the next decode doesn't overwrite this one */
+                        const netpkt_t pkt                   = net_netswitch->rx_pktv[rx_packets];
+                        net_netswitch->rx_pktv[rx_packets++] = net_netswitch->rx_packet.pkt;
+                        net_netswitch->rx_packet.pkt         = pkt;
+                    }
+                } while (ns_rx_pending(nsconn) && (rx_packets < SWITCH_PKT_BATCH));
+                if (rx_packets > 0) {
+                    network_rx_put_pktv(net_netswitch->card, net_netswitch->rx_pktv, rx_packets);
                 }
 #ifdef _WIN32
                 break;
@@ -402,6 +481,8 @@ net_netswitch_init(const netcard_t *card, const uint8_t *mac_addr, void *priv, c
     /* The remote switch hostname */
     strncpy(ns_args.nrs_hostname, netcard->nrs_hostname, sizeof(ns_args.nrs_hostname) - 1);
     ns_args.nrs_hostname[127] = 0x00;
+    /* Same-host peers can use shared memory for data frames (local mode only) */
+    ns_args.shm = !!netcard->switch_shm;
 
     net_switch_log("%s Net Switch: Starting up virtual switch with group %d, flags %d\n", net_netswitch->switch_type, ns_args.group, ns_args.flags);
 
@@ -423,7 +504,9 @@ net_netswitch_init(const netcard_t *card, const uint8_t *mac_addr, void *priv, c
     }
 
     for (int i = 0; i < SWITCH_PKT_BATCH; i++) {
-        net_netswitch->pktv[i].data = calloc(1, NET_MAX_FRAME);
+        net_netswitch->pktv[i].data        = calloc(1, NET_MAX_FRAME);
+        net_netswitch->rx_pktv[i].data     = calloc(1, NET_MAX_FRAME);
+        net_netswitch->shm_rx_pktv[i].data = calloc(1, NET_MAX_FRAME);
     }
     net_netswitch->rx_packet.pkt.data = calloc(1, NET_MAX_FRAME);
 
@@ -433,6 +516,10 @@ net_netswitch_init(const netcard_t *card, const uint8_t *mac_addr, void *priv, c
     net_netswitch->sock_event = CreateEvent(NULL, FALSE, FALSE, NULL);
 #endif
     net_netswitch->poll_tid = thread_create(net_netswitch_thread, net_netswitch);
+    if (((NSCONN *) net_netswitch->nsconn)->shm != NULL) {
+        net_netswitch->shm_running = 1;
+        net_netswitch->shm_tid     = thread_create(net_netswitch_shm_thread, net_netswitch);
+    }
 
     /* Add the timers */
 #ifdef ENABLE_NET_SWITCH_STATS
@@ -473,8 +560,16 @@ net_netswitch_close(void *priv)
     thread_wait(net_netswitch->poll_tid);
     net_switch_log("%s Net Switch: thread ended\n", net_netswitch->switch_type);
 
+    if (net_netswitch->shm_tid != NULL) {
+        net_netswitch->shm_running = 0;
+        ns_shm_wake(((NSCONN *) net_netswitch->nsconn)->shm);
+        thread_wait(net_netswitch->shm_tid);
+    }
+
     for (int i = 0; i < SWITCH_PKT_BATCH; i++) {
         free(net_netswitch->pktv[i].data);
+        free(net_netswitch->rx_pktv[i].data);
+        free(net_netswitch->shm_rx_pktv[i].data);
     }
     free(net_netswitch->rx_packet.pkt.data);
 
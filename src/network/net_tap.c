@@ -83,7 +83,7 @@ typedef struct net_tap_t {
     thread_t  *poll_tid;
     net_evt_t  tx_event;
     net_evt_t  stop_event;
-    netpkt_t   pkt_rx;
+    netpkt_t   pkts_rx[NET_QUEUE_LEN];
     netpkt_t   pkts_tx[NET_QUEUE_LEN];
 } net_tap_t;
 
@@ -166,13 +166,24 @@ static void net_tap_thread(void *priv) {
             }
         }
         if (pfd[NET_EVENT_RX].revents & POLLIN) {
-            ssize_t len = read(tap->fd, tap->pkt_rx.data, NET_MAX_FRAME);
-            if (len < 0) {
-                tap_log("TAP: read error: %s\n", strerror(errno));
-                continue;
+            // The fd is non-blocking: drain every frame that is already
+            // queued on the tap device and hand them over in one go.
+            int packets = 0;
+            while (packets < NET_QUEUE_LEN) {
+                netpkt_t *pkt = &tap->pkts_rx[packets];
+                ssize_t len = read(tap->fd, pkt->data, NET_MAX_FRAME);
+                if (len < 0) {
+                    if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+                        tap_log("TAP: read error: %s\n", strerror(errno));
+                    }
+                    break;
+                }
+                pkt->len = len;
+                packets++;
+            }
+            if (packets > 0) {
+                network_rx_put_pktv(tap->card, tap->pkts_rx, packets);
             }
-            tap->pkt_rx.len = len;
-            network_rx_put_pkt(tap->card, &tap->pkt_rx);
         }
         if (pfd[NET_EVENT_STOP].revents & POLLIN) {
             net_event_clear(&tap->stop_event);
@@ -193,9 +204,9 @@ void net_tap_close(void *priv)
     thread_wait(tap->poll_tid);
     tap_log("TAP: poll thread exited.\n");
     for(int i = 0; i < NET_QUEUE_LEN; i++) {
+        free(tap->pkts_rx[i].data);
         free(tap->pkts_tx[i].data);
     }
-    free(tap->pkt_rx.data);
     if (tap->fd >= 0) {
         close(tap->fd);
     }
@@ -320,13 +331,10 @@ net_tap_init(
     if (!tap) {
         goto alloc_fail;
     }
-    tap->pkt_rx.data = calloc(1, NET_MAX_FRAME);
-    if (!tap->pkt_rx.data) {
-        goto alloc_fail;
-    }
     for(int i = 0; i < NET_QUEUE_LEN; i++) {
+        tap->pkts_rx[i].data = calloc(1, NET_MAX_FRAME);
         tap->pkts_tx[i].data = calloc(1, NET_MAX_FRAME);
-        if (!tap->pkts_tx[i].data) {
+        if (!tap->pkts_rx[i].data || !tap->pkts_tx[i].data) {
             goto alloc_fail;
         }
     }
@@ -30,6 +30,7 @@
 #if !defined(_WIN32)
 #include <poll.h>
 #include <unistd.h>
+#include <sys/socket.h>
 #else
 #error VDE is not supported under windows
 #endif
@@ -68,7 +69,7 @@ typedef struct net_vde_t {
     thread_t  *poll_tid;            // Polling thread
     net_evt_t  tx_event;            // Packets to transmit event
     net_evt_t  stop_event;          // Stop thread event
-    netpkt_t   pkt;                 // Packet read/sent
+    netpkt_t   pkts_rx[VDE_PKT_BATCH]; // Packets received in one wakeup
     netpkt_t   pktv[VDE_PKT_BATCH]; // Packet queue
     uint8_t    mac_addr[6];         // MAC Address
 } net_vde_t;
@@ -159,11 +160,21 @@ static void net_vde_thread(void *priv) {
             }
         }
 
-        // Packets are available for reading. Read packet and queue it
+        // Packets are available for reading. Drain everything that is
+        // already waiting on the socket and queue it as one batch
         if (pfd[NET_EVENT_RX].revents & POLLIN) {
-            int nc = f_vde_recv(vde->vdeconn, vde->pkt.data, NET_MAX_FRAME, 0);
-            vde->pkt.len = nc;
-            network_rx_put_pkt(vde->card, &vde->pkt);
+            int packets = 0;
+            while (packets < VDE_PKT_BATCH) {
+                netpkt_t *pkt = &vde->pkts_rx[packets];
+                ssize_t   nc  = f_vde_recv(vde->vdeconn, pkt->data, NET_MAX_FRAME,
+                                           packets ? MSG_DONTWAIT : 0);
+                if (nc <= 0)
+                    break;
+                pkt->len = nc;
+                packets++;
+            }
+            if (packets > 0)
+                network_rx_put_pktv(vde->card, vde->pkts_rx, packets);
         }
 
         // We have been told to close
@@ -219,8 +230,8 @@ void net_vde_close(void *priv) {
     // Free all the mallocs!
     for(i=0;i<VDE_PKT_BATCH; i++) {
         free(vde->pktv[i].data);
+        free(vde->pkts_rx[i].data);
     }
-    free(vde->pkt.data);
     f_vde_close(vde->vdeconn);
     net_event_close(&vde->tx_event);
     net_event_close(&vde->stop_event);
@@ -288,9 +299,9 @@ void *net_vde_init(const netcard_t *card, const uint8_t *mac_addr, void *priv, c
     vde_log("VDE: Socket opened (%s).\n", socket_name);
 
     for(uint8_t i = 0; i < VDE_PKT_BATCH; i++) {
-        vde->pktv[i].data = calloc(1, NET_MAX_FRAME);
+        vde->pktv[i].data    = calloc(1, NET_MAX_FRAME);
+        vde->pkts_rx[i].data = calloc(1, NET_MAX_FRAME);
     }
-    vde->pkt.data = calloc(1,NET_MAX_FRAME);
     net_event_init(&vde->tx_event);
     net_event_init(&vde->stop_event);
     vde->poll_tid = thread_create(net_vde_thread, vde);     // Fire up the read-write thread!
@@ -12,6 +12,7 @@
  *
  *          Copyright 2024 cold-brewed
  */
+#define _GNU_SOURCE
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -266,10 +267,27 @@ ns_open(struct ns_open_args *open_args) {
     /* Protocol version */
     conn->version = NS_PROTOCOL_VERSION;
 
+    /* Datagram batches for the polling thread */
+    conn->rx_batch = calloc(NS_BATCH_LENGTH, NET_SWITCH_BUFFER_LENGTH);
+    conn->tx_batch = calloc(NS_BATCH_LENGTH, NET_SWITCH_BUFFER_LENGTH);
+    if(conn->rx_batch == NULL || conn->tx_batch == NULL) {
+        errno=ENOMEM;
+        goto fail;
+    }
+
     if(!ns_socket_setup(conn)) {
         goto fail;
     }
 
+    /* Data frames for same-host peers can bypass the sockets entirely.
+     * Control messages keep using the multicast socket. */
+    if(open_args->shm && (conn->switch_type == SWITCH_TYPE_LOCAL)) {
+        conn->shm = ns_shm_open(open_args->group, conn->client_id);
+        if(conn->shm == NULL) {
+            net_switch_log("Shared memory transport unavailable, using multicast for data\n");
+        }
+    }
+
     if (conn->switch_type == SWITCH_TYPE_REMOTE) {
         /* Perhaps one day do the entire handshake process here */
         if(!ns_send_control(conn, MessageType_MESSAGE_TYPE_CONNECT_REQUEST)) {
@@ -305,6 +323,8 @@ fail:
     for (int i = 0; i < FRAGMENT_BUFFER_LENGTH; i++) {
         free(conn->fragment_buffer[i]);
     }
+    free(conn->rx_batch);
+    free(conn->tx_batch);
     return NULL;
 }
 
@@ -341,6 +361,116 @@ ns_sock_send(NSCONN *conn,const void *buf, const size_t len, const int flags) {
     }
 }
 
+/* Pull in as many datagrams as are already waiting on the socket, up to NS_BATCH_LENGTH.
+ * Only called once the caller has been told the socket is readable. */
+static int
+ns_sock_recv_batch(NSCONN *conn) {
+    int count = 0;
+
+    conn->rx_batch_count = 0;
+    conn->rx_batch_next  = 0;
+
+    if (!fd_valid(conn->fddata)) {
+        errno=EBADF;
+        return -1;
+    }
+
+#if defined(__linux__)
+    struct mmsghdr msgs[NS_BATCH_LENGTH];
+    struct iovec   iovs[NS_BATCH_LENGTH];
+    memset(msgs, 0, sizeof(msgs));
+    for (int i = 0; i < NS_BATCH_LENGTH; i++) {
+        iovs[i].iov_base           = conn->rx_batch + (i * NET_SWITCH_BUFFER_LENGTH);
+        iovs[i].iov_len            = NET_SWITCH_BUFFER_LENGTH;
+        msgs[i].msg_hdr.msg_iov    = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    count = recvmmsg(conn->fddata, msgs, NS_BATCH_LENGTH, MSG_DONTWAIT, NULL);
+    if (count < 0) {
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        conn->rx_batch_len[i] = msgs[i].msg_len;
+    }
+#elif !defined(_WIN32)
+    while (count < NS_BATCH_LENGTH) {
+        const ssize_t nc = recv(conn->fddata, conn->rx_batch + (count * NET_SWITCH_BUFFER_LENGTH), NET_SWITCH_BUFFER_LENGTH, MSG_DONTWAIT);
+        if (nc < 0) {
+            break;
+        }
+        conn->rx_batch_len[count++] = nc;
+    }
+    if (count == 0) {
+        return -1;
+    }
+#else
+    /* No batched receive on winsock, one datagram per wakeup */
+    const int nc = recv(conn->fddata, (char *) conn->rx_batch, NET_SWITCH_BUFFER_LENGTH, 0);
+    if (nc < 0) {
+        return -1;
+    }
+    conn->rx_batch_len[count++] = nc;
+#endif
+
+    conn->rx_batch_count = count;
+    return count;
+}
+
+bool
+ns_rx_pending(const NSCONN *conn) {
+    return conn->rx_batch_next < conn->rx_batch_count;
+}
+
+bool
+ns_send_flush(NSCONN *conn) {
+    const int count = conn->tx_batch_count;
+    bool      ret   = true;
+
+    if (count == 0) {
+        return true;
+    }
+    conn->tx_batch_count = 0;
+
+    if (!fd_valid(conn->fddata)) {
+        errno=EBADF;
+        return false;
+    }
+
+#if defined(__linux__)
+    struct mmsghdr msgs[NS_BATCH_LENGTH];
+    struct iovec   iovs[NS_BATCH_LENGTH];
+    memset(msgs, 0, sizeof(msgs));
+    for (int i = 0; i < count; i++) {
+        iovs[i].iov_base            = conn->tx_batch + (i * NET_SWITCH_BUFFER_LENGTH);
+        iovs[i].iov_len             = conn->tx_batch_len[i];
+        msgs[i].msg_hdr.msg_name    = &conn->outaddr;
+        msgs[i].msg_hdr.msg_namelen = sizeof(conn->outaddr);
+        msgs[i].msg_hdr.msg_iov     = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen  = 1;
+    }
+    /* sendmmsg can stop short, keep going until everything is out */
+    int sent = 0;
+    while (sent < count) {
+        const int nc = sendmmsg(conn->fdout, &msgs[sent], count - sent, 0);
+        if (nc <= 0) {
+            net_switch_log("Error sending batch on the socket: %s\n", strerror(errno));
+            ret = false;
+            break;
+        }
+        sent += nc;
+    }
+#else
+    for (int i = 0; i < count; i++) {
+        if (sendto(conn->fdout, (const char *) conn->tx_batch + (i * NET_SWITCH_BUFFER_LENGTH), conn->tx_batch_len[i], 0,
+                   (struct sockaddr *) &conn->outaddr, sizeof(conn->outaddr)) < 0) {
+            ret = false;
+        }
+    }
+#endif
+
+    return ret;
+}
+
 ssize_t
 ns_send_pb(NSCONN *conn, const netpkt_t *packet,int flags) {
 
@@ -364,8 +494,16 @@ ns_send_pb(NSCONN *conn, const netpkt_t *packet,int flags) {
     const uint32_t fragment_sequence = conn->sequence;
     const int64_t  packet_timestamp  = ns_get_current_millis();
     for (uint8_t fragment_index = 0; fragment_index < fragment_count; fragment_index++) {
-        uint8_t buffer[NET_SWITCH_BUFFER_LENGTH];
-        pb_ostream_t stream = pb_ostream_from_buffer(buffer, sizeof(buffer));
+        uint8_t  send_buffer[NET_SWITCH_BUFFER_LENGTH];
+        uint8_t *buffer = send_buffer;
+        /* Batched sends are encoded straight into the next free batch slot */
+        if(flags & NS_SEND_BATCH) {
+            if(conn->tx_batch_count == NS_BATCH_LENGTH) {
+                ns_send_flush(conn);
+            }
+            buffer = conn->tx_batch + (conn->tx_batch_count * NET_SWITCH_BUFFER_LENGTH);
+        }
+        pb_ostream_t stream = pb_ostream_from_buffer(buffer, NET_SWITCH_BUFFER_LENGTH);
 #ifdef ENABLE_NET_SWITCH_PB_FILE_DEBUG
         uint8_t file_buffer[NET_SWITCH_BUFFER_LENGTH];
         /* file_stream used for debugging and writing the message to a file */
@@ -421,8 +559,14 @@ ns_send_pb(NSCONN *conn, const netpkt_t *packet,int flags) {
             return -1;
         }
 
-        /* Send on the socket */
-        const ssize_t nc = ns_sock_send(conn, buffer, stream.bytes_written, 0);
+        /* Send on the socket, or leave it in the batch for ns_send_flush */
+        ssize_t nc;
+        if(flags & NS_SEND_BATCH) {
+            conn->tx_batch_len[conn->tx_batch_count++] = stream.bytes_written;
+            nc = (ssize_t) stream.bytes_written;
+        } else {
+            nc = ns_sock_send(conn, buffer, stream.bytes_written, 0);
+        }
         if(!nc) {
             net_switch_log("Error sending data on the socket\n");
             errno=EBADF;
@@ -586,16 +730,21 @@ ns_recv_pb(NSCONN *conn, ns_rx_packet_t *packet,size_t len,int flags) {
     NetworkMessage  network_message = NetworkMessage_init_zero;
     ns_rx_packet_t *ns_packet       = packet;
 
-    uint8_t buffer[NET_SWITCH_BUFFER_LENGTH];
-
     /* TODO: Use the passed len? Most likely not needed */
-    const ssize_t nc = ns_sock_recv(conn, buffer, NET_SWITCH_BUFFER_LENGTH, 0);
+    /* Refill the batch once everything from the previous receive is decoded */
+    if(!ns_rx_pending(conn) && (ns_sock_recv_batch(conn) <= 0)) {
+        net_switch_log("Error receiving data on the socket\n");
+        errno=EBADF;
+        return false;
+    }
+    const uint8_t *buffer = conn->rx_batch + (conn->rx_batch_next * NET_SWITCH_BUFFER_LENGTH);
+    const ssize_t  nc     = (ssize_t) conn->rx_batch_len[conn->rx_batch_next++];
     if(!nc) {
         net_switch_log("Error receiving data on the socket\n");
         errno=EBADF;
         return false;
     }
-    pb_istream_t stream = pb_istream_from_buffer(buffer, sizeof(buffer));
+    pb_istream_t stream = pb_istream_from_buffer(buffer, nc);
 
     if (!pb_decode_delimited(&stream, NetworkMessage_fields, &network_message)) {
         /* Decode failed */
@@ -820,6 +969,8 @@ ns_close(NSCONN *conn) {
     }
     /* No need to check the return here as we're closing out */
     ns_send_control(conn, MessageType_MESSAGE_TYPE_LEAVE);
+    ns_shm_close(conn->shm);
+    conn->shm = NULL;
     for (int i = 0; i < FRAGMENT_BUFFER_LENGTH; i++) {
         if (conn->fragment_buffer[i]->size > 0) {
             free(conn->fragment_buffer[i]->data);
@@ -827,6 +978,9 @@ ns_close(NSCONN *conn) {
         }
         free(conn->fragment_buffer[i]);
     }
+    free(conn->rx_batch);
+    free(conn->tx_batch);
+    conn->rx_batch = conn->tx_batch = NULL;
     close(conn->fddata);
     close(conn->fdout);
     return 0;
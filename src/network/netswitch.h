@@ -61,6 +61,10 @@
 #define MAX_PRINTABLE_MAC 32
 /* Maximum hostname length for a remote switch host */
 #define MAX_HOSTNAME 128
+/* Datagrams moved per recvmmsg / sendmmsg call */
+#define NS_BATCH_LENGTH 32
+/* ns_send_pb flag: queue the datagrams until ns_send_flush instead of sending right away */
+#define NS_SEND_BATCH (1 << 0)
 
 typedef enum {
     FLAGS_NONE    =      0,
@@ -86,12 +90,28 @@ struct ns_open_args {
     char      *client_id;
     uint8_t    mac_addr[6];
     char       nrs_hostname[MAX_HOSTNAME];
+    /* Local mode only: exchange frames with same-host peers through shared memory */
+    bool       shm;
 };
 
 struct nsconn;
 
 typedef struct nsconn NSCONN;
 
+struct ns_shm;
+
+typedef struct ns_shm ns_shm_t;
+
+struct ns_shm_stats {
+    uint64_t tx_frames;
+    uint64_t rx_frames;
+    /* Frames lost because this peer fell too far behind */
+    uint64_t dropped;
+    /* Send to receive latency, in ns */
+    int64_t  latency_total;
+    int64_t  latency_max;
+};
+
 struct ns_stats {
     size_t  max_tx_frame;
     size_t  max_tx_packet;
@@ -156,6 +176,17 @@ struct nsconn {
      */
     uint16_t           remote_source_port;
     ns_fragment_t      *fragment_buffer[FRAGMENT_BUFFER_LENGTH];
+    /* Shared memory transport for data frames, NULL if not in use */
+    ns_shm_t           *shm;
+    /* Datagrams received in one go, waiting to be decoded by ns_recv_pb */
+    uint8_t            *rx_batch;
+    size_t              rx_batch_len[NS_BATCH_LENGTH];
+    int                 rx_batch_count;
+    int                 rx_batch_next;
+    /* Encoded datagrams waiting for ns_send_flush */
+    uint8_t            *tx_batch;
+    size_t              tx_batch_len[NS_BATCH_LENGTH];
+    int                 tx_batch_count;
 };
 
 typedef struct {
@@ -218,6 +249,9 @@ int ns_pollfd(const NSCONN *conn);
  * and have the output placed in the packet struct */
 bool ns_recv_pb(NSCONN *conn, ns_rx_packet_t *packet,size_t len,int flags);
 
+/* Are there datagrams left over from the last receive batch? */
+bool ns_rx_pending(const NSCONN *conn);
+
 /* Do not call directly! Used internally */
 ssize_t ns_sock_recv(const NSCONN *conn,void *buf,size_t len,int flags);
 
@@ -225,6 +259,9 @@ ssize_t ns_sock_recv(const NSCONN *conn,void *buf,size_t len,int flags);
 * and have the output placed in the packet struct */
 ssize_t ns_send_pb(NSCONN *conn, const netpkt_t *packet,int flags);
 
+/* Send everything queued with NS_SEND_BATCH */
+bool ns_send_flush(NSCONN *conn);
+
 /* Send control messages */
 bool ns_send_control(NSCONN *conn, MessageType type);
 
@@ -279,6 +316,25 @@ bool fd_valid(int fd);
 /* Wrapping increment for the sequence number */
 bool seq_increment(NSCONN *conn);
 
+/* Attach to the shared memory ring for a local switch group */
+ns_shm_t *ns_shm_open(uint8_t group, uint32_t client_id);
+
+/* Send a raw frame to the other peers on the ring */
+bool ns_shm_send(ns_shm_t *shm, const netpkt_t *pkt);
+
+/* Receive a raw frame from another peer on the ring, waiting up to timeout ms.
+ * Returns false if nothing arrived in time */
+bool ns_shm_recv(ns_shm_t *shm, netpkt_t *pkt, int timeout);
+
+/* Wake up anyone waiting in ns_shm_recv */
+void ns_shm_wake(ns_shm_t *shm);
+
+/* Detach from the ring */
+void ns_shm_close(ns_shm_t *shm);
+
+/* Transport statistics */
+const struct ns_shm_stats *ns_shm_get_stats(const ns_shm_t *shm);
+
 #ifdef ENABLE_NET_SWITCH_LOG
 static void
 net_switch_log(const char *fmt, ...)
@@ -0,0 +1,390 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          Network Switch shared memory transport
+ *
+ *          Local switch peers on the same host can exchange raw frames
+ *          through a ring in a named shared memory segment (one per
+ *          switch group) instead of protobuf-encoded multicast datagrams.
+ *          Control messages (join/leave/keepalive) still travel over the
+ *          multicast socket.
+ *
+ *          The ring behaves like a hub: every frame is visible to every
+ *          peer, each peer keeps its own read cursor, and peers that fall
+ *          more than a ring's worth of frames behind lose the oldest ones,
+ *          just like a congested switch port would. Slots are protected by
+ *          a sequence number so a reader can detect a slot that was
+ *          overwritten while it was being copied out.
+ *
+ *          The segment is all zeros when created, which is a valid empty
+ *          ring, so peers never have to race to initialize it.
+ *
+ * Authors: 86Box developers
+ *
+ *          Copyright 2026 86Box developers.
+ */
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#ifndef _WIN32
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+#ifdef __linux__
+#    include <limits.h>
+#    include <linux/futex.h>
+#    include <sys/syscall.h>
+#endif
+
+#define HAVE_STDARG_H
+#include <86box/86box.h>
+#include <86box/device.h>
+#include <86box/thread.h>
+#include <86box/timer.h>
+#include <86box/network.h>
+#include <86box/plat_unused.h>
+#include "netswitch.h"
+
+/* Must be a power of 2 */
+#define NS_SHM_RING_SLOTS 256
+#define NS_SHM_RING_MASK  (NS_SHM_RING_SLOTS - 1)
+/* "86NS" */
+#define NS_SHM_MAGIC      0x534e3638
+/* Bump whenever the layout below changes */
+#define NS_SHM_VERSION    1
+/* How many times to spin on a slot that is still being written */
+#define NS_SHM_SPIN_COUNT 64
+
+typedef struct {
+    /* Ticket + 1 once the slot holds a complete frame, 0 while it is written */
+    _Atomic uint64_t seq;
+    uint32_t         client_id;
+    uint32_t         len;
+    /* Monotonic host time (in ns) the frame was sent at, for latency stats */
+    int64_t          stamp;
+    uint8_t          data[NET_MAX_FRAME];
+} ns_shm_slot_t;
+
+typedef struct {
+    _Atomic uint32_t magic;
+    _Atomic uint32_t version;
+    /* Next ticket to hand out to a sender */
+    _Atomic uint64_t head;
+    /* Bumped on every published frame, readers sleep on it */
+    _Atomic uint32_t doorbell;
+    /* Number of readers sleeping on the doorbell */
+    _Atomic uint32_t sleepers;
+    ns_shm_slot_t    slots[NS_SHM_RING_SLOTS];
+} ns_shm_ring_t;
+
+struct ns_shm {
+    char           name[32];
+    uint32_t       client_id;
+    ns_shm_ring_t *ring;
+    /* Next ticket this peer will read */
+    uint64_t       cursor;
+    struct ns_shm_stats stats;
+#ifndef _WIN32
+    int            fd;
+#endif
+};
+
+#ifndef _WIN32
+static int64_t
+ns_shm_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((int64_t) ts.tv_sec * 1000000000LL) + ts.tv_nsec;
+}
+
+/* Sleep until the doorbell moves away from bell, or timeout (ms) expires */
+static void
+ns_shm_wait(ns_shm_t *shm, uint32_t bell, int timeout)
+{
+#ifdef __linux__
+    struct timespec ts;
+
+    ts.tv_sec  = timeout / 1000;
+    ts.tv_nsec = (timeout % 1000) * 1000000L;
+
+    atomic_fetch_add(&shm->ring->sleepers, 1);
+    /* Not FUTEX_PRIVATE_FLAG, the doorbell is shared between processes */
+    syscall(SYS_futex, &shm->ring->doorbell, FUTEX_WAIT, bell, &ts, NULL, 0);
+    atomic_fetch_sub(&shm->ring->sleepers, 1);
+#else
+    /* No cross-process futex here, fall back to polling */
+    struct timespec ts = { 0, 1000000L };
+
+    (void) timeout;
+    if (atomic_load(&shm->ring->doorbell) == bell)
+        nanosleep(&ts, NULL);
+#endif
+}
+
+static void
+ns_shm_ring_doorbell(ns_shm_t *shm)
+{
+    atomic_fetch_add(&shm->ring->doorbell, 1);
+#ifdef __linux__
+    /* Only pay for the syscall if somebody is actually asleep */
+    if (atomic_load(&shm->ring->sleepers) > 0)
+        syscall(SYS_futex, &shm->ring->doorbell, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#endif
+}
+
+ns_shm_t *
+ns_shm_open(uint8_t group, uint32_t client_id)
+{
+    ns_shm_t *shm;
+    uint32_t  magic = 0;
+
+    if ((shm = calloc(1, sizeof(ns_shm_t))) == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    snprintf(shm->name, sizeof(shm->name), "/86box-netswitch-%02d", group);
+    shm->client_id = client_id;
+
+    shm->fd = shm_open(shm->name, O_RDWR | O_CREAT, 0600);
+    if (shm->fd < 0) {
+        net_switch_log("Net Switch: shm_open(%s) failed: %s\n", shm->name, strerror(errno));
+        free(shm);
+        return NULL;
+    }
+
+    /* Every peer sizes the segment the same way, so this is idempotent */
+    if (ftruncate(shm->fd, sizeof(ns_shm_ring_t)) < 0) {
+        net_switch_log("Net Switch: ftruncate(%s) failed: %s\n", shm->name, strerror(errno));
+        goto fail;
+    }
+
+    shm->ring = mmap(NULL, sizeof(ns_shm_ring_t), PROT_READ | PROT_WRITE, MAP_SHARED, shm->fd, 0);
+    if (shm->ring == MAP_FAILED) {
+        net_switch_log("Net Switch: mmap(%s) failed: %s\n", shm->name, strerror(errno));
+        shm->ring = NULL;
+        goto fail;
+    }
+
+    /* First one in stamps the segment, everyone else checks the layout */
+    if (!atomic_compare_exchange_strong(&shm->ring->magic, &magic, NS_SHM_MAGIC) && (magic != NS_SHM_MAGIC)) {
+        net_switch_log("Net Switch: %s is not a switch segment\n", shm->name);
+        goto fail;
+    }
+    /* A version of zero means the creator has not stamped it yet */
+    if (magic == 0)
+        atomic_store(&shm->ring->version, NS_SHM_VERSION);
+    else if ((atomic_load(&shm->ring->version) != NS_SHM_VERSION) &&
+             (atomic_load(&shm->ring->version) != 0)) {
+        net_switch_log("Net Switch: %s has an incompatible layout version %u\n",
+                       shm->name, atomic_load(&shm->ring->version));
+        goto fail;
+    }
+
+    /* Start at the current head, frames sent before we joined are not ours */
+    shm->cursor = atomic_load(&shm->ring->head);
+
+    net_switch_log("Net Switch: attached to shared memory ring %s at ticket %llu\n",
+                   shm->name, (unsigned long long) shm->cursor);
+
+    return shm;
+
+fail:
+    if (shm->ring != NULL)
+        munmap(shm->ring, sizeof(ns_shm_ring_t));
+    close(shm->fd);
+    free(shm);
+    errno = EINVAL;
+    return NULL;
+}
+
+bool
+ns_shm_send(ns_shm_t *shm, const netpkt_t *pkt)
+{
+    uint64_t       ticket;
+    ns_shm_slot_t *slot;
+
+    if ((pkt->len <= 0) || (pkt->len > NET_MAX_FRAME))
+        return false;
+
+    ticket = atomic_fetch_add(&shm->ring->head, 1);
+    slot   = &shm->ring->slots[ticket & NS_SHM_RING_MASK];
+
+    /* Invalidate the slot before touching the payload */
+    atomic_store_explicit(&slot->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    slot->client_id = shm->client_id;
+    slot->len       = pkt->len;
+    slot->stamp     = ns_shm_now();
+    memcpy(slot->data, pkt->data, pkt->len);
+
+    atomic_store_explicit(&slot->seq, ticket + 1, memory_order_release);
+
+    ns_shm_ring_doorbell(shm);
+
+    shm->stats.tx_frames++;
+
+    return true;
+}
+
+bool
+ns_shm_recv(ns_shm_t *shm, netpkt_t *pkt, int timeout)
+{
+    ns_shm_ring_t *ring  = shm->ring;
+    int            spins = 0;
+    ns_shm_slot_t *slot;
+    uint64_t       head;
+    uint64_t       seq;
+    uint32_t       bell;
+    uint32_t       client_id;
+    uint32_t       len;
+    int64_t        stamp;
+
+    while (1) {
+        bell = atomic_load(&ring->doorbell);
+        head = atomic_load(&ring->head);
+
+        if (shm->cursor == head) {
+            /* Nothing new, go to sleep */
+            if (timeout == 0)
+                return false;
+            ns_shm_wait(shm, bell, timeout);
+            if (atomic_load(&ring->head) == shm->cursor)
+                return false;
+            continue;
+        }
+
+        /* Fell behind by more than a whole ring, skip the lost frames */
+        if ((head - shm->cursor) > NS_SHM_RING_SLOTS) {
+            shm->stats.dropped += (head - shm->cursor) - NS_SHM_RING_SLOTS;
+            shm->cursor = head - NS_SHM_RING_SLOTS;
+        }
+
+        slot = &ring->slots[shm->cursor & NS_SHM_RING_MASK];
+        seq  = atomic_load_explicit(&slot->seq, memory_order_acquire);
+
+        if (seq != (shm->cursor + 1)) {
+            if ((seq > (shm->cursor + 1)) || ((head - shm->cursor) > (NS_SHM_RING_SLOTS / 2))) {
+                /* Overwritten already, or the sender died halfway through */
+                shm->stats.dropped++;
+                shm->cursor++;
+                continue;
+            }
+
+            /* Still being written, give the sender a moment */
+            if (++spins < NS_SHM_SPIN_COUNT)
+                continue;
+            spins = 0;
+            ns_shm_wait(shm, bell, 1);
+            continue;
+        }
+
+        client_id = slot->client_id;
+        len       = slot->len;
+        stamp     = slot->stamp;
+        if (len > NET_MAX_FRAME)
+            len = NET_MAX_FRAME;
+        memcpy(pkt->data, slot->data, len);
+
+        /* Make sure nobody recycled the slot while we were copying */
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&slot->seq, memory_order_relaxed) != seq) {
+            shm->stats.dropped++;
+            shm->cursor++;
+            continue;
+        }
+
+        shm->cursor++;
+
+        /* Our own frames come back around too */
+        if (client_id == shm->client_id)
+            continue;
+
+        pkt->len = (int) len;
+
+        shm->stats.rx_frames++;
+        stamp = ns_shm_now() - stamp;
+        shm->stats.latency_total += stamp;
+        if (stamp > shm->stats.latency_max)
+            shm->stats.latency_max = stamp;
+
+        return true;
+    }
+}
+
+void
+ns_shm_wake(ns_shm_t *shm)
+{
+#ifdef __linux__
+    /* Spurious for the other peers, they will just go back to sleep */
+    syscall(SYS_futex, &shm->ring->doorbell, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#else
+    (void) shm;
+#endif
+}
+
+void
+ns_shm_close(ns_shm_t *shm)
+{
+    if (shm == NULL)
+        return;
+
+    /* The segment is left in place for the other peers in the group */
+    munmap(shm->ring, sizeof(ns_shm_ring_t));
+    close(shm->fd);
+    free(shm);
+}
+#else
+ns_shm_t *
+ns_shm_open(UNUSED(uint8_t group), UNUSED(uint32_t client_id))
+{
+    net_switch_log("Net Switch: the shared memory transport is not available on this platform\n");
+    errno = ENOSYS;
+    return NULL;
+}
+
+bool
+ns_shm_send(UNUSED(ns_shm_t *shm), UNUSED(const netpkt_t *pkt))
+{
+    return false;
+}
+
+bool
+ns_shm_recv(UNUSED(ns_shm_t *shm), UNUSED(netpkt_t *pkt), UNUSED(int timeout))
+{
+    return false;
+}
+
+void
+ns_shm_wake(UNUSED(ns_shm_t *shm))
+{
+    /* Nothing to do */
+}
+
+void
+ns_shm_close(UNUSED(ns_shm_t *shm))
+{
+    /* Nothing to do */
+}
+#endif
+
+const struct ns_shm_stats *
+ns_shm_get_stats(const ns_shm_t *shm)
+{
+    return &shm->stats;
+}
@@ -721,6 +721,23 @@ network_rx_put_pkt(netcard_t *card, netpkt_t *pkt)
     return ret;
 }
 
+/* Queue a batch of received packets, taking the lock only once. */
+int
+network_rx_put_pktv(netcard_t *card, netpkt_t *pkt_vec, int vec_size)
+{
+    int pkt_count = 0;
+
+    thread_wait_mutex(card->rx_mutex);
+    for (int i = 0; i < vec_size; i++) {
+        if (network_queue_put_swap(&card->queues[NET_QUEUE_RX], pkt_vec))
+            pkt_count++;
+        pkt_vec++;
+    }
+    thread_release_mutex(card->rx_mutex);
+
+    return pkt_count;
+}
+
 void
 network_connect(int id, int connect)
 {
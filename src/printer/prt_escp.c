@@ -64,6 +64,7 @@
 #include <86box/pit.h>
 #include <86box/path.h>
 #include <86box/plat.h>
+#include <86box/thread.h>
 #include <86box/ui.h>
 #include <86box/lpt.h>
 #include <86box/video.h>
@@ -86,6 +87,11 @@
 #define PAGE_CPI     10.0 /* standard 10 cpi */
 #define PAGE_LPI     6.0  /* standard 6 lpi */
 
+/* Page image formats. */
+#define PAGE_FORMAT_PNG_FAST 0 /* PNG, fastest compression */
+#define PAGE_FORMAT_PNG_BEST 1 /* PNG, best compression */
+#define PAGE_FORMAT_PPM      2 /* uncompressed PPM */
+
 /* FreeType library handles - global so they can be shared. */
 FT_Library ft_lib = NULL;
 
@@ -253,8 +259,25 @@ typedef struct escp_t {
     uint8_t ctrl;
 
     PALETTE palcol;
+
+    /* page output */
+    int      page_format;
+    uint8_t *spare_pixels; /* blank buffer handed back by the output worker */
+    mutex_t *spare_mutex;
 } escp_t;
 
+/* A finished page on its way to the output worker. */
+typedef struct escp_page_t {
+    escp_t  *dev;
+    char     path[1024];
+    int      format;
+    uint16_t w;
+    uint16_t h;
+    uint16_t pitch;
+    uint8_t *pixels;
+    PALETTE  palcol;
+} escp_page_t;
+
 static void
 update_font(escp_t *dev);
 static void
@@ -347,35 +370,122 @@ escp_log(const char *fmt, ...)
 #    define escp_log(fmt, ...)
 #endif
 
-/* Dump the current page into a formatted file. */
+/* Write a page as a binary (P6) PPM image file. */
+static void
+write_ppm(escp_page_t *pg)
+{
+    uint8_t *row;
+    uint8_t *pix;
+    FILE    *fp;
+
+    fp = plat_fopen(pg->path, "wb");
+    if (fp == NULL) {
+        escp_log("ESC/P: unable to create page file '%s'\n", pg->path);
+        return;
+    }
+
+    fprintf(fp, "P6\n%i %i\n255\n", pg->w, pg->h);
+
+    row = (uint8_t *) malloc((size_t) pg->w * 3);
+    for (uint16_t y = 0; y < pg->h; y++) {
+        pix = pg->pixels + ((size_t) y * pg->pitch);
+        for (uint16_t x = 0; x < pg->w; x++) {
+            row[(x * 3)]     = pg->palcol[pix[x]].r;
+            row[(x * 3) + 1] = pg->palcol[pix[x]].g;
+            row[(x * 3) + 2] = pg->palcol[pix[x]].b;
+        }
+        fwrite(row, 1, (size_t) pg->w * 3, fp);
+    }
+    free(row);
+
+    fclose(fp);
+}
+
+/* Output worker: encode a page, then recycle its buffer as the spare. */
+static void
+write_page(void *priv)
+{
+    escp_page_t *pg  = (escp_page_t *) priv;
+    escp_t      *dev = pg->dev;
+
+    if (pg->format == PAGE_FORMAT_PPM)
+        write_ppm(pg);
+    else
+        png_write_rgb(pg->path, pg->pixels, pg->w, pg->h, pg->pitch, pg->palcol,
+                      (pg->format == PAGE_FORMAT_PNG_BEST) ? 9 : 1);
+
+    /* Clear the buffer here, so the emulation thread does not have to. */
+    memset(pg->pixels, 0x00, (size_t) pg->pitch * pg->h);
+
+    thread_wait_mutex(dev->spare_mutex);
+    if (dev->spare_pixels == NULL) {
+        dev->spare_pixels = pg->pixels;
+        pg->pixels        = NULL;
+    }
+    thread_release_mutex(dev->spare_mutex);
+
+    free(pg->pixels);
+    free(pg);
+}
+
+/*
+ * Dump the current page into a formatted file.
+ *
+ * The page buffer is handed over to the output worker as-is and, unless
+ * this is the last page, replaced with a blank one, so no copy is made and
+ * the guest does not have to wait for the image to be compressed.
+ */
 static void
-dump_page(escp_t *dev)
+dump_page(escp_t *dev, int last)
 {
-    char path[1024];
+    escp_page_t *pg = (escp_page_t *) malloc(sizeof(escp_page_t));
+    uint8_t     *pixels;
+
+    pg->dev    = dev;
+    pg->format = dev->page_format;
+    pg->w      = dev->page->w;
+    pg->h      = dev->page->h;
+    pg->pitch  = dev->page->pitch;
+    pg->pixels = dev->page->pixels;
+    memcpy(pg->palcol, dev->palcol, sizeof(PALETTE));
+    strcpy(pg->path, dev->pagepath);
+    strcat(pg->path, dev->page_fn);
+
+    if (last)
+        pixels = NULL;
+    else {
+        thread_wait_mutex(dev->spare_mutex);
+        pixels            = dev->spare_pixels;
+        dev->spare_pixels = NULL;
+        thread_release_mutex(dev->spare_mutex);
 
-    strcpy(path, dev->pagepath);
-    strcat(path, dev->page_fn);
-    png_write_rgb(path, dev->page->pixels, dev->page->w, dev->page->h, dev->page->pitch, dev->palcol);
+        if (pixels == NULL)
+            pixels = (uint8_t *) calloc((size_t) dev->page->pitch * dev->page->h, 1);
+    }
+    dev->page->pixels = pixels;
+
+    prt_output_queue(write_page, pg);
 }
 
 static void
 new_page(escp_t *dev, int8_t save, int8_t resetx)
 {
-    /* Dump the current page if needed. */
+    /* Dump the current page if needed, this leaves us with a blank one. */
     if (save && dev->page)
-        dump_page(dev);
+        dump_page(dev, 0);
     if (resetx)
         dev->curr_x = dev->left_margin;
 
     /* Clear page. */
     dev->curr_y = dev->top_margin;
     if (dev->page) {
+        if (!save)
+            memset(dev->page->pixels, 0x00, (size_t) dev->page->pitch * dev->page->h);
         dev->page->dirty = 0;
-        memset(dev->page->pixels, 0x00, (size_t) dev->page->pitch * dev->page->h);
     }
 
     /* Make the page's file name. */
-    plat_tempfile(dev->page_fn, NULL, ".png");
+    plat_tempfile(dev->page_fn, NULL, (dev->page_format == PAGE_FORMAT_PPM) ? ".ppm" : ".png");
 }
 
 static void
@@ -2017,6 +2127,14 @@ escp_init(void *lpt)
     dev->page_height = PAGE_HEIGHT;
     dev->dpi         = PAGE_DPI;
 
+    /* Each port has its own settings. */
+    device_context_inst(&prt_escp_device, (lpt != NULL) ? (((lpt_t *) lpt)->id + 1) : 1);
+    dev->page_format = device_get_config_int("page_format");
+    device_context_restore();
+
+    dev->spare_mutex = thread_create_mutex();
+    prt_output_init();
+
     /* Create 8-bit grayscale buffer for the page. */
     dev->page         = (psurface_t *) malloc(sizeof(psurface_t));
     dev->page->w      = (int) (dev->dpi * dev->page_width);
@@ -2075,20 +2193,41 @@ escp_close(void *priv)
     if (dev->page != NULL) {
         /* Print last page if it contains data. */
         if (dev->page->dirty)
-            dump_page(dev);
+            dump_page(dev, 1);
 
         if (dev->page->pixels != NULL)
             free(dev->page->pixels);
         free(dev->page);
     }
 
+    /* Wait for the output worker to finish with our pages. */
+    prt_output_close();
+    free(dev->spare_pixels);
+    thread_close_mutex(dev->spare_mutex);
+
     FT_Done_Face(dev->fontface);
     free(dev);
 }
 
 // clang-format off
-#if 0
 static const device_config_t lpt_prt_escp_config[] = {
+    {
+        .name           = "page_format",
+        .description    = "Page Format",
+        .type           = CONFIG_SELECTION,
+        .default_string = NULL,
+        .default_int    = PAGE_FORMAT_PNG_FAST,
+        .file_filter    = NULL,
+        .spinner        = { 0 },
+        .selection      = {
+            { .description = "PNG (fast)",         .value = PAGE_FORMAT_PNG_FAST },
+            { .description = "PNG (smallest)",     .value = PAGE_FORMAT_PNG_BEST },
+            { .description = "PPM (uncompressed)", .value = PAGE_FORMAT_PPM      },
+            { .description = ""                                                  }
+        },
+        .bios           = { { 0 } }
+    },
+#if 0
     {
         .name           = "paper_size",
         .description    = "Paper Size",
@@ -2104,9 +2243,9 @@ static const device_config_t lpt_prt_escp_config[] = {
         },
         .bios           = { { 0 } }
     },
+#endif
     { .name = "", .description = "", .type = CONFIG_END }
 };
-#endif
 // clang-format on
 
 const device_t prt_escp_device = {
@@ -2120,11 +2259,7 @@ const device_t prt_escp_device = {
     .available     = NULL,
     .speed_changed = NULL,
     .force_redraw  = NULL,
-#if 0
     .config        = lpt_prt_escp_config
-#else
-    .config        = NULL
-#endif
 };
 
 const lpt_device_t lpt_prt_escp_device = {
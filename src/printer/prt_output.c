@@ -0,0 +1,215 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Background page output worker shared by the printers.
+ *
+ *          Encoding a page (PNG compression, Ghostscript conversion,
+ *          ...) is far too slow to be done on the emulation thread, so
+ *          the printers hand finished pages over to this worker, which
+ *          processes them in submission order.
+ *
+ * Authors: 86Box developers
+ *
+ *          Copyright 2026 86Box developers.
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <wchar.h>
+#define HAVE_STDARG_H
+#include <86box/86box.h>
+#include <86box/thread.h>
+#include <86box/plat_unused.h>
+#include <86box/printer.h>
+
+typedef struct prt_output_job_t {
+    void (*func)(void *priv);
+    void *priv;
+
+    struct prt_output_job_t *next;
+} prt_output_job_t;
+
+static struct {
+    int users;
+    int running;
+    int pending;
+
+    prt_output_job_t *head;
+    prt_output_job_t *tail;
+
+    thread_t *thread;
+    event_t  *wake_event;
+    event_t  *idle_event;
+    mutex_t  *mutex;
+} prt_output;
+
+#ifdef ENABLE_PRT_OUTPUT_LOG
+int prt_output_do_log = ENABLE_PRT_OUTPUT_LOG;
+
+static void
+prt_output_log(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (prt_output_do_log) {
+        va_start(ap, fmt);
+        pclog_ex(fmt, ap);
+        va_end(ap);
+    }
+}
+#else
+#    define prt_output_log(fmt, ...)
+#endif
+
+static prt_output_job_t *
+prt_output_pop(void)
+{
+    prt_output_job_t *job;
+
+    thread_wait_mutex(prt_output.mutex);
+    job = prt_output.head;
+    if (job != NULL) {
+        prt_output.head = job->next;
+        if (prt_output.head == NULL)
+            prt_output.tail = NULL;
+    }
+    thread_release_mutex(prt_output.mutex);
+
+    return job;
+}
+
+static void
+prt_output_thread(UNUSED(void *priv))
+{
+    prt_output_job_t *job;
+
+    while (1) {
+        thread_wait_event(prt_output.wake_event, -1);
+        thread_reset_event(prt_output.wake_event);
+
+        while ((job = prt_output_pop()) != NULL) {
+            job->func(job->priv);
+            free(job);
+
+            thread_wait_mutex(prt_output.mutex);
+            if (--prt_output.pending == 0)
+                thread_set_event(prt_output.idle_event);
+            thread_release_mutex(prt_output.mutex);
+        }
+
+        if (!prt_output.running)
+            break;
+    }
+}
+
+/* Start the worker, or add a user to the already running one. */
+void
+prt_output_init(void)
+{
+    if (prt_output.users++ > 0)
+        return;
+
+    prt_output.head    = NULL;
+    prt_output.tail    = NULL;
+    prt_output.pending = 0;
+    prt_output.running = 1;
+
+    prt_output.mutex      = thread_create_mutex();
+    prt_output.wake_event = thread_create_event();
+    prt_output.idle_event = thread_create_event();
+    thread_set_event(prt_output.idle_event);
+
+    prt_output.thread = thread_create(prt_output_thread, NULL);
+
+    prt_output_log("PRT: page output worker started\n");
+}
+
+/* Drop a user, stopping the worker once all queued pages are written. */
+void
+prt_output_close(void)
+{
+    if ((prt_output.users == 0) || (--prt_output.users > 0)) {
+        prt_output_wait();
+        return;
+    }
+
+    prt_output.running = 0;
+    thread_set_event(prt_output.wake_event);
+    thread_wait(prt_output.thread);
+    prt_output.thread = NULL;
+
+    thread_destroy_event(prt_output.idle_event);
+    thread_destroy_event(prt_output.wake_event);
+    thread_close_mutex(prt_output.mutex);
+
+    prt_output_log("PRT: page output worker stopped\n");
+}
+
+/*
+ * Queue a job for the worker. The job owns priv from now on and is
+ * responsible for freeing it. Without a running worker (or if too many
+ * pages are already in flight) we throttle the caller rather than let
+ * the page buffers pile up in memory.
+ */
+void
+prt_output_queue(void (*func)(void *priv), void *priv)
+{
+    prt_output_job_t *job;
+
+    if (prt_output.users == 0) {
+        func(priv);
+        return;
+    }
+
+    if (prt_output_pending() >= PRT_OUTPUT_MAX_PENDING)
+        prt_output_wait();
+
+    job       = (prt_output_job_t *) malloc(sizeof(prt_output_job_t));
+    job->func = func;
+    job->priv = priv;
+    job->next = NULL;
+
+    thread_wait_mutex(prt_output.mutex);
+    if (prt_output.tail != NULL)
+        prt_output.tail->next = job;
+    else
+        prt_output.head = job;
+    prt_output.tail = job;
+    if (prt_output.pending++ == 0)
+        thread_reset_event(prt_output.idle_event);
+    thread_release_mutex(prt_output.mutex);
+
+    thread_set_event(prt_output.wake_event);
+}
+
+int
+prt_output_pending(void)
+{
+    int ret;
+
+    if (prt_output.users == 0)
+        return 0;
+
+    thread_wait_mutex(prt_output.mutex);
+    ret = prt_output.pending;
+    thread_release_mutex(prt_output.mutex);
+
+    return ret;
+}
+
+/* Wait for all queued jobs to complete. */
+void
+prt_output_wait(void)
+{
+    if (prt_output.users == 0)
+        return;
+
+    thread_wait_event(prt_output.idle_event, -1);
+}
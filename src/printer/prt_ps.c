@@ -32,6 +32,7 @@
 #include <86box/plat.h>
 #include <86box/plat_dynld.h>
 #include <86box/ui.h>
+#include <86box/printer.h>
 #include <86box/prt_devs.h>
 #include "cpu.h"
 
@@ -144,37 +145,35 @@ pulse_timer(void *priv)
     timer_disable(&dev->pulse_timer);
 }
 
+/* A finished job on its way to the output worker. */
+typedef struct ps_job_t {
+    bool pcl;
+    char input_fn[1024];
+    char output_fn[1024];
+} ps_job_t;
+
 static int
-convert_to_pdf(ps_t *dev)
+convert_to_pdf(ps_job_t *job)
 {
     volatile int code, arg = 0;
     void        *instance = NULL;
-    char         input_fn[1024];
-    char         output_fn[1024];
     char        *gsargv[11];
 
-    strcpy(input_fn, dev->printer_path);
-    path_slash(input_fn);
-    strcat(input_fn, dev->filename);
-
-    strcpy(output_fn, input_fn);
-    strcpy(output_fn + strlen(output_fn) - (dev->pcl ? 4 : 3), ".pdf");
-
     gsargv[arg++] = "";
     gsargv[arg++] = "-dNOPAUSE";
     gsargv[arg++] = "-dBATCH";
     gsargv[arg++] = "-dSAFER";
     gsargv[arg++] = "-sDEVICE=pdfwrite";
-    if (dev->pcl) {
+    if (job->pcl) {
         gsargv[arg++] = "-LPCL";
         gsargv[arg++] = "-lPCL5E";
     }
     gsargv[arg++] = "-q";
     gsargv[arg++] = "-o";
-    gsargv[arg++] = output_fn;
-    gsargv[arg++] = input_fn;
+    gsargv[arg++] = job->output_fn;
+    gsargv[arg++] = job->input_fn;
 
-    code = gsapi_new_instance(&instance, dev);
+    code = gsapi_new_instance(&instance, job);
     if (code < 0)
         return code;
 
@@ -191,13 +190,43 @@ convert_to_pdf(ps_t *dev)
     gsapi_delete_instance(instance);
 
     if (code == 0)
-        plat_remove(input_fn);
+        plat_remove(job->input_fn);
     else
-        plat_remove(output_fn);
+        plat_remove(job->output_fn);
 
     return code;
 }
 
+/* Output worker: run the finished job through Ghostscript. */
+static void
+convert_job(void *priv)
+{
+    ps_job_t *job = (ps_job_t *) priv;
+
+    if (ghostscript_handle != NULL)
+        convert_to_pdf(job);
+
+    free(job);
+}
+
+/* Hand the finished job over to the output worker. */
+static void
+finish_job(ps_t *dev)
+{
+    ps_job_t *job = (ps_job_t *) malloc(sizeof(ps_job_t));
+
+    job->pcl = dev->pcl;
+
+    strcpy(job->input_fn, dev->printer_path);
+    path_slash(job->input_fn);
+    strcat(job->input_fn, dev->filename);
+
+    strcpy(job->output_fn, job->input_fn);
+    strcpy(job->output_fn + strlen(job->output_fn) - (dev->pcl ? 4 : 3), ".pdf");
+
+    prt_output_queue(convert_job, job);
+}
+
 static void
 write_buffer(ps_t *dev, bool finish)
 {
@@ -232,7 +261,7 @@ write_buffer(ps_t *dev, bool finish)
 
     if (finish) {
         if (ghostscript_handle != NULL)
-            convert_to_pdf(dev);
+            finish_job(dev);
 
         dev->filename[0] = 0;
     }
@@ -434,6 +463,8 @@ ps_init(void *lpt)
     timer_add(&dev->pulse_timer, pulse_timer, dev, 0);
     timer_add(&dev->timeout_timer, timeout_timer, dev, 0);
 
+    prt_output_init();
+
     reset_ps(dev);
 
     return dev;
@@ -482,6 +513,8 @@ pcl_init(void *lpt)
     timer_add(&dev->pulse_timer, pulse_timer, dev, 0);
     timer_add(&dev->timeout_timer, timeout_timer, dev, 0);
 
+    prt_output_init();
+
     reset_ps(dev);
 
     return dev;
@@ -499,6 +532,9 @@ ps_close(void *priv)
     if (dev->buffer[0] != 0)
         write_buffer(dev, true);
 
+    /* Ghostscript must stay loaded until the output worker is done. */
+    prt_output_close();
+
     if (ghostscript_handle != NULL) {
         dynld_close(ghostscript_handle);
         ghostscript_handle = NULL;
@@ -133,13 +133,22 @@ typedef struct prnt_t {
     uint8_t ctrl;
 } prnt_t;
 
-/* Dump the current page into a formatted file. */
+/* A finished page on its way to the output worker. */
+typedef struct prnt_page_t {
+    char     filename[1024];
+    uint16_t w;
+    uint16_t lines;
+    char    *chars;
+} prnt_page_t;
+
+/* Output worker: append a page to the output file. */
 static void
-dump_page(prnt_t *dev)
+write_page(void *priv)
 {
-    char     path[1024];
-    uint8_t  ch;
-    FILE    *fp;
+    prnt_page_t *pg = (prnt_page_t *) priv;
+    char         path[1024];
+    uint8_t      ch;
+    FILE        *fp;
 
     /* Create the full path for this file. */
     memset(path, 0x00, sizeof(path));
@@ -147,12 +156,14 @@ dump_page(prnt_t *dev)
     if (!plat_dir_check(path))
         plat_dir_create(path);
     path_slash(path);
-    strcat(path, dev->filename);
+    strcat(path, pg->filename);
 
     /* Create the file. */
     fp = plat_fopen(path, "a");
     if (fp == NULL) {
         // ERRLOG("PRNT: unable to create print page '%s'\n", path);
+        free(pg->chars);
+        free(pg);
         return;
     }
     fseek(fp, 0, SEEK_END);
@@ -161,9 +172,9 @@ dump_page(prnt_t *dev)
     if (ftell(fp) != 0)
         fputc('\014', fp);
 
-    for (uint16_t y = 0; y < dev->curr_y; y++) {
-        for (uint16_t x = 0; x < dev->page->w; x++) {
-            ch = dev->page->chars[(y * dev->page->w) + x];
+    for (uint16_t y = 0; y < pg->lines; y++) {
+        for (uint16_t x = 0; x < pg->w; x++) {
+            ch = pg->chars[(y * pg->w) + x];
             if (ch == 0x00) {
                 /* End of line marker. */
                 fputc('\n', fp);
@@ -176,17 +187,39 @@ dump_page(prnt_t *dev)
 
     /* All done, close the file. */
     fclose(fp);
+
+    free(pg->chars);
+    free(pg);
+}
+
+/*
+ * Dump the current page into a formatted file. The character buffer is
+ * handed over to the output worker, and replaced with a blank one.
+ */
+static void
+dump_page(prnt_t *dev)
+{
+    prnt_page_t *pg = (prnt_page_t *) malloc(sizeof(prnt_page_t));
+
+    strcpy(pg->filename, dev->filename);
+    pg->w     = dev->page->w;
+    pg->lines = dev->curr_y;
+    pg->chars = dev->page->chars;
+
+    dev->page->chars = (char *) calloc(dev->page->w * dev->page->h, 1);
+
+    prt_output_queue(write_page, pg);
 }
 
 static void
 new_page(prnt_t *dev)
 {
-    /* Dump the current page if needed. */
+    /* Dump the current page if needed, this leaves us with a blank one. */
     if (dev->page->dirty)
         dump_page(dev);
+    else
+        memset(dev->page->chars, 0x00, dev->page->h * dev->page->w);
 
-    /* Clear page. */
-    memset(dev->page->chars, 0x00, dev->page->h * dev->page->w);
     dev->curr_y      = 0;
     dev->page->dirty = 0;
 }
@@ -466,6 +499,8 @@ prnt_init(void *lpt)
     /* Initialize parameters. */
     reset_printer(dev);
 
+    prt_output_init();
+
     /* Create a page buffer. */
     dev->page        = (psurface_t *) malloc(sizeof(psurface_t));
     dev->page->w     = dev->max_chars;
@@ -497,6 +532,9 @@ prnt_close(void *priv)
         free(dev->page);
     }
 
+    /* Wait for the output worker to finish with our pages. */
+    prt_output_close();
+
     free(dev);
 }
 
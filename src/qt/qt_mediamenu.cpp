@@ -597,9 +597,13 @@ MediaMenu::cdromMount(int i, int dir, const QString &arg)
     else if (dir == 1)
         filename = QFileDialog::getExistingDirectory(parentWidget);
     else {
+        QStringList extensions = { "iso", "cue", "mds" };
+#ifdef USE_LIBCHDR
+        extensions << "chd";
+#endif
         filename = QFileDialog::getOpenFileName(parentWidget, QString(),
                                                 QString(),
-            tr("CD-ROM images") % util::DlgFilter({ "iso", "cue", "mds" }) % tr("All files") % util::DlgFilter({ "*" }, true));
+            tr("CD-ROM images") % util::DlgFilter(extensions) % tr("All files") % util::DlgFilter({ "*" }, true));
     }
 
     if (filename.isEmpty())
@@ -813,12 +813,11 @@ OpenGLRenderer::OpenGLRenderer(QWidget *parent)
     , renderTimer(new QTimer(this))
 {
     connect(renderTimer, &QTimer::timeout, this, [this]() { this->render(); } );
-    imagebufs[0] = std::unique_ptr<uint8_t>(new uint8_t[2048 * 2048 * 4]);
-    imagebufs[1] = std::unique_ptr<uint8_t>(new uint8_t[2048 * 2048 * 4]);
 
-    buf_usage = std::vector<std::atomic_flag>(2);
-    buf_usage[0].clear();
-    buf_usage[1].clear();
+    /* The image buffers themselves are set up in initializeBuffers(). */
+    buf_usage = std::vector<std::atomic_flag>(BUFFERCOUNT);
+    for (auto &flag : buf_usage)
+        flag.clear();
 
     QSurfaceFormat format;
 
@@ -846,6 +845,71 @@ OpenGLRenderer::OpenGLRenderer(QWidget *parent)
 
 OpenGLRenderer::~OpenGLRenderer() { finalize(); }
 
+void
+OpenGLRenderer::initializeExtensions()
+{
+#ifndef NO_BUFFER_STORAGE
+    if (context->hasExtension("GL_ARB_buffer_storage") || context->hasExtension("GL_EXT_buffer_storage")) {
+        glBufferStorage = (PFNGLBUFFERSTORAGEEXTPROC_LOCAL) context->getProcAddress(context->hasExtension("GL_ARB_buffer_storage") ? "glBufferStorage" : "glBufferStorageEXT");
+        hasBufferStorage = (glBufferStorage != nullptr);
+    }
+#endif
+    ogl3_log("Persistent pixel buffers: %s\n", hasBufferStorage ? "yes" : "no");
+}
+
+void
+OpenGLRenderer::initializeBuffers()
+{
+    glw.glGenBuffers(1, &unpackBufferID);
+    glw.glBindBuffer(GL_PIXEL_UNPACK_BUFFER, unpackBufferID);
+
+    if (hasBufferStorage) {
+        /* Create persistent buffer for pixel transfer, the blitter writes
+           frames straight into it. */
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, BUFFERBYTES * BUFFERCOUNT, NULL, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+        unpackBuffer = glw.glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, BUFFERBYTES * BUFFERCOUNT, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+
+        if (unpackBuffer == nullptr) {
+            /* Immutable storage can't be respecified, start over with a fresh buffer. */
+            ogl3_log("Could not map persistent pixel buffer, falling back\n");
+            glw.glDeleteBuffers(1, &unpackBufferID);
+            glw.glGenBuffers(1, &unpackBufferID);
+            glw.glBindBuffer(GL_PIXEL_UNPACK_BUFFER, unpackBufferID);
+            hasBufferStorage = false;
+        }
+    }
+
+    if (!hasBufferStorage) {
+        /* Fallback; create our own buffer. Only the rows covered by each
+           blit are streamed into the pixel buffer. */
+        unpackBuffer = malloc(BUFFERBYTES * BUFFERCOUNT);
+        glw.glBufferData(GL_PIXEL_UNPACK_BUFFER, BUFFERBYTES, NULL, GL_STREAM_DRAW);
+    }
+
+    glw.glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    for (int i = 0; i < BUFFERCOUNT; i++) {
+        imagebufs[i] = (uint8_t *) unpackBuffer + (BUFFERBYTES * i);
+        fences[i]    = nullptr;
+    }
+}
+
+/* Hand an image buffer back to the blitter once the GPU is done reading from it. */
+void
+OpenGLRenderer::releaseBuffer(int buf_idx, bool wait)
+{
+    if (fences[buf_idx] == nullptr)
+        return;
+
+    GLenum ret = glw.glClientWaitSync(fences[buf_idx], GL_SYNC_FLUSH_COMMANDS_BIT, wait ? 1000000000 : 0);
+    if (ret == GL_TIMEOUT_EXPIRED)
+        return;
+
+    glw.glDeleteSync(fences[buf_idx]);
+    fences[buf_idx] = nullptr;
+    buf_usage[buf_idx].clear();
+}
+
 void
 OpenGLRenderer::initialize()
 {
@@ -889,6 +953,10 @@ OpenGLRenderer::initialize()
         glw.glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
         ogl3_log("Max texture size: %dx%d\n", max_texture_size, max_texture_size);
 
+        initializeExtensions();
+
+        initializeBuffers();
+
         glw.glEnable(GL_TEXTURE_2D);
 
         //renderTimer->start(75);
@@ -1126,6 +1194,25 @@ OpenGLRenderer::finalize()
 
     context->makeCurrent(this);
 
+    /* Let pending uploads finish, then keep the blitter away from the buffers. */
+    for (int i = 0; i < BUFFERCOUNT; i++)
+        releaseBuffer(i, true);
+    for (auto &flag : buf_usage)
+        flag.test_and_set();
+
+    if (unpackBufferID) {
+        if (hasBufferStorage) {
+            glw.glBindBuffer(GL_PIXEL_UNPACK_BUFFER, unpackBufferID);
+            glw.glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            glw.glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        } else
+            free(unpackBuffer);
+        glw.glDeleteBuffers(1, &unpackBufferID);
+        unpackBufferID = 0;
+    }
+    unpackBuffer = nullptr;
+    imagebufs.fill(nullptr);
+
     delete_texture(&scene_texture);
 
     if (active_shader) {
@@ -1158,12 +1245,31 @@ OpenGLRenderer::onBlit(int buf_idx, int x, int y, int w, int h)
     source.setRect(x, y, w, h);
 
     glw.glBindTexture(GL_TEXTURE_2D, scene_texture.id);
+    glw.glBindBuffer(GL_PIXEL_UNPACK_BUFFER, unpackBufferID);
     glw.glPixelStorei(GL_UNPACK_ROW_LENGTH, 2048);
-    glw.glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, (GLenum) QOpenGLTexture::BGRA, (GLenum) QOpenGLTexture::UInt32_RGBA8_Rev, (const void *) ((uintptr_t) imagebufs[buf_idx].get() + (uintptr_t) (2048 * 4 * y + x * 4)));
+    if (hasBufferStorage) {
+        /* The frame is already in the mapped buffer, the upload is queued
+           from there and the buffer is returned once its fence signals. */
+        glw.glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, (GLenum) QOpenGLTexture::BGRA, (GLenum) QOpenGLTexture::UInt32_RGBA8_Rev, (const void *) ((uintptr_t) (BUFFERBYTES * buf_idx) + (uintptr_t) (2048 * 4 * y + x * 4)));
+        fences[buf_idx] = glw.glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    } else {
+        /* Orphan the pixel buffer and stream in the blitted rows only; the
+           driver takes its own copy, so the image buffer is free right away. */
+        glw.glBufferData(GL_PIXEL_UNPACK_BUFFER, BUFFERBYTES, NULL, GL_STREAM_DRAW);
+        glw.glBufferSubData(GL_PIXEL_UNPACK_BUFFER, 0, 2048 * 4 * h, imagebufs[buf_idx] + (2048 * 4 * y));
+        glw.glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, (GLenum) QOpenGLTexture::BGRA, (GLenum) QOpenGLTexture::UInt32_RGBA8_Rev, (const void *) ((uintptr_t) (x * 4)));
+        buf_usage[buf_idx].clear();
+    }
     glw.glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glw.glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
     glw.glBindTexture(GL_TEXTURE_2D, 0);
 
-    buf_usage[buf_idx].clear();
+    /* The blitter cycles through the buffers in order, so make sure the next
+       one is available (it is two frames old by now and will rarely block),
+       and return any others that have completed. */
+    for (int i = 1; i < BUFFERCOUNT; i++)
+        releaseBuffer((buf_idx + i) % BUFFERCOUNT, i == 1);
+
     source.setRect(x, y, w, h);
     this->pixelRatio = devicePixelRatio();
     onResize(this->width(), this->height());
@@ -1185,8 +1291,8 @@ OpenGLRenderer::getBuffers()
 {
     std::vector<std::tuple<uint8_t *, std::atomic_flag *>> buffers;
 
-    buffers.push_back(std::make_tuple(imagebufs[0].get(), &buf_usage[0]));
-    buffers.push_back(std::make_tuple(imagebufs[1].get(), &buf_usage[1]));
+    for (int i = 0; i < BUFFERCOUNT; i++)
+        buffers.push_back(std::make_tuple(imagebufs[i], &buf_usage[i]));
 
     return buffers;
 }
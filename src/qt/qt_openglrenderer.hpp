@@ -47,6 +47,18 @@ extern "C"
 #include <86box/qt-glslp-parser.h>
 }
 
+#define BUFFERBYTES  16777216 /* Pixel is 4 bytes. */
+#define BUFFERCOUNT  3        /* How many buffers to use for pixel transfer (2-3 is commonly recommended). */
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#    define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#    define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+typedef void(QOPENGLF_APIENTRYP PFNGLBUFFERSTORAGEEXTPROC_LOCAL)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+
 struct render_data {
     int                 pass;
     struct glsl_shader *shader;
@@ -87,7 +99,8 @@ protected:
 
 private:
 
-    std::array<std::unique_ptr<uint8_t>, 2> imagebufs;
+    std::array<uint8_t *, BUFFERCOUNT> imagebufs {};
+    std::array<GLsync, BUFFERCOUNT>    fences {};
 
     QTimer        *renderTimer;
 
@@ -103,13 +116,18 @@ private:
     struct shader_texture scene_texture;
     glsl_t *active_shader;
 
-    void *unpackBuffer = nullptr;
+    void  *unpackBuffer     = nullptr;
+    GLuint unpackBufferID   = 0;
+    bool   hasBufferStorage = false;
+
+    PFNGLBUFFERSTORAGEEXTPROC_LOCAL glBufferStorage = nullptr;
 
     int glsl_version[2] = { 0, 0 };
 
     void initialize();
     void initializeExtensions();
     void initializeBuffers();
+    void releaseBuffer(int buf_idx, bool wait);
     void applyOptions();
     
     void create_scene_shader();
@@ -23,13 +23,16 @@
 #include <OS.h>
 #endif
 
+#include <cerrno>
 #include <cstdio>
+#include <cstring>
 
 #include <mutex>
 #include <thread>
 #include <memory>
 #include <algorithm>
 #include <map>
+#include <vector>
 
 #include <QDebug>
 
@@ -62,6 +65,7 @@
 #ifdef Q_OS_UNIX
 #    include <pthread.h>
 #    include <sys/mman.h>
+#    include <unistd.h>
 #endif
 
 #include <sys/stat.h>
@@ -452,6 +456,67 @@ plat_munmap(void *ptr, size_t size)
 #endif
 }
 
+void
+plat_mmap_advise(void *ptr, size_t size, int flags)
+{
+#if defined Q_OS_LINUX
+#    ifdef MADV_HUGEPAGE
+    if ((flags & PLAT_MMAP_HUGEPAGE) && madvise(ptr, size, MADV_HUGEPAGE))
+        pclog("Huge pages not available: %s\n", strerror(errno));
+#    endif
+#    ifdef MADV_MERGEABLE
+    if ((flags & PLAT_MMAP_MERGEABLE) && madvise(ptr, size, MADV_MERGEABLE))
+        pclog("Page merging not available: %s\n", strerror(errno));
+#    endif
+#else
+    Q_UNUSED(ptr)
+    Q_UNUSED(size)
+    Q_UNUSED(flags)
+#endif
+}
+
+/* Give the memory back to the host, returns 0 if it now reads as zero. */
+int
+plat_mmap_discard(void *ptr, size_t size)
+{
+#if defined Q_OS_LINUX && defined MADV_DONTNEED
+    return madvise(ptr, size, MADV_DONTNEED) ? -1 : 0;
+#else
+    Q_UNUSED(ptr)
+    Q_UNUSED(size)
+    return -1;
+#endif
+}
+
+int
+plat_mmap_resident(void *ptr, size_t size, size_t *resident)
+{
+#if defined Q_OS_UNIX && !defined Q_OS_HAIKU
+    long   page_size = sysconf(_SC_PAGESIZE);
+    size_t pages     = (size + page_size - 1) / page_size;
+#    if defined Q_OS_LINUX
+    std::vector<unsigned char> vec(pages);
+#    else
+    std::vector<char> vec(pages);
+#    endif
+
+    if (mincore(ptr, size, vec.data()))
+        return -1;
+
+    *resident = 0;
+    for (size_t c = 0; c < pages; c++) {
+        if (vec[c] & 1)
+            *resident += page_size;
+    }
+    return 0;
+#else
+    Q_UNUSED(ptr)
+    Q_UNUSED(size)
+    Q_UNUSED(resident)
+    return -1;
+#endif
+}
+
 extern bool cpu_thread_running;
 void
 plat_pause(int p)
@@ -462,7 +462,7 @@ RendererStack::blit(int x, int y, int w, int h)
 {
     if ((x < 0) || (y < 0) || (w <= 0) || (h <= 0) ||
         (w > 2048) || (h > 2048) || (switchInProgress) ||
-        (monitors[m_monitor_index].target_buffer == NULL) || imagebufs.empty() ||
+        (monitors[m_monitor_index].front_buffer == NULL) || imagebufs.empty() ||
         std::get<std::atomic_flag *>(imagebufs[currentBuf])->test_and_set()) {
         video_blit_complete_monitor(m_monitor_index);
         return;
@@ -474,7 +474,7 @@ RendererStack::blit(int x, int y, int w, int h)
     uint8_t *imagebits = std::get<uint8_t *>(imagebufs[currentBuf]);
     for (int y1 = y; y1 < (y + h); y1++) {
         auto scanline = imagebits + (y1 * rendererWindow->getBytesPerRow()) + (x * 4);
-        video_copy(scanline, &(monitors[m_monitor_index].target_buffer->line[y1][x]), w * 4);
+        video_copy(scanline, &(monitors[m_monitor_index].front_buffer->line[y1][x]), w * 4);
     }
 
     if (monitors[m_monitor_index].mon_screenshots && !rendererTakesScreenshots) {
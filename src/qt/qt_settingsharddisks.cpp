@@ -43,6 +43,9 @@ const int DataBus                = Qt::UserRole;
 const int DataBusChannel         = Qt::UserRole + 1;
 const int DataBusPrevious        = Qt::UserRole + 2;
 const int DataBusChannelPrevious = Qt::UserRole + 3;
+const int DataOverlay            = Qt::UserRole + 4;
+const int DataWriteCache         = Qt::UserRole + 5;
+const int DataFlushTimeout       = Qt::UserRole + 6;
 
 QIcon hard_disk_icon;
 
@@ -97,6 +100,9 @@ addRow(QAbstractItemModel *model, hard_disk_t *hd)
         model->setData(filenameIndex, fileName);
 
     model->setData(filenameIndex, fileName, Qt::UserRole);
+    model->setData(filenameIndex, QString(hd->overlay), DataOverlay);
+    model->setData(filenameIndex, hd->write_cache, DataWriteCache);
+    model->setData(filenameIndex, hd->flush_timeout, DataFlushTimeout);
 
     model->setData(model->index(row, ColumnCylinders), hd->tracks);
     model->setData(model->index(row, ColumnHeads), hd->hpc);
@@ -167,6 +173,10 @@ SettingsHarddisks::save()
 
         QByteArray fileName = idx.siblingAtColumn(ColumnFilename).data(Qt::UserRole).toString().toUtf8();
         strncpy(hdd[i].fn, fileName.data(), sizeof(hdd[i].fn) - 1);
+        QByteArray overlay = idx.siblingAtColumn(ColumnFilename).data(DataOverlay).toString().toUtf8();
+        strncpy(hdd[i].overlay, overlay.data(), sizeof(hdd[i].overlay) - 1);
+        hdd[i].write_cache   = idx.siblingAtColumn(ColumnFilename).data(DataWriteCache).toUInt();
+        hdd[i].flush_timeout = idx.siblingAtColumn(ColumnFilename).data(DataFlushTimeout).toUInt();
         hdd[i].priv = nullptr;
     }
 }
@@ -319,7 +329,9 @@ addDriveFromDialog(Ui::SettingsHarddisks *ui, const HarddiskDialog &dlg)
     hd.hpc      = dlg.heads();
     hd.spt      = dlg.sectors();
     strncpy(hd.fn, fn.data(), sizeof(hd.fn) - 1);
-    hd.speed_preset = dlg.speed();
+    hd.speed_preset  = dlg.speed();
+    hd.write_cache   = HDD_WRITE_CACHE_BACK;
+    hd.flush_timeout = 0;
 
     addRow(ui->tableView->model(), &hd);
     ui->tableView->resizeColumnsToContents();
@@ -223,7 +223,7 @@ SettingsPorts::on_pushButtonConfigureLpt2_clicked()
     int   lptDevice = ui->comboBoxLpt2->currentData().toInt();
     auto *device    = lpt_device_getdevice(lptDevice);
 
-    DeviceConfig::ConfigureDevice(device, 1);
+    DeviceConfig::ConfigureDevice(device, 2);
 }
 
 void
@@ -243,7 +243,7 @@ SettingsPorts::on_pushButtonConfigureLpt3_clicked()
     int   lptDevice = ui->comboBoxLpt3->currentData().toInt();
     auto *device    = lpt_device_getdevice(lptDevice);
 
-    DeviceConfig::ConfigureDevice(device, 1);
+    DeviceConfig::ConfigureDevice(device, 3);
 }
 
 void
@@ -263,7 +263,7 @@ SettingsPorts::on_pushButtonConfigureLpt4_clicked()
     int   lptDevice = ui->comboBoxLpt4->currentData().toInt();
     auto *device    = lpt_device_getdevice(lptDevice);
 
-    DeviceConfig::ConfigureDevice(device, 1);
+    DeviceConfig::ConfigureDevice(device, 4);
 }
 
 void
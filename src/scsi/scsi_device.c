@@ -212,6 +212,49 @@ scsi_device_init(void)
     }
 }
 
+/* Start a new S/G list for a command, keeping the allocated entries. */
+void
+scsi_sg_reset(scsi_sg_list_t *sg, const int transfer_size, const int in, const int out)
+{
+    sg->count         = 0;
+    sg->length        = 0;
+    sg->transfer_size = transfer_size;
+    sg->in            = in;
+    sg->out           = out;
+    sg->done          = 0;
+}
+
+void
+scsi_sg_add(scsi_sg_list_t *sg, const uint32_t addr, const uint32_t len)
+{
+    if (!len)
+        return;
+
+    /* Merge segments that continue each other. */
+    if (sg->count && ((sg->entries[sg->count - 1].addr + sg->entries[sg->count - 1].len) == addr)) {
+        sg->entries[sg->count - 1].len += len;
+        sg->length += len;
+        return;
+    }
+
+    if (sg->count == sg->size) {
+        sg->size    = sg->size ? (sg->size << 1) : 16;
+        sg->entries = (scsi_sg_t *) realloc(sg->entries, sg->size * sizeof(scsi_sg_t));
+    }
+
+    sg->entries[sg->count].addr = addr;
+    sg->entries[sg->count].len  = len;
+    sg->count++;
+    sg->length += len;
+}
+
+void
+scsi_sg_free(scsi_sg_list_t *sg)
+{
+    free(sg->entries);
+    memset(sg, 0x00, sizeof(scsi_sg_list_t));
+}
+
 int
 scsi_device_get_id(uint8_t data)
 {
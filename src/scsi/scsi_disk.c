@@ -22,6 +22,7 @@
 #include <86box/86box.h>
 #include <86box/timer.h>
 #include <86box/device.h>
+#include <86box/dma.h>
 #include <86box/log.h>
 #include <86box/scsi.h>
 #include <86box/scsi_device.h>
@@ -66,6 +67,7 @@ const uint8_t scsi_disk_command_flags[0x100] = {
     [0x2a ... 0x2b] = IMPLEMENTED | CHECK_READY,
     [0x2e]          = IMPLEMENTED | CHECK_READY,
     [0x2f]          = IMPLEMENTED | CHECK_READY | SCSI_ONLY,
+    [0x35]          = IMPLEMENTED | CHECK_READY,
     [0x41]          = IMPLEMENTED | CHECK_READY,
     [0x55]          = IMPLEMENTED,
     [0x5a]          = IMPLEMENTED,
@@ -77,7 +79,8 @@ const uint8_t scsi_disk_command_flags[0x100] = {
 };
 
 uint64_t scsi_disk_mode_sense_page_flags = (GPMODEP_FORMAT_DEVICE_PAGE | GPMODEP_RIGID_DISK_PAGE |
-                                            GPMODEP_UNK_VENDOR_PAGE | GPMODEP_ALL_PAGES);
+                                            GPMODEP_CACHING_PAGE | GPMODEP_UNK_VENDOR_PAGE |
+                                            GPMODEP_ALL_PAGES);
 
 static const mode_sense_pages_t scsi_disk_mode_sense_pages_default = {
     { [0x03] = { GPMODE_FORMAT_DEVICE_PAGE,           0x16, 0x00, 0x01, 0x00, 0x01, 0x00, 0x01,
@@ -86,6 +89,9 @@ static const mode_sense_pages_t scsi_disk_mode_sense_pages_default = {
       [0x04] = { GPMODE_RIGID_DISK_PAGE,              0x16, 0x00, 0x10, 0x00, 0x40, 0x00, 0x00,
                   0x00,                               0x00, 0x00, 0x00, 0x00, 0xc8, 0xff, 0xff,
                   0xff,                               0x00, 0x00, 0x00, 0x15, 0x18, 0x00, 0x00 },
+      [0x08] = { GPMODE_CACHING_PAGE,                 0x12, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                 0x00,                                0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                 0x00,                                0x00, 0x00, 0x00 },
       [0x30] = { GPMODE_UNK_VENDOR_PAGE | 0x80,       0x16, '8' , '6' , 'B' , 'o' , 'x' , ' ' ,
                   ' ' ,                               ' ' , ' ' , ' ' , ' ' , ' ' , ' ' , ' ' ,
                   ' ' ,                               ' ' , ' ' , ' ' , ' ' , ' ' , ' ' , ' '  } }
@@ -98,6 +104,9 @@ static const mode_sense_pages_t scsi_disk_mode_sense_pages_changeable = {
       [0x04] = { GPMODE_RIGID_DISK_PAGE,              0x16, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
                  0x00,                                0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
                  0x00,                                0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+      [0x08] = { GPMODE_CACHING_PAGE,                 0x12, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                 0x00,                                0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                 0x00,                                0x00, 0x00, 0x00 },
       [0x30] = { GPMODE_UNK_VENDOR_PAGE | 0x80,       0x16, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
                  0xff,                                0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
                  0xff,                                0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff } }
@@ -219,6 +228,13 @@ uint8_t
 scsi_disk_mode_sense_read(const scsi_disk_t *dev, const uint8_t pgctl,
                           const uint8_t page, const uint8_t pos)
 {
+    /* Caching page, WCE (byte 2 bit 2) follows the write cache of the image. */
+    if ((page == GPMODE_CACHING_PAGE) && (pos == 2)) {
+        if (pgctl == 0 || pgctl == 3)
+            return hdd_image_get_write_cache(dev->id) ? 0x04 : 0x00;
+        return hdd_image_write_cache_supported(dev->id) ? 0x04 : 0x00;
+    }
+
     if (pgctl == 1)
         return scsi_disk_mode_sense_pages_changeable.pages[page][pos];
 
@@ -273,6 +289,8 @@ scsi_disk_mode_sense_read(const scsi_disk_t *dev, const uint8_t pgctl,
             default:
                 break;
         }
+    else if (page == GPMODE_CACHING_PAGE)
+        return scsi_disk_mode_sense_pages_default.pages[page][pos];
     else
         switch (pgctl) {
             case 0:
@@ -759,9 +777,155 @@ scsi_disk_data_phase_error(scsi_disk_t *dev, const uint32_t info)
     scsi_disk_cmd_error(dev);
 }
 
+/*
+   Claim the S/G list the host adapter offers for the current command, if
+   it covers all the requested blocks, so they move straight between the
+   image and guest memory.
+ */
+static int
+scsi_disk_sg_claim(const scsi_disk_t *dev, const int out)
+{
+    const uint8_t   scsi_bus = (dev->drv->scsi_id >> 4) & 0x0f;
+    const uint8_t   scsi_id  = dev->drv->scsi_id & 0x0f;
+    scsi_sg_list_t *sg;
+
+    if (dev->drv->bus_type != HDD_BUS_SCSI)
+        return 0;
+
+    sg = scsi_devices[scsi_bus][scsi_id].sg;
+    if ((sg == NULL) || !(out ? sg->out : sg->in) ||
+        (sg->length < ((uint32_t) dev->requested_blocks << 9)))
+        return 0;
+
+    sg->done = 1;
+    return 1;
+}
+
+static scsi_sg_list_t *
+scsi_disk_sg_claimed(const scsi_disk_t *dev)
+{
+    const uint8_t   scsi_bus = (dev->drv->scsi_id >> 4) & 0x0f;
+    const uint8_t   scsi_id  = dev->drv->scsi_id & 0x0f;
+    scsi_sg_list_t *sg;
+
+    if (dev->drv->bus_type != HDD_BUS_SCSI)
+        return NULL;
+
+    sg = scsi_devices[scsi_bus][scsi_id].sg;
+
+    return ((sg != NULL) && sg->done) ? sg : NULL;
+}
+
+/* Copy len bytes between buf and the S/G list, from entry and offset on. */
+static void
+scsi_disk_sg_copy(const scsi_sg_list_t *sg, int *entry, uint32_t *offset,
+                  uint8_t *buf, const uint32_t len, const int out)
+{
+    uint32_t pos = 0;
+    uint32_t chunk;
+
+    while (pos < len) {
+        if (*offset >= sg->entries[*entry].len) {
+            (*entry)++;
+            *offset = 0;
+            continue;
+        }
+
+        chunk = MIN(len - pos, sg->entries[*entry].len - *offset);
+        if (out)
+            dma_bm_read(sg->entries[*entry].addr + *offset, &buf[pos], chunk, sg->transfer_size);
+        else
+            dma_bm_write(sg->entries[*entry].addr + *offset, &buf[pos], chunk, sg->transfer_size);
+
+        pos += chunk;
+        *offset += chunk;
+    }
+}
+
+/*
+   Read or write the requested blocks directly in guest memory, only the
+   sectors straddling two segments or hitting MMIO go through a bounce
+   buffer.
+ */
+static int
+scsi_disk_sg_blocks(scsi_disk_t *dev, const scsi_sg_list_t *sg, const int out)
+{
+    uint8_t  bounce[512];
+    uint32_t sector = dev->sector_pos;
+    uint32_t left   = dev->requested_blocks;
+    uint32_t offset = 0;
+    uint32_t addr;
+    uint32_t len;
+    uint32_t n;
+    uint8_t *p;
+    int      entry  = 0;
+    int      ret;
+
+    while (left > 0) {
+        if (offset >= sg->entries[entry].len) {
+            entry++;
+            offset = 0;
+            continue;
+        }
+
+        addr = sg->entries[entry].addr + offset;
+        p    = dma_bm_get_ptr(addr, MIN(sg->entries[entry].len - offset, left << 9),
+                              sg->transfer_size, &len, !out);
+        n    = len >> 9;
+
+        if ((p != NULL) && n) {
+            if (out)
+                ret = hdd_image_write(dev->id, sector, n, p);
+            else {
+                ret = hdd_image_read(dev->id, sector, n, p);
+                dma_bm_written(addr, n << 9);
+            }
+            offset += n << 9;
+        } else {
+            n = 1;
+            if (out) {
+                scsi_disk_sg_copy(sg, &entry, &offset, bounce, 512, 1);
+                ret = hdd_image_write(dev->id, sector, 1, bounce);
+            } else {
+                ret = hdd_image_read(dev->id, sector, 1, bounce);
+                scsi_disk_sg_copy(sg, &entry, &offset, bounce, 512, 0);
+            }
+        }
+
+        if (ret < 0)
+            return -1;
+
+        sector += n;
+        left -= n;
+    }
+
+    return 1;
+}
+
+/* Whether the current write has to reach the image before it completes,
+   because of FUA or because the data is to be verified on the medium. */
+static int
+scsi_disk_write_is_fua(const scsi_disk_t *dev)
+{
+    switch (dev->current_cdb[0]) {
+        case GPCMD_WRITE_10:
+        case GPCMD_WRITE_12:
+            return !!(dev->current_cdb[1] & 0x08);
+        case GPCMD_WRITE_AND_VERIFY_10:
+        case GPCMD_WRITE_AND_VERIFY_12:
+            return 1;
+
+        default:
+            return 0;
+    }
+}
+
 static int
 scsi_disk_blocks(scsi_disk_t *dev, int32_t *len, UNUSED(int first_batch), const int out)
 {
+    const scsi_sg_list_t *sg;
+    int                   ret;
+
     const uint32_t medium_size = hdd_image_get_last_sector(dev->id) + 1;
 
     *len = 0;
@@ -783,23 +947,27 @@ scsi_disk_blocks(scsi_disk_t *dev, int32_t *len, UNUSED(int first_batch), const
 
     *len = dev->requested_blocks << 9;
 
-    for (int i = 0; i < dev->requested_blocks; i++) {
-        if (out) {
-            if (hdd_image_write(dev->id, dev->sector_pos, 1, dev->temp_buffer +
-                                (i << 9)) < 0) {
-                scsi_disk_write_error(dev);
-                return -1;
-            }
-        } else {
-            if (hdd_image_read(dev->id, dev->sector_pos, 1, dev->temp_buffer +
-                               (i << 9)) < 0) {
-                scsi_disk_read_error(dev);
-                return -1;
-            }
-        }
-        dev->sector_pos++;
+    sg = scsi_disk_sg_claimed(dev);
+    if (sg != NULL)
+        ret = scsi_disk_sg_blocks(dev, sg, out);
+    else if (out)
+        ret = hdd_image_write(dev->id, dev->sector_pos, dev->requested_blocks, dev->temp_buffer);
+    else
+        ret = hdd_image_read(dev->id, dev->sector_pos, dev->requested_blocks, dev->temp_buffer);
+
+    if ((ret >= 0) && out && scsi_disk_write_is_fua(dev) && hdd_image_get_write_cache(dev->id))
+        ret = hdd_image_flush(dev->id);
+
+    if (ret < 0) {
+        if (out)
+            scsi_disk_write_error(dev);
+        else
+            scsi_disk_read_error(dev);
+        return -1;
     }
 
+    dev->sector_pos += dev->requested_blocks;
+
     scsi_disk_log(dev->log, "%s %i bytes of blocks...\n", out ? "Written" : "Read", *len);
 
     dev->sector_len -= dev->requested_blocks;
@@ -1106,7 +1274,8 @@ scsi_disk_command(scsi_common_t *sc, const uint8_t *cdb)
                     dev->requested_blocks = max_len;
 
                     dev->packet_len = max_len * alloc_length;
-                    scsi_disk_buf_alloc(dev, dev->packet_len);
+                    if (!scsi_disk_sg_claim(dev, 0))
+                        scsi_disk_buf_alloc(dev, dev->packet_len);
 
                     dev->drv->seek_pos = dev->sector_pos;
                     dev->drv->seek_len = dev->sector_len;
@@ -1207,7 +1376,8 @@ scsi_disk_command(scsi_common_t *sc, const uint8_t *cdb)
                     dev->requested_blocks = max_len;
 
                     dev->packet_len = max_len * alloc_length;
-                    scsi_disk_buf_alloc(dev, dev->packet_len);
+                    if (!scsi_disk_sg_claim(dev, 1))
+                        scsi_disk_buf_alloc(dev, dev->packet_len);
 
                     dev->requested_blocks = max_len;
                     dev->packet_len       = max_len << 9;
@@ -1291,6 +1461,7 @@ scsi_disk_command(scsi_common_t *sc, const uint8_t *cdb)
                     len = alloc_length;
                 dev->temp_buffer[0] = len - 1;
                 dev->temp_buffer[1] = 0;
+                dev->temp_buffer[2] = 0x10; /* DPOFUA, FUA is honored. */
                 if (block_desc)
                     dev->temp_buffer[3] = 8;
             } else {
@@ -1300,6 +1471,7 @@ scsi_disk_command(scsi_common_t *sc, const uint8_t *cdb)
                 dev->temp_buffer[0] = (len - 2) >> 8;
                 dev->temp_buffer[1] = (len - 2) & 255;
                 dev->temp_buffer[2] = 0;
+                dev->temp_buffer[3] = 0x10; /* DPOFUA, FUA is honored. */
                 if (block_desc) {
                     dev->temp_buffer[6] = 0;
                     dev->temp_buffer[7] = 8;
@@ -1477,6 +1649,17 @@ atapi_out:
             scsi_disk_command_complete(dev);
             break;
 
+        case GPCMD_SYNCHRONIZE_CACHE:
+            /* The whole cache is flushed, whatever range is given. */
+            if (hdd_image_flush(dev->id) < 0) {
+                scsi_disk_write_error(dev);
+                return;
+            }
+
+            scsi_disk_set_phase(dev, SCSI_PHASE_STATUS);
+            scsi_disk_command_complete(dev);
+            break;
+
         case GPCMD_READ_CDROM_CAPACITY:
             scsi_disk_buf_alloc(dev, 8);
 
@@ -1624,7 +1807,22 @@ scsi_disk_phase_data_out(scsi_common_t *sc)
 
                 if (!(scsi_disk_mode_sense_page_flags & (1LL << ((uint64_t) page))))
                     error |= 1;
-                else  for (i = 0; i < page_len; i++) {
+                else if (page == GPMODE_CACHING_PAGE) {
+                    /* Only WCE can be changed. */
+                    for (i = 0; i < page_len; i++) {
+                        val = dev->temp_buffer[pos + i];
+                        if ((val & ~((i == 0) ? 0x04 : 0x00)) != scsi_disk_mode_sense_pages_default.pages[page][i + 2]) {
+                            scsi_disk_invalid_field_pl(dev, val);
+                            error |= 1;
+                            break;
+                        }
+                    }
+                    if (!error && (page_len > 0) &&
+                        (hdd_image_set_write_cache(dev->id, dev->temp_buffer[pos] & 0x04) < 0)) {
+                        scsi_disk_invalid_field_pl(dev, dev->temp_buffer[pos]);
+                        error |= 1;
+                    }
+                } else  for (i = 0; i < page_len; i++) {
                     const uint8_t old  = dev->ms_pages_saved.pages[page][i + 2];
                     const uint8_t ch   = scsi_disk_mode_sense_pages_changeable.pages[page][i + 2];
 
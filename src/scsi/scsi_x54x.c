@@ -722,9 +722,11 @@ x54x_get_length(x54x_t *dev, Req_t *req, int Is24bit)
                 x54x_rd_sge(dev, Is24bit, DataPointer + i, &SGBuffer);
 
                 DataToTransfer += SGBuffer.Segment;
+                scsi_sg_add(&dev->sg, SGBuffer.SegmentPointer, SGBuffer.Segment);
             }
             return DataToTransfer;
         } else if (req->CmdBlock.common.Opcode == SCSI_INITIATOR_COMMAND || req->CmdBlock.common.Opcode == SCSI_INITIATOR_COMMAND_RES) {
+            scsi_sg_add(&dev->sg, DataPointer, DataLength);
             return DataLength;
         } else {
             return 0;
@@ -789,6 +791,15 @@ x54x_buf_dma_transfer(x54x_t *dev, Req_t *req, int Is24bit, int TransferLength,
     x54x_log("Data Buffer %s: length %d (%u), pointer 0x%04X\n",
              dir ? "write" : "read", BufLen, DataLength, DataPointer);
 
+    if (dev->sg.done) {
+        /* The device moved the data itself, only account for reading
+           the S/G list again. */
+        x54x_log("Data moved by the device\n");
+        if ((req->CmdBlock.common.Opcode == SCATTER_GATHER_COMMAND) || (req->CmdBlock.common.Opcode == SCATTER_GATHER_COMMAND_RES))
+            x54x_add_to_period(dev, DataLength);
+        return;
+    }
+
     if ((req->CmdBlock.common.ControlByte != 0x03) && TransferLength && BufLen) {
         if ((req->CmdBlock.common.Opcode == SCATTER_GATHER_COMMAND) || (req->CmdBlock.common.Opcode == SCATTER_GATHER_COMMAND_RES)) {
 
@@ -889,6 +900,16 @@ SenseBufferFree(x54x_t *dev, Req_t *req, int Copy)
     }
 }
 
+/* Make sure no device still refers to the S/G list of an aborted command. */
+static void
+x54x_sg_detach(x54x_t *dev)
+{
+    for (uint8_t i = 0; i < SCSI_ID_MAX; i++) {
+        if (scsi_devices[dev->bus][i].sg == &dev->sg)
+            scsi_devices[dev->bus][i].sg = NULL;
+    }
+}
+
 static void
 x54x_scsi_cmd(x54x_t *dev)
 {
@@ -899,6 +920,11 @@ x54x_scsi_cmd(x54x_t *dev)
 
     sd = &scsi_devices[dev->bus][req->TargetID];
 
+    /* Let the device move the data straight to or from guest memory. */
+    scsi_sg_reset(&dev->sg, dev->transfer_size,
+                  (req->CmdBlock.common.ControlByte == 0x00) || (req->CmdBlock.common.ControlByte == CCB_DATA_XFER_IN),
+                  (req->CmdBlock.common.ControlByte == 0x00) || (req->CmdBlock.common.ControlByte == CCB_DATA_XFER_OUT));
+
     target_cdb_len       = 12;
     dev->target_data_len = x54x_get_length(dev, req, bit24);
 
@@ -926,15 +952,17 @@ x54x_scsi_cmd(x54x_t *dev)
     dev->Residue = 0;
 
     sd->buffer_length = dev->target_data_len;
+    sd->sg            = &dev->sg;
 
     scsi_device_command_phase0(sd, dev->temp_cdb);
     dev->scsi_cmd_phase = sd->phase;
 
     x54x_log("Control byte: %02X\n", (req->CmdBlock.common.ControlByte == 0x03));
 
-    if (dev->scsi_cmd_phase == SCSI_PHASE_STATUS)
+    if (dev->scsi_cmd_phase == SCSI_PHASE_STATUS) {
+        sd->sg                  = NULL;
         dev->callback_sub_phase = 3;
-    else
+    } else
         dev->callback_sub_phase = 2;
 
     x54x_log("scsi_devices[%02i][%02i].Status = %02X\n", dev->bus, req->TargetID, sd->status);
@@ -962,6 +990,7 @@ x54x_scsi_cmd_phase1(x54x_t *dev)
         }
     }
 
+    sd->sg                  = NULL;
     dev->callback_sub_phase = 3;
     x54x_log("scsi_devices[%02xi][%02i].Status = %02X\n", dev->bus, req->TargetID, sd->status);
 }
@@ -1435,6 +1464,7 @@ x54x_reset(x54x_t *dev)
     dev->MailboxOutPosCur     = 0;
 
     /* Reset all devices on controller reset. */
+    x54x_sg_detach(dev);
     for (uint8_t i = 0; i < 16; i++)
         scsi_device_reset(&scsi_devices[dev->bus][i]);
 
@@ -1929,6 +1959,9 @@ x54x_close(void *priv)
         dev->MailboxCount = dev->BIOSMailboxCount = 0;
         dev->MailboxReq = dev->BIOSMailboxReq = 0;
 
+        x54x_sg_detach(dev);
+        scsi_sg_free(&dev->sg);
+
         if (dev->ven_data)
             free(dev->ven_data);
 
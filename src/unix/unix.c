@@ -445,6 +445,58 @@ plat_munmap(void *ptr, size_t size)
     munmap(ptr, size);
 }
 
+void
+plat_mmap_advise(void *ptr, size_t size, int flags)
+{
+#ifdef MADV_HUGEPAGE
+    if ((flags & PLAT_MMAP_HUGEPAGE) && madvise(ptr, size, MADV_HUGEPAGE))
+        pclog("Huge pages not available: %s\n", strerror(errno));
+#endif
+#ifdef MADV_MERGEABLE
+    if ((flags & PLAT_MMAP_MERGEABLE) && madvise(ptr, size, MADV_MERGEABLE))
+        pclog("Page merging not available: %s\n", strerror(errno));
+#endif
+}
+
+/* Give the memory back to the host, returns 0 if it now reads as zero. */
+int
+plat_mmap_discard(void *ptr, size_t size)
+{
+#if defined(__linux__) && defined(MADV_DONTNEED)
+    return madvise(ptr, size, MADV_DONTNEED) ? -1 : 0;
+#else
+    return -1;
+#endif
+}
+
+int
+plat_mmap_resident(void *ptr, size_t size, size_t *resident)
+{
+#ifdef __HAIKU__
+    return -1;
+#else
+    long           page_size = sysconf(_SC_PAGESIZE);
+    size_t         pages     = (size + page_size - 1) / page_size;
+    unsigned char *vec       = malloc(pages);
+    int            ret       = -1;
+
+    if (vec == NULL)
+        return -1;
+
+    if (!mincore(ptr, size, (void *) vec)) {
+        *resident = 0;
+        for (size_t c = 0; c < pages; c++) {
+            if (vec[c] & 1)
+                *resident += page_size;
+        }
+        ret = 0;
+    }
+    free(vec);
+
+    return ret;
+#endif
+}
+
 uint64_t
 plat_timer_read(void)
 {
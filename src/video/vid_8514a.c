@@ -3697,7 +3697,6 @@ ibm8514_poll(void *priv)
 
                     if (dev->firstline == 2000) {
                         dev->firstline = dev->displine;
-                        video_wait_for_buffer_monitor(svga->monitor_index);
                     }
 
                     if (dev->hwcursor_on)
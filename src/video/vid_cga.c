@@ -566,7 +566,6 @@ cga_poll(void *priv)
         if (cga->cgadispon) {
             if (cga->displine < cga->firstline) {
                 cga->firstline = cga->displine;
-                video_wait_for_buffer();
             }
             cga->lastline = cga->displine;
             switch (cga->double_type) {
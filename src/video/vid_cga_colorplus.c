@@ -153,7 +153,6 @@ colorplus_poll(void *priv)
         if (colorplus->cga.cgadispon) {
             if (colorplus->cga.displine < colorplus->cga.firstline) {
                 colorplus->cga.firstline = colorplus->cga.displine;
-                video_wait_for_buffer();
             }
             colorplus->cga.lastline = colorplus->cga.displine;
             /* Left / right border */
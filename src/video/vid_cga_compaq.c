@@ -116,7 +116,6 @@ compaq_cga_poll(void *priv)
         if (dev->cgadispon) {
             if (dev->displine < dev->firstline) {
                 dev->firstline = dev->displine;
-                video_wait_for_buffer();
                 compaq_cga_log("Firstline %i\n", dev->firstline);
             }
             dev->lastline = dev->displine;
@@ -290,9 +290,6 @@ compaq_plasma_poll(void *priv)
             self->cga.cgastat |= 1;
             self->cga.linepos = 1;
             if (self->cga.cgadispon) {
-                if (self->cga.displine == 0)
-                    video_wait_for_buffer();
-
                 /* 80-col */
                 if (self->cga.cgamode & 0x01) {
                     scanline = self->cga.displine & 0x0f;
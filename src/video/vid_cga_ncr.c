@@ -178,7 +178,6 @@ nga_poll(void *priv)
             if (nga->cga.cgadispon) {
                 if (nga->cga.displine < nga->cga.firstline) {
                     nga->cga.firstline = nga->cga.displine;
-                    video_wait_for_buffer();
                 }
                 nga->cga.lastline = nga->cga.displine;
                 /* 80-col */
@@ -576,7 +576,6 @@ quadcolor_poll(void *priv)
         if (quadcolor->cgadispon) {
             if (quadcolor->displine < quadcolor->firstline) {
                 quadcolor->firstline = quadcolor->displine;
-                video_wait_for_buffer();
             }
             quadcolor->lastline = quadcolor->displine;
             switch (quadcolor->double_type) {
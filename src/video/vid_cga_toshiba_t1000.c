@@ -471,10 +471,6 @@ t1000_poll(void *priv)
         t1000->cga.cgastat |= 1;
         t1000->linepos = 1;
         if (t1000->dispon) {
-            if (t1000->displine == 0) {
-                video_wait_for_buffer();
-            }
-
             /* Graphics */
             if (t1000->cga.cgamode & 0x02) {
                 if (t1000->cga.cgamode & CGA_MODE_FLAG_HIGHRES_GRAPHICS)
@@ -490,10 +490,6 @@ t3100e_poll(void *priv)
         t3100e->cga.cgastat |= 1;
         t3100e->linepos = 1;
         if (t3100e->dispon) {
-            if (t3100e->displine == 0) {
-                video_wait_for_buffer();
-            }
-
             /* Graphics */
             if (t3100e->cga.cgamode & CGA_MODE_FLAG_GRAPHICS) {
                 if (t3100e->cga.cgamode & CGA_MODE_FLAG_HIGHRES_GRAPHICS)
@@ -665,7 +665,6 @@ v6355_poll(void *priv)
         if (v6355->cgadispon) {
             if (v6355->displine < v6355->firstline) {
                 v6355->firstline = v6355->displine;
-                video_wait_for_buffer();
             }
 
             v6355->lastline = v6355->displine;
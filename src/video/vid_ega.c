@@ -862,7 +862,6 @@ ega_poll(void *priv)
             ega->memaddr &= ega->vrammask;
             if (ega->firstline == 2000) {
                 ega->firstline = ega->displine;
-                video_wait_for_buffer();
             }
 
             old_ma = ega->memaddr;
@@ -498,10 +498,6 @@ f82c425_poll(void *priv)
         f82c425->cga.cgastat |= 1;
         f82c425->linepos = 1;
         if (f82c425->dispon) {
-            if (f82c425->displine == 0) {
-                video_wait_for_buffer();
-            }
-
             switch (f82c425->cga.cgamode & 0x13) {
                 case 0x12:
                     f82c425_cgaline6(f82c425);
@@ -308,7 +308,6 @@ hercules_poll(void *priv)
         if (dev->dispon) {
             if (dev->displine < dev->firstline) {
                 dev->firstline = dev->displine;
-                video_wait_for_buffer();
             }
             dev->lastline = dev->displine;
 
@@ -162,7 +162,6 @@ mda_poll(void *priv)
         if (mda->dispon) {
             if (mda->displine < mda->firstline) {
                 mda->firstline = mda->displine;
-                video_wait_for_buffer();
             }
             mda->lastline = mda->displine;
 
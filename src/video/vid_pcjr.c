@@ -547,7 +547,6 @@ vid_poll(void *priv)
         if (pcjr->dispon) {
             if (pcjr->displine < pcjr->firstline) {
                 pcjr->firstline = pcjr->displine;
-                video_wait_for_buffer();
             }
             pcjr->lastline = pcjr->displine;
             switch (pcjr->double_type) {
@@ -3024,7 +3024,6 @@ da2_poll(void *priv)
             da2->memaddr &= da2->vram_display_mask;
             if (da2->firstline == 2000) {
                 da2->firstline = da2->displine;
-                video_wait_for_buffer();
             }
 
             if (!da2->override)
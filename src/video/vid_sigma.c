@@ -617,7 +617,6 @@ sigma_poll(void *priv)
         if (sigma->cgadispon) {
             if (sigma->displine < sigma->firstline) {
                 sigma->firstline = sigma->displine;
-                video_wait_for_buffer();
             }
             sigma->lastline = sigma->displine;
 
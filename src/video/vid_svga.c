@@ -1214,10 +1214,8 @@ svga_recalctimings(svga_t *svga)
             int x_add   = enable_overscan ? svga->monitor->mon_overscan_x : 0;
             int y_start = enable_overscan ? 0 : (svga->monitor->mon_overscan_y >> 1);
             int x_start = enable_overscan ? 0 : (svga->monitor->mon_overscan_x >> 1);
-            video_wait_for_buffer_monitor(svga->monitor_index);
             memset(svga->monitor->target_buffer->dat, 0, (size_t) svga->monitor->target_buffer->w * svga->monitor->target_buffer->h * 4);
             video_blit_memtoscreen_monitor(x_start, y_start, svga->monitor->mon_xsize + x_add, svga->monitor->mon_ysize + y_add, svga->monitor_index);
-            video_wait_for_buffer_monitor(svga->monitor_index);
             svga->dpms_ui = 1;
             ui_sb_set_text_w(plat_get_string(STRING_MONITOR_SLEEP));
         }
@@ -1381,7 +1379,6 @@ svga_poll(void *priv)
             svga->memaddr &= svga->vram_display_mask;
             if (svga->firstline == 2000) {
                 svga->firstline = svga->displine;
-                video_wait_for_buffer_monitor(svga->monitor_index);
             }
 
             if (svga->hwcursor_on || svga->dac_hwcursor_on || svga->overlay_on)
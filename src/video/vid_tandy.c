@@ -595,7 +595,6 @@ vid_poll(void *priv)
         if (vid->dispon) {
             if (vid->displine < vid->firstline) {
                 vid->firstline = vid->displine;
-                video_wait_for_buffer();
             }
             vid->lastline = vid->displine;
             switch (vid->double_type) {
@@ -542,7 +542,6 @@ voodoo_callback(void *priv)
 
                 if (voodoo->line < voodoo->dirty_line_low) {
                     voodoo->dirty_line_low = voodoo->line;
-                    video_wait_for_buffer_monitor(voodoo->monitor_index);
                 }
                 if (voodoo->line > voodoo->dirty_line_high)
                     voodoo->dirty_line_high = voodoo->line;
@@ -774,10 +774,6 @@ wy700_poll(void *priv)
         wy700->mda_stat |= 1;
         wy700->linepos = 1;
         if (wy700->dispon) {
-            if (wy700->displine == 0) {
-                video_wait_for_buffer();
-            }
-
             if (wy700->wy700_mode & 0x80)
                 mode = wy700->wy700_mode & 0xF0;
             else
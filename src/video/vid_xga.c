@@ -3326,7 +3326,6 @@ xga_poll(void *priv)
 
                     if (xga->firstline == 2000) {
                         xga->firstline = xga->displine;
-                        video_wait_for_buffer_monitor(svga->monitor_index);
                     }
 
                     if (xga->hwcursor_on)
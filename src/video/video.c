@@ -232,17 +232,43 @@ const uint32_t shade[5][256] = {
     }
 };
 
+/*
+ * Frames are handed from the emulation thread to the blit thread without
+ * either one waiting for the other. The card always draws into the same
+ * target buffer, so the lines it doesn't redraw keep their contents, and
+ * completing a frame only publishes its rectangle. The blit thread then
+ * copies that rectangle into whichever of its two present buffers the
+ * blitter isn't reading, and hands it over once the blitter has called
+ * video_blit_complete_monitor() for the other one. A frame completed
+ * before the blit thread got to the previous one replaces it, and the
+ * previous one counts as dropped.
+ *
+ * The copy starts as soon as the blit thread wakes up, while the emulated
+ * display is in vertical blanking, so it is normally done before the card
+ * draws the first line of the next frame. If the blit thread runs late,
+ * the frame may pick up some lines of the next one.
+ */
+#define BLIT_BUFFERS 2
+
 typedef struct blit_data_struct {
     int x, y, w, h;
     int busy;
-    int buffer_in_use;
     int thread_run;
     int monitor_index;
 
+    bitmap_t     *buffers[BLIT_BUFFERS]; /* Owned by the blit thread. */
+    int           front;
+    atomic_ullong pending; /* Packed rectangle of the last frame, 0 if taken. */
+    atomic_int    front_in_use;
+
+    uint32_t stats_ticks;
+    int      stats_presented;
+    int      stats_dropped;
+
     thread_t *blit_thread;
     event_t  *wake_blit_thread;
     event_t  *blit_complete;
-    event_t  *buffer_not_in_use;
+    event_t  *front_released;
 } blit_data_t;
 
 static uint32_t cga_2_table[16];
@@ -273,13 +299,14 @@ video_setblit(void (*blit)(int, int, int, int, int))
     blit_func = blit;
 }
 
+/* Called by the blitter once it is done reading the front buffer. */
 void
 video_blit_complete_monitor(int monitor_index)
 {
-    blit_data_t *blit_data_ptr   = monitors[monitor_index].mon_blit_data_ptr;
-    blit_data_ptr->buffer_in_use = 0;
+    blit_data_t *blit_data_ptr = monitors[monitor_index].mon_blit_data_ptr;
 
-    thread_set_event(blit_data_ptr->buffer_not_in_use);
+    atomic_store(&blit_data_ptr->front_in_use, 0);
+    thread_set_event(blit_data_ptr->front_released);
 }
 
 void
@@ -292,16 +319,6 @@ video_wait_for_blit_monitor(int monitor_index)
     thread_reset_event(blit_data_ptr->blit_complete);
 }
 
-void
-video_wait_for_buffer_monitor(int monitor_index)
-{
-    blit_data_t *blit_data_ptr = monitors[monitor_index].mon_blit_data_ptr;
-
-    while (blit_data_ptr->buffer_in_use)
-        thread_wait_event(blit_data_ptr->buffer_not_in_use, -1);
-    thread_reset_event(blit_data_ptr->buffer_not_in_use);
-}
-
 static png_structp png_ptr[MONITORS_NUM];
 static png_infop   info_ptr[MONITORS_NUM];
 
@@ -439,17 +456,87 @@ video_transform_copy(void *__restrict _Dst, const void *__restrict _Src, size_t
     return _Dst;
 }
 
+/* Log the presented and dropped frame rates, about once per second. */
+static void
+blit_stats_update(blit_data_t *data, monitor_t *monitor)
+{
+    uint32_t ticks = plat_get_ticks();
+    int      presented;
+    int      dropped;
+
+    if ((ticks - data->stats_ticks) < 1000)
+        return;
+
+    presented = atomic_load(&monitor->mon_frames_presented);
+    dropped   = atomic_load(&monitor->mon_frames_dropped);
+    video_log("Monitor %i: %i frames/s presented, %i dropped\n", data->monitor_index,
+              presented - data->stats_presented, dropped - data->stats_dropped);
+
+    data->stats_ticks     = ticks;
+    data->stats_presented = presented;
+    data->stats_dropped   = dropped;
+}
+
 static void
 blit_thread(void *param)
 {
-    blit_data_t *data = param;
+    blit_data_t        *data    = param;
+    monitor_t          *monitor = &monitors[data->monitor_index];
+    const bitmap_t     *src;
+    bitmap_t           *next;
+    unsigned long long  pending;
+    int                 x;
+    int                 y;
+    int                 w;
+    int                 h;
+
     while (data->thread_run) {
         thread_wait_event(data->wake_blit_thread, -1);
         thread_reset_event(data->wake_blit_thread);
+
+        pending = atomic_exchange(&data->pending, 0);
+        if (!pending)
+            continue;
+
         MTR_BEGIN("video", "blit_thread");
 
-        if (blit_func)
+        data->busy = 1;
+
+        x = (int16_t) (pending & 0xffff);
+        y = (int16_t) ((pending >> 16) & 0xffff);
+        w = (int) ((pending >> 32) & 0xffff);
+        h = (int) ((pending >> 48) & 0xffff);
+
+        /* Only the blit rectangle is copied, into the present buffer the
+           blitter isn't reading; it may still be busy with the other one. */
+        src  = monitor->target_buffer;
+        next = data->buffers[data->front ^ 1];
+        if ((x >= 0) && (y >= 0) && (x < next->w) && (y < next->h)) {
+            for (int yy = y; (yy < (y + h)) && (yy < next->h); yy++)
+                memcpy(&next->line[yy][x], &src->line[yy][x], MIN(w, next->w - x) << 2);
+        }
+
+        while (atomic_load(&data->front_in_use) && data->thread_run)
+            thread_wait_event(data->front_released, -1);
+        thread_reset_event(data->front_released);
+        if (!data->thread_run) {
+            data->busy = 0;
+            break;
+        }
+
+        data->front           = data->front ^ 1;
+        data->x               = x;
+        data->y               = y;
+        data->w               = w;
+        data->h               = h;
+        monitor->front_buffer = next;
+
+        if (blit_func) {
+            atomic_store(&data->front_in_use, 1);
             blit_func(data->x, data->y, data->w, data->h, data->monitor_index);
+        }
+        atomic_fetch_add(&monitor->mon_frames_presented, 1);
+        blit_stats_update(data, monitor);
 
         data->busy = 0;
 
@@ -461,22 +548,23 @@ blit_thread(void *param)
 void
 video_blit_memtoscreen_monitor(int x, int y, int w, int h, int monitor_index)
 {
+    monitor_t         *monitor = &monitors[monitor_index];
+    blit_data_t        *data    = monitor->mon_blit_data_ptr;
+    unsigned long long  pending;
+
     MTR_BEGIN("video", "video_blit_memtoscreen");
 
     if ((w <= 0) || (h <= 0))
         return;
 
-    video_wait_for_blit_monitor(monitor_index);
-
-    monitors[monitor_index].mon_blit_data_ptr->busy          = 1;
-    monitors[monitor_index].mon_blit_data_ptr->buffer_in_use = 1;
-    monitors[monitor_index].mon_blit_data_ptr->x             = x;
-    monitors[monitor_index].mon_blit_data_ptr->y             = y;
-    monitors[monitor_index].mon_blit_data_ptr->w             = w;
-    monitors[monitor_index].mon_blit_data_ptr->h             = h;
-    monitors[monitor_index].mon_renderedframes++;
+    /* Publish the rectangle, replacing a frame the blit thread didn't get to. */
+    pending = (unsigned long long) (uint16_t) x | ((unsigned long long) (uint16_t) y << 16) |
+              ((unsigned long long) (uint16_t) w << 32) | ((unsigned long long) (uint16_t) h << 48);
+    if (atomic_exchange(&data->pending, pending))
+        atomic_fetch_add(&monitor->mon_frames_dropped, 1);
+    monitor->mon_renderedframes++;
 
-    thread_set_event(monitors[monitor_index].mon_blit_data_ptr->wake_blit_thread);
+    thread_set_event(data->wake_blit_thread);
     MTR_END("video", "video_blit_memtoscreen");
 }
 
@@ -856,11 +944,18 @@ video_monitor_init(int index)
     monitors[index].mon_unscaled_size_y                  = 480;
     monitors[index].mon_bpp                              = 8;
     monitors[index].mon_changeframecount                 = 2;
-    monitors[index].target_buffer                        = create_bitmap(2048, 2048);
     monitors[index].mon_blit_data_ptr                    = calloc(1, sizeof(blit_data_t));
+    for (int i = 0; i < BLIT_BUFFERS; i++)
+        monitors[index].mon_blit_data_ptr->buffers[i] = create_bitmap(2048, 2048);
+    monitors[index].mon_blit_data_ptr->front             = 1;
+    atomic_init(&monitors[index].mon_blit_data_ptr->pending, 0);
+    monitors[index].mon_blit_data_ptr->stats_ticks       = plat_get_ticks();
+    monitors[index].target_buffer                        = create_bitmap(2048, 2048);
+    monitors[index].front_buffer                         = monitors[index].mon_blit_data_ptr->buffers[1];
     monitors[index].mon_blit_data_ptr->wake_blit_thread  = thread_create_event();
     monitors[index].mon_blit_data_ptr->blit_complete     = thread_create_event();
-    monitors[index].mon_blit_data_ptr->buffer_not_in_use = thread_create_event();
+    monitors[index].mon_blit_data_ptr->front_released    = thread_create_event();
+    atomic_init(&monitors[index].mon_blit_data_ptr->front_in_use, 0);
     monitors[index].mon_blit_data_ptr->thread_run        = 1;
     monitors[index].mon_blit_data_ptr->monitor_index     = index;
     monitors[index].mon_pal_lookup                       = calloc(sizeof(uint32_t), 256);
@@ -869,6 +964,8 @@ video_monitor_init(int index)
     monitors[index].mon_vid_type                         = VIDEO_FLAG_TYPE_NONE;
     atomic_init(&doresize_monitors[index], 0);
     atomic_init(&monitors[index].mon_screenshots, 0);
+    atomic_init(&monitors[index].mon_frames_presented, 0);
+    atomic_init(&monitors[index].mon_frames_dropped, 0);
     if (index >= 1)
         ui_init_monitor(index);
     monitors[index].mon_blit_data_ptr->blit_thread = thread_create(blit_thread, monitors[index].mon_blit_data_ptr);
@@ -882,19 +979,26 @@ video_monitor_close(int monitor_index)
     }
     monitors[monitor_index].mon_blit_data_ptr->thread_run = 0;
     thread_set_event(monitors[monitor_index].mon_blit_data_ptr->wake_blit_thread);
+    thread_set_event(monitors[monitor_index].mon_blit_data_ptr->front_released);
     thread_wait(monitors[monitor_index].mon_blit_data_ptr->blit_thread);
     if (monitor_index >= 1)
         ui_deinit_monitor(monitor_index);
-    thread_destroy_event(monitors[monitor_index].mon_blit_data_ptr->buffer_not_in_use);
+    video_log("Monitor %i: %i frames presented, %i dropped\n", monitor_index,
+              atomic_load(&monitors[monitor_index].mon_frames_presented),
+              atomic_load(&monitors[monitor_index].mon_frames_dropped));
+    thread_destroy_event(monitors[monitor_index].mon_blit_data_ptr->front_released);
     thread_destroy_event(monitors[monitor_index].mon_blit_data_ptr->blit_complete);
     thread_destroy_event(monitors[monitor_index].mon_blit_data_ptr->wake_blit_thread);
+    for (int i = 0; i < BLIT_BUFFERS; i++)
+        destroy_bitmap(monitors[monitor_index].mon_blit_data_ptr->buffers[i]);
     free(monitors[monitor_index].mon_blit_data_ptr);
+    destroy_bitmap(monitors[monitor_index].target_buffer);
     if (!monitors[monitor_index].mon_pal_lookup_static)
         free(monitors[monitor_index].mon_pal_lookup);
     if (!monitors[monitor_index].mon_cga_palette_static)
         free(monitors[monitor_index].mon_cga_palette);
-    destroy_bitmap(monitors[monitor_index].target_buffer);
     monitors[monitor_index].target_buffer = NULL;
+    monitors[monitor_index].front_buffer  = NULL;
     memset(&monitors[monitor_index], 0, sizeof(monitor_t));
 }
 